@@ -80,7 +80,11 @@
              ARG_STRING,                                \
              NULL,                                      \
              "Directory to log senone score files to"   \
-             }
+             },                                         \
+    { "-sencomp",                                       \
+            ARG_BOOLEAN,                                \
+            "no",                                       \
+            "Compress senone score files and index their frames" }
 
 /** Options defining beam width parameters for tuning the search. */
 #define POCKETSPHINX_BEAM_OPTIONS                                       \
@@ -143,6 +147,10 @@
       ARG_BOOLEAN,                                                                              \
       "yes",                                                                                    \
       "Run forward lexicon-tree search (1st pass)" },                                           \
+{ "-lmla",                                                                                      \
+      ARG_BOOLEAN,                                                                              \
+      "no",                                                                                     \
+      "Apply unigram language model lookahead in the lexicon-tree search" },                    \
 { "-fwdflat",                                                                                   \
       ARG_BOOLEAN,                                                                              \
       "yes",                                                                                    \
@@ -159,6 +167,10 @@
       ARG_INT32,                                                                                \
       "5000",                                                                                   \
       "Initial backpointer table size" },                                                       \
+{ "-bptblgc",                                                                                   \
+      ARG_INT32,                                                                                \
+      "0",                                                                                      \
+      "Compact the backpointer table every N frames (or 0 for never), needs -fwdflat no -bestpath no" }, \
 { "-maxwpf",                                                                                    \
       ARG_INT32,                                                                                \
       "-1",                                                                                     \
@@ -366,14 +378,46 @@
       ARG_BOOLEAN,                                                              \
       "yes",                                                                    \
       "Use memory-mapped I/O (if possible) for model files" },                  \
+{ "-amcache",                                                                   \
+      ARG_STRING,                                                               \
+      NULL,                                                                     \
+      "Compiled continuous acoustic model file (written if missing or out of date)" }, \
+{ "-pipeline",                                                                  \
+      ARG_BOOLEAN,                                                              \
+      "no",                                                                     \
+      "Compute features on a separate thread, overlapping with search" },       \
+{ "-nthreads",                                                                  \
+      ARG_INT32,                                                                \
+      "1",                                                                      \
+      "Number of threads to compute senone scores on" },                        \
 { "-ds",                                                                        \
       ARG_INT32,                                                                \
       "1",                                                                      \
       "Frame GMM computation downsampling ratio" },                             \
+{ "-gmm_batch",                                                                 \
+      ARG_INT32,                                                                \
+      "1",                                                                      \
+      "Number of frames to compute senone scores for at once with -compallsen" }, \
+{ "-ds_thresh",                                                                 \
+      ARG_FLOAT32,                                                              \
+      "0",                                                                      \
+      "Reuse senone scores of a recent frame if features differ by at most this (RMS, 0 to disable)" }, \
+{ "-ds_max",                                                                    \
+      ARG_INT32,                                                                \
+      "2",                                                                      \
+      "Most consecutive frames to reuse senone scores for with -ds_thresh" },   \
 { "-topn",                                                                      \
       ARG_INT32,                                                                \
       "4",                                                                      \
       "Maximum number of top Gaussians to use in scoring." },                   \
+{ "-ci_pbeam",                                                                  \
+      ARG_FLOAT64,                                                              \
+      "0",                                                                      \
+      "Beam on CI senone scores for computing CD senones in continuous models (0 to compute all)" }, \
+{ "-quantgau",                                                                  \
+      ARG_BOOLEAN,                                                              \
+      "no",                                                                     \
+      "Compute continuous model Gaussians in 16-bit integers (less accurate)" }, \
 { "-topn_beam",                                                                 \
       ARG_STRING,                                                               \
       "0",                                                                     \
@@ -308,6 +308,19 @@ long ps_decode_raw(ps_decoder_t *ps, FILE *rawfh,
 POCKETSPHINX_EXPORT
 int ps_decode_senscr(ps_decoder_t *ps, FILE *senfh);
 
+/**
+ * Decode a senone score dump file by name.
+ *
+ * Compressed dump files (see -sencomp) are memory-mapped if -mmap is
+ * set, so that no time is spent reading them.
+ *
+ * @param ps Decoder
+ * @param file Name of dump file.
+ * @return Number of frames read, or <0 on error.
+ */
+POCKETSPHINX_EXPORT
+int ps_decode_senscr_file(ps_decoder_t *ps, char const *file);
+
 /**
  * Start processing of the stream of speech. Channel parameters like
  * noise-level are maintained for the stream and reused among utterances.
@@ -418,6 +431,22 @@ char const *ps_get_hyp(ps_decoder_t *ps, int32 *out_best_score);
 POCKETSPHINX_EXPORT
 char const *ps_get_hyp_final(ps_decoder_t *ps, int32 *out_is_final);
 
+/**
+ * Get the part of the hypothesis that can no longer change.
+ *
+ * @note This is only known before the end of the utterance if the
+ * backpointer table is compacted during N-Gram search (see the
+ * -bptblgc option), which finds the words that all of the remaining
+ * paths agree on.
+ *
+ * @param ps Decoder.
+ * @param out_frame Output: last frame of the returned words, or -1.
+ * @return String containing the stable part of the hypothesis.  NULL
+ *         if no part of it is stable yet.
+ */
+POCKETSPHINX_EXPORT
+char const *ps_get_hyp_stable(ps_decoder_t *ps, int32 *out_frame);
+
 /**
  * Get posterior probability.
  *
@@ -594,6 +623,24 @@ POCKETSPHINX_EXPORT
 void ps_get_utt_time(ps_decoder_t *ps, double *out_nspeech,
                      double *out_ncpu, double *out_nwall);
 
+/**
+ * Get senone scoring information for the current utterance.
+ *
+ * With -ds_thresh, frames similar enough to a recently scored one
+ * reuse its senone scores instead of being scored in full.
+ *
+ * @param ps Decoder.
+ * @param out_nframe Output: Number of frames scored (by all searches).
+ * @param out_nskip  Output: Number of them that reused the senone scores
+ *                   of an earlier frame.
+ * @param out_ncpu   Output: Number of seconds of CPU time spent scoring.
+ * @param out_nsaved Output: Estimated number of seconds of CPU time
+ *                   saved by reusing scores.
+ */
+POCKETSPHINX_EXPORT
+void ps_get_utt_skip(ps_decoder_t *ps, int32 *out_nframe, int32 *out_nskip,
+                     double *out_ncpu, double *out_nsaved);
+
 /**
  * Get overall performance information.
  *
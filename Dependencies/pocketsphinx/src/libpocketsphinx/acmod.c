@@ -54,6 +54,7 @@
 #include <sphinxbase/byteorder.h>
 #include <sphinxbase/feat.h>
 #include <sphinxbase/bio.h>
+#include <sphinxbase/sbthread.h>
 
 /* Local headers. */
 #include "cmdln_macro.h"
@@ -67,6 +68,65 @@
 #endif
 
 static int32 acmod_process_mfcbuf(acmod_t *acmod);
+static int acmod_close_senfh(acmod_t *acmod);
+static void acmod_insen_free(acmod_t *acmod);
+static void acmod_pipe_free(acmod_t *acmod);
+static int acmod_pipe_send(acmod_t *acmod, int cmd);
+static int acmod_pipe_process_raw(acmod_t *acmod,
+                                  int16 const **inout_raw,
+                                  size_t *inout_n_samps,
+                                  int full_utt);
+
+/**
+ * Commands for the feature extraction thread.
+ */
+enum acmod_pipe_cmd_e {
+    ACMOD_PIPE_START,   /**< Start an utterance, then signal. */
+    ACMOD_PIPE_RAW,     /**< Process a block of audio. */
+    ACMOD_PIPE_END,     /**< End the utterance, then signal. */
+    ACMOD_PIPE_SYNC,    /**< Signal once everything before it is done. */
+    ACMOD_PIPE_EXIT     /**< Exit the thread. */
+};
+
+/**
+ * Message passed to the feature extraction thread.
+ */
+typedef struct acmod_pipe_msg_s {
+    int cmd;
+    int16 *raw;         /**< Copy of the audio, freed by the thread. */
+    size_t n_samps;
+    int grow_feat;      /**< Caller's acmod_set_grow() setting. */
+    int full_utt;
+    FILE *mfcfh;        /**< MFCC log file handed over to the thread. */
+} acmod_pipe_msg_t;
+
+/**
+ * Feature extraction thread state.
+ *
+ * The thread runs acmod_process_raw() on a private acmod_t which
+ * shares the front end and dynamic feature objects with the real one
+ * but has its own MFCC and feature buffers.  After each call it takes
+ * the frames out of that feature buffer just as search would, so the
+ * blocks of cepstra which reach feat_s2mfc2feat_live() (and hence
+ * live CMN) are exactly the same as without the thread.  The frames
+ * then wait in a queue until search picks them up with
+ * acmod_fetch_feat().
+ */
+typedef struct acmod_pipe_s {
+    sbthread_t *thread;
+    sbevent_t *synced;  /**< Signalled after START, END or SYNC. */
+    acmod_t *shadow;    /**< State used on the thread only. */
+
+    sbmtx_t *mtx;       /**< Protects everything below. */
+    mfcc_t ***feat_q;   /**< Finished frames (circular). */
+    int32 n_q_alloc;
+    int32 n_q_frame;
+    int32 q_outidx;
+    int32 n_feat_alloc; /**< Size of the shadow's feature buffer. */
+    int32 utt_start_frame;
+    int32 vad_state;
+    int32 error;
+} acmod_pipe_t;
 
 static int
 acmod_init_am(acmod_t *acmod)
@@ -107,7 +167,11 @@ acmod_init_am(acmod_t *acmod)
         return -1;
     }
 
-    if (cmd_ln_str_r(acmod->config, "-senmgau")) {
+    if (cmd_ln_str_r(acmod->config, "-senmgau")
+        || ms_mgau_cache_valid(acmod->config, acmod->lmath)) {
+        /* Only ms_mgau writes compiled models, so go straight to it
+         * rather than have the other modules load (and reject) the
+         * model files first. */
         E_INFO("Using general multi-stream GMM computation\n");
         acmod->mgau = ms_mgau_init(acmod, acmod->lmath, acmod->mdef);
         if (acmod->mgau == NULL)
@@ -226,6 +290,476 @@ acmod_feat_mismatch(acmod_t *acmod, feat_t *fcb)
     return FALSE;
 }
 
+static acmod_t *
+acmod_pipe_shadow(acmod_t *acmod)
+{
+    acmod_t *shadow;
+
+    /* Only what acmod_process_raw() and acmod_end_utt() need.  The
+     * front end and dynamic feature objects are borrowed. */
+    shadow = ckd_calloc(1, sizeof(*shadow));
+    shadow->config = acmod->config;
+    shadow->fe = acmod->fe;
+    shadow->fcb = acmod->fcb;
+    shadow->state = ACMOD_IDLE;
+    shadow->n_mfc_alloc = acmod->n_mfc_alloc;
+    shadow->mfc_buf = (mfcc_t **)
+        ckd_calloc_2d(shadow->n_mfc_alloc, acmod->fcb->cepsize,
+                      sizeof(**shadow->mfc_buf));
+    shadow->n_feat_alloc = acmod->n_feat_alloc;
+    shadow->feat_buf = feat_array_alloc(acmod->fcb, shadow->n_feat_alloc);
+    shadow->framepos = ckd_calloc(shadow->n_feat_alloc,
+                                  sizeof(*shadow->framepos));
+    return shadow;
+}
+
+static void
+acmod_pipe_copy_frame(feat_t *fcb, mfcc_t **dst, mfcc_t **src)
+{
+    int i;
+
+    for (i = 0; i < feat_dimension1(fcb); ++i)
+        memcpy(dst[i], src[i], feat_dimension2(fcb, i) * sizeof(**src));
+}
+
+/**
+ * Move all frames out of the shadow's feature buffer into the queue,
+ * advancing it the same way acmod_advance() would.
+ */
+static void
+acmod_pipe_push(acmod_pipe_t *pipe)
+{
+    acmod_t *shadow = pipe->shadow;
+
+    sbmtx_lock(pipe->mtx);
+    if (pipe->n_q_frame + shadow->n_feat_frame > pipe->n_q_alloc) {
+        mfcc_t ***feat_q;
+        int32 i, n_alloc;
+
+        n_alloc = pipe->n_q_alloc * 2;
+        while (n_alloc < pipe->n_q_frame + shadow->n_feat_frame)
+            n_alloc *= 2;
+        feat_q = feat_array_alloc(shadow->fcb, n_alloc);
+        for (i = 0; i < pipe->n_q_frame; ++i)
+            acmod_pipe_copy_frame(shadow->fcb, feat_q[i],
+                                  pipe->feat_q[(pipe->q_outidx + i)
+                                               % pipe->n_q_alloc]);
+        feat_array_free(pipe->feat_q);
+        pipe->feat_q = feat_q;
+        pipe->n_q_alloc = n_alloc;
+        pipe->q_outidx = 0;
+    }
+    while (shadow->n_feat_frame > 0) {
+        int32 inptr = (pipe->q_outidx + pipe->n_q_frame) % pipe->n_q_alloc;
+
+        acmod_pipe_copy_frame(shadow->fcb, pipe->feat_q[inptr],
+                              shadow->feat_buf[shadow->feat_outidx]);
+        ++pipe->n_q_frame;
+        if (++shadow->feat_outidx == shadow->n_feat_alloc)
+            shadow->feat_outidx = 0;
+        --shadow->n_feat_frame;
+        ++shadow->output_frame;
+    }
+    pipe->n_feat_alloc = shadow->n_feat_alloc;
+    pipe->utt_start_frame = shadow->utt_start_frame;
+    pipe->vad_state = fe_get_vad_state(shadow->fe);
+    sbmtx_unlock(pipe->mtx);
+}
+
+static void
+acmod_pipe_error(acmod_pipe_t *pipe)
+{
+    sbmtx_lock(pipe->mtx);
+    pipe->error = TRUE;
+    sbmtx_unlock(pipe->mtx);
+}
+
+static int
+acmod_pipe_main(sbthread_t *th)
+{
+    acmod_pipe_t *pipe = sbthread_arg(th);
+    acmod_t *shadow = pipe->shadow;
+    acmod_pipe_msg_t msg;
+    void *data;
+
+    while ((data = sbmsgq_wait(sbthread_msgq(th), NULL, -1, 0)) != NULL) {
+        int16 const *raw;
+
+        memcpy(&msg, data, sizeof(msg));
+        switch (msg.cmd) {
+        case ACMOD_PIPE_START:
+            /* Drop anything left over if search gave up early.  Any
+             * audio sent before this message has been pushed by now,
+             * so none of it can leak into the new utterance. */
+            sbmtx_lock(pipe->mtx);
+            pipe->n_q_frame = 0;
+            pipe->error = FALSE;
+            sbmtx_unlock(pipe->mtx);
+            /* As in acmod_start_utt(), minus the scoring state. */
+            fe_start_utt(shadow->fe);
+            shadow->state = ACMOD_STARTED;
+            shadow->n_mfc_frame = 0;
+            shadow->n_feat_frame = 0;
+            shadow->mfc_outidx = 0;
+            shadow->feat_outidx = 0;
+            shadow->output_frame = 0;
+            sbevent_signal(pipe->synced);
+            break;
+        case ACMOD_PIPE_RAW:
+            acmod_set_grow(shadow, msg.grow_feat);
+            if (msg.mfcfh)
+                shadow->mfcfh = msg.mfcfh;
+            /* Same loop as ps_process_raw(), with the search step
+             * replaced by acmod_pipe_push(). */
+            raw = msg.raw;
+            do {
+                if (acmod_process_raw(shadow, &raw, &msg.n_samps,
+                                      msg.full_utt) < 0) {
+                    acmod_pipe_error(pipe);
+                    break;
+                }
+                acmod_pipe_push(pipe);
+            } while (msg.n_samps > 0);
+            ckd_free(msg.raw);
+            break;
+        case ACMOD_PIPE_END:
+            if (acmod_end_utt(shadow) < 0)
+                acmod_pipe_error(pipe);
+            acmod_pipe_push(pipe);
+            sbevent_signal(pipe->synced);
+            break;
+        case ACMOD_PIPE_SYNC:
+            sbevent_signal(pipe->synced);
+            break;
+        case ACMOD_PIPE_EXIT:
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static acmod_pipe_t *
+acmod_pipe_init(acmod_t *acmod)
+{
+    acmod_pipe_t *pipe;
+
+    pipe = ckd_calloc(1, sizeof(*pipe));
+    pipe->shadow = acmod_pipe_shadow(acmod);
+    pipe->n_q_alloc = acmod->n_feat_alloc;
+    pipe->feat_q = feat_array_alloc(acmod->fcb, pipe->n_q_alloc);
+    pipe->n_feat_alloc = acmod->n_feat_alloc;
+    pipe->mtx = sbmtx_init();
+    pipe->synced = sbevent_init();
+    acmod->pipe = pipe;
+    if (pipe->mtx == NULL || pipe->synced == NULL
+        || (pipe->thread = sbthread_start(acmod->config,
+                                          acmod_pipe_main, pipe)) == NULL) {
+        E_ERROR("Failed to start feature extraction thread\n");
+        acmod_pipe_free(acmod);
+        return NULL;
+    }
+    E_INFO("Computing features on a separate thread\n");
+    return pipe;
+}
+
+static void
+acmod_pipe_free(acmod_t *acmod)
+{
+    acmod_pipe_t *pipe = acmod->pipe;
+    acmod_t *shadow;
+
+    if (pipe == NULL)
+        return;
+    if (pipe->thread) {
+        acmod_pipe_send(acmod, ACMOD_PIPE_EXIT);
+        sbthread_free(pipe->thread);
+    }
+    shadow = pipe->shadow;
+    if (shadow->mfcfh)
+        fclose(shadow->mfcfh);
+    ckd_free_2d((void **)shadow->mfc_buf);
+    feat_array_free(shadow->feat_buf);
+    ckd_free(shadow->framepos);
+    ckd_free(shadow);
+    feat_array_free(pipe->feat_q);
+    if (pipe->mtx)
+        sbmtx_free(pipe->mtx);
+    if (pipe->synced)
+        sbevent_free(pipe->synced);
+    ckd_free(pipe);
+    acmod->pipe = NULL;
+}
+
+static int
+acmod_pipe_send(acmod_t *acmod, int cmd)
+{
+    acmod_pipe_msg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.cmd = cmd;
+    return sbthread_send(acmod->pipe->thread, sizeof(msg), &msg);
+}
+
+/**
+ * Wait until the thread has handled everything sent so far.
+ */
+static int
+acmod_pipe_sync(acmod_t *acmod, int cmd)
+{
+    if (acmod_pipe_send(acmod, cmd) < 0)
+        return -1;
+    return sbevent_wait(acmod->pipe->synced, -1, 0);
+}
+
+/*
+ * Frame skipping: a frame whose features are close enough to those of
+ * a frame scored shortly before it reuses that frame's senone scores.
+ * Senones that are active now but were not then are scored on the new
+ * frame, together with the best senone of the old one, so that their
+ * scores can be brought to the old frame's normalization.
+ */
+
+static void
+acmod_skip_init(acmod_t *acmod)
+{
+    float32 thresh;
+    int32 n_sen, i;
+
+    thresh = cmd_ln_float32_r(acmod->config, "-ds_thresh");
+    acmod->skip_thresh = thresh * thresh;
+    acmod->skip_max = cmd_ln_int32_r(acmod->config, "-ds_max");
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    for (i = 0; i < ACMOD_N_SKIP; ++i) {
+        acmod->skip[i].frame = -1;
+        acmod->skip[i].feat = ckd_calloc(feat_dimension(acmod->fcb),
+                                         sizeof(*acmod->skip[i].feat));
+        acmod->skip[i].senscr = ckd_calloc(n_sen,
+                                           sizeof(*acmod->skip[i].senscr));
+        acmod->skip[i].valid = bitvec_alloc(n_sen);
+    }
+    acmod->skip_active = ckd_calloc(n_sen, sizeof(*acmod->skip_active));
+    acmod->skip_senscr = ckd_calloc(n_sen, sizeof(*acmod->skip_senscr));
+    E_INFO("Reusing senone scores for up to %d frames within distance %f\n",
+           acmod->skip_max, thresh);
+}
+
+static void
+acmod_skip_clear(acmod_t *acmod)
+{
+    int i;
+
+    for (i = 0; i < ACMOD_N_SKIP; ++i)
+        acmod->skip[i].frame = -1;
+}
+
+/**
+ * Find a frame whose scores can be reused for frame_idx, or NULL.
+ */
+static acmod_skip_t *
+acmod_skip_find(acmod_t *acmod, mfcc_t **feat, int frame_idx)
+{
+    acmod_skip_t *sk;
+    float32 dist;
+    int32 i, n_dim;
+
+    if (acmod->skip_thresh == 0)
+        return NULL;
+
+    /* The nearest frame before this one, if it is recent enough. */
+    sk = NULL;
+    for (i = 0; i < ACMOD_N_SKIP; ++i) {
+        if (acmod->skip[i].frame < 0
+            || frame_idx < acmod->skip[i].frame
+            || frame_idx - acmod->skip[i].frame > acmod->skip_max)
+            continue;
+        if (sk == NULL || acmod->skip[i].frame > sk->frame)
+            sk = &acmod->skip[i];
+    }
+    if (sk == NULL)
+        return NULL;
+
+    /* Mean squared difference of the feature vectors (all streams
+     * are contiguous, see feat_array_alloc()). */
+    n_dim = feat_dimension(acmod->fcb);
+    dist = 0;
+    for (i = 0; i < n_dim; ++i) {
+        float32 d = MFCC2FLOAT(feat[0][i]) - MFCC2FLOAT(sk->feat[i]);
+        dist += d * d;
+    }
+    if (dist > acmod->skip_thresh * n_dim)
+        return NULL;
+    return sk;
+}
+
+/**
+ * Remember the scores of a frame that was just scored in full.
+ */
+static void
+acmod_skip_save(acmod_t *acmod, mfcc_t **feat, int frame_idx)
+{
+    acmod_skip_t *sk;
+    int32 i, n_sen, best;
+
+    /* Nothing to reuse. */
+    if (!acmod->compallsen && acmod->n_senone_active == 0)
+        return;
+
+    /* Replace this search's last saved frame, or else an unused or
+     * the oldest one. */
+    sk = NULL;
+    for (i = 0; i < ACMOD_N_SKIP; ++i) {
+        acmod_skip_t *s = &acmod->skip[i];
+        if (s->frame >= 0 && frame_idx >= s->frame
+            && frame_idx - s->frame <= acmod->skip_max + 1) {
+            if (sk == NULL || s->frame > sk->frame)
+                sk = s;
+        }
+    }
+    if (sk == NULL) {
+        sk = &acmod->skip[0];
+        for (i = 1; i < ACMOD_N_SKIP; ++i)
+            if (acmod->skip[i].frame < sk->frame)
+                sk = &acmod->skip[i];
+    }
+
+    sk->frame = frame_idx;
+    memcpy(sk->feat, feat[0], feat_dimension(acmod->fcb) * sizeof(*sk->feat));
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    best = 0;
+    if (acmod->compallsen) {
+        memcpy(sk->senscr, acmod->senone_scores, n_sen * sizeof(*sk->senscr));
+        bitvec_set_all(sk->valid, n_sen);
+        for (i = 1; i < n_sen; ++i)
+            if (sk->senscr[i] < sk->senscr[best])
+                best = i;
+    }
+    else {
+        int32 sen;
+
+        bitvec_clear_all(sk->valid, n_sen);
+        for (i = 0, sen = 0; i < acmod->n_senone_active; ++i) {
+            sen += acmod->senone_active[i];
+            sk->senscr[sen] = acmod->senone_scores[sen];
+            bitvec_set(sk->valid, sen);
+            if (i == 0 || sk->senscr[sen] < sk->senscr[best])
+                best = sen;
+        }
+    }
+    sk->best = best;
+}
+
+static int32
+acmod_skip_add(uint8 *active, int32 n, int32 *inout_last, int32 sen)
+{
+    int32 delta = sen - *inout_last;
+
+    /* Bridge large gaps like acmod_flags2list() does. */
+    while (delta > 255) {
+        active[n++] = 255;
+        delta -= 255;
+    }
+    active[n++] = delta;
+    *inout_last = sen;
+    return n;
+}
+
+/**
+ * Get the scores of the active senones from a recently scored frame,
+ * scoring any that were not active in it.
+ */
+static void
+acmod_skip_score(acmod_t *acmod, acmod_skip_t *sk,
+                 mfcc_t **feat, int frame_idx)
+{
+    int32 i, n, sen, last, shift, have_best;
+
+    if (acmod->compallsen) {
+        memcpy(acmod->senone_scores, sk->senscr,
+               bin_mdef_n_sen(acmod->mdef) * sizeof(*sk->senscr));
+        return;
+    }
+
+    /* List the missing senones, and the reference one, in order. */
+    n = last = 0;
+    have_best = FALSE;
+    for (i = 0, sen = 0; i < acmod->n_senone_active; ++i) {
+        sen += acmod->senone_active[i];
+        if (bitvec_is_set(sk->valid, sen))
+            continue;
+        if (!have_best && sk->best < sen) {
+            n = acmod_skip_add(acmod->skip_active, n, &last, sk->best);
+            have_best = TRUE;
+        }
+        n = acmod_skip_add(acmod->skip_active, n, &last, sen);
+    }
+    if (n > 0) {
+        if (!have_best)
+            n = acmod_skip_add(acmod->skip_active, n, &last, sk->best);
+        ps_mgau_frame_eval(acmod->mgau, acmod->skip_senscr,
+                           acmod->skip_active, n,
+                           feat, frame_idx, FALSE);
+        shift = sk->senscr[sk->best] - acmod->skip_senscr[sk->best];
+        for (i = 0, sen = 0; i < acmod->n_senone_active; ++i) {
+            int32 scr;
+
+            sen += acmod->senone_active[i];
+            if (bitvec_is_set(sk->valid, sen))
+                continue;
+            scr = acmod->skip_senscr[sen] + shift;
+            if (scr > SENSCR_DUMMY)
+                scr = SENSCR_DUMMY;
+            else if (scr < -SENSCR_DUMMY)
+                scr = -SENSCR_DUMMY;
+            sk->senscr[sen] = scr;
+            bitvec_set(sk->valid, sen);
+        }
+    }
+
+    for (i = 0, sen = 0; i < acmod->n_senone_active; ++i) {
+        sen += acmod->senone_active[i];
+        acmod->senone_scores[sen] = sk->senscr[sen];
+    }
+}
+
+/*
+ * Batched scoring: with -compallsen, the scores of a frame do not
+ * depend on the search, so they are computed for as many of the
+ * following frames as are available (up to -gmm_batch) at once, which
+ * the model can do faster than one at a time.  They are kept in a
+ * ring of rows, which also holds the frames up to -pl_window back, so
+ * that the phone loop and the main search share them.
+ */
+
+static void
+acmod_batch_init(acmod_t *acmod)
+{
+    int i;
+
+    acmod->n_batch = cmd_ln_int32_r(acmod->config, "-gmm_batch");
+    if (acmod->n_batch > PS_MGAU_MAX_BATCH)
+        acmod->n_batch = PS_MGAU_MAX_BATCH;
+    acmod->n_batch_alloc = acmod->n_batch
+        + cmd_ln_int32_r(acmod->config, "-pl_window") + 1;
+    acmod->batch_senscr = (int16 **)
+        ckd_calloc_2d(acmod->n_batch_alloc, bin_mdef_n_sen(acmod->mdef),
+                      sizeof(**acmod->batch_senscr));
+    acmod->batch_frame = ckd_calloc(acmod->n_batch_alloc,
+                                    sizeof(*acmod->batch_frame));
+    for (i = 0; i < acmod->n_batch_alloc; ++i)
+        acmod->batch_frame[i] = -1;
+    E_INFO("Computing senone scores for up to %d frames at once\n",
+           acmod->n_batch);
+}
+
+static void
+acmod_batch_clear(acmod_t *acmod)
+{
+    int i;
+
+    for (i = 0; i < acmod->n_batch_alloc; ++i)
+        acmod->batch_frame[i] = -1;
+}
+
 acmod_t *
 acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb)
 {
@@ -291,6 +825,14 @@ acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb)
                                                      sizeof(*acmod->senone_active));
     acmod->log_zero = logmath_get_zero(acmod->lmath);
     acmod->compallsen = cmd_ln_boolean_r(config, "-compallsen");
+    if (cmd_ln_float32_r(config, "-ds_thresh") > 0)
+        acmod_skip_init(acmod);
+    if (cmd_ln_int32_r(config, "-gmm_batch") > 1)
+        acmod_batch_init(acmod);
+
+    if (cmd_ln_boolean_r(config, "-pipeline")
+        && acmod_pipe_init(acmod) == NULL)
+        goto error_out;
     return acmod;
 
 error_out:
@@ -301,9 +843,13 @@ error_out:
 void
 acmod_free(acmod_t *acmod)
 {
+    int i;
+
     if (acmod == NULL)
         return;
 
+    /* Stop the thread before anything it uses goes away. */
+    acmod_pipe_free(acmod);
     feat_free(acmod->fcb);
     fe_free(acmod->fe);
     cmd_ln_free_r(acmod->config);
@@ -317,14 +863,27 @@ acmod_free(acmod_t *acmod)
         fclose(acmod->mfcfh);
     if (acmod->rawfh)
         fclose(acmod->rawfh);
-    if (acmod->senfh)
-        fclose(acmod->senfh);
+    acmod_close_senfh(acmod);
+    acmod_insen_free(acmod);
 
     ckd_free(acmod->framepos);
+    ckd_free(acmod->senfh_index);
+    ckd_free(acmod->senfh_zz);
+    ckd_free(acmod->senfh_bits);
     ckd_free(acmod->senone_scores);
     ckd_free(acmod->senone_active_vec);
     ckd_free(acmod->senone_active);
     ckd_free(acmod->rawdata);
+    for (i = 0; i < ACMOD_N_SKIP; ++i) {
+        ckd_free(acmod->skip[i].feat);
+        ckd_free(acmod->skip[i].senscr);
+        ckd_free(acmod->skip[i].valid);
+    }
+    ckd_free(acmod->skip_active);
+    ckd_free(acmod->skip_senscr);
+    if (acmod->batch_senscr)
+        ckd_free_2d(acmod->batch_senscr);
+    ckd_free(acmod->batch_frame);
 
     if (acmod->mdef)
         bin_mdef_free(acmod->mdef);
@@ -345,10 +904,33 @@ acmod_update_mllr(acmod_t *acmod, ps_mllr_t *mllr)
         ps_mllr_free(acmod->mllr);
     acmod->mllr = mllr;
     ps_mgau_transform(acmod->mgau, mllr);
+    acmod_skip_clear(acmod);
+    acmod_batch_clear(acmod);
 
     return mllr;
 }
 
+/*
+ * Compressed senone score files (version 1.0) have the frames written
+ * by acmod_write_scores_comp(), followed by an index (aligned to 4
+ * bytes) and a trailer: the offset of the index, the number of
+ * entries in it (4 bytes each) and a magic number.  If each frame was
+ * written once, in order, the magic number is SENCOMP_MAGIC and the
+ * index has the offset of each frame (4 bytes).  Otherwise it is
+ * SENCOMP_MAGIC_MULTI and the index has the frame and offset of each
+ * scoring (4 bytes each) in the order they were written.
+ */
+#define SENCOMP_MAGIC "SIDX"
+#define SENCOMP_MAGIC_MULTI "SIDM"
+/** Rice codes of this many 1 bits are followed by the value itself. */
+#define SENCOMP_ESC 16
+/** Bits in an escaped value (twice the largest difference of scores). */
+#define SENCOMP_ESC_BITS 17
+/** Largest Rice parameter. */
+#define SENCOMP_MAX_K 15
+/** Size of the frame header. */
+#define SENCOMP_FRAME_HDR 8
+
 int
 acmod_write_senfh_header(acmod_t *acmod, FILE *logfh)
 {
@@ -357,21 +939,90 @@ acmod_write_senfh_header(acmod_t *acmod, FILE *logfh)
     sprintf(nsenstr, "%d", bin_mdef_n_sen(acmod->mdef));
     sprintf(logbasestr, "%f", logmath_get_base(acmod->lmath));
     return bio_writehdr(logfh,
-                        "version", "0.1",
+                        "version", acmod->senfh_comp ? "1.0" : "0.1",
                         "mdef_file", cmd_ln_str_r(acmod->config, "-mdef"),
                         "n_sen", nsenstr,
                         "logbase", logbasestr, NULL);
 }
 
+/*
+ * Close the senone score file, writing the index of a compressed
+ * one first.
+ */
+static int
+acmod_close_senfh(acmod_t *acmod)
+{
+    static const uint8 zeros[4] = { 0, 0, 0, 0 };
+    FILE *senfh = acmod->senfh;
+    uint32 *index = acmod->senfh_index;
+    uint32 trailer[2], pad, n_index;
+    char const *magic;
+    int32 i;
+    int rv = 0;
+
+    if (senfh == NULL)
+        return 0;
+    acmod->senfh = NULL;
+    if (acmod->senfh_comp) {
+        /* Keep only the offsets if each frame was written once. */
+        for (i = 0; i < acmod->n_senfh_index; ++i)
+            if (index[i * 2] != (uint32)i)
+                break;
+        if (i == acmod->n_senfh_index) {
+            for (i = 0; i < acmod->n_senfh_index; ++i)
+                index[i] = index[i * 2 + 1];
+            n_index = acmod->n_senfh_index;
+            magic = SENCOMP_MAGIC;
+        }
+        else {
+            n_index = acmod->n_senfh_index * 2;
+            magic = SENCOMP_MAGIC_MULTI;
+        }
+        pad = (4 - acmod->senfh_pos % 4) % 4;
+        trailer[0] = acmod->senfh_pos + pad;
+        trailer[1] = acmod->n_senfh_index;
+        if (fwrite(zeros, 1, pad, senfh) != pad
+            || fwrite(index, 4, n_index, senfh) != n_index
+            || fwrite(trailer, 4, 2, senfh) != 2
+            || fwrite(magic, 1, 4, senfh) != 4) {
+            E_ERROR_SYSTEM("Failed to write index to senone file");
+            rv = -1;
+        }
+    }
+    fclose(senfh);
+    return rv;
+}
+
 int
 acmod_set_senfh(acmod_t *acmod, FILE *logfh)
 {
-    if (acmod->senfh)
-        fclose(acmod->senfh);
+    long pos;
+    int n_sen;
+
+    acmod_close_senfh(acmod);
     acmod->senfh = logfh;
     if (logfh == NULL)
         return 0;
-    return acmod_write_senfh_header(acmod, logfh);
+    acmod->senfh_comp = cmd_ln_boolean_r(acmod->config, "-sencomp");
+    if (acmod_write_senfh_header(acmod, logfh) < 0)
+        return -1;
+    if (!acmod->senfh_comp)
+        return 0;
+
+    if ((pos = ftell(logfh)) < 0) {
+        E_ERROR_SYSTEM("Compressed senone file must be seekable");
+        return -1;
+    }
+    acmod->senfh_pos = pos;
+    acmod->n_senfh_index = 0;
+    acmod->n_senfh_frame = 0;
+    if (acmod->senfh_zz == NULL) {
+        n_sen = bin_mdef_n_sen(acmod->mdef);
+        acmod->senfh_zz = ckd_calloc(n_sen, sizeof(*acmod->senfh_zz));
+        /* No score takes more than SENCOMP_ESC + SENCOMP_ESC_BITS bits. */
+        acmod->senfh_bits = ckd_calloc(n_sen, 5);
+    }
+    return 0;
 }
 
 int
@@ -425,7 +1076,14 @@ acmod_set_grow(acmod_t *acmod, int grow_feat)
 int
 acmod_start_utt(acmod_t *acmod)
 {
-    fe_start_utt(acmod->fe);
+    if (acmod->pipe) {
+        /* The thread empties the queue; wait for it so that search
+         * cannot fetch frames of the previous utterance. */
+        if (acmod_pipe_sync(acmod, ACMOD_PIPE_START) < 0)
+            return -1;
+    }
+    else
+        fe_start_utt(acmod->fe);
     acmod->state = ACMOD_STARTED;
     acmod->n_mfc_frame = 0;
     acmod->n_feat_frame = 0;
@@ -436,6 +1094,12 @@ acmod_start_utt(acmod_t *acmod)
     acmod->n_senone_active = 0;
     acmod->mgau->frame_idx = 0;
     acmod->rawdata_pos = 0;
+    acmod->n_score_frame = 0;
+    acmod->n_skip_frame = 0;
+    ptmr_reset(&acmod->score_perf);
+    ptmr_reset(&acmod->skip_perf);
+    acmod_skip_clear(acmod);
+    acmod_batch_clear(acmod);
 
     return 0;
 }
@@ -446,7 +1110,14 @@ acmod_end_utt(acmod_t *acmod)
     int32 nfr = 0;
 
     acmod->state = ACMOD_ENDED;
-    if (acmod->n_mfc_frame < acmod->n_mfc_alloc) {
+    if (acmod->pipe) {
+        /* The thread flushes the front end, then we collect
+         * whatever fits (search will take the rest). */
+        if (acmod_pipe_sync(acmod, ACMOD_PIPE_END) < 0)
+            return -1;
+        nfr = acmod_fetch_feat(acmod);
+    }
+    else if (acmod->n_mfc_frame < acmod->n_mfc_alloc) {
         int inptr;
         /* Where to start writing them (circular buffer) */
         inptr = (acmod->mfc_outidx + acmod->n_mfc_frame) % acmod->n_mfc_alloc;
@@ -478,10 +1149,10 @@ acmod_end_utt(acmod_t *acmod)
         acmod->rawfh = NULL;
     }
 
-    if (acmod->senfh) {
-        fclose(acmod->senfh);
-        acmod->senfh = NULL;
-    }
+    /* A compressed senone file also takes the scores of the search
+     * that follows, until acmod_set_senfh(acmod, NULL). */
+    if (!acmod->senfh_comp)
+        acmod_close_senfh(acmod);
 
     return nfr;
 }
@@ -634,6 +1305,10 @@ acmod_process_raw(acmod_t *acmod,
     int32 out_frameidx;
     int16 const *prev_audio_inptr;
     
+    if (acmod->pipe)
+        return acmod_pipe_process_raw(acmod, inout_raw, inout_n_samps,
+                                      full_utt);
+
     /* If this is a full utterance, process it all at once. */
     if (full_utt)
         return acmod_process_full_raw(acmod, inout_raw, inout_n_samps);
@@ -716,6 +1391,51 @@ acmod_process_raw(acmod_t *acmod,
     return acmod_process_mfcbuf(acmod);
 }
 
+static int
+acmod_pipe_process_raw(acmod_t *acmod,
+                       int16 const **inout_raw,
+                       size_t *inout_n_samps,
+                       int full_utt)
+{
+    acmod_pipe_msg_t msg;
+    size_t n_samps = *inout_n_samps;
+
+    /* The thread always takes all of the audio, so log it here. */
+    if (n_samps + acmod->rawdata_pos < acmod->rawdata_size) {
+        memcpy(acmod->rawdata + acmod->rawdata_pos, *inout_raw,
+               n_samps * sizeof(int16));
+        acmod->rawdata_pos += n_samps;
+    }
+    if (acmod->rawfh)
+        fwrite(*inout_raw, sizeof(int16), n_samps, acmod->rawfh);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.cmd = ACMOD_PIPE_RAW;
+    msg.n_samps = n_samps;
+    if (n_samps) {
+        msg.raw = ckd_malloc(n_samps * sizeof(int16));
+        memcpy(msg.raw, *inout_raw, n_samps * sizeof(int16));
+    }
+    msg.grow_feat = acmod->grow_feat;
+    msg.full_utt = full_utt;
+    /* The thread writes (and closes) the MFCC log from now on. */
+    msg.mfcfh = acmod->mfcfh;
+    if (sbthread_send(acmod->pipe->thread, sizeof(msg), &msg) < 0) {
+        ckd_free(msg.raw);
+        return -1;
+    }
+    acmod->mfcfh = NULL;
+    *inout_raw += n_samps;
+    *inout_n_samps = 0;
+    if (acmod->state == ACMOD_STARTED)
+        acmod->state = ACMOD_PROCESSING;
+
+    /* A full utterance is sized as a whole, so wait for all of it. */
+    if (full_utt && acmod_pipe_sync(acmod, ACMOD_PIPE_SYNC) < 0)
+        return -1;
+    return acmod_fetch_feat(acmod);
+}
+
 int
 acmod_process_cep(acmod_t *acmod,
                   mfcc_t ***inout_cep,
@@ -845,16 +1565,68 @@ acmod_process_feat(acmod_t *acmod,
     return 1;
 }
 
+int
+acmod_fetch_feat(acmod_t *acmod)
+{
+    acmod_pipe_t *pipe = acmod->pipe;
+    int nfr = 0;
+
+    if (pipe == NULL)
+        return 0;
+
+    sbmtx_lock(pipe->mtx);
+    if (pipe->error) {
+        sbmtx_unlock(pipe->mtx);
+        return -1;
+    }
+    /* Follow the size the buffer would have had without the thread,
+     * so that acmod_rewind() works (or not) the same way.  Only do
+     * this while it is empty, as growing does not unwrap it. */
+    if (acmod->n_feat_frame == 0 && acmod->n_feat_alloc < pipe->n_feat_alloc)
+        acmod_grow_feat_buf(acmod, pipe->n_feat_alloc);
+    /* Like acmod_process_raw(), queue no more than fits in mfc_buf,
+     * so search still has its lookahead window of past frames. */
+    while (pipe->n_q_frame > 0
+           && (acmod->grow_feat || acmod->n_feat_frame < acmod->n_mfc_alloc)
+           && acmod_process_feat(acmod, pipe->feat_q[pipe->q_outidx]) > 0) {
+        if (++pipe->q_outidx == pipe->n_q_alloc)
+            pipe->q_outidx = 0;
+        --pipe->n_q_frame;
+        ++nfr;
+    }
+    acmod->utt_start_frame = pipe->utt_start_frame;
+    sbmtx_unlock(pipe->mtx);
+
+    return nfr;
+}
+
+int
+acmod_get_vad_state(acmod_t *acmod)
+{
+    int vad_state;
+
+    if (acmod->pipe == NULL)
+        return fe_get_vad_state(acmod->fe);
+    sbmtx_lock(acmod->pipe->mtx);
+    vad_state = acmod->pipe->vad_state;
+    sbmtx_unlock(acmod->pipe->mtx);
+    return vad_state;
+}
+
 static int
-acmod_read_senfh_header(acmod_t *acmod)
+acmod_read_senfh_header(acmod_t *acmod, int *out_comp)
 {
     char **name, **val;
     int32 swap;
     int i;
 
+    *out_comp = FALSE;
     if (bio_readhdr(acmod->insenfh, &name, &val, &swap) < 0)
         goto error_out;
     for (i = 0; name[i] != NULL; ++i) {
+        if (!strcmp(name[i], "version"))
+            *out_comp = !strcmp(val[i], "1.0");
+
         if (!strcmp(name[i], "n_sen")) {
             if (atoi(val[i]) != bin_mdef_n_sen(acmod->mdef)) {
                 E_ERROR("Number of senones in senone file (%d) does not "
@@ -881,17 +1653,235 @@ error_out:
     return -1;
 }
 
-int
-acmod_set_insenfh(acmod_t *acmod, FILE *senfh)
+static uint32
+acmod_insen_uint32(acmod_t *acmod, uint8 const *ptr)
+{
+    uint32 val;
+
+    memcpy(&val, ptr, 4);
+    if (acmod->insen_swap)
+        SWAP_INT32(&val);
+    return val;
+}
+
+/*
+ * Group the scorings of a SENCOMP_MAGIC_MULTI index (at off in
+ * insen_data) by frame, keeping the order they were written in.
+ */
+static int
+acmod_insen_index_multi(acmod_t *acmod, uint32 start, uint32 off,
+                        uint32 n_rec)
+{
+    uint8 const *data = acmod->insen_data;
+    int32 *first, *next;
+    uint32 i, frame, pos;
+
+    acmod->insen_index = ckd_calloc(n_rec + 1, sizeof(*acmod->insen_index));
+    /* Every frame has a scoring, so there are no more frames. */
+    first = acmod->insen_first = ckd_calloc(n_rec + 2, sizeof(*first));
+    acmod->insen_n_frame = 0;
+    for (i = 0; i < n_rec; ++i) {
+        frame = acmod_insen_uint32(acmod, data + off + i * 8);
+        pos = acmod_insen_uint32(acmod, data + off + i * 8 + 4);
+        if (frame >= n_rec || pos < start || pos >= off)
+            goto error_out;
+        ++first[frame + 1];
+        if ((int32)frame >= acmod->insen_n_frame)
+            acmod->insen_n_frame = frame + 1;
+    }
+    for (i = 0; i < (uint32)acmod->insen_n_frame; ++i) {
+        if (first[i + 1] == 0)
+            goto error_out;
+        first[i + 1] += first[i];
+    }
+    next = ckd_calloc(acmod->insen_n_frame, sizeof(*next));
+    memcpy(next, first, acmod->insen_n_frame * sizeof(*next));
+    for (i = 0; i < n_rec; ++i) {
+        frame = acmod_insen_uint32(acmod, data + off + i * 8);
+        acmod->insen_index[next[frame]++]
+            = acmod_insen_uint32(acmod, data + off + i * 8 + 4);
+    }
+    ckd_free(next);
+    return 0;
+
+error_out:
+    E_ERROR("Corrupt index in senone file\n");
+    return -1;
+}
+
+/*
+ * Find the frames of the compressed senone file in insen_data, from
+ * its index or, if it has none (because it was not closed), from the
+ * sizes of the frames themselves (taking each to be the only scoring
+ * of the next frame).
+ */
+static int
+acmod_insen_index(acmod_t *acmod, uint32 start)
+{
+    uint8 const *data = acmod->insen_data;
+    uint32 size = acmod->insen_size;
+    uint32 off, end, i, n_sen, n_index;
+    int multi;
+
+    multi = (size >= start + 12
+             && !memcmp(data + size - 4, SENCOMP_MAGIC_MULTI, 4));
+    if (multi
+        || (size >= start + 12 && !memcmp(data + size - 4, SENCOMP_MAGIC, 4))) {
+        off = acmod_insen_uint32(acmod, data + size - 12);
+        n_index = acmod_insen_uint32(acmod, data + size - 8);
+        if (off < start || off > size - 12
+            || (size - 12 - off) / (multi ? 8 : 4) != n_index
+            || (size - 12 - off) % (multi ? 8 : 4) != 0) {
+            E_ERROR("Corrupt index in senone file\n");
+            return -1;
+        }
+        if (multi)
+            return acmod_insen_index_multi(acmod, start, off, n_index);
+        acmod->insen_n_frame = n_index;
+        acmod->insen_index = ckd_calloc(acmod->insen_n_frame + 1,
+                                        sizeof(*acmod->insen_index));
+        for (i = 0; i < (uint32)acmod->insen_n_frame; ++i) {
+            acmod->insen_index[i] = acmod_insen_uint32(acmod, data + off + i * 4);
+            if (acmod->insen_index[i] < start || acmod->insen_index[i] >= off) {
+                E_ERROR("Corrupt index in senone file\n");
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    E_WARN("Senone file has no index, scanning it\n");
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    acmod->insen_n_frame = 0;
+    acmod->insen_index = ckd_calloc(1, sizeof(*acmod->insen_index));
+    for (off = start; size - off >= SENCOMP_FRAME_HDR; off = end) {
+        int16 n_active;
+
+        memcpy(&n_active, data + off, 2);
+        if (acmod->insen_swap)
+            SWAP_INT16(&n_active);
+        end = acmod_insen_uint32(acmod, data + off + 4);
+        if (n_active != n_sen)
+            end += n_active;
+        if (end > size - off - SENCOMP_FRAME_HDR)
+            break;
+        end += off + SENCOMP_FRAME_HDR;
+        acmod->insen_index = ckd_realloc(acmod->insen_index,
+                                         (acmod->insen_n_frame + 2)
+                                         * sizeof(*acmod->insen_index));
+        acmod->insen_index[acmod->insen_n_frame++] = off;
+    }
+    return 0;
+}
+
+/*
+ * Stop reading a senone file, closing it if acmod opened it.
+ */
+static void
+acmod_insen_free(acmod_t *acmod)
+{
+    if (acmod->insen_mmap)
+        mmio_file_unmap(acmod->insen_mmap);
+    ckd_free(acmod->insen_buf);
+    ckd_free(acmod->insen_index);
+    ckd_free(acmod->insen_first);
+    ckd_free(acmod->insen_used);
+    acmod->insen_mmap = NULL;
+    acmod->insen_buf = NULL;
+    acmod->insen_data = NULL;
+    acmod->insen_index = NULL;
+    acmod->insen_first = NULL;
+    acmod->insen_used = NULL;
+    acmod->insen_n_frame = 0;
+    acmod->insen_frame = 0;
+    acmod->insen_rec = -1;
+    if (acmod->insen_own && acmod->insenfh)
+        fclose(acmod->insenfh);
+    acmod->insenfh = NULL;
+}
+
+/*
+ * Start reading senfh, which is named file if acmod is to own it.
+ */
+static int
+acmod_insen_init(acmod_t *acmod, FILE *senfh, char const *file)
 {
+    long start, size;
+    int comp;
+
+    acmod_insen_free(acmod);
     acmod->insenfh = senfh;
+    acmod->insen_own = (file != NULL);
     if (senfh == NULL) {
         acmod->n_feat_frame = 0;
         acmod->compallsen = cmd_ln_boolean_r(acmod->config, "-compallsen");
         return 0;
     }
     acmod->compallsen = TRUE;
-    return acmod_read_senfh_header(acmod);
+    if (acmod_read_senfh_header(acmod, &comp) < 0)
+        goto error_out;
+    if (!comp)
+        return 0;
+
+    /* Compressed files are read (or mapped) whole. */
+    if ((start = ftell(senfh)) < 0
+        || fseek(senfh, 0, SEEK_END) < 0
+        || (size = ftell(senfh)) < 0) {
+        E_ERROR_SYSTEM("Compressed senone file must be seekable");
+        goto error_out;
+    }
+    acmod->insen_size = size;
+    if (file && cmd_ln_boolean_r(acmod->config, "-mmap")) {
+        if ((acmod->insen_mmap = mmio_file_read(file)) == NULL)
+            goto error_out;
+        acmod->insen_data = mmio_file_ptr(acmod->insen_mmap);
+    }
+    else {
+        acmod->insen_buf = ckd_malloc(size + 1);
+        if (fseek(senfh, 0, SEEK_SET) < 0
+            || fread(acmod->insen_buf, 1, size, senfh) != (size_t)size) {
+            E_ERROR_SYSTEM("Failed to read senone file");
+            goto error_out;
+        }
+        acmod->insen_data = acmod->insen_buf;
+    }
+    if (acmod_insen_index(acmod, start) < 0)
+        goto error_out;
+    if (acmod->insen_first == NULL) {
+        int32 i;
+
+        acmod->insen_first = ckd_calloc(acmod->insen_n_frame + 1,
+                                        sizeof(*acmod->insen_first));
+        for (i = 0; i <= acmod->insen_n_frame; ++i)
+            acmod->insen_first[i] = i;
+    }
+    acmod->insen_used = ckd_calloc(acmod->insen_n_frame + 1,
+                                   sizeof(*acmod->insen_used));
+    return 0;
+
+error_out:
+    acmod_insen_init(acmod, NULL, NULL);
+    return -1;
+}
+
+int
+acmod_set_insenfh(acmod_t *acmod, FILE *senfh)
+{
+    return acmod_insen_init(acmod, senfh, NULL);
+}
+
+int
+acmod_set_insen_file(acmod_t *acmod, char const *file)
+{
+    FILE *senfh;
+
+    if (file == NULL)
+        return acmod_insen_init(acmod, NULL, NULL);
+    if ((senfh = fopen(file, "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open senone file %s", file);
+        return -1;
+    }
+    return acmod_insen_init(acmod, senfh, file);
 }
 
 int
@@ -912,6 +1902,8 @@ acmod_rewind(acmod_t *acmod)
     acmod->output_frame = 0;
     acmod->senscr_frame = -1;
     acmod->mgau->frame_idx = 0;
+    acmod_skip_clear(acmod);
+    acmod_batch_clear(acmod);
 
     return 0;
 }
@@ -968,6 +1960,130 @@ error_out:
     return -1;
 }
 
+/* Append the low nbits (no more than 24) of val to a bit stream. */
+#define SENCOMP_PUT(ptr, acc, n, val, nbits)            \
+    do {                                                \
+        acc = (acc << (nbits)) | (val);                 \
+        n += (nbits);                                   \
+        while (n >= 8) {                                \
+            n -= 8;                                     \
+            *ptr++ = (uint8)(acc >> n);                 \
+        }                                               \
+    } while (0)
+
+int
+acmod_write_scores_comp(acmod_t *acmod, int frame_idx, int n_active,
+                        uint8 const *active, int16 const *senscr)
+{
+    FILE *senfh = acmod->senfh;
+    uint32 *zz = acmod->senfh_zz;
+    uint8 *ptr;
+    int32 i, k, best_k, n_sen, prev, n_delta;
+    uint32 acc, n, bits, best_bits, n_bytes;
+    int16 n_active2;
+    uint8 hdr[2];
+
+    /* Frames are scored again for the search when there is a phone
+     * loop, with the same scores if all senones are computed.
+     * Otherwise each scoring has its own active senones (and best
+     * score), so it is written again. */
+    if (frame_idx < acmod->n_senfh_frame && acmod->compallsen)
+        return 0;
+
+    /* Compressed frame format:
+     *
+     * (2 bytes) n_active: Number of active senones
+     * (1 byte) k: Rice parameter
+     * (1 byte) unused
+     * (4 bytes) n_bytes: Size of coded scores
+     * If not all senones active:
+     * (n_active bytes) deltas to active senones
+     * (n_bytes bytes) coded scores of active senones
+     *
+     * Each score is coded as its difference from the previous one (or
+     * from 0), mapped 0, -1, 1, -2, 2... to 0, 1, 2, 3, 4... and Rice
+     * coded: the value shifted right by k in unary (as that many 1
+     * bits and a 0 bit), then its low k bits.  Values with
+     * SENCOMP_ESC or more 1 bits are written as SENCOMP_ESC 1 bits
+     * and SENCOMP_ESC_BITS bits of the value instead.  Bits are
+     * packed most significant first.
+     */
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    n_delta = (n_active == n_sen) ? 0 : n_active;
+    prev = 0;
+    for (i = n = 0; i < n_active; ++i) {
+        int32 d;
+
+        if (n_delta)
+            n += active[i];
+        else
+            n = i;
+        d = senscr[n] - prev;
+        prev = senscr[n];
+        zz[i] = (d < 0) ? ((uint32)-d << 1) - 1 : (uint32)d << 1;
+    }
+
+    /* Pick the k that takes the fewest bits. */
+    best_k = 0;
+    best_bits = ~0U;
+    for (k = 0; k <= SENCOMP_MAX_K; ++k) {
+        for (bits = i = 0; i < n_active; ++i) {
+            uint32 q = zz[i] >> k;
+            bits += (q < SENCOMP_ESC) ? q + 1 + k
+                : SENCOMP_ESC + SENCOMP_ESC_BITS;
+        }
+        if (bits >= best_bits)
+            break;
+        best_bits = bits;
+        best_k = k;
+    }
+
+    k = best_k;
+    ptr = acmod->senfh_bits;
+    acc = n = 0;
+    for (i = 0; i < n_active; ++i) {
+        uint32 q = zz[i] >> k;
+        if (q < SENCOMP_ESC) {
+            SENCOMP_PUT(ptr, acc, n, ((1U << q) - 1) << 1, q + 1);
+            SENCOMP_PUT(ptr, acc, n, zz[i] & ((1U << k) - 1), k);
+        }
+        else {
+            SENCOMP_PUT(ptr, acc, n, (1U << SENCOMP_ESC) - 1, SENCOMP_ESC);
+            SENCOMP_PUT(ptr, acc, n, zz[i], SENCOMP_ESC_BITS);
+        }
+    }
+    if (n > 0)
+        *ptr++ = (uint8)(acc << (8 - n));
+    n_bytes = ptr - acmod->senfh_bits;
+
+    n_active2 = n_active;
+    hdr[0] = k;
+    hdr[1] = 0;
+    if (fwrite(&n_active2, 2, 1, senfh) != 1
+        || fwrite(hdr, 1, 2, senfh) != 2
+        || fwrite(&n_bytes, 4, 1, senfh) != 1
+        || fwrite(active, 1, n_delta, senfh) != n_delta
+        || fwrite(acmod->senfh_bits, 1, n_bytes, senfh) != n_bytes) {
+        E_ERROR_SYSTEM("Failed to write frame to senone file");
+        return -1;
+    }
+
+    if (acmod->n_senfh_index == acmod->n_senfh_index_alloc) {
+        acmod->n_senfh_index_alloc = acmod->n_senfh_index_alloc
+            ? acmod->n_senfh_index_alloc * 2 : 256;
+        acmod->senfh_index = ckd_realloc(acmod->senfh_index,
+                                         acmod->n_senfh_index_alloc * 2
+                                         * sizeof(*acmod->senfh_index));
+    }
+    acmod->senfh_index[acmod->n_senfh_index * 2] = frame_idx;
+    acmod->senfh_index[acmod->n_senfh_index * 2 + 1] = acmod->senfh_pos;
+    ++acmod->n_senfh_index;
+    if (frame_idx >= acmod->n_senfh_frame)
+        acmod->n_senfh_frame = frame_idx + 1;
+    acmod->senfh_pos += SENCOMP_FRAME_HDR + n_delta + n_bytes;
+    return 0;
+}
+
 /**
  * Internal version, used for reading previous frames in acmod_score()
  */
@@ -1029,6 +2145,132 @@ error_out:
     return 0;
 }
 
+/* Make sure a bit stream has at least nbits (no more than 24) bits. */
+#define SENCOMP_FILL(ptr, end, acc, n, nbits)           \
+    while (n < (nbits)) {                               \
+        acc = (acc << 8) | ((ptr < end) ? *ptr : 0);    \
+        ++ptr;                                          \
+        n += 8;                                         \
+    }
+
+/* Take nbits bits from a bit stream, after SENCOMP_FILL(). */
+#define SENCOMP_GET(acc, n, nbits)                      \
+    ((n -= (nbits)), (acc >> n) & ((1U << (nbits)) - 1))
+
+/**
+ * Read a scoring from a compressed senone file (see
+ * acmod_write_scores_comp()), unless it is already in senone_scores.
+ */
+static int
+acmod_read_scores_comp(acmod_t *acmod, int32 rec)
+{
+    uint8 const *ptr, *end;
+    int16 *senscr = acmod->senone_scores;
+    int32 i, n, k, prev, sen, n_sen, n_delta;
+    uint32 acc, n_acc, n_bytes, off;
+    int16 n_active;
+
+    if (rec == acmod->insen_rec)
+        return 1;
+    acmod->insen_rec = -1;
+
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+    off = acmod->insen_index[rec];
+    ptr = acmod->insen_data + off;
+    if (acmod->insen_size - off < SENCOMP_FRAME_HDR)
+        goto error_out;
+    memcpy(&n_active, ptr, 2);
+    if (acmod->insen_swap)
+        SWAP_INT16(&n_active);
+    k = ptr[2];
+    n_bytes = acmod_insen_uint32(acmod, ptr + 4);
+    ptr += SENCOMP_FRAME_HDR;
+    if (n_active < 0 || n_active > n_sen || k > SENCOMP_MAX_K)
+        goto error_out;
+    n_delta = (n_active == n_sen) ? 0 : n_active;
+    if (n_bytes > acmod->insen_size - off - SENCOMP_FRAME_HDR - n_delta)
+        goto error_out;
+
+    acmod->n_senone_active = n_active;
+    memcpy(acmod->senone_active, ptr, n_delta);
+    ptr += n_delta;
+    end = ptr + n_bytes;
+
+    prev = 0;
+    acc = n_acc = 0;
+    /* n is the first senone not yet filled in, sen the last active
+     * one, which the deltas are relative to. */
+    for (i = n = sen = 0; i < n_active; ++i) {
+        uint32 q, zz;
+
+        /* Count 1 bits a byte at a time. */
+        q = 0;
+        for (;;) {
+            SENCOMP_FILL(ptr, end, acc, n_acc, 8);
+            zz = (acc >> (n_acc - 8)) & 0xff;
+            if (zz != 0xff)
+                break;
+            n_acc -= 8;
+            q += 8;
+            if (q >= SENCOMP_ESC)
+                break;
+        }
+        if (q < SENCOMP_ESC) {
+            while (zz & 0x80) {
+                zz <<= 1;
+                ++q;
+            }
+            n_acc -= q % 8 + 1;
+            SENCOMP_FILL(ptr, end, acc, n_acc, k);
+            zz = (q << k) | SENCOMP_GET(acc, n_acc, k);
+        }
+        else {
+            SENCOMP_FILL(ptr, end, acc, n_acc, SENCOMP_ESC_BITS);
+            zz = SENCOMP_GET(acc, n_acc, SENCOMP_ESC_BITS);
+        }
+        prev += (zz & 1) ? -(int32)((zz + 1) >> 1) : (int32)(zz >> 1);
+
+        if (n_delta) {
+            sen += acmod->senone_active[i];
+            if (sen >= n_sen)
+                goto error_out;
+            while (n < sen)
+                senscr[n++] = SENSCR_DUMMY;
+        }
+        else
+            sen = i;
+        senscr[sen] = prev;
+        if (n <= sen)
+            n = sen + 1;
+    }
+    /* The last byte or two filled in may be past the end. */
+    if ((ptr - end) * 8 > (int32)n_acc)
+        goto error_out;
+    while (n < n_sen)
+        senscr[n++] = SENSCR_DUMMY;
+    acmod->insen_rec = rec;
+    return 1;
+
+error_out:
+    E_ERROR("Corrupt scoring %d in senone file\n", rec);
+    return -1;
+}
+
+/**
+ * Find the scoring of a frame of a compressed senone file to replay
+ * for the next request for it: the one written for the same request,
+ * or the last one if the frame was scored fewer times.
+ */
+static int32
+acmod_insen_next(acmod_t *acmod, int frame)
+{
+    int32 n_rec, k;
+
+    n_rec = acmod->insen_first[frame + 1] - acmod->insen_first[frame];
+    k = acmod->insen_used[frame]++;
+    return acmod->insen_first[frame] + (k < n_rec ? k : n_rec - 1);
+}
+
 int
 acmod_read_scores(acmod_t *acmod)
 {
@@ -1047,7 +2289,17 @@ acmod_read_scores(acmod_t *acmod)
                 acmod->n_feat_alloc;
     }
 
-    if ((rv = acmod_read_scores_internal(acmod)) != 1)
+    if (acmod->insen_index) {
+        if (acmod->n_feat_frame == acmod->n_feat_alloc
+            || acmod->insen_frame >= acmod->insen_n_frame)
+            return 0;
+        /* The first request for the frame takes this scoring. */
+        rv = acmod_read_scores_comp(acmod,
+                                    acmod->insen_first[acmod->insen_frame]);
+    }
+    else
+        rv = acmod_read_scores_internal(acmod);
+    if (rv != 1)
         return rv;
 
     /* Set acmod->senscr_frame appropriately so that these scores
@@ -1061,7 +2313,10 @@ acmod_read_scores(acmod_t *acmod)
      * position for the relevant frame in the (possibly circular)
      * buffer. */
     ++acmod->n_feat_frame;
-    acmod->framepos[inptr] = ftell(acmod->insenfh);
+    if (acmod->insen_index)
+        acmod->framepos[inptr] = acmod->insen_frame++;
+    else
+        acmod->framepos[inptr] = ftell(acmod->insenfh);
 
     return 1;
 }
@@ -1123,6 +2378,51 @@ acmod_get_frame(acmod_t *acmod, int *inout_frame_idx)
     return acmod->feat_buf[feat_idx];
 }
 
+/**
+ * Get all senone scores for frame_idx from the batch, computing them
+ * and those of the next available frames if they are not there.
+ */
+static int
+acmod_batch_score(acmod_t *acmod, int frame_idx)
+{
+    int16 *senscr[PS_MGAU_MAX_BATCH];
+    mfcc_t **feat[PS_MGAU_MAX_BATCH];
+    int row, n, j;
+
+    row = frame_idx % acmod->n_batch_alloc;
+    if (acmod->batch_frame[row] != frame_idx) {
+        n = acmod->output_frame + acmod->n_feat_frame - frame_idx;
+        if (n > acmod->n_batch)
+            n = acmod->n_batch;
+        if (n < 1)
+            n = 1;
+        for (j = 0; j < n; ++j) {
+            int feat_idx, r;
+
+            if ((feat_idx = calc_feat_idx(acmod, frame_idx + j)) < 0)
+                return -1;
+            feat[j] = acmod->feat_buf[feat_idx];
+            r = (frame_idx + j) % acmod->n_batch_alloc;
+            senscr[j] = acmod->batch_senscr[r];
+            acmod->batch_frame[r] = frame_idx + j;
+        }
+        ptmr_start(&acmod->score_perf);
+        if (ps_mgau_base(acmod->mgau)->vt->frame_eval_batch)
+            ps_mgau_frame_eval_batch(acmod->mgau, senscr, feat, n, frame_idx);
+        else {
+            for (j = 0; j < n; ++j)
+                ps_mgau_frame_eval(acmod->mgau, senscr[j],
+                                   acmod->senone_active,
+                                   acmod->n_senone_active,
+                                   feat[j], frame_idx + j, TRUE);
+        }
+        ptmr_stop(&acmod->score_perf);
+    }
+    memcpy(acmod->senone_scores, acmod->batch_senscr[row],
+           bin_mdef_n_sen(acmod->mdef) * sizeof(*acmod->senone_scores));
+    return 0;
+}
+
 int16 const *
 acmod_score(acmod_t *acmod, int *inout_frame_idx)
 {
@@ -1132,8 +2432,9 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
     frame_idx = calc_frame_idx(acmod, inout_frame_idx);
 
     /* If all senones are being computed, or we are using a senone file,
-       then we can reuse existing scores. */
-    if ((acmod->compallsen || acmod->insenfh)
+       then we can reuse existing scores.  A compressed one may have
+       other scores for each request. */
+    if ((acmod->compallsen || acmod->insenfh) && acmod->insen_index == NULL
         && frame_idx == acmod->senscr_frame) {
         if (inout_frame_idx)
             *inout_frame_idx = frame_idx;
@@ -1148,23 +2449,51 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
      * If there is an input senone file locate the appropriate frame and read
      * it.
      */
-    if (acmod->insenfh) {
+    if (acmod->insen_index) {
+        int32 rec = acmod_insen_next(acmod, acmod->framepos[feat_idx]);
+        if (acmod_read_scores_comp(acmod, rec) < 0)
+            return NULL;
+    }
+    else if (acmod->insenfh) {
         fseek(acmod->insenfh, acmod->framepos[feat_idx], SEEK_SET);
         if (acmod_read_scores_internal(acmod) < 0)
             return NULL;
     }
     else {
+        mfcc_t **feat = acmod->feat_buf[feat_idx];
+        acmod_skip_t *sk;
+
         /* Build active senone list. */
         acmod_flags2list(acmod);
 
-        /* Generate scores for the next available frame */
-        ps_mgau_frame_eval(acmod->mgau,
-                           acmod->senone_scores,
-                           acmod->senone_active,
-                           acmod->n_senone_active,
-                           acmod->feat_buf[feat_idx],
-                           frame_idx,
-                           acmod->compallsen);
+        ++acmod->n_score_frame;
+        if (acmod->n_batch > 1 && acmod->compallsen) {
+            if (acmod_batch_score(acmod, frame_idx) < 0)
+                return NULL;
+        }
+        else if ((sk = acmod_skip_find(acmod, feat, frame_idx)) != NULL) {
+            /* A frame scored again gets its own scores back, which
+             * doesn't count as reusing another frame's. */
+            if (sk->frame != frame_idx)
+                ++acmod->n_skip_frame;
+            ptmr_start(&acmod->skip_perf);
+            acmod_skip_score(acmod, sk, feat, frame_idx);
+            ptmr_stop(&acmod->skip_perf);
+        }
+        else {
+            /* Generate scores for the next available frame */
+            ptmr_start(&acmod->score_perf);
+            ps_mgau_frame_eval(acmod->mgau,
+                               acmod->senone_scores,
+                               acmod->senone_active,
+                               acmod->n_senone_active,
+                               feat,
+                               frame_idx,
+                               acmod->compallsen);
+            ptmr_stop(&acmod->score_perf);
+            if (acmod->skip_thresh > 0)
+                acmod_skip_save(acmod, feat, frame_idx);
+        }
     }
 
     if (inout_frame_idx)
@@ -1173,10 +2502,17 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
 
     /* Dump scores to the senone dump file if one exists. */
     if (acmod->senfh) {
-        if (acmod_write_scores(acmod, acmod->n_senone_active,
-                               acmod->senone_active,
-                               acmod->senone_scores,
-                               acmod->senfh) < 0)
+        if (acmod->senfh_comp) {
+            if (acmod_write_scores_comp(acmod, frame_idx,
+                                        acmod->n_senone_active,
+                                        acmod->senone_active,
+                                        acmod->senone_scores) < 0)
+                return NULL;
+        }
+        else if (acmod_write_scores(acmod, acmod->n_senone_active,
+                                    acmod->senone_active,
+                                    acmod->senone_scores,
+                                    acmod->senfh) < 0)
             return NULL;
         E_DEBUG(1,("Frame %d has %d active states\n", frame_idx,
                    acmod->n_senone_active));
@@ -1334,6 +2670,12 @@ acmod_stream_offset(acmod_t *acmod)
 void
 acmod_start_stream(acmod_t *acmod)
 {
+    if (acmod->pipe) {
+        /* The front end belongs to the thread while it is busy. */
+        acmod_pipe_sync(acmod, ACMOD_PIPE_SYNC);
+        acmod->pipe->shadow->utt_start_frame = 0;
+        acmod->pipe->utt_start_frame = 0;
+    }
     fe_start_stream(acmod->fe);
     acmod->utt_start_frame = 0;
 }
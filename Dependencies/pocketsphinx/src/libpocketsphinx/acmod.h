@@ -52,6 +52,8 @@
 #include <sphinxbase/fe.h>
 #include <sphinxbase/feat.h>
 #include <sphinxbase/bitvec.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/mmio.h>
 #include <sphinxbase/err.h>
 #include <sphinxbase/prim_type.h>
 
@@ -108,8 +110,22 @@ typedef struct ps_mgaufuncs_s {
     int (*transform)(ps_mgau_t *mgau,
                      ps_mllr_t *mllr);
     void (*free)(ps_mgau_t *mgau);
+    /**
+     * Compute all senone scores for n_frame (at most PS_MGAU_MAX_BATCH)
+     * consecutive frames starting at frame, feat[j] being the features
+     * of frame + j and senscr[j] its scores, exactly as frame_eval
+     * would one frame at a time.  NULL if not supported.
+     */
+    int (*frame_eval_batch)(ps_mgau_t *mgau,
+                            int16 **senscr,
+                            mfcc_t ***feat,
+                            int32 n_frame,
+                            int32 frame);
 } ps_mgaufuncs_t;    
 
+/** Most frames to compute senone scores for at once (see -gmm_batch). */
+#define PS_MGAU_MAX_BATCH 16
+
 struct ps_mgau_s {
     ps_mgaufuncs_t *vt;  /**< vtable of mgau functions. */
     int frame_idx;       /**< frame counter. */
@@ -119,11 +135,33 @@ struct ps_mgau_s {
 #define ps_mgau_frame_eval(mg,senscr,senone_active,n_senone_active,feat,frame,compallsen) \
     (*ps_mgau_base(mg)->vt->frame_eval)                                 \
     (mg, senscr, senone_active, n_senone_active, feat, frame, compallsen)
+#define ps_mgau_frame_eval_batch(mg,senscr,feat,n_frame,frame)          \
+    (*ps_mgau_base(mg)->vt->frame_eval_batch)                           \
+    (mg, senscr, feat, n_frame, frame)
 #define ps_mgau_transform(mg, mllr)                                  \
     (*ps_mgau_base(mg)->vt->transform)(mg, mllr)
 #define ps_mgau_free(mg)                                  \
     (*ps_mgau_base(mg)->vt->free)(mg)
 
+/**
+ * Number of frames whose senone scores are kept for reuse (see
+ * acmod_t::skip).  There are two so that the phone loop and the main
+ * search, which score frames -pl_window apart, each have their own.
+ */
+#define ACMOD_N_SKIP 2
+
+/**
+ * Senone scores of a frame that was scored, for reuse by the
+ * following frames if their features are close enough to its.
+ */
+typedef struct acmod_skip_s {
+    int frame;          /**< Frame these scores are for, or -1 if none. */
+    int32 best;         /**< Best active senone in that frame. */
+    mfcc_t *feat;       /**< Its feature vector, all streams together. */
+    int16 *senscr;      /**< Its senone scores. */
+    bitvec_t *valid;    /**< Senones with a score in senscr. */
+} acmod_skip_t;
+
 /**
  * Acoustic model structure.
  *
@@ -144,6 +182,9 @@ struct ps_mgau_s {
  * TODO: In addition, this structure serves the purpose of queueing
  * frames of features (and potentially also scores in the future) for
  * asynchronous passes of recognition operating in parallel.
+ *
+ * With -pipeline, raw audio is turned into dynamic features on a
+ * separate thread (see acmod_fetch_feat()).
  */
 struct acmod_s {
     /* Global objects, not retained. */
@@ -154,6 +195,7 @@ struct acmod_s {
     /* Feature computation: */
     fe_t *fe;                  /**< Acoustic feature computation. */
     feat_t *fcb;               /**< Dynamic feature computation. */
+    struct acmod_pipe_s *pipe; /**< Feature extraction thread, if any. */
 
     /* Model parameters: */
     bin_mdef_t *mdef;          /**< Model definition. */
@@ -169,6 +211,25 @@ struct acmod_s {
     int n_senone_active;       /**< Number of active GMMs. */
     int log_zero;              /**< Zero log-probability value. */
 
+    /* Frame skipping (see -ds_thresh): */
+    float32 skip_thresh;       /**< Squared distance per feature dimension
+                                  below which scores are reused, or 0. */
+    int skip_max;              /**< Most frames to reuse scores for. */
+    acmod_skip_t skip[ACMOD_N_SKIP]; /**< Frames with reusable scores. */
+    uint8 *skip_active;        /**< Deltas to senones missing from them. */
+    int16 *skip_senscr;        /**< Scores of the missing senones. */
+    int32 n_score_frame;       /**< Number of frames scored this utterance. */
+    int32 n_skip_frame;        /**< Number of them that reused an earlier frame's scores. */
+    ptmr_t score_perf;         /**< Time spent scoring frames in full. */
+    ptmr_t skip_perf;          /**< Time spent scoring missing senones. */
+
+    /* Batched scoring (see -gmm_batch): */
+    int n_batch;               /**< Frames to score at once, or 1. */
+    int n_batch_alloc;         /**< Number of rows of batch_senscr. */
+    int16 **batch_senscr;      /**< Scores of recent frames, frame f in
+                                  row f % n_batch_alloc. */
+    int *batch_frame;          /**< Frame in each row, or -1. */
+
     /* Utterance processing: */
     mfcc_t **mfc_buf;   /**< Temporary buffer of acoustic features. */
     mfcc_t ***feat_buf; /**< Temporary buffer of dynamic features. */
@@ -176,7 +237,33 @@ struct acmod_s {
     FILE *mfcfh;        /**< File for writing acoustic feature data. */
     FILE *senfh;        /**< File for writing senone score data. */
     FILE *insenfh;	/**< Input senone score file. */
-    long *framepos;     /**< File positions of recent frames in senone file. */
+    long *framepos;     /**< File positions of recent frames in senone file
+                           (frame numbers in a compressed one). */
+
+    /* Compressed senone score files (see acmod_write_scores_comp()): */
+    uint8 senfh_comp;          /**< Is senfh compressed? */
+    uint32 senfh_pos;          /**< Bytes written to senfh so far. */
+    uint32 *senfh_index;       /**< Frame and offset of each scoring
+                                  written to senfh. */
+    int32 n_senfh_index;       /**< Number of scorings written to senfh. */
+    int32 n_senfh_index_alloc; /**< Number of scorings in senfh_index. */
+    int32 n_senfh_frame;       /**< Number of frames written to senfh. */
+    uint32 *senfh_zz;          /**< Score differences of a frame to write. */
+    uint8 *senfh_bits;         /**< Coded scores of a frame to write. */
+    uint8 insen_own;           /**< Did acmod open insenfh? */
+    mmio_file_t *insen_mmap;   /**< Memory map of a compressed insenfh. */
+    uint8 *insen_buf;          /**< Or its contents, if not mapped. */
+    uint8 const *insen_data;   /**< Contents of a compressed insenfh. */
+    uint32 insen_size;         /**< Size of insen_data. */
+    uint32 *insen_index;       /**< Offset of each scoring in insen_data,
+                                  by frame, or NULL if insenfh is not
+                                  compressed. */
+    int32 *insen_first;        /**< First scoring of each frame in
+                                  insen_index (and one past the last). */
+    int32 *insen_used;         /**< Scorings of each frame replayed. */
+    int32 insen_n_frame;       /**< Number of frames in insen_data. */
+    int32 insen_frame;         /**< Next frame for acmod_read_scores(). */
+    int32 insen_rec;           /**< Scoring in senone_scores, or -1. */
 
     /* Rawdata collected during decoding */
     int16 *rawdata;
@@ -235,6 +322,13 @@ ps_mllr_t *acmod_update_mllr(acmod_t *acmod, ps_mllr_t *mllr);
 /**
  * Start logging senone scores to a filehandle.
  *
+ * With -sencomp, the file is written in the compressed format of
+ * acmod_write_scores_comp(), and its index is written when logging
+ * stops.  Other files are closed by acmod_end_utt(), but a compressed
+ * one stays open for the frames searched after it (the phone loop
+ * lookahead window and a second pass) until this is called with
+ * NULL, as ps_end_utt() does.
+ *
  * @param acmod Acoustic model object.
  * @param logfh Filehandle to log to.
  * @return 0 for success, <0 on error.
@@ -332,6 +426,27 @@ int acmod_process_raw(acmod_t *acmod,
                       size_t *inout_n_samps,
                       int full_utt);
 
+/**
+ * Move finished feature frames from the feature extraction thread
+ * into the dynamic feature buffer.
+ *
+ * With -pipeline, acmod_process_raw() queues audio for the feature
+ * extraction thread and returns immediately, so features arrive in
+ * the background.  This picks up as many of them as currently fit.
+ * Without -pipeline it does nothing.
+ *
+ * @return Number of frames added, or <0 on error.
+ */
+int acmod_fetch_feat(acmod_t *acmod);
+
+/**
+ * Get the voice activity state of the front end.
+ *
+ * With -pipeline this is the state after the most recently processed
+ * block of audio, which may lag behind what has been passed in.
+ */
+int acmod_get_vad_state(acmod_t *acmod);
+
 /**
  * Feed acoustic feature data into the acoustic model for scoring.
  *
@@ -372,6 +487,17 @@ int acmod_process_feat(acmod_t *acmod,
  */
 int acmod_set_insenfh(acmod_t *acmod, FILE *insenfh);
 
+/**
+ * Set up a senone score dump file for input, by name.
+ *
+ * Unlike acmod_set_insenfh(), a compressed dump file is memory-mapped
+ * if -mmap is set, rather than read in.
+ *
+ * @param file Name of dump file, or NULL to stop reading one.
+ * @return 0 for success, <0 for failure
+ */
+int acmod_set_insen_file(acmod_t *acmod, char const *file);
+
 /**
  * Read one frame of scores from senone score dump file.
  *
@@ -393,6 +519,14 @@ mfcc_t **acmod_get_frame(acmod_t *acmod, int *inout_frame_idx);
 /**
  * Score one frame of data.
  *
+ * With -compallsen and -gmm_batch, scores are computed for several
+ * frames at once, as far as they are available, and kept until the
+ * searches have used them.
+ *
+ * With -ds_thresh, the scores of a frame up to -ds_max frames earlier
+ * are returned if its features are close enough to this one's (only
+ * senones that were not active then are scored).
+ *
  * @param inout_frame_idx Input: frame index to score, or NULL
  *                        to obtain scores for the most recent frame.
  *                        Output: frame index corresponding to this
@@ -417,6 +551,19 @@ int acmod_write_senfh_header(acmod_t *acmod, FILE *logfh);
 int acmod_write_scores(acmod_t *acmod, int n_active, uint8 const *active,
                        int16 const *senscr, FILE *senfh);
 
+/**
+ * Write a frame of senone scores to a compressed dump file (see
+ * -sencomp), which must be acmod->senfh.  The differences between
+ * successive active scores are Rice coded, and the offset of each
+ * frame is kept for the index written when the file is closed, so
+ * that frames can be read back in any order.  Unless all senones
+ * are computed, a frame scored again (by the phone loop lookahead or
+ * another pass) is written again, and replay gives each request for
+ * the frame the scoring made for it.
+ */
+int acmod_write_scores_comp(acmod_t *acmod, int frame_idx, int n_active,
+                            uint8 const *active, int16 const *senscr);
+
 
 /**
  * Get best score and senone index for current frame.
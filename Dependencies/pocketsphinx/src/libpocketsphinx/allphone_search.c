@@ -354,20 +354,16 @@ phmm_eval_all(allphone_search_t * allphs, const int16 * senscr)
     mdef = ((ps_search_t *) allphs)->acmod->mdef;
     ci_phmm = allphs->ci_phmm;
 
-    best = WORST_SCORE;
-
     hmm_context_set_senscore(allphs->hmmctx, senscr);
     for (ci = 0; ci < mdef->n_ciphone; ci++) {
         for (p = ci_phmm[(unsigned) ci]; p; p = p->next) {
             if (hmm_frame(&(p->hmm)) == allphs->frame) {
-                int32 score;
                 allphs->n_hmm_eval++;
-                score = hmm_vit_eval((hmm_t *) p);
-                if (score > best)
-                    best = score;
+                hmm_vit_eval_add(allphs->hmmctx, (hmm_t *) p);
             }
         }
     }
+    best = hmm_vit_eval_flush(allphs->hmmctx);
 
     return best;
 }
@@ -540,7 +536,8 @@ allphone_search_init(const char *name,
     mdef = acmod->mdef;
 
     allphs->hmmctx = hmm_context_init(bin_mdef_n_emit_state(mdef),
-                                      acmod->tmat->tp, NULL, mdef->sseq);
+                                      acmod->tmat->tp, acmod->tmat->n_tmat,
+                                      NULL, mdef->sseq);
     if (allphs->hmmctx == NULL) {
         ps_search_free(ps_search_base(allphs));
         return NULL;
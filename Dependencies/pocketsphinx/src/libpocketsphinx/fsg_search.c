@@ -188,7 +188,8 @@ fsg_search_init(const char *name,
     fsgs->fsg = fsg_model_retain(fsg);
     /* Initialize HMM context. */
     fsgs->hmmctx = hmm_context_init(bin_mdef_n_emit_state(acmod->mdef),
-                                    acmod->tmat->tp, NULL, acmod->mdef->sseq);
+                                    acmod->tmat->tp, acmod->tmat->n_tmat,
+                                    NULL, acmod->mdef->sseq);
     if (fsgs->hmmctx == NULL) {
         ps_search_free(ps_search_base(fsgs));
         return NULL;
@@ -264,6 +265,7 @@ fsg_search_free(ps_search_t *search)
     }
     hmm_context_free(fsgs->hmmctx);
     fsg_model_free(fsgs->fsg);
+    ckd_free(fsgs->prune_score);
     ckd_free(fsgs);
 }
 
@@ -322,7 +324,7 @@ fsg_search_hmm_eval(fsg_search_t *fsgs)
     gnode_t *gn;
     fsg_pnode_t *pnode;
     hmm_t *hmm;
-    int32 bestscore;
+    int32 bestscore, score;
     int32 n, maxhmmpf;
 
     bestscore = WORST_SCORE;
@@ -333,8 +335,6 @@ fsg_search_hmm_eval(fsg_search_t *fsgs)
     }
 
     for (n = 0, gn = fsgs->pnode_active; gn; gn = gnode_next(gn), n++) {
-        int32 score;
-
         pnode = (fsg_pnode_t *) gnode_ptr(gn);
         hmm = fsg_pnode_hmmptr(pnode);
         assert(hmm_frame(hmm) == fsgs->frame);
@@ -344,45 +344,55 @@ fsg_search_hmm_eval(fsg_search_t *fsgs)
                fsgs->frame);
         hmm_dump(hmm, stdout);
 #endif
-        score = hmm_vit_eval(hmm);
 #if __FSG_DBG_CHAN__
+        score = hmm_vit_eval(hmm);
         E_INFO("pnode(%08x) after eval @frm %5d\n",
                (int32) pnode, fsgs->frame);
         hmm_dump(hmm, stdout);
-#endif
 
         if (score BETTER_THAN bestscore)
             bestscore = score;
+#else
+        hmm_vit_eval_add(fsgs->hmmctx, hmm);
+#endif
     }
+    if ((score = hmm_vit_eval_flush(fsgs->hmmctx)) BETTER_THAN bestscore)
+        bestscore = score;
 
 #if __FSG_DBG__
     E_INFO("[%5d] %6d HMM; bestscr: %11d\n", fsgs->frame, n, bestscore);
 #endif
     fsgs->n_hmm_eval += n;
 
-    /* Adjust beams if #active HMMs larger than absolute threshold */
+    /* Narrow the beams if #active HMMs larger than absolute threshold */
+    fsgs->beam_factor = 1.0f;
+    fsgs->beam = fsgs->beam_orig;
+    fsgs->pbeam = fsgs->pbeam_orig;
+    fsgs->wbeam = fsgs->wbeam_orig;
     maxhmmpf = cmd_ln_int32_r(ps_search_config(fsgs), "-maxhmmpf");
-    if (maxhmmpf != -1 && n > maxhmmpf) {
+    if (maxhmmpf > 0 && n > maxhmmpf) {
+        int32 *prune_score, i, beam;
+
+        prune_score = hmm_score_grow(&fsgs->prune_score,
+                                     &fsgs->n_prune_score_alloc, n);
+        for (i = 0, gn = fsgs->pnode_active; gn; gn = gnode_next(gn), i++) {
+            pnode = (fsg_pnode_t *) gnode_ptr(gn);
+            prune_score[i] = hmm_bestscore(fsg_pnode_hmmptr(pnode));
+        }
         /*
-         * Too many HMMs active; reduce the beam factor applied to the default
-         * beams, but not if the factor is already at a floor (0.1).
+         * Keep only the maxhmmpf best HMMs, and narrow the phone and
+         * word beams in proportion.
          */
-        if (fsgs->beam_factor > 0.1) {        /* Hack!!  Hardwired constant 0.1 */
-            fsgs->beam_factor *= 0.9f;        /* Hack!!  Hardwired constant 0.9 */
-            fsgs->beam =
-                (int32) (fsgs->beam_orig * fsgs->beam_factor);
+        beam = hmm_score_select(prune_score, n, maxhmmpf) - bestscore;
+        if (beam BETTER_THAN fsgs->beam_orig) {
+            fsgs->beam_factor = (float32) beam / fsgs->beam_orig;
+            fsgs->beam = beam;
             fsgs->pbeam =
                 (int32) (fsgs->pbeam_orig * fsgs->beam_factor);
             fsgs->wbeam =
                 (int32) (fsgs->wbeam_orig * fsgs->beam_factor);
         }
     }
-    else {
-        fsgs->beam_factor = 1.0f;
-        fsgs->beam = fsgs->beam_orig;
-        fsgs->pbeam = fsgs->pbeam_orig;
-        fsgs->wbeam = fsgs->wbeam_orig;
-    }
 
     if (n > fsg_lextree_n_pnode(fsgs->lextree))
         E_FATAL("PANIC! Frame %d: #HMM evaluated(%d) > #PNodes(%d)\n",
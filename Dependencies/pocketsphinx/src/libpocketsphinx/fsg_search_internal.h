@@ -85,6 +85,8 @@ typedef struct fsg_search_s {
                                      beams to determine actual effective beams.
                                      For implementing absolute pruning. */
     int32 beam, pbeam, wbeam;	/**< Effective beams after applying beam_factor */
+    int32 *prune_score;         /**< Scores of the active HMMs, for -maxhmmpf */
+    int32 n_prune_score_alloc;  /**< Number of prune_score allocated */
     int32 lw, pip, wip;         /**< Language weights */
   
     frame_idx_t frame;		/**< Current frame. */
@@ -42,19 +42,34 @@
 /* System headers. */
 #include <assert.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <limits.h>
 
 /* SphinxBase headers. */
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/err.h>
+#include <sphinxbase/simd.h>
+
+#ifdef SPHINX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
 
 /* Local headers. */
 #include "hmm.h"
 
+static void hmm_lanes_init(hmm_context_t *ctx, int32 n_tmat);
+
 hmm_context_t *
 hmm_context_init(int32 n_emit_state,
 		 uint8 ** const *tp,
+		 int32 n_tmat,
 		 int16 const *senscore,
 		 uint16 * const *sseq)
 {
@@ -72,6 +87,7 @@ hmm_context_init(int32 n_emit_state,
     ctx->senscore = senscore;
     ctx->sseq = sseq;
     ctx->st_sen_scr = ckd_calloc(n_emit_state, sizeof(*ctx->st_sen_scr));
+    hmm_lanes_init(ctx, n_tmat);
 
     return ctx;
 }
@@ -82,6 +98,7 @@ hmm_context_free(hmm_context_t *ctx)
     if (ctx == NULL)
         return;
     ckd_free(ctx->st_sen_scr);
+    ckd_free(ctx->tp_lane);
     ckd_free(ctx);
 }
 
@@ -806,6 +823,574 @@ hmm_vit_eval(hmm_t * hmm)
     }
 }
 
+/*
+ * Vector Viterbi evaluation.  The scores of n_lane HMMs are gathered
+ * into a tile, one row for each state score, history, senone score
+ * and transition probability, one HMM to a column, evaluated a row at
+ * a time, and scattered back.  Branches are replaced by selects, and
+ * every quirk of the scalar code above is kept (the exit state and,
+ * in 5-state HMMs, states 3 and 4 are only updated if the states
+ * before them are above WORST_SCORE, and a 3-state one without a
+ * skip from state 0 to 2 takes the one from state 1 to the exit state
+ * in its place), so the results are the same.
+ *
+ * The first HMM_LANE_N_COPY rows are copied from and to hmm_t::score
+ * onwards (scores, histories, out_score and out_history) four HMMs at
+ * a time, by transposing them with 128-bit vectors.
+ */
+#define HMM_LANE_N_COPY 12
+#define hmm_lane_ptr(h, k) (&(h)->score[0] + (k))
+
+/* Fail to compile (with a negative array size) unless those rows are
+ * contiguous int32s in hmm_t, with no padding between them. */
+typedef char hmm_lane_layout_check[
+    (sizeof(((hmm_t *)0)->score[0]) == sizeof(int32)
+     && sizeof(((hmm_t *)0)->history[0]) == sizeof(int32)
+     && offsetof(hmm_t, history)
+        == offsetof(hmm_t, score) + HMM_MAX_NSTATE * sizeof(int32)
+     && offsetof(hmm_t, out_score)
+        == offsetof(hmm_t, history) + HMM_MAX_NSTATE * sizeof(int32)
+     && offsetof(hmm_t, out_history)
+        == offsetof(hmm_t, out_score) + sizeof(int32)
+     && HMM_LANE_N_COPY == 2 * HMM_MAX_NSTATE + 2) ? 1 : -1];
+
+enum hmm_lane_row_e {
+    R_S0, R_S1, R_S2, R_S3, R_S4,
+    R_H0, R_H1, R_H2, R_H3, R_H4,
+    R_OS, R_OH,
+    R_SEN0, R_SEN1, R_SEN2, R_SEN3, R_SEN4,
+    R_BEST,
+    R_TP /* Transition probabilities, in the order below. */
+};
+
+enum hmm_lane_tp_3st_e {
+    T3_00, T3_01, T3_02, T3_11, T3_12, T3_13, T3_22, T3_23, T3_N
+};
+
+enum hmm_lane_tp_5st_e {
+    T5_00, T5_01, T5_02, T5_11, T5_12, T5_13, T5_22, T5_23,
+    T5_24, T5_33, T5_34, T5_35, T5_44, T5_45, T5_N
+};
+
+/* Transition probabilities of each matrix in hmm_context_t::tp_lane. */
+#define HMM_LANE_N_TP 16
+#define HMM_LANE_N_ROW (R_TP + HMM_LANE_N_TP)
+#define tile_row(row) (tile + (row) * n_lane)
+
+/* Transitions of the 3- and 5-state HMMs, in the order of the tile rows. */
+static const uint8 hmm_lane_tp_3st[T3_N][2] = {
+    {0, 0}, {0, 1}, {0, 2}, {1, 1}, {1, 2}, {1, 3}, {2, 2}, {2, 3}
+};
+static const uint8 hmm_lane_tp_5st[T5_N][2] = {
+    {0, 0}, {0, 1}, {0, 2}, {1, 1}, {1, 2}, {1, 3}, {2, 2}, {2, 3},
+    {2, 4}, {3, 3}, {3, 4}, {3, 5}, {4, 4}, {4, 5}
+};
+
+/* Senone scores of the HMMs. */
+static void
+hmm_lanes_get_sen(hmm_t * const *hmm, int32 n_lane, int32 n_state,
+                  int32 *tile)
+{
+    int16 const *senscore = hmm[0]->ctx->senscore;
+    int32 i, l;
+
+    for (l = 0; l < n_lane; ++l) {
+        uint16 const *sseq = hmm[l]->senid;
+
+        for (i = 0; i < n_state; ++i)
+            tile_row(R_SEN0 + i)[l] = nonmpx_senscr(i);
+    }
+}
+
+/* Best scores of the HMMs, and the best of them and best. */
+static int32
+hmm_lanes_put_best(hmm_t * const *hmm, int32 n_lane, int32 const *tile,
+                   int32 best)
+{
+    int32 l;
+
+    for (l = 0; l < n_lane; ++l) {
+        hmm_bestscore(hmm[l]) = tile_row(R_BEST)[l];
+        if (tile_row(R_BEST)[l] BETTER_THAN best)
+            best = tile_row(R_BEST)[l];
+    }
+    return best;
+}
+
+/*
+ * Copy the first HMM_LANE_N_COPY rows of the tile from (get) and to
+ * (put) the HMMs, with 128-bit vectors: LOAD and STORE, and
+ * TRANSPOSE4, which transposes a 4x4 matrix of int32 in four of them.
+ * get also copies the first n_tp transition probabilities of each HMM
+ * from hmm_context_t::tp_lane.
+ */
+#define HMM_DEFINE_LANES_COPY(get, put, attr, vec_t,                      \
+                              LOAD, STORE, TRANSPOSE4)                    \
+static attr void                                                          \
+get(hmm_t * const *hmm, int32 n_lane, int32 n_tp, int32 *tile)            \
+{                                                                         \
+    int32 const *tp = hmm[0]->ctx->tp_lane;                               \
+    vec_t v0, v1, v2, v3;                                                 \
+    int32 g, k;                                                           \
+                                                                          \
+    for (g = 0; g < n_lane; g += 4) {                                     \
+        for (k = 0; k < HMM_LANE_N_COPY; k += 4) {                        \
+            v0 = LOAD(hmm_lane_ptr(hmm[g], k));                           \
+            v1 = LOAD(hmm_lane_ptr(hmm[g + 1], k));                       \
+            v2 = LOAD(hmm_lane_ptr(hmm[g + 2], k));                       \
+            v3 = LOAD(hmm_lane_ptr(hmm[g + 3], k));                       \
+            TRANSPOSE4(v0, v1, v2, v3);                                   \
+            STORE(tile_row(k) + g, v0);                                   \
+            STORE(tile_row(k + 1) + g, v1);                               \
+            STORE(tile_row(k + 2) + g, v2);                               \
+            STORE(tile_row(k + 3) + g, v3);                               \
+        }                                                                 \
+        for (k = 0; k < n_tp; k += 4) {                                   \
+            v0 = LOAD(tp + hmm[g]->tmatid * HMM_LANE_N_TP + k);           \
+            v1 = LOAD(tp + hmm[g + 1]->tmatid * HMM_LANE_N_TP + k);       \
+            v2 = LOAD(tp + hmm[g + 2]->tmatid * HMM_LANE_N_TP + k);       \
+            v3 = LOAD(tp + hmm[g + 3]->tmatid * HMM_LANE_N_TP + k);       \
+            TRANSPOSE4(v0, v1, v2, v3);                                   \
+            STORE(tile_row(R_TP + k) + g, v0);                            \
+            STORE(tile_row(R_TP + k + 1) + g, v1);                        \
+            STORE(tile_row(R_TP + k + 2) + g, v2);                        \
+            STORE(tile_row(R_TP + k + 3) + g, v3);                        \
+        }                                                                 \
+    }                                                                     \
+}                                                                         \
+                                                                          \
+static attr void                                                          \
+put(hmm_t * const *hmm, int32 n_lane, int32 const *tile)                  \
+{                                                                         \
+    vec_t v0, v1, v2, v3;                                                 \
+    int32 g, k;                                                           \
+                                                                          \
+    for (g = 0; g < n_lane; g += 4) {                                     \
+        for (k = 0; k < HMM_LANE_N_COPY; k += 4) {                        \
+            v0 = LOAD(tile_row(k) + g);                                   \
+            v1 = LOAD(tile_row(k + 1) + g);                               \
+            v2 = LOAD(tile_row(k + 2) + g);                               \
+            v3 = LOAD(tile_row(k + 3) + g);                               \
+            TRANSPOSE4(v0, v1, v2, v3);                                   \
+            STORE(hmm_lane_ptr(hmm[g], k), v0);                           \
+            STORE(hmm_lane_ptr(hmm[g + 1], k), v1);                       \
+            STORE(hmm_lane_ptr(hmm[g + 2], k), v2);                       \
+            STORE(hmm_lane_ptr(hmm[g + 3], k), v3);                       \
+        }                                                                 \
+    }                                                                     \
+}
+
+/*
+ * The kernels are written with these operations on vectors of int32:
+ * LOAD and STORE a row of the tile, SET1, ADD, GT (a mask of the
+ * lanes where a > b) and SEL (m ? a : b).  GET and PUT copy the tile
+ * from and to the HMMs (see HMM_DEFINE_LANES_COPY).
+ */
+#define HMM_VMAX(GT, SEL, a, b) SEL(GT(a, b), a, b)
+/* Scores below WORST_SCORE are set to it. */
+#define HMM_VCLAMP(GT, SEL, s) SEL(GT(worst, s), worst, s)
+/* Best of three transitions, and the history that goes with it. */
+#define HMM_VBEST3(GT, SEL, t0, h0, t1, h1, t2, h2, s, h)                 \
+    do {                                                                  \
+        m = GT(t0, t1);                                                   \
+        s = SEL(m, t0, t1);                                               \
+        h = SEL(m, h0, h1);                                               \
+        m = GT(t2, s);                                                    \
+        s = SEL(m, t2, s);                                                \
+        h = SEL(m, h2, h);                                                \
+    } while (0)
+
+#define HMM_DEFINE_EVAL_3ST(name, attr, vec_t, mask_t, width, GET, PUT,   \
+                            LOAD, STORE, SET1, ADD, GT, SEL)              \
+static attr int32                                                         \
+name(hmm_t * const *hmm, int32 best)                                      \
+{                                                                         \
+    int32 const n_lane = width;                                           \
+    int32 tile[HMM_LANE_N_ROW * width];                                   \
+    vec_t worst, s0, s1, s2, s3, t0, t1, t2, h, b;                        \
+    mask_t m, act;                                                        \
+                                                                          \
+    GET(hmm, n_lane, T3_N, tile);                                         \
+    hmm_lanes_get_sen(hmm, n_lane, 3, tile);                              \
+    worst = SET1(WORST_SCORE);                                            \
+    s0 = ADD(LOAD(tile_row(R_S0)), LOAD(tile_row(R_SEN0)));               \
+    s1 = ADD(LOAD(tile_row(R_S1)), LOAD(tile_row(R_SEN1)));               \
+    s2 = ADD(LOAD(tile_row(R_S2)), LOAD(tile_row(R_SEN2)));               \
+                                                                          \
+    /* Transitions into the exit state */                                 \
+    act = GT(s1, worst);                                                  \
+    t1 = ADD(s2, LOAD(tile_row(R_TP + T3_23)));                           \
+    t0 = LOAD(tile_row(R_TP + T3_13));                                    \
+    t2 = SEL(GT(t0, SET1(TMAT_WORST_SCORE)), ADD(s1, t0), SET1(INT_MIN)); \
+    m = GT(t1, t2);                                                       \
+    s3 = HMM_VCLAMP(GT, SEL, SEL(m, t1, t2));                             \
+    h = SEL(m, LOAD(tile_row(R_H2)), LOAD(tile_row(R_H1)));               \
+    STORE(tile_row(R_OS), SEL(act, s3, LOAD(tile_row(R_OS))));            \
+    STORE(tile_row(R_OH), SEL(act, h, LOAD(tile_row(R_OH))));             \
+    b = SEL(act, s3, worst);                                              \
+    t2 = SEL(act, t2, SET1(INT_MIN));                                     \
+                                                                          \
+    /* Transitions into state 2 */                                        \
+    t0 = LOAD(tile_row(R_TP + T3_02));                                    \
+    t2 = SEL(GT(t0, SET1(TMAT_WORST_SCORE)), ADD(s0, t0), t2);            \
+    t0 = ADD(s2, LOAD(tile_row(R_TP + T3_22)));                           \
+    t1 = ADD(s1, LOAD(tile_row(R_TP + T3_12)));                           \
+    HMM_VBEST3(GT, SEL, t0, LOAD(tile_row(R_H2)),                         \
+               t1, LOAD(tile_row(R_H1)), t2, LOAD(tile_row(R_H0)), s3, h); \
+    s3 = HMM_VCLAMP(GT, SEL, s3);                                         \
+    b = HMM_VMAX(GT, SEL, s3, b);                                         \
+    STORE(tile_row(R_S2), s3);                                            \
+    STORE(tile_row(R_H2), h);                                             \
+                                                                          \
+    /* Transitions into state 1 */                                        \
+    t0 = ADD(s1, LOAD(tile_row(R_TP + T3_11)));                           \
+    t1 = ADD(s0, LOAD(tile_row(R_TP + T3_01)));                           \
+    m = GT(t0, t1);                                                       \
+    s3 = HMM_VCLAMP(GT, SEL, SEL(m, t0, t1));                             \
+    h = SEL(m, LOAD(tile_row(R_H1)), LOAD(tile_row(R_H0)));               \
+    b = HMM_VMAX(GT, SEL, s3, b);                                         \
+    STORE(tile_row(R_S1), s3);                                            \
+    STORE(tile_row(R_H1), h);                                             \
+                                                                          \
+    /* Transition into state 0 */                                         \
+    s3 = HMM_VCLAMP(GT, SEL, ADD(s0, LOAD(tile_row(R_TP + T3_00))));      \
+    b = HMM_VMAX(GT, SEL, s3, b);                                         \
+    STORE(tile_row(R_S0), s3);                                            \
+    STORE(tile_row(R_BEST), b);                                           \
+                                                                          \
+    PUT(hmm, n_lane, tile);                                               \
+    return hmm_lanes_put_best(hmm, n_lane, tile, best);                   \
+}
+
+#define HMM_DEFINE_EVAL_5ST(name, attr, vec_t, mask_t, width, GET, PUT,   \
+                            LOAD, STORE, SET1, ADD, GT, SEL)              \
+static attr int32                                                         \
+name(hmm_t * const *hmm, int32 best)                                      \
+{                                                                         \
+    int32 const n_lane = width;                                           \
+    int32 tile[HMM_LANE_N_ROW * width];                                   \
+    vec_t worst, s0, s1, s2, s3, s4, t0, t1, t2, s, h, b;                 \
+    mask_t m, act;                                                        \
+                                                                          \
+    GET(hmm, n_lane, HMM_LANE_N_TP, tile);                                \
+    hmm_lanes_get_sen(hmm, n_lane, 5, tile);                              \
+    worst = SET1(WORST_SCORE);                                            \
+    s0 = ADD(LOAD(tile_row(R_S0)), LOAD(tile_row(R_SEN0)));               \
+    s1 = ADD(LOAD(tile_row(R_S1)), LOAD(tile_row(R_SEN1)));               \
+    s2 = ADD(LOAD(tile_row(R_S2)), LOAD(tile_row(R_SEN2)));               \
+    s3 = ADD(LOAD(tile_row(R_S3)), LOAD(tile_row(R_SEN3)));               \
+    s4 = ADD(LOAD(tile_row(R_S4)), LOAD(tile_row(R_SEN4)));               \
+                                                                          \
+    /* Transitions into the exit state */                                 \
+    act = GT(s3, worst);                                                  \
+    t1 = ADD(s4, LOAD(tile_row(R_TP + T5_45)));                           \
+    t2 = ADD(s3, LOAD(tile_row(R_TP + T5_35)));                           \
+    m = GT(t1, t2);                                                       \
+    s = HMM_VCLAMP(GT, SEL, SEL(m, t1, t2));                              \
+    h = SEL(m, LOAD(tile_row(R_H4)), LOAD(tile_row(R_H3)));               \
+    STORE(tile_row(R_OS), SEL(act, s, LOAD(tile_row(R_OS))));             \
+    STORE(tile_row(R_OH), SEL(act, h, LOAD(tile_row(R_OH))));             \
+    b = SEL(act, s, worst);                                               \
+                                                                          \
+    /* Transitions into state 4 */                                        \
+    act = GT(s2, worst);                                                  \
+    t0 = ADD(s4, LOAD(tile_row(R_TP + T5_44)));                           \
+    t1 = ADD(s3, LOAD(tile_row(R_TP + T5_34)));                           \
+    t2 = ADD(s2, LOAD(tile_row(R_TP + T5_24)));                           \
+    HMM_VBEST3(GT, SEL, t0, LOAD(tile_row(R_H4)),                         \
+               t1, LOAD(tile_row(R_H3)), t2, LOAD(tile_row(R_H2)), s, h); \
+    s = HMM_VCLAMP(GT, SEL, s);                                           \
+    b = SEL(act, HMM_VMAX(GT, SEL, s, b), b);                             \
+    STORE(tile_row(R_S4), SEL(act, s, LOAD(tile_row(R_S4))));             \
+    STORE(tile_row(R_H4), SEL(act, h, LOAD(tile_row(R_H4))));             \
+                                                                          \
+    /* Transitions into state 3 */                                        \
+    act = GT(s1, worst);                                                  \
+    t0 = ADD(s3, LOAD(tile_row(R_TP + T5_33)));                           \
+    t1 = ADD(s2, LOAD(tile_row(R_TP + T5_23)));                           \
+    t2 = ADD(s1, LOAD(tile_row(R_TP + T5_13)));                           \
+    HMM_VBEST3(GT, SEL, t0, LOAD(tile_row(R_H3)),                         \
+               t1, LOAD(tile_row(R_H2)), t2, LOAD(tile_row(R_H1)), s, h); \
+    s = HMM_VCLAMP(GT, SEL, s);                                           \
+    b = SEL(act, HMM_VMAX(GT, SEL, s, b), b);                             \
+    STORE(tile_row(R_S3), SEL(act, s, LOAD(tile_row(R_S3))));             \
+    STORE(tile_row(R_H3), SEL(act, h, LOAD(tile_row(R_H3))));             \
+                                                                          \
+    /* Transitions into state 2 */                                        \
+    t0 = ADD(s2, LOAD(tile_row(R_TP + T5_22)));                           \
+    t1 = ADD(s1, LOAD(tile_row(R_TP + T5_12)));                           \
+    t2 = ADD(s0, LOAD(tile_row(R_TP + T5_02)));                           \
+    HMM_VBEST3(GT, SEL, t0, LOAD(tile_row(R_H2)),                         \
+               t1, LOAD(tile_row(R_H1)), t2, LOAD(tile_row(R_H0)), s, h); \
+    s = HMM_VCLAMP(GT, SEL, s);                                           \
+    b = HMM_VMAX(GT, SEL, s, b);                                          \
+    STORE(tile_row(R_S2), s);                                             \
+    STORE(tile_row(R_H2), h);                                             \
+                                                                          \
+    /* Transitions into state 1 */                                        \
+    t0 = ADD(s1, LOAD(tile_row(R_TP + T5_11)));                           \
+    t1 = ADD(s0, LOAD(tile_row(R_TP + T5_01)));                           \
+    m = GT(t0, t1);                                                       \
+    s = HMM_VCLAMP(GT, SEL, SEL(m, t0, t1));                              \
+    h = SEL(m, LOAD(tile_row(R_H1)), LOAD(tile_row(R_H0)));               \
+    b = HMM_VMAX(GT, SEL, s, b);                                          \
+    STORE(tile_row(R_S1), s);                                             \
+    STORE(tile_row(R_H1), h);                                             \
+                                                                          \
+    /* Transition into state 0 */                                         \
+    s = HMM_VCLAMP(GT, SEL, ADD(s0, LOAD(tile_row(R_TP + T5_00))));       \
+    b = HMM_VMAX(GT, SEL, s, b);                                          \
+    STORE(tile_row(R_S0), s);                                             \
+    STORE(tile_row(R_BEST), b);                                           \
+                                                                          \
+    PUT(hmm, n_lane, tile);                                               \
+    return hmm_lanes_put_best(hmm, n_lane, tile, best);                   \
+}
+
+#ifdef SPHINX_HAVE_SSE2
+#define SSE2_LOAD(p) _mm_loadu_si128((__m128i const *)(p))
+#define SSE2_STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define SSE2_SEL(m, a, b) _mm_or_si128(_mm_and_si128(m, a),               \
+                                       _mm_andnot_si128(m, b))
+#define SSE2_TRANSPOSE4(a, b, c, d)                                       \
+    do {                                                                  \
+        __m128i t0 = _mm_unpacklo_epi32(a, b);                            \
+        __m128i t1 = _mm_unpacklo_epi32(c, d);                            \
+        __m128i t2 = _mm_unpackhi_epi32(a, b);                            \
+        __m128i t3 = _mm_unpackhi_epi32(c, d);                            \
+        a = _mm_unpacklo_epi64(t0, t1);                                   \
+        b = _mm_unpackhi_epi64(t0, t1);                                   \
+        c = _mm_unpacklo_epi64(t2, t3);                                   \
+        d = _mm_unpackhi_epi64(t2, t3);                                   \
+    } while (0)
+HMM_DEFINE_LANES_COPY(hmm_lanes_get_sse2, hmm_lanes_put_sse2, , __m128i,
+                      SSE2_LOAD, SSE2_STORE, SSE2_TRANSPOSE4)
+HMM_DEFINE_EVAL_5ST(hmm_eval_5st_sse2, , __m128i, __m128i, 4,
+                    hmm_lanes_get_sse2, hmm_lanes_put_sse2,
+                    SSE2_LOAD, SSE2_STORE, _mm_set1_epi32, _mm_add_epi32,
+                    _mm_cmpgt_epi32, SSE2_SEL)
+
+#ifdef SPHINX_HAVE_AVX2
+/* The tile is copied with 128-bit vectors here too, in AVX encoding. */
+HMM_DEFINE_LANES_COPY(hmm_lanes_get_avx2, hmm_lanes_put_avx2,
+                      SIMD_TARGET_AVX2, __m128i,
+                      SSE2_LOAD, SSE2_STORE, SSE2_TRANSPOSE4)
+#define AVX2_LOAD(p) _mm256_loadu_si256((__m256i const *)(p))
+#define AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define AVX2_SEL(m, a, b) _mm256_blendv_epi8(b, a, m)
+HMM_DEFINE_EVAL_3ST(hmm_eval_3st_avx2, SIMD_TARGET_AVX2, __m256i, __m256i, 8,
+                    hmm_lanes_get_avx2, hmm_lanes_put_avx2,
+                    AVX2_LOAD, AVX2_STORE, _mm256_set1_epi32,
+                    _mm256_add_epi32, _mm256_cmpgt_epi32, AVX2_SEL)
+HMM_DEFINE_EVAL_5ST(hmm_eval_5st_avx2, SIMD_TARGET_AVX2, __m256i, __m256i, 8,
+                    hmm_lanes_get_avx2, hmm_lanes_put_avx2,
+                    AVX2_LOAD, AVX2_STORE, _mm256_set1_epi32,
+                    _mm256_add_epi32, _mm256_cmpgt_epi32, AVX2_SEL)
+#endif /* SPHINX_HAVE_AVX2 */
+#endif /* SPHINX_HAVE_SSE2 */
+
+#ifdef SPHINX_HAVE_NEON
+#define NEON_TRANSPOSE4(a, b, c, d)                                       \
+    do {                                                                  \
+        int32x4x2_t p = vtrnq_s32(a, b);                                  \
+        int32x4x2_t q = vtrnq_s32(c, d);                                  \
+        a = vcombine_s32(vget_low_s32(p.val[0]), vget_low_s32(q.val[0])); \
+        b = vcombine_s32(vget_low_s32(p.val[1]), vget_low_s32(q.val[1])); \
+        c = vcombine_s32(vget_high_s32(p.val[0]), vget_high_s32(q.val[0])); \
+        d = vcombine_s32(vget_high_s32(p.val[1]), vget_high_s32(q.val[1])); \
+    } while (0)
+HMM_DEFINE_LANES_COPY(hmm_lanes_get_neon, hmm_lanes_put_neon, , int32x4_t,
+                      vld1q_s32, vst1q_s32, NEON_TRANSPOSE4)
+HMM_DEFINE_EVAL_3ST(hmm_eval_3st_neon, , int32x4_t, uint32x4_t, 4,
+                    hmm_lanes_get_neon, hmm_lanes_put_neon,
+                    vld1q_s32, vst1q_s32, vdupq_n_s32, vaddq_s32,
+                    vcgtq_s32, vbslq_s32)
+HMM_DEFINE_EVAL_5ST(hmm_eval_5st_neon, , int32x4_t, uint32x4_t, 4,
+                    hmm_lanes_get_neon, hmm_lanes_put_neon,
+                    vld1q_s32, vst1q_s32, vdupq_n_s32, vaddq_s32,
+                    vcgtq_s32, vbslq_s32)
+#endif /* SPHINX_HAVE_NEON */
+
+static void
+hmm_lanes_init(hmm_context_t *ctx, int32 n_tmat)
+{
+    uint8 const (*trans)[2];
+    uint32 simd;
+    int32 t, k, n_trans;
+
+    ctx->queue_best = WORST_SCORE;
+    if (ctx->n_emit_state == 3) {
+        trans = hmm_lane_tp_3st;
+        n_trans = T3_N;
+    }
+    else if (ctx->n_emit_state == 5) {
+        trans = hmm_lane_tp_5st;
+        n_trans = T5_N;
+    }
+    else
+        return;
+
+    simd = simd_get_features();
+    (void)simd;
+#if defined(SPHINX_HAVE_SSE2) && defined(SPHINX_HAVE_AVX2)
+    if (simd & SIMD_AVX2) {
+        ctx->n_lane = 8;
+        ctx->eval_lanes = (n_trans == T3_N)
+            ? hmm_eval_3st_avx2 : hmm_eval_5st_avx2;
+    }
+    else
+#endif
+#ifdef SPHINX_HAVE_SSE2
+    /* Without blends, four 3-state HMMs at a time are no faster. */
+    if ((simd & SIMD_SSE2) && n_trans == T5_N) {
+        ctx->n_lane = 4;
+        ctx->eval_lanes = hmm_eval_5st_sse2;
+    }
+    else
+#endif
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON) {
+        ctx->n_lane = 4;
+        ctx->eval_lanes = (n_trans == T3_N)
+            ? hmm_eval_3st_neon : hmm_eval_5st_neon;
+    }
+    else
+#endif
+        return;
+
+    ctx->tp_lane = ckd_calloc(n_tmat * HMM_LANE_N_TP, sizeof(*ctx->tp_lane));
+    for (t = 0; t < n_tmat; ++t)
+        for (k = 0; k < n_trans; ++k)
+            ctx->tp_lane[t * HMM_LANE_N_TP + k]
+                = -ctx->tp[t][trans[k][0]][trans[k][1]];
+}
+
+/* Start loading an HMM that will be evaluated shortly. */
+#if defined(SPHINX_HAVE_SSE2)
+#define hmm_prefetch(h) do {                                            \
+        _mm_prefetch((char const *)(h), _MM_HINT_T0);                   \
+        _mm_prefetch((char const *)((h) + 1) - 1, _MM_HINT_T0);         \
+    } while (0)
+#elif defined(__GNUC__)
+#define hmm_prefetch(h) do {                                            \
+        __builtin_prefetch(h);                                          \
+        __builtin_prefetch((char const *)((h) + 1) - 1);                \
+    } while (0)
+#else
+#define hmm_prefetch(h)
+#endif
+
+/* Evaluate the queue, or as much of it as fills all the lanes. */
+static void
+hmm_vit_eval_queue(hmm_context_t *ctx)
+{
+    int32 i, n, score;
+
+    for (i = n = 0; i < ctx->n_queued; ++i) {
+        if (hmm_is_mpx(ctx->lane[i])) {
+            score = hmm_vit_eval(ctx->lane[i]);
+            if (score BETTER_THAN ctx->queue_best)
+                ctx->queue_best = score;
+        }
+        else
+            ctx->lane[n++] = ctx->lane[i];
+    }
+    if (n == ctx->n_lane) {
+        ctx->queue_best = ctx->eval_lanes(ctx->lane, ctx->queue_best);
+        n = 0;
+    }
+    ctx->n_queued = n;
+}
+
+void
+hmm_vit_eval_add(hmm_context_t *ctx, hmm_t *hmm)
+{
+    int32 score;
+
+    if (ctx->n_lane) {
+        /* Don't look at it yet, it is probably not in cache. */
+        hmm_prefetch(hmm);
+        ctx->lane[ctx->n_queued++] = hmm;
+        if (ctx->n_queued == ctx->n_lane)
+            hmm_vit_eval_queue(ctx);
+        return;
+    }
+    score = hmm_vit_eval(hmm);
+    if (score BETTER_THAN ctx->queue_best)
+        ctx->queue_best = score;
+}
+
+int32
+hmm_vit_eval_flush(hmm_context_t *ctx)
+{
+    int32 i, score, best;
+
+    best = ctx->queue_best;
+    for (i = 0; i < ctx->n_queued; ++i) {
+        score = hmm_vit_eval(ctx->lane[i]);
+        if (score BETTER_THAN best)
+            best = score;
+    }
+    ctx->n_queued = 0;
+    ctx->queue_best = WORST_SCORE;
+    return best;
+}
+
+int32
+hmm_score_select(int32 *score, int32 n, int32 n_keep)
+{
+    int32 lo, hi, i, j, k, a, b, c, pivot, tmp;
+
+    assert(n_keep > 0 && n_keep <= n);
+    /* Quickselect, best scores first. */
+    k = n_keep - 1;
+    lo = 0;
+    hi = n - 1;
+    while (lo < hi) {
+        /* Median of three for the pivot. */
+        a = score[lo];
+        b = score[lo + (hi - lo) / 2];
+        c = score[hi];
+        if (a BETTER_THAN b) {
+            tmp = a; a = b; b = tmp;
+        }
+        pivot = (c BETTER_THAN b) ? b : (c BETTER_THAN a) ? c : a;
+
+        i = lo;
+        j = hi;
+        while (i <= j) {
+            while (score[i] BETTER_THAN pivot)
+                ++i;
+            while (pivot BETTER_THAN score[j])
+                --j;
+            if (i <= j) {
+                tmp = score[i];
+                score[i++] = score[j];
+                score[j--] = tmp;
+            }
+        }
+        /* Now score[lo..j] >= pivot, score[i..hi] <= pivot, and
+         * anything in between is the pivot. */
+        if (k <= j)
+            hi = j;
+        else if (k >= i)
+            lo = i;
+        else
+            return pivot;
+    }
+    return score[k];
+}
+
+int32 *
+hmm_score_grow(int32 **inout_score, int32 *inout_n_alloc, int32 n)
+{
+    if (n > *inout_n_alloc) {
+        *inout_n_alloc = n;
+        *inout_score = ckd_realloc(*inout_score, n * sizeof(**inout_score));
+    }
+    return *inout_score;
+}
+
 int32
 hmm_dump_vit_eval(hmm_t * hmm, FILE * fp)
 {
@@ -134,6 +134,24 @@ typedef int32 frame_idx_t;
  * 3-state topologies that contain a subset of the above transitions should work as well. 
  */
 
+typedef struct hmm_s hmm_t;
+
+/**
+ * Hard-coded limit on the number of emitting states.
+ */
+#define HMM_MAX_NSTATE 5
+
+/**
+ * Most HMMs evaluated together by the vector kernels.
+ */
+#define HMM_MAX_LANES 8
+
+/**
+ * Evaluate hmm_context_t::n_lane non-multiplex HMMs together.
+ * @return the best of best and their best scores.
+ */
+typedef int32 (*hmm_eval_lanes_f)(hmm_t * const *hmm, int32 best);
+
 /**
  * @struct hmm_context_t
  * @brief Shared information between a set of HMMs.
@@ -152,12 +170,18 @@ typedef struct hmm_context_s {
     int32 *st_sen_scr;      /**< Temporary array of senone scores (for some topologies). */
     listelem_alloc_t *mpx_ssid_alloc; /**< Allocator for senone sequence ID arrays. */
     void *udata;            /**< Whatever you feel like, gosh. */
-} hmm_context_t;
 
-/**
- * Hard-coded limit on the number of emitting states.
- */
-#define HMM_MAX_NSTATE 5
+    int32 n_lane;           /**< HMMs evaluated together by eval_lanes, or
+                               0 if they are evaluated one by one. */
+    hmm_eval_lanes_f eval_lanes; /**< Vector kernel for this topology. */
+    int32 *tp_lane;         /**< Transition probabilities of each matrix,
+                               negated and in the order the vector
+                               kernels use them. */
+    hmm_t *lane[HMM_MAX_LANES];  /**< HMMs queued by hmm_vit_eval_add(). */
+    int32 n_queued;         /**< Number of HMMs in lane. */
+    int32 queue_best;       /**< Best score of the HMMs evaluated since the
+                               last hmm_vit_eval_flush(). */
+} hmm_context_t;
 
 /**
  * @struct hmm_t
@@ -166,8 +190,11 @@ typedef struct hmm_context_s {
  * An individual HMM among the HMM search space.  An HMM with N
  * emitting states consists of N+1 internal states including the
  * non-emitting exit (out) state.
+ *
+ * The vector kernels of hmm_vit_eval_add() copy score through
+ * out_history as one array of int32, so they must stay together.
  */
-typedef struct hmm_s {
+struct hmm_s {
     hmm_context_t *ctx;            /**< Shared context data for this HMM. */
     int32 score[HMM_MAX_NSTATE];   /**< State scores for emitting states. */
     int32 history[HMM_MAX_NSTATE]; /**< History indices for emitting states. */
@@ -180,7 +207,7 @@ typedef struct hmm_s {
     frame_idx_t frame;  /**< Frame in which this HMM was last active; <0 if inactive */
     uint8 mpx;          /**< Is this HMM multiplex? (hoisted for speed) */
     uint8 n_emit_state; /**< Number of emitting states (hoisted for speed) */
-} hmm_t;
+};
 
 /** Access macros. */
 #define hmm_context(h) (h)->ctx
@@ -218,6 +245,7 @@ typedef struct hmm_s {
  **/
 hmm_context_t *hmm_context_init(int32 n_emit_state,
                                 uint8 ** const *tp,
+                                int32 n_tmat,
                                 int16 const *senscore,
                                 uint16 * const *sseq);
 
@@ -281,6 +309,46 @@ void hmm_enter(hmm_t *h, int32 score,
  * well.
 */
 int32 hmm_vit_eval(hmm_t *hmm);
+
+/**
+ * Viterbi evaluation of an HMM, possibly later.
+ *
+ * HMMs of the 3- and 5-state left-to-right topologies are queued in
+ * their context ctx, and the non-multiplex ones evaluated
+ * hmm_context_t::n_lane at a time by a vector kernel, their scores
+ * laid out one HMM to a lane.  This also gives them time to be
+ * fetched into cache.  The results are exactly those of
+ * hmm_vit_eval(), but they are only all there after
+ * hmm_vit_eval_flush().
+ */
+void hmm_vit_eval_add(hmm_context_t *ctx, hmm_t *hmm);
+
+/**
+ * Evaluate the HMMs still queued by hmm_vit_eval_add().
+ *
+ * @return the best score of all the HMMs added since the last call,
+ * or WORST_SCORE if there were none.
+ */
+int32 hmm_vit_eval_flush(hmm_context_t *ctx);
+
+/**
+ * Find the n_keep-th best of n scores (of HMMs or word exits), for
+ * histogram pruning: keeping only those no worse than it keeps
+ * exactly n_keep of them, or a few more if it is tied.
+ *
+ * The scores are reordered.  This takes time linear in n (on average).
+ */
+int32 hmm_score_select(int32 *score, int32 n, int32 n_keep);
+
+/**
+ * Grow a scratch array of scores for hmm_score_select(), if needed,
+ * so that it holds at least n of them.
+ *
+ * @param inout_score The array, which may be NULL, and is reallocated.
+ * @param inout_n_alloc The number of scores allocated in it.
+ * @return the array.
+ */
+int32 *hmm_score_grow(int32 **inout_score, int32 *inout_n_alloc, int32 n);
   
 
 /**
@@ -202,35 +202,24 @@ static void
 kws_search_hmm_eval(kws_search_t * kwss, int16 const *senscr)
 {
     int32 i, keyword_iter;
-    int32 bestscore = WORST_SCORE;
 
     hmm_context_set_senscore(kwss->hmmctx, senscr);
 
     /* evaluate hmms from phone loop */
-    for (i = 0; i < kwss->n_pl; ++i) {
-        hmm_t *hmm = &kwss->pl_hmms[i];
-        int32 score;
-
-        score = hmm_vit_eval(hmm);
-        if (score BETTER_THAN bestscore)
-            bestscore = score;
-    }
+    for (i = 0; i < kwss->n_pl; ++i)
+        hmm_vit_eval_add(kwss->hmmctx, &kwss->pl_hmms[i]);
     /* evaluate hmms for active nodes */
     for (keyword_iter = 0; keyword_iter < kwss->n_keyphrases; keyword_iter++) {
         kws_keyword_t *keyword = &kwss->keyphrases[keyword_iter];
         for (i = 0; i < keyword->n_hmms; i++) {
             hmm_t *hmm = kws_nth_hmm(keyword, i);
 
-            if (hmm_is_active(hmm)) {
-                int32 score;
-                score = hmm_vit_eval(hmm);
-                if (score BETTER_THAN bestscore)
-                    bestscore = score;
-            }
+            if (hmm_is_active(hmm))
+                hmm_vit_eval_add(kwss->hmmctx, hmm);
         }
     }
 
-    kwss->bestscore = bestscore;
+    kwss->bestscore = hmm_vit_eval_flush(kwss->hmmctx);
 }
 
 /*
@@ -484,7 +473,8 @@ kws_search_reinit(ps_search_t * search, dict_t * dict, dict2pid_t * d2p)
         hmm_context_free(kwss->hmmctx);
     kwss->hmmctx =
         hmm_context_init(bin_mdef_n_emit_state(search->acmod->mdef),
-                         search->acmod->tmat->tp, NULL,
+                         search->acmod->tmat->tp,
+                         search->acmod->tmat->n_tmat, NULL,
                          search->acmod->mdef->sseq);
     if (kwss->hmmctx == NULL)
         return -1;
@@ -122,6 +122,17 @@
 #include <sphinxbase/bio.h>
 #include <sphinxbase/err.h>
 #include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/simd.h>
+
+#ifdef SPHINX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
 
 /* Local headesr. */
 #include "ms_gauden.h"
@@ -134,6 +145,19 @@
 
 #define WORST_DIST	(int32)(0x80000000)
 
+/* Largest number of densities in a block. */
+#define GAUDEN_MAX_LANE 8
+
+/* Size of the codebook tiles scored for several frames at a time. */
+#define GAUDEN_TILE_BYTES 16384
+
+/* Threshold that no score is below. */
+#ifdef FIXED_POINT
+#define GAUDEN_NO_THRESH ((mfcc_t)WORST_DIST)
+#else
+#define GAUDEN_NO_THRESH ((mfcc_t)-INFINITY)
+#endif
+
 void
 gauden_dump(const gauden_t * g)
 {
@@ -175,6 +199,30 @@ gauden_dump_ind(const gauden_t * g, int senidx)
     fflush(stderr);
 }
 
+/*
+ * Point the parameter vectors of each codebook, feature and density
+ * into buf, where they are contiguous.
+ */
+static void ****
+gauden_param_ptrs(int32 n_mgau, int32 n_feat, int32 n_density,
+                  int32 const *veclen, void *buf)
+{
+    void ****out;
+    int32 i, j, k, l;
+
+    out = (void ****) ckd_calloc_3d(n_mgau, n_feat, n_density,
+                                    sizeof(void *));
+    for (i = 0, l = 0; i < n_mgau; i++) {
+        for (j = 0; j < n_feat; j++) {
+            for (k = 0; k < n_density; k++) {
+                out[i][j][k] = (float32 *)buf + l;
+                l += veclen[j];
+            }
+        }
+    }
+    return out;
+}
+
 static int32
 gauden_param_read(float32 ***** out_param,      /* Alloc space iff *out_param == NULL */
                   int32 * out_n_mgau,
@@ -184,7 +232,7 @@ gauden_param_read(float32 ***** out_param,      /* Alloc space iff *out_param ==
 {
     char tmp;
     FILE *fp;
-    int32 i, j, k, l, n, blk;
+    int32 i, n, blk;
     int32 n_mgau;
     int32 n_feat;
     int32 n_density;
@@ -258,17 +306,9 @@ gauden_param_read(float32 ***** out_param,      /* Alloc space iff *out_param ==
 
     /* Allocate memory for mixture gaussian densities if not already allocated */
     if (!(*out_param)) {
-        out = (float32 ****) ckd_calloc_3d(n_mgau, n_feat, n_density,
-                                         sizeof(float32 *));
         buf = (float32 *) ckd_calloc(n, sizeof(float32));
-        for (i = 0, l = 0; i < n_mgau; i++) {
-            for (j = 0; j < n_feat; j++) {
-                for (k = 0; k < n_density; k++) {
-                    out[i][j][k] = &buf[l];
-                    l += veclen[j];
-                }
-            }
-        }
+        out = (float32 ****) gauden_param_ptrs(n_mgau, n_feat, n_density,
+                                               veclen, buf);
     }
     else {
         out = (float32 ****) *out_param;
@@ -297,9 +337,10 @@ gauden_param_read(float32 ***** out_param,      /* Alloc space iff *out_param ==
 }
 
 static void
-gauden_param_free(mfcc_t **** p)
+gauden_param_free(mfcc_t **** p, int32 mapped)
 {
-    ckd_free(p[0][0][0]);
+    if (!mapped)
+        ckd_free(p[0][0][0]);
     ckd_free_3d(p);
 }
 
@@ -356,6 +397,663 @@ gauden_dist_precompute(gauden_t * g, logmath_t *lmath, float32 varfloor)
     return 0;
 }
 
+/*
+ * Density evaluation kernels.  Each vector lane holds a different
+ * density of a block, and each density is still scored one dimension
+ * at a time, in order, so the scores are exactly those of the scalar
+ * code.  In fixed-point, a density that underflows is marked in uf
+ * and scored as WORST_SCORE, like the scalar code did.
+ */
+#define GAUDEN_DEFINE_EVAL_BLK(name, attr, vec_t, uf_t, width, check,   \
+                               LOAD, SET1, SUB, MUL, UF_INIT, UF_STEP,  \
+                               ALL_OUT, FINISH)                         \
+    static attr int32                                                   \
+    name(mfcc_t const *mean, mfcc_t const *var, mfcc_t const *det,      \
+         mfcc_t const *obs, int32 featlen, mfcc_t thresh,               \
+         int32 b, int32 n_block, mfcc_t *out_d, int32 *out_uf)          \
+    {                                                                   \
+        vec_t th = SET1(thresh);                                        \
+                                                                        \
+        mean += b * featlen * (width);                                  \
+        var += b * featlen * (width);                                   \
+        for (; b < n_block; ++b) {                                      \
+            vec_t d = LOAD(det + b * (width));                          \
+            uf_t uf = UF_INIT;                                          \
+            int32 i;                                                    \
+                                                                        \
+            for (i = 0; i < featlen; ++i) {                             \
+                vec_t diff, p = d;                                      \
+                                                                        \
+                if (i % (check) == 0 && ALL_OUT(d, uf, th))             \
+                    break;                                              \
+                diff = SUB(SET1(obs[i]), LOAD(mean + i * (width)));     \
+                d = SUB(d, MUL(MUL(diff, diff),                         \
+                               LOAD(var + i * (width))));               \
+                UF_STEP(uf, d, p);                                      \
+            }                                                           \
+            mean += featlen * (width);                                  \
+            var += featlen * (width);                                   \
+            if (i == featlen) {                                         \
+                *out_uf = FINISH(out_d, d, uf);                         \
+                return b;                                               \
+            }                                                           \
+        }                                                               \
+        return n_block;                                                 \
+    }
+
+#define GD_SCALAR_LOAD(p) (*(p))
+#define GD_SCALAR_SET1(x) (x)
+#define GD_SCALAR_SUB(a, b) ((a) - (b))
+#ifdef FIXED_POINT
+/* Have to check for underflows here. */
+#define GD_SCALAR_UF_STEP(uf, d, p) ((uf) |= ((d) > (p)))
+#define GD_SCALAR_ALL_OUT(d, uf, th) ((uf) || (d) < (th))
+#define GD_SCALAR_FINISH(out, d, uf) \
+    (*(out) = (uf) ? WORST_SCORE : (d), (uf))
+#else
+#define GD_SCALAR_UF_STEP(uf, d, p) ((void)(p))
+#define GD_SCALAR_ALL_OUT(d, uf, th) ((d) < (th))
+#define GD_SCALAR_FINISH(out, d, uf) ((void)(uf), *(out) = (d), 0)
+#endif
+GAUDEN_DEFINE_EVAL_BLK(eval_blk, , mfcc_t, int32, 1, 1, GD_SCALAR_LOAD,
+                       GD_SCALAR_SET1, GD_SCALAR_SUB, MFCCMUL, 0,
+                       GD_SCALAR_UF_STEP, GD_SCALAR_ALL_OUT,
+                       GD_SCALAR_FINISH)
+
+#ifdef FIXED_POINT
+/*
+ * MFCCMUL() keeps bits DEFAULT_RADIX..DEFAULT_RADIX+31 of the 64-bit
+ * product.  SSE2 has no signed 32x32->64 multiply, so on x86 only
+ * AVX2 is supported.
+ */
+#ifdef SPHINX_HAVE_AVX2
+static inline SIMD_TARGET_AVX2 __m256i
+gd_fixmul_avx2(__m256i a, __m256i b)
+{
+    __m256i even, odd;
+
+    even = _mm256_mul_epi32(a, b);
+    odd = _mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                           _mm256_srli_epi64(b, 32));
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, DEFAULT_RADIX),
+                              _mm256_slli_epi64(odd, 32 - DEFAULT_RADIX),
+                              0xaa);
+}
+static inline SIMD_TARGET_AVX2 int32
+gd_all_out_avx2(__m256i d, __m256i uf, __m256i th)
+{
+    __m256i out = _mm256_or_si256(uf, _mm256_cmpgt_epi32(th, d));
+    return _mm256_movemask_ps(_mm256_castsi256_ps(out)) == 0xff;
+}
+static inline SIMD_TARGET_AVX2 int32
+gd_finish_avx2(mfcc_t *out, __m256i d, __m256i uf)
+{
+    _mm256_storeu_si256((__m256i *)out,
+                        _mm256_blendv_epi8(d, _mm256_set1_epi32(WORST_SCORE),
+                                           uf));
+    return _mm256_movemask_ps(_mm256_castsi256_ps(uf));
+}
+#define GD_AVX2_LOAD(p) _mm256_loadu_si256((__m256i const *)(p))
+#define GD_AVX2_UF_STEP(uf, d, p) \
+    ((uf) = _mm256_or_si256(uf, _mm256_cmpgt_epi32(d, p)))
+GAUDEN_DEFINE_EVAL_BLK(eval_blk_avx2, SIMD_TARGET_AVX2, __m256i, __m256i,
+                       8, 4, GD_AVX2_LOAD, _mm256_set1_epi32,
+                       _mm256_sub_epi32, gd_fixmul_avx2,
+                       _mm256_setzero_si256(), GD_AVX2_UF_STEP,
+                       gd_all_out_avx2, gd_finish_avx2)
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+static inline int32x4_t
+gd_fixmul_neon(int32x4_t a, int32x4_t b)
+{
+    return vcombine_s32(vshrn_n_s64(vmull_s32(vget_low_s32(a),
+                                              vget_low_s32(b)),
+                                    DEFAULT_RADIX),
+                        vshrn_n_s64(vmull_high_s32(a, b), DEFAULT_RADIX));
+}
+static inline int32
+gd_finish_neon(mfcc_t *out, int32x4_t d, uint32x4_t uf)
+{
+    static const uint32 bits[4] = { 1, 2, 4, 8 };
+
+    vst1q_s32(out, vbslq_s32(uf, vdupq_n_s32(WORST_SCORE), d));
+    return vaddvq_u32(vandq_u32(uf, vld1q_u32(bits)));
+}
+#define GD_NEON_UF_STEP(uf, d, p) ((uf) = vorrq_u32(uf, vcgtq_s32(d, p)))
+#define GD_NEON_ALL_OUT(d, uf, th) \
+    (vminvq_u32(vorrq_u32(uf, vcltq_s32(d, th))) != 0)
+GAUDEN_DEFINE_EVAL_BLK(eval_blk_neon, , int32x4_t, uint32x4_t, 4, 4,
+                       vld1q_s32, vdupq_n_s32, vsubq_s32, gd_fixmul_neon,
+                       vdupq_n_u32(0), GD_NEON_UF_STEP, GD_NEON_ALL_OUT,
+                       gd_finish_neon)
+#endif /* SPHINX_HAVE_NEON */
+
+#else /* !FIXED_POINT */
+
+/* Separate multiplies and subtracts (no FMA) round like the scalar
+ * code. */
+#define GD_FLOAT_UF_STEP(uf, d, p) ((void)(p))
+#ifdef SPHINX_HAVE_SSE2
+#define GD_HAVE_SSE2 1
+#define GD_SSE2_ALL_OUT(d, uf, th) \
+    (_mm_movemask_ps(_mm_cmplt_ps(d, th)) == 0xf)
+#define GD_SSE2_FINISH(out, d, uf) ((void)(uf), _mm_storeu_ps(out, d), 0)
+GAUDEN_DEFINE_EVAL_BLK(eval_blk_sse2, , __m128, int32, 4, 4, _mm_loadu_ps,
+                       _mm_set1_ps, _mm_sub_ps, _mm_mul_ps, 0,
+                       GD_FLOAT_UF_STEP, GD_SSE2_ALL_OUT, GD_SSE2_FINISH)
+#endif /* SPHINX_HAVE_SSE2 */
+
+#ifdef SPHINX_HAVE_AVX2
+#define GD_AVX2_ALL_OUT(d, uf, th) \
+    (_mm256_movemask_ps(_mm256_cmp_ps(d, th, _CMP_LT_OQ)) == 0xff)
+#define GD_AVX2_FINISH(out, d, uf) \
+    ((void)(uf), _mm256_storeu_ps(out, d), 0)
+GAUDEN_DEFINE_EVAL_BLK(eval_blk_avx2, SIMD_TARGET_AVX2, __m256, int32, 8, 4,
+                       _mm256_loadu_ps, _mm256_set1_ps, _mm256_sub_ps,
+                       _mm256_mul_ps, 0, GD_FLOAT_UF_STEP, GD_AVX2_ALL_OUT,
+                       GD_AVX2_FINISH)
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+#define GD_NEON_ALL_OUT(d, uf, th) (vminvq_u32(vcltq_f32(d, th)) != 0)
+#define GD_NEON_FINISH(out, d, uf) ((void)(uf), vst1q_f32(out, d), 0)
+GAUDEN_DEFINE_EVAL_BLK(eval_blk_neon, , float32x4_t, int32, 4, 4, vld1q_f32,
+                       vdupq_n_f32, vsubq_f32, vmulq_f32, 0,
+                       GD_FLOAT_UF_STEP, GD_NEON_ALL_OUT, GD_NEON_FINISH)
+#endif /* SPHINX_HAVE_NEON */
+
+#endif /* !FIXED_POINT */
+
+/*
+ * Quantized density evaluation kernels.  Each lane holds a different
+ * density of a block, and two dimensions of it, whose difference d
+ * from the observation is multiplied by the precision v as (d * v +
+ * (1 << 14)) >> 15 (pmulhrsw), then by d again and added up in 32
+ * bits (pmaddwd).  Features and means are clamped so that the sum of
+ * a whole stream cannot overflow.  Every kernel computes exactly the
+ * same integer distances.
+ *
+ * The distance is knocked out once it is above a limit computed from
+ * the threshold and determinant of each density, and converted back
+ * to a score at the end.
+ */
+#define GAUDEN_DEFINE_EVAL_Q(name, attr, acc_t, width, LIMIT, ZERO,     \
+                             ALL_OUT, STEP, FINISH)                     \
+    static attr int32                                                   \
+    name(int16 const *mean, int16 const *var, float32 const *det,       \
+         int32 const *obs, int32 n_pair, float32 scale, mfcc_t thresh,  \
+         int32 b, int32 n_block, mfcc_t *out_d)                         \
+    {                                                                   \
+        mean += b * n_pair * (width) * 2;                               \
+        var += b * n_pair * (width) * 2;                                \
+        for (; b < n_block; ++b) {                                      \
+            acc_t lim = LIMIT(det + b * (width), thresh, scale);        \
+            acc_t acc = ZERO;                                           \
+            int32 i;                                                    \
+                                                                        \
+            for (i = 0; i < n_pair; ++i) {                              \
+                if (i % 2 == 0 && ALL_OUT(acc, lim))                    \
+                    break;                                              \
+                acc = STEP(acc, obs[i], mean + i * (width) * 2,         \
+                           var + i * (width) * 2);                      \
+            }                                                           \
+            mean += n_pair * (width) * 2;                               \
+            var += n_pair * (width) * 2;                                \
+            if (i == n_pair) {                                          \
+                FINISH(out_d, det + b * (width), acc, scale);           \
+                return b;                                               \
+            }                                                           \
+        }                                                               \
+        return n_block;                                                 \
+    }
+
+/* Largest distance limit, which is below 2^31 as a float32. */
+#define GD_Q_MAX_LIM 2147483520.0f
+
+#ifdef FIXED_POINT
+#define GD_Q_SCORE(x) ((x) < (float32)WORST_SCORE \
+                       ? WORST_SCORE : (mfcc_t)(x))
+#else
+#define GD_Q_SCORE(x) ((mfcc_t)(x))
+#endif
+
+static int32
+gd_q_limit(float32 const *det, mfcc_t thresh, float32 scale)
+{
+    float32 lim = (*det - (float32)thresh) * (1.0f / scale);
+
+    if (lim > GD_Q_MAX_LIM)
+        lim = GD_Q_MAX_LIM;
+    if (lim < -1.0f)
+        lim = -1.0f;
+    return (int32)lim;
+}
+static int32
+gd_q_step(int32 acc, int32 obs, int16 const *mean, int16 const *var)
+{
+    int32 d0 = (int16)(obs & 0xffff) - mean[0];
+    int32 d1 = (int16)((uint32)obs >> 16) - mean[1];
+
+    return acc + ((d0 * var[0] + (1 << 14)) >> 15) * d0
+        + ((d1 * var[1] + (1 << 14)) >> 15) * d1;
+}
+#define GD_Q_ALL_OUT(acc, lim) ((acc) > (lim))
+#define GD_Q_FINISH(out, det, acc, scale) \
+    (*(out) = GD_Q_SCORE(*(det) - (float32)(acc) * (scale)))
+GAUDEN_DEFINE_EVAL_Q(eval_q, , int32, 1, gd_q_limit, 0, GD_Q_ALL_OUT,
+                     gd_q_step, GD_Q_FINISH)
+
+#ifdef SPHINX_HAVE_AVX2
+static inline SIMD_TARGET_AVX2 __m256i
+gd_q_limit_avx2(float32 const *det, mfcc_t thresh, float32 scale)
+{
+    __m256 lim = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(det),
+                                             _mm256_set1_ps((float32)thresh)),
+                               _mm256_set1_ps(1.0f / scale));
+
+    lim = _mm256_min_ps(lim, _mm256_set1_ps(GD_Q_MAX_LIM));
+    lim = _mm256_max_ps(lim, _mm256_set1_ps(-1.0f));
+    return _mm256_cvttps_epi32(lim);
+}
+static inline SIMD_TARGET_AVX2 __m256i
+gd_q_step_avx2(__m256i acc, int32 obs, int16 const *mean, int16 const *var)
+{
+    __m256i d = _mm256_sub_epi16(_mm256_set1_epi32(obs),
+                                 _mm256_loadu_si256((__m256i const *)mean));
+    __m256i p = _mm256_mulhrs_epi16(d,
+                                    _mm256_loadu_si256((__m256i const *)var));
+
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(p, d));
+}
+static inline SIMD_TARGET_AVX2 void
+gd_q_finish_avx2(mfcc_t *out, float32 const *det, __m256i acc, float32 scale)
+{
+    __m256 d = _mm256_sub_ps(_mm256_loadu_ps(det),
+                             _mm256_mul_ps(_mm256_cvtepi32_ps(acc),
+                                           _mm256_set1_ps(scale)));
+#ifdef FIXED_POINT
+    d = _mm256_max_ps(d, _mm256_set1_ps((float32)WORST_SCORE));
+    _mm256_storeu_si256((__m256i *)out, _mm256_cvttps_epi32(d));
+#else
+    _mm256_storeu_ps(out, d);
+#endif
+}
+#define GD_Q_ALL_OUT_AVX2(acc, lim) \
+    (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(acc, lim))) \
+     == 0xff)
+GAUDEN_DEFINE_EVAL_Q(eval_q_avx2, SIMD_TARGET_AVX2, __m256i, 8,
+                     gd_q_limit_avx2, _mm256_setzero_si256(),
+                     GD_Q_ALL_OUT_AVX2, gd_q_step_avx2, gd_q_finish_avx2)
+#endif /* SPHINX_HAVE_AVX2 */
+
+/* The quantized NEON kernel has not been built or run on arm64 yet, so
+ * NEON machines use the scalar quantized kernel unless GD_HAVE_Q_NEON
+ * is defined to 1. */
+#ifndef GD_HAVE_Q_NEON
+#define GD_HAVE_Q_NEON 0
+#endif
+#if defined(SPHINX_HAVE_NEON) && GD_HAVE_Q_NEON
+static inline int32x4_t
+gd_q_limit_neon(float32 const *det, mfcc_t thresh, float32 scale)
+{
+    float32x4_t lim = vmulq_f32(vsubq_f32(vld1q_f32(det),
+                                          vdupq_n_f32((float32)thresh)),
+                                vdupq_n_f32(1.0f / scale));
+
+    lim = vminq_f32(lim, vdupq_n_f32(GD_Q_MAX_LIM));
+    lim = vmaxq_f32(lim, vdupq_n_f32(-1.0f));
+    return vcvtq_s32_f32(lim);
+}
+static inline int32x4_t
+gd_q_step_neon(int32x4_t acc, int32 obs, int16 const *mean, int16 const *var)
+{
+    /* vqrdmulh rounds like pmulhrsw, and v is never -32768. */
+    int16x8_t d = vsubq_s16(vreinterpretq_s16_s32(vdupq_n_s32(obs)),
+                            vld1q_s16(mean));
+    int16x8_t p = vqrdmulhq_s16(d, vld1q_s16(var));
+
+    return vaddq_s32(acc,
+                     vpaddq_s32(vmull_s16(vget_low_s16(p), vget_low_s16(d)),
+                                vmull_high_s16(p, d)));
+}
+static inline void
+gd_q_finish_neon(mfcc_t *out, float32 const *det, int32x4_t acc,
+                 float32 scale)
+{
+    float32x4_t d = vsubq_f32(vld1q_f32(det),
+                              vmulq_f32(vcvtq_f32_s32(acc),
+                                        vdupq_n_f32(scale)));
+#ifdef FIXED_POINT
+    d = vmaxq_f32(d, vdupq_n_f32((float32)WORST_SCORE));
+    vst1q_s32(out, vcvtq_s32_f32(d));
+#else
+    vst1q_f32(out, d);
+#endif
+}
+#define GD_Q_ALL_OUT_NEON(acc, lim) (vminvq_u32(vcgtq_s32(acc, lim)) != 0)
+GAUDEN_DEFINE_EVAL_Q(eval_q_neon, , int32x4_t, 4, gd_q_limit_neon,
+                     vdupq_n_s32(0), GD_Q_ALL_OUT_NEON, gd_q_step_neon,
+                     gd_q_finish_neon)
+#endif /* SPHINX_HAVE_NEON && GD_HAVE_Q_NEON */
+
+static void
+gauden_blk_free(gauden_t * g)
+{
+    if (g->q_mean) {
+        if (!g->blk_mapped) {
+            ckd_free(g->q_mean[0][0]);
+            ckd_free(g->q_var[0][0]);
+            ckd_free(g->q_det[0][0]);
+            ckd_free(g->q_offset[0]);
+            ckd_free(g->q_mul[0]);
+            ckd_free(g->q_max);
+            ckd_free(g->q_scale);
+        }
+        ckd_free_2d(g->q_mean);
+        ckd_free_2d(g->q_var);
+        ckd_free_2d(g->q_det);
+        ckd_free_2d_ptr(g->q_offset);
+        ckd_free_2d_ptr(g->q_mul);
+        g->q_mean = g->q_var = NULL;
+        g->q_det = NULL;
+        g->q_offset = g->q_mul = NULL;
+        g->q_max = NULL;
+        g->q_scale = NULL;
+    }
+    if (g->blk_mean) {
+        /* With one lane these point into mean, var and det. */
+        if (g->n_lane > 1 && !g->blk_mapped) {
+            ckd_free(g->blk_mean[0][0]);
+            ckd_free(g->blk_var[0][0]);
+            ckd_free(g->blk_det[0][0]);
+        }
+        ckd_free_2d(g->blk_mean);
+        ckd_free_2d(g->blk_var);
+        ckd_free_2d(g->blk_det);
+        g->blk_mean = g->blk_var = g->blk_det = NULL;
+    }
+    g->blk_mapped = FALSE;
+}
+
+/*
+ * Choose the density evaluation kernel for this machine, which
+ * decides how many densities there are in a block.
+ */
+static void
+gauden_blk_kernel(gauden_t * g)
+{
+    uint32 simd;
+
+    g->n_lane = 1;
+    g->eval_blk = eval_blk;
+    g->eval_q = eval_q;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if ((simd & SIMD_NEON) && (GD_HAVE_Q_NEON || !g->quant)) {
+        g->n_lane = 4;
+        g->eval_blk = eval_blk_neon;
+#if GD_HAVE_Q_NEON
+        g->eval_q = eval_q_neon;
+#endif
+    }
+#endif
+#ifdef GD_HAVE_SSE2
+    /* There is no quantized SSE2 kernel. */
+    if ((simd & SIMD_SSE2) && !g->quant) {
+        g->n_lane = 4;
+        g->eval_blk = eval_blk_sse2;
+    }
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2) {
+        g->n_lane = 8;
+        g->eval_blk = eval_blk_avx2;
+        g->eval_q = eval_q_avx2;
+    }
+#endif
+    (void)simd;
+    g->n_block = (g->n_density + g->n_lane - 1) / g->n_lane;
+}
+
+/* Sizes of the quantized or blocked arrays of each codebook. */
+static int32
+gauden_blk_veclen(gauden_t * g)
+{
+    int32 f, blk;
+
+    for (f = 0, blk = 0; f < g->n_feat; ++f) {
+        if (g->quant)
+            blk += (g->featlen[f] + 1) / 2 * 2;
+        else
+            blk += g->featlen[f];
+    }
+    return g->n_block * g->n_lane * blk;
+}
+
+static int32
+gauden_max_featlen(gauden_t * g)
+{
+    int32 f, j;
+
+    for (f = 0, j = 0; f < g->n_feat; ++f)
+        if (g->featlen[f] > j)
+            j = g->featlen[f];
+    return j;
+}
+
+/*
+ * Point the blocked (or quantized) codebooks of each feature stream
+ * into mean, var and det, which hold them codebook by codebook.
+ */
+static void
+gauden_blk_ptrs(gauden_t * g, void *mean, void *var, void *det)
+{
+    size_t elem = g->quant ? sizeof(int16) : sizeof(mfcc_t);
+    size_t det_elem = g->quant ? sizeof(float32) : sizeof(mfcc_t);
+    void ***m_out, ***v_out, ***d_out;
+    int32 m, f;
+
+    m_out = (void ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(void *));
+    v_out = (void ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(void *));
+    d_out = (void ***)ckd_calloc_2d(g->n_mgau, g->n_feat, sizeof(void *));
+    for (m = 0; m < g->n_mgau; ++m) {
+        for (f = 0; f < g->n_feat; ++f) {
+            int32 featlen = g->featlen[f];
+            size_t n;
+
+            if (g->quant)
+                featlen = (featlen + 1) / 2 * 2;
+            n = (size_t)g->n_block * g->n_lane * featlen * elem;
+            m_out[m][f] = mean;
+            v_out[m][f] = var;
+            d_out[m][f] = det;
+            mean = (char *)mean + n;
+            var = (char *)var + n;
+            det = (char *)det + g->n_block * g->n_lane * det_elem;
+        }
+    }
+    if (g->quant) {
+        g->q_mean = (int16 ***)m_out;
+        g->q_var = (int16 ***)v_out;
+        g->q_det = (float32 ***)d_out;
+    }
+    else {
+        g->blk_mean = (mfcc_t ***)m_out;
+        g->blk_var = (mfcc_t ***)v_out;
+        g->blk_det = (mfcc_t ***)d_out;
+    }
+}
+
+/*
+ * Quantize the (precomputed) codebooks of each feature stream.
+ *
+ * Each dimension is mapped to [-q_max, q_max] so as to cover every
+ * mean plus or minus 4 standard deviations, and q_max is small enough
+ * for the distance (the sum over the stream of the squared difference
+ * times the precision) to fit in 32 bits.  Precisions are scaled to
+ * the same unit of distance, with the largest one at 32767.
+ */
+static void
+gauden_quant_init(gauden_t * g)
+{
+    int32 m, f, c, j, n_pair, maxlen;
+    float64 ln_base;
+
+    maxlen = gauden_max_featlen(g);
+    g->q_offset = (float32 **)ckd_calloc_2d(g->n_feat, maxlen,
+                                            sizeof(float32));
+    g->q_mul = (float32 **)ckd_calloc_2d(g->n_feat, maxlen,
+                                         sizeof(float32));
+    g->q_max = ckd_calloc(g->n_feat, sizeof(*g->q_max));
+    g->q_scale = ckd_calloc(g->n_feat, sizeof(*g->q_scale));
+    gauden_blk_ptrs(g,
+                    ckd_calloc(g->n_mgau * gauden_blk_veclen(g),
+                               sizeof(int16)),
+                    ckd_calloc(g->n_mgau * gauden_blk_veclen(g),
+                               sizeof(int16)),
+                    ckd_calloc(g->n_mgau * g->n_feat
+                               * g->n_block * g->n_lane,
+                               sizeof(float32)));
+
+    ln_base = log(logmath_get_base(g->lmath));
+    for (f = 0; f < g->n_feat; ++f) {
+        int32 featlen = g->featlen[f];
+        float64 maxvar = 0.0;
+
+        n_pair = (featlen + 1) / 2;
+        g->q_max[f] = (int32)(sqrt(2147483647.0 / (2 * n_pair)) / 2);
+        if (g->q_max[f] > 16383)
+            g->q_max[f] = 16383;
+        for (j = 0; j < featlen; ++j) {
+            float64 lo = DBL_MAX, hi = -DBL_MAX;
+
+            /* A difference of 4 standard deviations costs 8 nats. */
+            for (m = 0; m < g->n_mgau; ++m) {
+                for (c = 0; c < g->n_density; ++c) {
+                    float64 mu = MFCC2FLOAT(g->mean[m][f][c][j]);
+                    float64 v = (float64)g->var[m][f][c][j];
+                    float64 w = (v > 0) ? sqrt(8.0 / ln_base / v) : 0;
+
+                    if (mu - w < lo)
+                        lo = mu - w;
+                    if (mu + w > hi)
+                        hi = mu + w;
+                }
+            }
+            if (hi <= lo)
+                hi = lo + 1.0;
+            g->q_offset[f][j] = (float32)((lo + hi) / 2);
+            g->q_mul[f][j] = (float32)(g->q_max[f] * 2 / (hi - lo));
+            for (m = 0; m < g->n_mgau; ++m) {
+                for (c = 0; c < g->n_density; ++c) {
+                    float64 v = (float64)g->var[m][f][c][j]
+                        / g->q_mul[f][j] / g->q_mul[f][j];
+                    if (v > maxvar)
+                        maxvar = v;
+                }
+            }
+        }
+        if (maxvar == 0.0)
+            maxvar = 1.0;
+        g->q_scale[f] = (float32)(maxvar * 32768.0 / 32767.0);
+
+        for (m = 0; m < g->n_mgau; ++m) {
+            int16 *mean = g->q_mean[m][f];
+            int16 *var = g->q_var[m][f];
+            float32 *det = g->q_det[m][f];
+
+            for (c = 0; c < g->n_block * g->n_lane; ++c) {
+                /* Offset of dimension 0 of codeword c. */
+                int32 k = (c / g->n_lane * n_pair * g->n_lane
+                           + c % g->n_lane) * 2;
+                if (c >= g->n_density) {
+                    /* Padding, which is never used. */
+                    det[c] = (float32)WORST_SCORE;
+                    continue;
+                }
+                det[c] = (float32)g->det[m][f][c];
+                for (j = 0; j < featlen; ++j) {
+                    float64 mu = (MFCC2FLOAT(g->mean[m][f][c][j])
+                                  - g->q_offset[f][j]) * g->q_mul[f][j];
+                    float64 v = (float64)g->var[m][f][c][j]
+                        / g->q_mul[f][j] / g->q_mul[f][j] / maxvar;
+                    int32 o = k + (j / 2 * g->n_lane) * 2 + j % 2;
+
+                    mean[o] = (int16)floor(mu + 0.5);
+                    var[o] = (int16)floor(v * 32767.0 + 0.5);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Lay out the (precomputed) codebooks in blocks for the density
+ * evaluation kernel.  With one lane, the blocked layout is the same
+ * as the original one, so it is not copied.
+ */
+static void
+gauden_blk_init(gauden_t * g)
+{
+    int32 m, f, c, j;
+
+    gauden_blk_kernel(g);
+    if (g->quant) {
+        gauden_quant_init(g);
+        return;
+    }
+    if (g->n_lane == 1) {
+        g->blk_mean = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat,
+                                                sizeof(mfcc_t *));
+        g->blk_var = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat,
+                                               sizeof(mfcc_t *));
+        g->blk_det = (mfcc_t ***)ckd_calloc_2d(g->n_mgau, g->n_feat,
+                                               sizeof(mfcc_t *));
+        for (m = 0; m < g->n_mgau; ++m) {
+            for (f = 0; f < g->n_feat; ++f) {
+                g->blk_mean[m][f] = g->mean[m][f][0];
+                g->blk_var[m][f] = g->var[m][f][0];
+                g->blk_det[m][f] = g->det[m][f];
+            }
+        }
+        return;
+    }
+
+    gauden_blk_ptrs(g,
+                    ckd_calloc(g->n_mgau * gauden_blk_veclen(g),
+                               sizeof(mfcc_t)),
+                    ckd_calloc(g->n_mgau * gauden_blk_veclen(g),
+                               sizeof(mfcc_t)),
+                    ckd_calloc(g->n_mgau * g->n_feat
+                               * g->n_block * g->n_lane,
+                               sizeof(mfcc_t)));
+    for (m = 0; m < g->n_mgau; ++m) {
+        for (f = 0; f < g->n_feat; ++f) {
+            int32 featlen = g->featlen[f];
+            mfcc_t *mean = g->blk_mean[m][f];
+            mfcc_t *var = g->blk_var[m][f];
+            mfcc_t *det = g->blk_det[m][f];
+
+            for (c = 0; c < g->n_block * g->n_lane; ++c) {
+                /* Offset of dimension 0 of codeword c. */
+                int32 k = c / g->n_lane * featlen * g->n_lane
+                    + c % g->n_lane;
+                if (c >= g->n_density) {
+                    /* Padding, which is never used. */
+                    det[c] = (mfcc_t)WORST_DIST;
+                    continue;
+                }
+                det[c] = g->det[m][f][c];
+                for (j = 0; j < featlen; ++j) {
+                    mean[k + j * g->n_lane] = g->mean[m][f][c][j];
+                    var[k + j * g->n_lane] = g->var[m][f][c][j];
+                }
+            }
+        }
+    }
+}
+
 
 gauden_t *
 gauden_init(char const *meanfile, char const *varfile, float32 varfloor, logmath_t *lmath)
@@ -391,133 +1089,276 @@ gauden_init(char const *meanfile, char const *varfile, float32 varfloor, logmath
 
     /* Floor variances and precompute variance determinants */
     gauden_dist_precompute(g, lmath, varfloor);
+    gauden_blk_init(g);
 
     return g;
 }
 
+gauden_t *
+gauden_init_arrays(void const **ptr, size_t const *size, int32 n_array,
+                   logmath_t *lmath)
+{
+    gauden_t *g;
+    int32 const *dims;
+    size_t n_blk, n_det;
+
+    if (n_array < 2 || size[0] != GAUDEN_N_DIMS * sizeof(int32))
+        return NULL;
+    dims = ptr[0];
+    if (dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0
+        || size[1] != dims[1] * sizeof(int32))
+        return NULL;
+
+    g = (gauden_t *) ckd_calloc(1, sizeof(gauden_t));
+    g->lmath = lmath;
+    g->n_mgau = dims[0];
+    g->n_feat = dims[1];
+    g->n_density = dims[2];
+    g->quant = dims[4];
+    g->featlen = ckd_calloc(g->n_feat, sizeof(*g->featlen));
+    memcpy(g->featlen, ptr[1], size[1]);
+    gauden_blk_kernel(g);
+    if (g->n_lane != dims[3]) {
+        E_INFO("Codebooks were laid out in blocks of %d, not %d\n",
+               dims[3], g->n_lane);
+        goto error_out;
+    }
+
+    n_blk = (size_t)gauden_blk_veclen(g) * g->n_mgau;
+    n_det = (size_t)g->n_mgau * g->n_feat * g->n_block * g->n_lane;
+    if (g->quant) {
+        size_t n_dim = (size_t)g->n_feat * gauden_max_featlen(g);
+
+        if (n_array != 9
+            || size[2] != n_blk * sizeof(int16)
+            || size[3] != n_blk * sizeof(int16)
+            || size[4] != n_det * sizeof(float32)
+            || size[5] != n_dim * sizeof(float32)
+            || size[6] != n_dim * sizeof(float32)
+            || size[7] != g->n_feat * sizeof(int32)
+            || size[8] != g->n_feat * sizeof(float32))
+            goto error_out;
+        gauden_blk_ptrs(g, (void *)ptr[2], (void *)ptr[3], (void *)ptr[4]);
+        g->q_offset = (float32 **)ckd_alloc_2d_ptr(g->n_feat,
+                                                   gauden_max_featlen(g),
+                                                   (void *)ptr[5],
+                                                   sizeof(float32));
+        g->q_mul = (float32 **)ckd_alloc_2d_ptr(g->n_feat,
+                                                gauden_max_featlen(g),
+                                                (void *)ptr[6],
+                                                sizeof(float32));
+        g->q_max = (int32 *)ptr[7];
+        g->q_scale = (float32 *)ptr[8];
+        g->blk_mapped = TRUE;
+        return g;
+    }
+
+    if (n_array != 5
+        || size[2] != n_blk * sizeof(mfcc_t)
+        || size[3] != n_blk * sizeof(mfcc_t)
+        || size[4] != n_det * sizeof(mfcc_t))
+        goto error_out;
+    if (g->n_lane > 1) {
+        gauden_blk_ptrs(g, (void *)ptr[2], (void *)ptr[3], (void *)ptr[4]);
+        g->blk_mapped = TRUE;
+        return g;
+    }
+    /* With one lane, the blocks are the codebooks themselves. */
+    g->mean = (mfcc_t ****)gauden_param_ptrs(g->n_mgau, g->n_feat,
+                                             g->n_density, g->featlen,
+                                             (void *)ptr[2]);
+    g->var = (mfcc_t ****)gauden_param_ptrs(g->n_mgau, g->n_feat,
+                                            g->n_density, g->featlen,
+                                            (void *)ptr[3]);
+    g->det = (mfcc_t ***)ckd_alloc_3d_ptr(g->n_mgau, g->n_feat,
+                                          g->n_density, (void *)ptr[4],
+                                          sizeof(mfcc_t));
+    g->mapped = TRUE;
+    gauden_blk_init(g);
+    return g;
+
+error_out:
+    gauden_free(g);
+    return NULL;
+}
+
+int32
+gauden_get_arrays(gauden_t *g, int32 *dims,
+                  void const **out_ptr, size_t *out_size)
+{
+    size_t n_blk, n_det;
+    int32 n;
+
+    dims[0] = g->n_mgau;
+    dims[1] = g->n_feat;
+    dims[2] = g->n_density;
+    dims[3] = g->n_lane;
+    dims[4] = g->quant;
+    n_blk = (size_t)gauden_blk_veclen(g) * g->n_mgau;
+    n_det = (size_t)g->n_mgau * g->n_feat * g->n_block * g->n_lane;
+
+    n = 0;
+    out_ptr[n] = dims;
+    out_size[n++] = GAUDEN_N_DIMS * sizeof(int32);
+    out_ptr[n] = g->featlen;
+    out_size[n++] = g->n_feat * sizeof(int32);
+    if (g->quant) {
+        size_t n_dim = (size_t)g->n_feat * gauden_max_featlen(g);
+
+        out_ptr[n] = g->q_mean[0][0];
+        out_size[n++] = n_blk * sizeof(int16);
+        out_ptr[n] = g->q_var[0][0];
+        out_size[n++] = n_blk * sizeof(int16);
+        out_ptr[n] = g->q_det[0][0];
+        out_size[n++] = n_det * sizeof(float32);
+        out_ptr[n] = g->q_offset[0];
+        out_size[n++] = n_dim * sizeof(float32);
+        out_ptr[n] = g->q_mul[0];
+        out_size[n++] = n_dim * sizeof(float32);
+        out_ptr[n] = g->q_max;
+        out_size[n++] = g->n_feat * sizeof(int32);
+        out_ptr[n] = g->q_scale;
+        out_size[n++] = g->n_feat * sizeof(float32);
+    }
+    else {
+        out_ptr[n] = g->blk_mean[0][0];
+        out_size[n++] = n_blk * sizeof(mfcc_t);
+        out_ptr[n] = g->blk_var[0][0];
+        out_size[n++] = n_blk * sizeof(mfcc_t);
+        out_ptr[n] = g->blk_det[0][0];
+        out_size[n++] = n_det * sizeof(mfcc_t);
+    }
+    return n;
+}
+
+/* Free mean, var and det (or, if mapped, just their pointers). */
+static void
+gauden_param_free_all(gauden_t * g)
+{
+    if (g->mean)
+        gauden_param_free(g->mean, g->mapped);
+    if (g->var)
+        gauden_param_free(g->var, g->mapped);
+    if (g->det) {
+        if (g->mapped)
+            ckd_free_3d_ptr(g->det);
+        else
+            ckd_free_3d(g->det);
+    }
+    g->mean = NULL;
+    g->var = NULL;
+    g->det = NULL;
+    g->mapped = FALSE;
+}
+
 void
 gauden_free(gauden_t * g)
 {
     if (g == NULL)
         return;
-    if (g->mean)
-        gauden_param_free(g->mean);
-    if (g->var)
-        gauden_param_free(g->var);
-    if (g->det)
-        ckd_free_3d(g->det);
+    gauden_blk_free(g);
+    gauden_param_free_all(g);
     if (g->featlen)
         ckd_free(g->featlen);
     ckd_free(g);
 }
 
-/* See compute_dist below */
+/*
+ * Find the next block of densities of codebook mgau and feature f,
+ * from b up to end, not knocked out by obs (or qobs, quantized), with
+ * the kernel in use.
+ */
 static int32
-compute_dist_all(gauden_dist_t * out_dist, mfcc_t* obs, int32 featlen,
-                 mfcc_t ** mean, mfcc_t ** var, mfcc_t * det,
-                 int32 n_density)
+eval_blk_any(gauden_t * g, int32 mgau, int32 f, mfcc_t const *obs,
+             int32 const *qobs, mfcc_t thresh, int32 b, int32 end,
+             mfcc_t *out_d, int32 *out_uf)
 {
-    int32 i, d;
-
-    for (d = 0; d < n_density; ++d) {
-        mfcc_t *m;
-        mfcc_t *v;
-        mfcc_t dval;
+    if (g->quant) {
+        *out_uf = 0;
+        return g->eval_q(g->q_mean[mgau][f], g->q_var[mgau][f],
+                         g->q_det[mgau][f], qobs, (g->featlen[f] + 1) / 2,
+                         g->q_scale[f], thresh, b, end, out_d);
+    }
+    return g->eval_blk(g->blk_mean[mgau][f], g->blk_var[mgau][f],
+                       g->blk_det[mgau][f], obs, g->featlen[f],
+                       thresh, b, end, out_d, out_uf);
+}
 
-        m = mean[d];
-        v = var[d];
-        dval = det[d];
+/* Start the top-N list for compute_dist_blk(). */
+static void
+compute_dist_init(gauden_t * g, gauden_dist_t * out_dist, int32 n_top)
+{
+    int32 c;
 
-        for (i = 0; i < featlen; i++) {
-            mfcc_t diff;
-#ifdef FIXED_POINT
-            /* Have to check for underflows here. */
-            mfcc_t pdval = dval;
-            diff = obs[i] - m[i];
-            dval -= MFCCMUL(MFCCMUL(diff, diff), v[i]);
-            if (dval > pdval) {
-                dval = WORST_SCORE;
-                break;
-            }
-#else
-            diff = obs[i] - m[i];
-            /* The compiler really likes this to be a single
-             * expression, for whatever reason. */
-            dval -= diff * diff * v[i];
-#endif
+    /* Special case optimization when n_density <= n_top: all of them
+     * are scored. */
+    if (n_top >= g->n_density) {
+        for (c = 0; c < g->n_density; ++c) {
+            out_dist[c].dist = WORST_SCORE;
+            out_dist[c].id = c;
         }
-
-        out_dist[d].dist = dval;
-        out_dist[d].id = d;
     }
-
-    return 0;
+    else {
+        for (c = 0; c < n_top; c++)
+            out_dist[c].dist = WORST_DIST;
+    }
 }
 
-
 /*
- * Compute the top-N closest gaussians from the chosen set (mgau,feat)
- * for the given input observation vector.
+ * Add the densities in blocks b up to end of codebook mgau and
+ * feature f to the top-N list for an input observation vector.
  */
-static int32
-compute_dist(gauden_dist_t * out_dist, int32 n_top,
-             mfcc_t * obs, int32 featlen,
-             mfcc_t ** mean, mfcc_t ** var, mfcc_t * det,
-             int32 n_density)
+static void
+compute_dist_blk(gauden_t * g, gauden_dist_t * out_dist, int32 n_top,
+                 int32 mgau, int32 f, mfcc_t const *obs, int32 const *qobs,
+                 int32 b, int32 end)
 {
-    int32 i, j, d;
+    mfcc_t d[GAUDEN_MAX_LANE];
+    int32 i, j, l, uf;
     gauden_dist_t *worst;
 
-    /* Special case optimization when n_density <= n_top */
-    if (n_top >= n_density)
-        return (compute_dist_all
-                (out_dist, obs, featlen, mean, var, det, n_density));
+    if (n_top >= g->n_density) {
+        /* Nothing is below the threshold, so the kernel only skips
+         * blocks where every density underflowed. */
+        for (; (b = eval_blk_any(g, mgau, f, obs, qobs, GAUDEN_NO_THRESH,
+                                 b, end, d, &uf)) < end; ++b) {
+            for (l = 0; l < g->n_lane; ++l) {
+                int32 c = b * g->n_lane + l;
+                if (c >= g->n_density)
+                    break;
+                out_dist[c].dist = d[l];
+            }
+        }
+        return;
+    }
 
-    for (i = 0; i < n_top; i++)
-        out_dist[i].dist = WORST_DIST;
     worst = &(out_dist[n_top - 1]);
 
-    for (d = 0; d < n_density; d++) {
-        mfcc_t *m;
-        mfcc_t *v;
-        mfcc_t dval;
-
-        m = mean[d];
-        v = var[d];
-        dval = det[d];
-
-        for (i = 0; (i < featlen) && (dval >= worst->dist); i++) {
-            mfcc_t diff;
-#ifdef FIXED_POINT
-            /* Have to check for underflows here. */
-            mfcc_t pdval = dval;
-            diff = obs[i] - m[i];
-            dval -= MFCCMUL(MFCCMUL(diff, diff), v[i]);
-            if (dval > pdval) {
-                dval = WORST_SCORE;
+    /* Scores never go up, so a codeword that falls below the worst
+     * one at any dimension is not in the top-N.  The kernel skips
+     * blocks where they all do, against the worst score when it is
+     * called; that only goes up, so those would be skipped anyway. */
+    for (; (b = eval_blk_any(g, mgau, f, obs, qobs, worst->dist,
+                             b, end, d, &uf)) < end; ++b) {
+        for (l = 0; l < g->n_lane; ++l) {
+            int32 c = b * g->n_lane + l;
+            mfcc_t dval = d[l];
+
+            if (c >= g->n_density)
                 break;
-            }
-#else
-            diff = obs[i] - m[i];
-            /* The compiler really likes this to be a single
-             * expression, for whatever reason. */
-            dval -= diff * diff * v[i];
-#endif
+            /* Codeword c underflowed or is worse than worst */
+            if ((uf & (1 << l)) || (dval < worst->dist))
+                continue;
+
+            /* Codeword c at least as good as worst so far; insert in the ordered list */
+            for (i = 0; (i < n_top) && (dval < out_dist[i].dist); i++);
+            assert(i < n_top);
+            for (j = n_top - 1; j > i; --j)
+                out_dist[j] = out_dist[j - 1];
+            out_dist[i].dist = dval;
+            out_dist[i].id = c;
         }
-
-        if ((i < featlen) || (dval < worst->dist))     /* Codeword d worse than worst */
-            continue;
-
-        /* Codeword d at least as good as worst so far; insert in the ordered list */
-        for (i = 0; (i < n_top) && (dval < out_dist[i].dist); i++);
-        assert(i < n_top);
-        for (j = n_top - 1; j > i; --j)
-            out_dist[j] = out_dist[j - 1];
-        out_dist[i].dist = dval;
-        out_dist[i].id = d;
     }
-
-    return 0;
 }
 
 
@@ -528,17 +1369,17 @@ compute_dist(gauden_dist_t * out_dist, int32 n_top,
  */
 int32
 gauden_dist(gauden_t * g,
-            int mgau, int32 n_top, mfcc_t** obs, gauden_dist_t ** out_dist)
+            int mgau, int32 n_top, mfcc_t** obs, int32 **qobs,
+            gauden_dist_t ** out_dist)
 {
     int32 f;
 
     assert((n_top > 0) && (n_top <= g->n_density));
 
     for (f = 0; f < g->n_feat; f++) {
-        compute_dist(out_dist[f], n_top,
-                     obs[f], g->featlen[f],
-                     g->mean[mgau][f], g->var[mgau][f], g->det[mgau][f],
-                     g->n_density);
+        compute_dist_init(g, out_dist[f], n_top);
+        compute_dist_blk(g, out_dist[f], n_top, mgau, f, obs[f],
+                         g->quant ? qobs[f] : NULL, 0, g->n_block);
         E_DEBUG(3, ("Top CW(%d,%d) = %d %d\n", mgau, f, out_dist[f][0].id,
                     (int)out_dist[f][0].dist >> SENSCR_SHIFT));
     }
@@ -546,6 +1387,73 @@ gauden_dist(gauden_t * g,
     return 0;
 }
 
+int32
+gauden_dist_batch(gauden_t * g, int mgau, int32 n_top,
+                  mfcc_t ***obs, int32 ***qobs, int32 n_frame,
+                  gauden_dist_t *** out_dist)
+{
+    int32 f, j, b, n_tile;
+
+    assert((n_top > 0) && (n_top <= g->n_density));
+
+    for (f = 0; f < g->n_feat; f++) {
+        /* Blocks of this stream that fit in GAUDEN_TILE_BYTES, means
+         * and variances together. */
+        n_tile = GAUDEN_TILE_BYTES
+            / (g->featlen[f] * g->n_lane * 2 * sizeof(mfcc_t));
+        if (n_tile < 1)
+            n_tile = 1;
+        for (j = 0; j < n_frame; ++j)
+            compute_dist_init(g, out_dist[j][f], n_top);
+        /* Each frame sees the blocks in the same order, with the same
+         * thresholds, as in gauden_dist(). */
+        for (b = 0; b < g->n_block; b += n_tile) {
+            int32 end = b + n_tile < g->n_block ? b + n_tile : g->n_block;
+            for (j = 0; j < n_frame; ++j)
+                compute_dist_blk(g, out_dist[j][f], n_top, mgau, f,
+                                 obs[j][f], g->quant ? qobs[j][f] : NULL,
+                                 b, end);
+        }
+    }
+
+    return 0;
+}
+
+void
+gauden_quant_obs(gauden_t * g, mfcc_t **obs, int32 **out_qobs)
+{
+    int32 f, j, k;
+
+    for (f = 0; f < g->n_feat; ++f) {
+        for (j = 0; j < g->featlen[f]; j += 2) {
+            int32 q[2] = { 0, 0 };
+
+            for (k = 0; k < 2 && j + k < g->featlen[f]; ++k) {
+                float32 x = (MFCC2FLOAT(obs[f][j + k]) - g->q_offset[f][j + k])
+                    * g->q_mul[f][j + k];
+                if (x > g->q_max[f])
+                    x = (float32)g->q_max[f];
+                if (x < -g->q_max[f])
+                    x = (float32)-g->q_max[f];
+                q[k] = (int32)floor(x + 0.5f);
+            }
+            out_qobs[f][j / 2] = (q[0] & 0xffff) | ((uint32)q[1] << 16);
+        }
+    }
+}
+
+void
+gauden_set_quant(gauden_t *g, int32 quant)
+{
+    if (g->mean == NULL) {
+        E_ERROR("Codebooks are only loaded in blocks, cannot quantize them\n");
+        return;
+    }
+    gauden_blk_free(g);
+    g->quant = quant;
+    gauden_blk_init(g);
+}
+
 int32
 gauden_mllr_transform(gauden_t *g, ps_mllr_t *mllr, cmd_ln_t *config)
 {
@@ -553,17 +1461,10 @@ gauden_mllr_transform(gauden_t *g, ps_mllr_t *mllr, cmd_ln_t *config)
     float32 ****fgau;
 
     /* Free data if already here */
-    if (g->mean)
-        gauden_param_free(g->mean);
-    if (g->var)
-        gauden_param_free(g->var);
-    if (g->det)
-        ckd_free_3d(g->det);
+    gauden_blk_free(g);
+    gauden_param_free_all(g);
     if (g->featlen)
         ckd_free(g->featlen);
-    g->mean = NULL;
-    g->var = NULL;
-    g->det = NULL;
     g->featlen = NULL;
 
     /* Reload means and variances (un-precomputed). */
@@ -613,5 +1514,6 @@ gauden_mllr_transform(gauden_t *g, ps_mllr_t *mllr, cmd_ln_t *config)
     /* Re-precompute (if we aren't adapting variances this isn't
      * actually necessary...) */
     gauden_dist_precompute(g, g->lmath, cmd_ln_float32_r(config, "-varfloor"));
+    gauden_blk_init(g);
     return 0;
 }
@@ -75,6 +75,36 @@ typedef struct {
 
 } gauden_dist_t;
 
+/**
+ * Find the next block of gauden_t::n_lane densities of one codebook
+ * and feature stream that is not knocked out by a feature vector
+ * (see gauden_t::blk_mean for the layout).
+ *
+ * A block is knocked out if every density in it falls below thresh.
+ * For the block found, out_d holds the score of each density, and
+ * out_uf a bitmask of the densities that underflowed (fixed-point
+ * only), whose score is WORST_SCORE.
+ *
+ * @return the index of the first block from b onwards that is not
+ * knocked out, or n_block if there is none.
+ */
+typedef int32 (*gauden_eval_blk_f)(mfcc_t const *mean, mfcc_t const *var,
+                                   mfcc_t const *det, mfcc_t const *obs,
+                                   int32 featlen, mfcc_t thresh,
+                                   int32 b, int32 n_block,
+                                   mfcc_t *out_d, int32 *out_uf);
+
+/**
+ * Like gauden_eval_blk_f, for densities quantized to 16 bits (see
+ * gauden_t::q_mean for the layout).  obs holds the quantized feature
+ * vector, two dimensions to each element, and scale is
+ * gauden_t::q_scale for the feature stream.  Nothing underflows.
+ */
+typedef int32 (*gauden_eval_q_f)(int16 const *mean, int16 const *var,
+                                 float32 const *det, int32 const *obs,
+                                 int32 n_pair, float32 scale, mfcc_t thresh,
+                                 int32 b, int32 n_block, mfcc_t *out_d);
+
 /**
  * \struct gauden_t
  * \brief Multivariate gaussian mixture density parameters
@@ -89,8 +119,47 @@ typedef struct {
     int32 n_feat;	/**< Number feature streams in each codebook */
     int32 n_density;	/**< Number gaussian densities in each codebook-feature stream */
     int32 *featlen;	/**< feature length for each feature */
+
+    int32 n_lane;       /**< Densities per block for the vector kernels */
+    int32 n_block;      /**< Blocks per codebook-feature stream */
+    mfcc_t ***blk_mean; /**< Means by codebook and feature, in n_block
+                           dimension-major blocks: dimension j of
+                           codeword b * n_lane + l is at
+                           blk_mean[m][f][(b * featlen + j) * n_lane + l].
+                           Each codebook is contiguous. */
+    mfcc_t ***blk_var;  /**< Precomputed variances, laid out like blk_mean */
+    mfcc_t ***blk_det;  /**< Determinants, padded to n_block * n_lane */
+    gauden_eval_blk_f eval_blk; /**< Density evaluation kernel */
+
+    int32 quant;        /**< Evaluate densities in 16-bit integers?  If
+                           so, the q_ fields are used instead of the
+                           blk_ ones. */
+    int16 ***q_mean;    /**< Quantized means by codebook and feature, in
+                           n_block blocks of dimension pairs: dimensions
+                           2p and 2p + 1 of codeword b * n_lane + l are
+                           at q_mean[m][f][((b * n_pair + p) * n_lane
+                           + l) * 2], where n_pair = (featlen + 1) / 2.
+                           Each codebook is contiguous. */
+    int16 ***q_var;     /**< Quantized precisions, laid out like q_mean */
+    float32 ***q_det;   /**< Determinants, padded to n_block * n_lane */
+    float32 **q_offset; /**< Offset of each dimension of each stream */
+    float32 **q_mul;    /**< Multiplier of each dimension of each stream */
+    int32 *q_max;       /**< Largest quantized value in each stream */
+    float32 *q_scale;   /**< Log units of one unit of quantized distance
+                           in each stream */
+    gauden_eval_q_f eval_q; /**< Quantized density evaluation kernel */
+
+    int32 mapped;       /**< Do mean, var and det point into a compiled
+                           model (see gauden_init_arrays())? */
+    int32 blk_mapped;   /**< Do the blk_ or q_ fields? */
 } gauden_t;
 
+/** Number of values in the first array from gauden_get_arrays(). */
+#define GAUDEN_N_DIMS 5
+
+/** Largest number of arrays from gauden_get_arrays(). */
+#define GAUDEN_MAX_ARRAYS 9
+
 
 /**
  * Read mixture gaussian codebooks from the given files.  Allocate memory space needed
@@ -105,12 +174,50 @@ gauden_init (char const *meanfile,/**< Input: File containing means of mixture g
              logmath_t *lmath
     );
 
+/**
+ * Create a set of codebooks from the arrays of another one, as
+ * returned by gauden_get_arrays() (typically read back from a
+ * compiled model file).  The arrays are used in place, so they must
+ * not change or go away before the codebooks are freed.
+ * Only the blocked (or quantized) codebooks are there, so mean, var
+ * and det are NULL, unless they are the same thing (one lane).
+ * @return NULL if the arrays are inconsistent or were laid out for a
+ * different density evaluation kernel than this machine's.
+ */
+gauden_t *gauden_init_arrays(void const **ptr, size_t const *size,
+                             int32 n_array, logmath_t *lmath);
+
+/**
+ * Get the blocked (or quantized) arrays of a set of codebooks, ready
+ * to be scored, for gauden_init_arrays().  The first array is dims, which
+ * must have room for GAUDEN_N_DIMS values.
+ * @return the number of arrays (no more than GAUDEN_MAX_ARRAYS).
+ */
+int32 gauden_get_arrays(gauden_t *g, int32 *dims,
+                        void const **out_ptr, size_t *out_size);
+
 /** Release memory allocated by gauden_init. */
 void gauden_free(gauden_t *g); /**< In: The gauden_t to free */
 
+/**
+ * Evaluate densities with 16-bit integer arithmetic, or not.
+ *
+ * Means, precisions and features are quantized to 16 bits, which
+ * makes the scores slightly less accurate.
+ */
+void gauden_set_quant(gauden_t *g, int32 quant);
+
 /** Transform Gaussians according to an MLLR matrix (or, eventually, more). */
 int32 gauden_mllr_transform(gauden_t *s, ps_mllr_t *mllr, cmd_ln_t *config);
 
+/**
+ * Quantize an observation vector for gauden_dist(), which has to be
+ * done once for each observation if densities are evaluated in
+ * integers (see gauden_set_quant()).  out_qobs[f] has (featlen[f] +
+ * 1) / 2 elements.
+ */
+void gauden_quant_obs(gauden_t *g, mfcc_t **obs, int32 **out_qobs);
+
 /**
  * Compute gaussian density values for the given input observation vector wrt the
  * specified mixture gaussian codebook (which may consist of several feature streams).
@@ -123,6 +230,8 @@ gauden_dist (gauden_t *g,	/**< In: handle to entire ensemble of codebooks */
 				   (g->{mean,var}[mgau]) */
 	     int n_top,		/**< In: Number top densities to be evaluated */
 	     mfcc_t **obs,	/**< In: Observation vector; obs[f] = for feature f */
+	     int32 **qobs,	/**< In: obs quantized by gauden_quant_obs(), if
+				   densities are evaluated in integers */
 	     gauden_dist_t **out_dist
 	     /**< Out: n_top best codewords and density values,
 		in worsening order, for each feature stream.
@@ -130,6 +239,16 @@ gauden_dist (gauden_t *g,	/**< In: handle to entire ensemble of codebooks */
 		Caller must allocate memory for this output */
     );
 
+/**
+ * Like gauden_dist(), for n_frame observation vectors at once, obs[j]
+ * (and qobs[j]) being the one for frame j, and out_dist[j] its output.
+ * Each tile of the codebook is scored for all of them while it is in
+ * cache.  The results are exactly those of gauden_dist().
+ */
+int32 gauden_dist_batch(gauden_t *g, int mgau, int n_top,
+                        mfcc_t ***obs, int32 ***qobs, int32 n_frame,
+                        gauden_dist_t ***out_dist);
+
 /**
    Dump the definitionn of Gaussian distribution. 
 */
@@ -68,6 +68,14 @@
  *
  */
 
+/* System headers. */
+#include <stdio.h>
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/pio.h>
+#include <sphinxbase/strfuncs.h>
+
 /* Local headers. */
 #include "ms_mgau.h"
 
@@ -75,9 +83,310 @@ static ps_mgaufuncs_t ms_mgau_funcs = {
     "ms",
     ms_cont_mgau_frame_eval, /* frame_eval */
     ms_mgau_mllr_transform,  /* transform */
-    ms_mgau_free             /* free */
+    ms_mgau_free,            /* free */
+    ms_cont_mgau_frame_eval_batch /* frame_eval_batch */
 };
 
+/*
+ * Compiled model file (-amcache).  It holds the arrays of
+ * gauden_get_arrays() and senone_get_arrays(), precomputed and laid
+ * out for this machine's density evaluation kernel, so that they can
+ * be memory-mapped and scored in place.  The file is the header
+ * below, the key (a string naming the model files and the parameters
+ * it was compiled with), the offset and size of each array, and the
+ * arrays, each aligned to MS_MGAU_CACHE_ALIGN bytes.  The checksum
+ * covers everything after the header.
+ */
+#define MS_MGAU_CACHE_MAGIC "PSAMC01"
+#define MS_MGAU_CACHE_BYTEORDER 0x11223344
+#define MS_MGAU_CACHE_ALIGN 64
+#define MS_MGAU_CACHE_MAX_ARRAYS (GAUDEN_MAX_ARRAYS + SENONE_N_ARRAYS)
+#define MS_MGAU_CACHE_PAD(n, a) (((n) + (a) - 1) / (a) * (a))
+
+typedef struct ms_mgau_cache_hdr_s {
+    char magic[8];
+    uint32 byteorder;
+    uint32 size;        /**< Size of the whole file */
+    uint32 chksum;      /**< Checksum of everything after the header */
+    uint32 key_len;     /**< Size of the key, padded */
+    uint32 n_gauden;    /**< Number of arrays from gauden_get_arrays() */
+    uint32 n_senone;    /**< Number of arrays from senone_get_arrays() */
+} ms_mgau_cache_hdr_t;
+
+static uint32
+ms_mgau_cache_chksum(void const *buf, size_t size)
+{
+    uint32 const *w = buf;
+    uint32 sum = 0;
+    size_t i;
+
+    /* Same as the checksums of the model files. */
+    for (i = 0; i < size / 4; ++i)
+        sum = (sum << 20 | sum >> 12) + w[i];
+    return sum;
+}
+
+/*
+ * Describe what a compiled model is compiled from: the model files,
+ * by size and modification time, and the parameters that go into the
+ * precomputed arrays.
+ */
+static char *
+ms_mgau_cache_key(cmd_ln_t *config, logmath_t *lmath)
+{
+    static char const *files[] = {
+        "-mdef", "-mean", "-var", "-mixw", "-senmgau"
+    };
+    char buf[256], *key, *tmp;
+    int i;
+
+    sprintf(buf, "mfcc=%d/%d;logbase=%.9g;varfloor=%.9g;mixwfloor=%.9g;"
+            "quantgau=%d", (int)sizeof(mfcc_t),
+#ifdef FIXED_POINT
+            DEFAULT_RADIX,
+#else
+            0,
+#endif
+            logmath_get_base(lmath),
+            cmd_ln_float32_r(config, "-varfloor"),
+            cmd_ln_float32_r(config, "-mixwfloor"),
+            cmd_ln_boolean_r(config, "-quantgau"));
+    key = ckd_salloc(buf);
+    for (i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        char const *file = cmd_ln_str_r(config, files[i]);
+        struct stat st;
+
+        if (file == NULL)
+            continue;
+        if (stat(file, &st) < 0)
+            st.st_size = st.st_mtime = 0;
+        sprintf(buf, ";%s=%ld:%ld:", files[i],
+                (long)st.st_size, (long)st.st_mtime);
+        tmp = string_join(key, buf, file, NULL);
+        ckd_free(key);
+        key = tmp;
+    }
+    return key;
+}
+
+/*
+ * Check the header and key of a compiled model, without reading the
+ * arrays.
+ */
+static int
+ms_mgau_cache_check(char const *file, char const *key,
+                    ms_mgau_cache_hdr_t *out_hdr)
+{
+    ms_mgau_cache_hdr_t hdr;
+    FILE *fp;
+    char *file_key;
+    int rv;
+
+    if ((fp = fopen(file, "rb")) == NULL)
+        return -1;
+    rv = -1;
+    file_key = NULL;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1
+        || memcmp(hdr.magic, MS_MGAU_CACHE_MAGIC, sizeof(hdr.magic)) != 0
+        || hdr.byteorder != MS_MGAU_CACHE_BYTEORDER) {
+        E_INFO("%s is not a compiled model for this machine\n", file);
+        goto out;
+    }
+    if (fseek(fp, 0, SEEK_END) < 0 || ftell(fp) != (long)hdr.size
+        || hdr.key_len != MS_MGAU_CACHE_PAD(strlen(key) + 1, 8)
+        || hdr.key_len > hdr.size
+        || hdr.n_gauden + hdr.n_senone > MS_MGAU_CACHE_MAX_ARRAYS) {
+        E_INFO("Compiled model %s is out of date\n", file);
+        goto out;
+    }
+    file_key = ckd_calloc(1, hdr.key_len);
+    if (fseek(fp, sizeof(hdr), SEEK_SET) < 0
+        || fread(file_key, 1, hdr.key_len, fp) != hdr.key_len
+        || strcmp(file_key, key) != 0) {
+        E_INFO("Compiled model %s is out of date\n", file);
+        goto out;
+    }
+    *out_hdr = hdr;
+    rv = 0;
+out:
+    ckd_free(file_key);
+    fclose(fp);
+    return rv;
+}
+
+int
+ms_mgau_cache_valid(cmd_ln_t *config, logmath_t *lmath)
+{
+    ms_mgau_cache_hdr_t hdr;
+    char const *file;
+    char *key;
+    int rv;
+
+    if ((file = cmd_ln_str_r(config, "-amcache")) == NULL)
+        return FALSE;
+    key = ms_mgau_cache_key(config, lmath);
+    rv = (ms_mgau_cache_check(file, key, &hdr) == 0);
+    ckd_free(key);
+    return rv;
+}
+
+/*
+ * Map the compiled model in file if it matches key, and create the
+ * codebooks and senones from it.
+ */
+static int
+ms_mgau_cache_read(ms_mgau_model_t *msg, char const *file, char const *key,
+                   logmath_t *lmath)
+{
+    ms_mgau_cache_hdr_t hdr;
+    void const *ptr[MS_MGAU_CACHE_MAX_ARRAYS];
+    size_t size[MS_MGAU_CACHE_MAX_ARRAYS];
+    uint32 const *tab;
+    char const *base;
+    uint32 i, n, off;
+
+    if (ms_mgau_cache_check(file, key, &hdr) < 0)
+        return -1;
+    if (cmd_ln_boolean_r(msg->config, "-mmap")) {
+        if ((msg->cache_mmap = mmio_file_read(file)) == NULL)
+            return -1;
+        base = mmio_file_ptr(msg->cache_mmap);
+    }
+    else {
+        FILE *fp;
+
+        msg->cache_buf = ckd_malloc(hdr.size);
+        if ((fp = fopen(file, "rb")) == NULL)
+            goto error_out;
+        i = fread(msg->cache_buf, 1, hdr.size, fp);
+        fclose(fp);
+        if (i != hdr.size)
+            goto error_out;
+        base = msg->cache_buf;
+    }
+
+    if (memcmp(base, &hdr, sizeof(hdr)) != 0
+        || ms_mgau_cache_chksum(base + sizeof(hdr), hdr.size - sizeof(hdr))
+        != hdr.chksum) {
+        E_ERROR("Checksum error in compiled model %s\n", file);
+        goto error_out;
+    }
+    n = hdr.n_gauden + hdr.n_senone;
+    off = sizeof(hdr) + hdr.key_len;
+    if (off + n * 2 * sizeof(uint32) > hdr.size)
+        goto error_out;
+    tab = (uint32 const *)(base + off);
+    for (i = 0; i < n; ++i) {
+        if (tab[i * 2] % MS_MGAU_CACHE_ALIGN != 0
+            || tab[i * 2] > hdr.size
+            || tab[i * 2 + 1] > hdr.size - tab[i * 2])
+            goto error_out;
+        ptr[i] = base + tab[i * 2];
+        size[i] = tab[i * 2 + 1];
+    }
+
+    msg->g = gauden_init_arrays(ptr, size, hdr.n_gauden, lmath);
+    msg->s = senone_init_arrays(ptr + hdr.n_gauden, size + hdr.n_gauden,
+                                hdr.n_senone,
+                                cmd_ln_float32_r(msg->config, "-mixwfloor"),
+                                lmath);
+    if (msg->g == NULL || msg->s == NULL)
+        goto error_out;
+    E_INFO("Mapped compiled model %s\n", file);
+    return 0;
+
+error_out:
+    E_INFO("Cannot use compiled model %s, loading the model files\n", file);
+    gauden_free(msg->g);
+    senone_free(msg->s);
+    msg->g = NULL;
+    msg->s = NULL;
+    if (msg->cache_mmap)
+        mmio_file_unmap(msg->cache_mmap);
+    ckd_free(msg->cache_buf);
+    msg->cache_mmap = NULL;
+    msg->cache_buf = NULL;
+    return -1;
+}
+
+/*
+ * Write the codebooks and senones to a compiled model in file.  It is
+ * written to a temporary file first, so a half-written one is never
+ * mapped.
+ */
+static int
+ms_mgau_cache_write(ms_mgau_model_t *msg, char const *file, char const *key)
+{
+    ms_mgau_cache_hdr_t hdr;
+    int32 gdims[GAUDEN_N_DIMS];
+    uint32 sdims[SENONE_N_DIMS];
+    void const *ptr[MS_MGAU_CACHE_MAX_ARRAYS];
+    size_t size[MS_MGAU_CACHE_MAX_ARRAYS], total;
+    uint32 *tab;
+    char *buf, *tmpfile;
+    FILE *fp;
+    int32 i, n;
+    int rv;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MS_MGAU_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.byteorder = MS_MGAU_CACHE_BYTEORDER;
+    hdr.key_len = MS_MGAU_CACHE_PAD(strlen(key) + 1, 8);
+    hdr.n_gauden = gauden_get_arrays(msg->g, gdims, ptr, size);
+    hdr.n_senone = senone_get_arrays(msg->s, sdims, ptr + hdr.n_gauden,
+                                     size + hdr.n_gauden);
+    n = hdr.n_gauden + hdr.n_senone;
+
+    total = MS_MGAU_CACHE_PAD(sizeof(hdr) + hdr.key_len
+                              + n * 2 * sizeof(uint32), MS_MGAU_CACHE_ALIGN);
+    for (i = 0; i < n; ++i)
+        total += MS_MGAU_CACHE_PAD(size[i], MS_MGAU_CACHE_ALIGN);
+    if (total > 0x7fffffff) {
+        E_WARN("Model is too large to compile\n");
+        return -1;
+    }
+    hdr.size = total;
+
+    buf = ckd_calloc(1, total);
+    strcpy(buf + sizeof(hdr), key);
+    tab = (uint32 *)(buf + sizeof(hdr) + hdr.key_len);
+    total = MS_MGAU_CACHE_PAD(sizeof(hdr) + hdr.key_len
+                              + n * 2 * sizeof(uint32), MS_MGAU_CACHE_ALIGN);
+    for (i = 0; i < n; ++i) {
+        tab[i * 2] = total;
+        tab[i * 2 + 1] = size[i];
+        memcpy(buf + total, ptr[i], size[i]);
+        total += MS_MGAU_CACHE_PAD(size[i], MS_MGAU_CACHE_ALIGN);
+    }
+    hdr.chksum = ms_mgau_cache_chksum(buf + sizeof(hdr),
+                                      total - sizeof(hdr));
+    memcpy(buf, &hdr, sizeof(hdr));
+
+    rv = -1;
+    tmpfile = string_join(file, ".tmp", NULL);
+    if ((fp = fopen(tmpfile, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s for writing", tmpfile);
+        goto out;
+    }
+    if (fwrite(buf, 1, total, fp) != total) {
+        E_ERROR_SYSTEM("Failed to write %s", tmpfile);
+        fclose(fp);
+        remove(tmpfile);
+        goto out;
+    }
+    if (fclose(fp) != 0 || rename(tmpfile, file) != 0) {
+        E_ERROR_SYSTEM("Failed to write %s", file);
+        remove(tmpfile);
+        goto out;
+    }
+    E_INFO("Wrote compiled model %s\n", file);
+    rv = 0;
+out:
+    ckd_free(tmpfile);
+    ckd_free(buf);
+    return rv;
+}
+
 ps_mgau_t *
 ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
 {
@@ -87,7 +396,10 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
     gauden_t *g;
     senone_t *s;
     cmd_ln_t *config;
+    char const *cache;
+    char *key;
     int i;
+    int32 n_pair;
 
     config = acmod->config;
 
@@ -95,11 +407,23 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
     msg->config = config;
     msg->g = NULL;
     msg->s = NULL;
-    
-    g = msg->g = gauden_init(cmd_ln_str_r(config, "-mean"),
+
+    key = NULL;
+    if ((cache = cmd_ln_str_r(config, "-amcache")) != NULL) {
+        key = ms_mgau_cache_key(config, lmath);
+        ms_mgau_cache_read(msg, cache, key, lmath);
+    }
+    if (msg->g == NULL) {
+        msg->g = gauden_init(cmd_ln_str_r(config, "-mean"),
                              cmd_ln_str_r(config, "-var"),
                              cmd_ln_float32_r(config, "-varfloor"),
                              lmath);
+        if (cmd_ln_boolean_r(config, "-quantgau"))
+            gauden_set_quant(msg->g, TRUE);
+    }
+    g = msg->g;
+    if (g->quant)
+        E_INFO("Computing Gaussian densities in 16-bit integers\n");
 
     /* Verify n_feat and veclen, against acmod. */
     if (g->n_feat != feat_dimension1(acmod->fcb)) {
@@ -115,11 +439,13 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
         }
     }
 
-    s = msg->s = senone_init(msg->g,
+    if (msg->s == NULL)
+        msg->s = senone_init(msg->g,
                              cmd_ln_str_r(config, "-mixw"),
                              cmd_ln_str_r(config, "-senmgau"),
                              cmd_ln_float32_r(config, "-mixwfloor"),
                              lmath, mdef);
+    s = msg->s;
 
     s->aw = cmd_ln_int32_r(config, "-aw");
 
@@ -137,6 +463,11 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
         E_ERROR("Senones use fewer codebooks (%d) than present (%d)\n",
                 s->n_gauden, g->n_mgau);
 
+    if (cache && msg->cache_mmap == NULL && msg->cache_buf == NULL)
+        ms_mgau_cache_write(msg, cache, key);
+    ckd_free(key);
+    key = NULL;
+
     msg->topn = cmd_ln_int32_r(config, "-topn");
     E_INFO("The value of topn: %d\n", msg->topn);
     if (msg->topn == 0 || msg->topn > msg->g->n_density) {
@@ -150,11 +481,65 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
         ckd_calloc_3d(g->n_mgau, g->n_feat, msg->topn,
                       sizeof(gauden_dist_t));
     msg->mgau_active = ckd_calloc(g->n_mgau, sizeof(int8));
+    n_pair = 0;
+    if (g->quant) {
+        for (i = 0; i < g->n_feat; ++i)
+            if ((g->featlen[i] + 1) / 2 > n_pair)
+                n_pair = (g->featlen[i] + 1) / 2;
+        msg->qobs = (int32 **)ckd_calloc_2d(g->n_feat, n_pair,
+                                            sizeof(**msg->qobs));
+    }
+    msg->gid_active = ckd_calloc(g->n_mgau, sizeof(*msg->gid_active));
+    msg->sen_active = ckd_calloc(s->n_sen, sizeof(*msg->sen_active));
+
+    msg->n_batch = cmd_ln_int32_r(config, "-gmm_batch");
+    if (msg->n_batch > PS_MGAU_MAX_BATCH)
+        msg->n_batch = PS_MGAU_MAX_BATCH;
+    if (msg->n_batch > 1) {
+        msg->batch_dist = ckd_calloc(msg->n_batch, sizeof(*msg->batch_dist));
+        if (msg->qobs)
+            msg->batch_qobs = ckd_calloc(msg->n_batch,
+                                         sizeof(*msg->batch_qobs));
+        for (i = 0; i < msg->n_batch; ++i) {
+            msg->batch_dist[i] = (gauden_dist_t ***)
+                ckd_calloc_3d(g->n_mgau, g->n_feat, msg->topn,
+                              sizeof(gauden_dist_t));
+            if (msg->qobs)
+                msg->batch_qobs[i] = (int32 **)
+                    ckd_calloc_2d(g->n_feat, n_pair, sizeof(int32));
+        }
+    }
+
+    i = cmd_ln_int32_r(config, "-nthreads");
+    if (i > 1) {
+        E_INFO("Computing senone scores on %d threads\n", i);
+        if ((msg->pool = sbpool_init(config, i)) == NULL)
+            goto error_out;
+    }
+    msg->part_best = ckd_calloc(msg->pool ? sbpool_size(msg->pool) : 1,
+                                sizeof(*msg->part_best));
+
+    if (cmd_ln_float64_r(config, "-ci_pbeam") > 0.0) {
+        if (mdef->n_ci_sen <= 0 || mdef->n_ci_sen >= s->n_sen
+            || mdef->n_sen != s->n_sen) {
+            E_WARN("No context-independent senones, -ci_pbeam ignored\n");
+        }
+        else {
+            msg->mdef = bin_mdef_retain(mdef);
+            msg->ci_beam = -logmath_log(lmath,
+                                        cmd_ln_float64_r(config, "-ci_pbeam"))
+                >> SENSCR_SHIFT;
+            msg->sen_sel = ckd_calloc(s->n_sen, sizeof(*msg->sen_sel));
+            E_INFO("Selecting CD senones within %d of the best CI senone\n",
+                   msg->ci_beam);
+        }
+    }
 
     mg = (ps_mgau_t *)msg;
     mg->vt = &ms_mgau_funcs;
     return mg;
 error_out:
+    ckd_free(key);
     ms_mgau_free(ps_mgau_base(msg));
     return NULL;    
 }
@@ -174,6 +559,34 @@ ms_mgau_free(ps_mgau_t * mg)
         ckd_free_3d((void *) msg->dist);
     if (msg->mgau_active)
         ckd_free(msg->mgau_active);
+    if (msg->qobs)
+        ckd_free_2d(msg->qobs);
+    if (msg->batch_dist) {
+        int i;
+        for (i = 0; i < msg->n_batch; ++i) {
+            ckd_free_3d(msg->batch_dist[i]);
+            if (msg->batch_qobs)
+                ckd_free_2d(msg->batch_qobs[i]);
+        }
+        ckd_free(msg->batch_dist);
+        ckd_free(msg->batch_qobs);
+    }
+    ckd_free(msg->gid_active);
+    ckd_free(msg->sen_active);
+    ckd_free(msg->part_best);
+    ckd_free(msg->sen_sel);
+    if (msg->mdef) {
+        if (msg->n_cd_eval + msg->n_cd_backoff > 0)
+            E_INFO("Computed %.1f%% of CD senones, backed off the rest to CI\n",
+                   100.0 * msg->n_cd_eval
+                   / (msg->n_cd_eval + msg->n_cd_backoff));
+        bin_mdef_free(msg->mdef);
+    }
+    sbpool_free(msg->pool);
+    /* After g and s, which may point into it. */
+    if (msg->cache_mmap)
+        mmio_file_unmap(msg->cache_mmap);
+    ckd_free(msg->cache_buf);
     
     ckd_free(msg);
 }
@@ -186,6 +599,187 @@ ms_mgau_mllr_transform(ps_mgau_t *s,
     return gauden_mllr_transform(msg->g, mllr, msg->config);
 }
 
+/**
+ * Work shared out to the threads computing a frame's senone scores.
+ */
+typedef struct ms_mgau_job_s {
+    ms_mgau_model_t *msg;
+    mfcc_t **feat;
+    int16 *senscr;
+    int32 const *gid; /**< Codebooks to evaluate, or NULL for all */
+    int32 n_gid;      /**< Number of codebooks to evaluate */
+    int32 const *sen; /**< Senones to evaluate, or NULL for all */
+    int32 n_sen;      /**< Number of senones to evaluate */
+    mfcc_t ***bfeat;  /**< Features of each frame of a batch */
+    int16 **bsenscr;  /**< Senone scores of each frame of a batch */
+    int32 n_frame;    /**< Number of frames in the batch */
+} ms_mgau_job_t;
+
+static void
+ms_mgau_eval_gauden(void *arg, int i, int n)
+{
+    ms_mgau_job_t *job = arg;
+    ms_mgau_model_t *msg = job->msg;
+    int32 k, end;
+
+    end = sbpool_part_start(job->n_gid, i + 1, n);
+    for (k = sbpool_part_start(job->n_gid, i, n); k < end; ++k) {
+        int32 gid = job->gid ? job->gid[k] : k;
+        gauden_dist(msg->g, gid, msg->topn, job->feat, msg->qobs,
+                    msg->dist[gid]);
+    }
+}
+
+static void
+ms_mgau_eval_senone(void *arg, int i, int n)
+{
+    ms_mgau_job_t *job = arg;
+    ms_mgau_model_t *msg = job->msg;
+    senone_t *sen = msg->s;
+    int32 k, end, best;
+
+    best = (int32) 0x7fffffff;
+    end = sbpool_part_start(job->n_sen, i + 1, n);
+    for (k = sbpool_part_start(job->n_sen, i, n); k < end; ++k) {
+        int32 s = job->sen ? job->sen[k] : k;
+        job->senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]],
+                                     msg->topn);
+        if (best > job->senscr[s])
+            best = job->senscr[s];
+    }
+    msg->part_best[i] = best;
+}
+
+static void
+ms_mgau_eval_gauden_batch(void *arg, int i, int n)
+{
+    ms_mgau_job_t *job = arg;
+    ms_mgau_model_t *msg = job->msg;
+    gauden_dist_t **out[PS_MGAU_MAX_BATCH];
+    int32 gid, j, end;
+
+    end = sbpool_part_start(msg->g->n_mgau, i + 1, n);
+    for (gid = sbpool_part_start(msg->g->n_mgau, i, n); gid < end; ++gid) {
+        for (j = 0; j < job->n_frame; ++j)
+            out[j] = msg->batch_dist[j][gid];
+        gauden_dist_batch(msg->g, gid, msg->topn, job->bfeat,
+                          msg->batch_qobs, job->n_frame, out);
+    }
+}
+
+static void
+ms_mgau_eval_senone_batch(void *arg, int i, int n)
+{
+    ms_mgau_job_t *job = arg;
+    ms_mgau_model_t *msg = job->msg;
+    senone_t *sen = msg->s;
+    int32 s, j, end;
+
+    /* Each senone's mixture weights are used for all the frames. */
+    end = sbpool_part_start(sen->n_sen, i + 1, n);
+    for (s = sbpool_part_start(sen->n_sen, i, n); s < end; ++s) {
+        for (j = 0; j < job->n_frame; ++j)
+            job->bsenscr[j][s] =
+                senone_eval(sen, s, msg->batch_dist[j][sen->mgau[s]],
+                            msg->topn);
+    }
+}
+
+/*
+ * Compute the codebooks and then the senones of job, and return the
+ * best senone score.  Each part of them is computed exactly as it
+ * would be on one thread, and the best score is the minimum over the
+ * parts, so the results do not depend on the number of threads.
+ */
+static int32
+ms_mgau_run(ms_mgau_model_t *msg, ms_mgau_job_t *job)
+{
+    int32 i, n_part, best;
+
+    n_part = msg->pool ? sbpool_size(msg->pool) : 1;
+    if (msg->pool) {
+        sbpool_run(msg->pool, ms_mgau_eval_gauden, job);
+        sbpool_run(msg->pool, ms_mgau_eval_senone, job);
+    }
+    else {
+        ms_mgau_eval_gauden(job, 0, 1);
+        ms_mgau_eval_senone(job, 0, 1);
+    }
+    best = msg->part_best[0];
+    for (i = 1; i < n_part; i++) {
+        if (best > msg->part_best[i])
+            best = msg->part_best[i];
+    }
+    return best;
+}
+
+/*
+ * Compute the CI senones, then only those of the other (CD) senones
+ * whose CI senone is within ci_beam of the best one, and give the
+ * rest the score of their CI senone.  sen lists the senones to score
+ * (or NULL for all), which are n_sen CI and CD senones in order.
+ */
+static int32
+ms_mgau_run_ci_select(ms_mgau_model_t *msg, ms_mgau_job_t *job,
+                      int32 const *sen, int32 n_sen)
+{
+    senone_t *s = msg->s;
+    int16 const *cd2cisen = msg->mdef->cd2cisen;
+    int32 n_ci_sen = msg->mdef->n_ci_sen;
+    int32 i, n, n_cd, best, th;
+
+    /* All the CI senones, and their codebooks. */
+    memset(msg->mgau_active, 0, msg->g->n_mgau);
+    job->n_gid = 0;
+    for (i = 0; i < n_ci_sen; ++i) {
+        msg->sen_sel[i] = i;
+        if (!msg->mgau_active[s->mgau[i]]) {
+            msg->mgau_active[s->mgau[i]] = 1;
+            msg->gid_active[job->n_gid++] = s->mgau[i];
+        }
+    }
+    job->gid = msg->gid_active;
+    job->sen = msg->sen_sel;
+    job->n_sen = n_ci_sen;
+    best = ms_mgau_run(msg, job);
+
+    /* The CD senones near enough to the best CI senone. */
+    th = best + msg->ci_beam;
+    job->n_gid = 0;
+    n = n_cd = 0;
+    for (i = 0; i < n_sen; ++i) {
+        int32 k = sen ? sen[i] : i;
+
+        if (k < n_ci_sen)
+            continue;
+        ++n_cd;
+        if (job->senscr[cd2cisen[k]] > th) {
+            job->senscr[k] = job->senscr[cd2cisen[k]];
+            continue;
+        }
+        msg->sen_sel[n++] = k;
+        if (!msg->mgau_active[s->mgau[k]]) {
+            msg->mgau_active[s->mgau[k]] = 1;
+            msg->gid_active[job->n_gid++] = s->mgau[k];
+        }
+    }
+    msg->n_cd_eval += n;
+    msg->n_cd_backoff += n_cd - n;
+    job->n_sen = n;
+    if (n > 0)
+        ms_mgau_run(msg, job);
+
+    /* Normalize by the best of the senones asked for, as if they
+     * had all been computed. */
+    best = (int32) 0x7fffffff;
+    for (i = 0; i < n_sen; ++i) {
+        int32 k = sen ? sen[i] : i;
+        if (best > job->senscr[k])
+            best = job->senscr[k];
+    }
+    return best;
+}
+
 int32
 ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 			int16 *senscr,
@@ -196,42 +790,28 @@ ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 			int32 compallsen)
 {
     ms_mgau_model_t *msg = (ms_mgau_model_t *)mg;
+    ms_mgau_job_t job;
     int32 gid;
-    int32 topn;
     int32 best;
+    int32 i, n_sen;
     gauden_t *g;
     senone_t *sen;
 
-    topn = ms_mgau_topn(msg);
     g = ms_mgau_gauden(msg);
     sen = ms_mgau_senone(msg);
 
+    job.msg = msg;
+    job.feat = feat;
+    job.senscr = senscr;
     if (compallsen) {
-	int32 s;
-
-	for (gid = 0; gid < g->n_mgau; gid++)
-	    gauden_dist(g, gid, topn, feat, msg->dist[gid]);
-
-	best = (int32) 0x7fffffff;
-	for (s = 0; s < sen->n_sen; s++) {
-	    senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]], topn);
-	    if (best > senscr[s]) {
-		best = senscr[s];
-	    }
-	}
-
-	/* Normalize senone scores */
-	for (s = 0; s < sen->n_sen; s++) {
-	    int32 bs = senscr[s] - best;
-	    if (bs > 32767)
-		bs = 32767;
-	    if (bs < -32768)
-		bs = -32768;
-	    senscr[s] = bs;
-	}
+        n_sen = sen->n_sen;
+        job.gid = NULL;
+        job.n_gid = g->n_mgau;
+        job.sen = NULL;
+        job.n_sen = n_sen;
     }
     else {
-	int32 i, n;
+	int32 n;
 	/* Flag all active mixture-gaussian codebooks */
 	for (gid = 0; gid < g->n_mgau; gid++)
 	    msg->mgau_active[gid] = 0;
@@ -241,38 +821,99 @@ ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 	    /* senone_active consists of deltas. */
 	    int32 s = senone_active[i] + n;
 	    msg->mgau_active[sen->mgau[s]] = 1;
+	    msg->sen_active[i] = s;
 	    n = s;
 	}
+        n_sen = n_senone_active;
+        job.sen = msg->sen_active;
+        job.n_sen = n_sen;
 
-	/* Compute topn gaussian density values (for active codebooks) */
+        job.n_gid = 0;
 	for (gid = 0; gid < g->n_mgau; gid++) {
 	    if (msg->mgau_active[gid])
-		gauden_dist(g, gid, topn, feat, msg->dist[gid]);
+                msg->gid_active[job.n_gid++] = gid;
 	}
+        job.gid = msg->gid_active;
+    }
 
-	best = (int32) 0x7fffffff;
-	n = 0;
-	for (i = 0; i < n_senone_active; i++) {
-	    int32 s = senone_active[i] + n;
-	    senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]], topn);
-	    if (best > senscr[s]) {
-		best = senscr[s];
-	    }
-	    n = s;
-	}
+    /* Compute topn gaussian density values (for active codebooks),
+     * then the senone scores, and the best one */
+    if (g->quant)
+        gauden_quant_obs(g, feat, msg->qobs);
+    if (msg->ci_beam > 0)
+        best = ms_mgau_run_ci_select(msg, &job,
+                                     compallsen ? NULL : msg->sen_active,
+                                     n_sen);
+    else
+        best = ms_mgau_run(msg, &job);
 
-	/* Normalize senone scores */
-	n = 0;
-	for (i = 0; i < n_senone_active; i++) {
-	    int32 s = senone_active[i] + n;
-	    int32 bs = senscr[s] - best;
-	    if (bs > 32767)
-		bs = 32767;
-	    if (bs < -32768)
-		bs = -32768;
-	    senscr[s] = bs;
-	    n = s;
-	}
+    /* Normalize senone scores */
+    for (i = 0; i < n_sen; i++) {
+        int32 s = compallsen ? i : msg->sen_active[i];
+        int32 bs = senscr[s] - best;
+        if (bs > 32767)
+            bs = 32767;
+        if (bs < -32768)
+            bs = -32768;
+        senscr[s] = bs;
+    }
+
+    return 0;
+}
+
+int32
+ms_cont_mgau_frame_eval_batch(ps_mgau_t * mg,
+                              int16 **senscr,
+                              mfcc_t ***feat,
+                              int32 n_frame,
+                              int32 frame)
+{
+    ms_mgau_model_t *msg = (ms_mgau_model_t *)mg;
+    ms_mgau_job_t job;
+    int32 i, j, n_sen;
+
+    /* CI-based selection depends on each frame's CI senone scores. */
+    if (n_frame > msg->n_batch || msg->ci_beam > 0) {
+        for (j = 0; j < n_frame; ++j)
+            ms_cont_mgau_frame_eval(mg, senscr[j], NULL, 0,
+                                    feat[j], frame + j, TRUE);
+        return 0;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.msg = msg;
+    job.bfeat = feat;
+    job.bsenscr = senscr;
+    job.n_frame = n_frame;
+    if (msg->g->quant)
+        for (j = 0; j < n_frame; ++j)
+            gauden_quant_obs(msg->g, feat[j], msg->batch_qobs[j]);
+    if (msg->pool) {
+        sbpool_run(msg->pool, ms_mgau_eval_gauden_batch, &job);
+        sbpool_run(msg->pool, ms_mgau_eval_senone_batch, &job);
+    }
+    else {
+        ms_mgau_eval_gauden_batch(&job, 0, 1);
+        ms_mgau_eval_senone_batch(&job, 0, 1);
+    }
+
+    /* Normalize senone scores, as ms_cont_mgau_frame_eval() does */
+    n_sen = msg->s->n_sen;
+    for (j = 0; j < n_frame; ++j) {
+        int16 *scr = senscr[j];
+        int32 best = (int32) 0x7fffffff;
+
+        for (i = 0; i < n_sen; ++i)
+            if (best > scr[i])
+                best = scr[i];
+        for (i = 0; i < n_sen; ++i) {
+            int32 bs = scr[i] - best;
+            if (bs > 32767)
+                bs = 32767;
+            if (bs < -32768)
+                bs = -32768;
+            scr[i] = bs;
+        }
     }
 
     return 0;
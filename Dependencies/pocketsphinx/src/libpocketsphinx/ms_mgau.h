@@ -100,6 +100,8 @@
 #include <sphinxbase/cmd_ln.h>
 #include <sphinxbase/logmath.h>
 #include <sphinxbase/feat.h>
+#include <sphinxbase/sbthread.h>
+#include <sphinxbase/mmio.h>
 
 /* Local headers. */
 #include "acmod.h"
@@ -120,7 +122,24 @@ typedef struct {
     /**< Intermediate used in computation */
     gauden_dist_t ***dist;  
     uint8 *mgau_active;
+    int32 **qobs;       /**< Quantized observation, if any */
+    int32 *gid_active;  /**< Active codebooks */
+    int32 *sen_active;  /**< Active senones */
+    int32 *part_best;   /**< Best senone score in each part */
+    int32 n_batch;      /**< Most frames to score at once */
+    gauden_dist_t ****batch_dist; /**< Like dist, for each of them */
+    int32 ***batch_qobs;          /**< Like qobs, for each of them */
+    int32 *sen_sel;     /**< Senones selected by their CI senone */
+    bin_mdef_t *mdef;   /**< Model definition, for CI-based selection */
+    int32 ci_beam;      /**< Beam on CI senone scores, or 0 to compute
+                           all CD senones */
+    int64 n_cd_eval;    /**< Number of CD senones computed */
+    int64 n_cd_backoff; /**< Number backed off to their CI senone */
+    sbpool_t *pool;     /**< Threads to compute scores on, or NULL */
     cmd_ln_t *config;
+
+    mmio_file_t *cache_mmap; /**< Compiled model g and s point into */
+    void *cache_buf;         /**< Same, if read without mmap */
 } ms_mgau_model_t;  
 
 #define ms_mgau_gauden(msg) (msg->g)
@@ -128,6 +147,13 @@ typedef struct {
 #define ms_mgau_topn(msg) (msg->topn)
 
 ps_mgau_t* ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef);
+
+/**
+ * Is there a compiled model (-amcache) that matches the model files
+ * and parameters in config?  If so, ms_mgau_init() will map it instead
+ * of loading those files.
+ */
+int ms_mgau_cache_valid(cmd_ln_t *config, logmath_t *lmath);
 void ms_mgau_free(ps_mgau_t *g);
 int32 ms_cont_mgau_frame_eval(ps_mgau_t * msg,
                               int16 *senscr,
@@ -136,6 +162,11 @@ int32 ms_cont_mgau_frame_eval(ps_mgau_t * msg,
                               mfcc_t ** feat,
                               int32 frame,
                               int32 compallsen);
+int32 ms_cont_mgau_frame_eval_batch(ps_mgau_t * msg,
+                                    int16 **senscr,
+                                    mfcc_t ***feat,
+                                    int32 n_frame,
+                                    int32 frame);
 int32 ms_mgau_mllr_transform(ps_mgau_t *s,
                              ps_mllr_t *mllr);
 
@@ -337,12 +337,68 @@ senone_init(gauden_t *g, char const *mixwfile, char const *sen2mgau_map_file,
     return s;
 }
 
+senone_t *
+senone_init_arrays(void const **ptr, size_t const *size, int32 n_array,
+                   float32 mixwfloor, logmath_t *lmath)
+{
+    senone_t *s;
+    uint32 const *dims;
+
+    if (n_array != SENONE_N_ARRAYS
+        || size[0] != SENONE_N_DIMS * sizeof(uint32))
+        return NULL;
+    dims = ptr[0];
+    if (size[1] != dims[0] * sizeof(uint32)
+        || size[2] != (size_t)dims[0] * dims[1] * dims[2])
+        return NULL;
+
+    s = (senone_t *) ckd_calloc(1, sizeof(senone_t));
+    s->lmath = logmath_init(logmath_get_base(lmath), SENSCR_SHIFT, TRUE);
+    s->mixwfloor = mixwfloor;
+    s->n_sen = dims[0];
+    s->n_feat = dims[1];
+    s->n_cw = dims[2];
+    s->n_gauden = dims[3];
+    s->mgau = ckd_calloc(s->n_sen, sizeof(*s->mgau));
+    memcpy(s->mgau, ptr[1], size[1]);
+    /* Transposed or not, as in senone_mixw_read(). */
+    if (s->n_gauden > 1)
+        s->pdf = (senprob_t ***) ckd_alloc_3d_ptr(s->n_sen, s->n_feat,
+                                                  s->n_cw, (void *)ptr[2],
+                                                  sizeof(senprob_t));
+    else
+        s->pdf = (senprob_t ***) ckd_alloc_3d_ptr(s->n_feat, s->n_cw,
+                                                  s->n_sen, (void *)ptr[2],
+                                                  sizeof(senprob_t));
+    s->mapped = TRUE;
+    return s;
+}
+
+int32
+senone_get_arrays(senone_t *s, uint32 *dims,
+                  void const **out_ptr, size_t *out_size)
+{
+    dims[0] = s->n_sen;
+    dims[1] = s->n_feat;
+    dims[2] = s->n_cw;
+    dims[3] = s->n_gauden;
+    out_ptr[0] = dims;
+    out_size[0] = SENONE_N_DIMS * sizeof(uint32);
+    out_ptr[1] = s->mgau;
+    out_size[1] = s->n_sen * sizeof(uint32);
+    out_ptr[2] = s->pdf[0][0];
+    out_size[2] = (size_t)s->n_sen * s->n_feat * s->n_cw;
+    return SENONE_N_ARRAYS;
+}
+
 void
 senone_free(senone_t * s)
 {
     if (s == NULL)
         return;
-    if (s->pdf)
+    if (s->pdf && s->mapped)
+        ckd_free_3d_ptr((void *) s->pdf);
+    else if (s->pdf)
         ckd_free_3d((void *) s->pdf);
     if (s->mgau)
         ckd_free(s->mgau);
@@ -158,8 +158,16 @@ typedef struct {
     uint32 *mgau;		/**< senone-id -> mgau-id mapping for senones in this set */
     int32 *featscr;              /**< The feature score for every senone, will be initialized inside senone_eval_all */
     int32 aw;			/**< Inverse acoustic weight */
+    int32 mapped;		/**< Does pdf point into a compiled model
+                                   (see senone_init_arrays())? */
 } senone_t;
 
+/** Number of values in the first array from senone_get_arrays(). */
+#define SENONE_N_DIMS 4
+
+/** Number of arrays from senone_get_arrays(). */
+#define SENONE_N_ARRAYS 3
+
 
 /**
  * Load a set of senones (mixing weights and mixture gaussian codebook mappings) from
@@ -177,6 +185,25 @@ senone_t *senone_init (gauden_t *g,             /**< In: codebooks */
                        bin_mdef_t *mdef         /**< In: model definition */
     );
 
+/**
+ * Create a set of senones from the arrays of another one, as returned
+ * by senone_get_arrays() (typically read back from a compiled model
+ * file).  The mixture weights are used in place, so they must not
+ * change or go away before the senones are freed.
+ * @return NULL if the arrays are inconsistent.
+ */
+senone_t *senone_init_arrays(void const **ptr, size_t const *size,
+                             int32 n_array, float32 mixwfloor,
+                             logmath_t *lmath);
+
+/**
+ * Get the arrays of a set of senones, for senone_init_arrays().  The
+ * first array is dims, which must have room for SENONE_N_DIMS values.
+ * @return the number of arrays (SENONE_N_ARRAYS).
+ */
+int32 senone_get_arrays(senone_t *s, uint32 *dims,
+                        void const **out_ptr, size_t *out_size);
+
 /** Release memory allocated by senone_init. */
 void senone_free(senone_t *s); /**< In: The senone_t to free */
 
@@ -161,7 +161,8 @@ ngram_search_init(const char *name,
     ps_search_init(&ngs->base, &ngram_funcs, PS_SEARCH_TYPE_NGRAM, name, config, acmod, dict, d2p);
 
     ngs->hmmctx = hmm_context_init(bin_mdef_n_emit_state(acmod->mdef),
-                                   acmod->tmat->tp, NULL, acmod->mdef->sseq);
+                                   acmod->tmat->tp, acmod->tmat->n_tmat,
+                                   NULL, acmod->mdef->sseq);
     if (ngs->hmmctx == NULL) {
         ps_search_free(ps_search_base(ngs));
         return NULL;
@@ -234,6 +235,17 @@ ngram_search_init(const char *name,
         ptmr_init(&ngs->bestpath_perf);
     }
 
+    /* The flat lexicon search and the word lattice need all of the
+     * backpointer table. */
+    ngs->bptbl_gc = cmd_ln_int32_r(config, "-bptblgc");
+    if (ngs->bptbl_gc > 0
+        && (!ngs->fwdtree || ngs->fwdflat || ngs->bestpath)) {
+        E_WARN("-bptblgc needs -fwdtree yes -fwdflat no -bestpath no, "
+               "not compacting the backpointer table\n");
+        ngs->bptbl_gc = 0;
+    }
+    ngs->bp_stable = NO_BP;
+
     return (ps_search_t *)ngs;
 
 error_out:
@@ -603,6 +615,109 @@ ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx)
     return base->hyp_str;
 }
 
+int32 *
+ngram_search_compact_bptable(ngram_search_t *ngs, int frame_idx,
+                             uint8 *live_frame)
+{
+    int32 *bp_map;
+    int32 i, j, bp, n_pending, stable, diverged, ss;
+
+    if (ngs->bpidx == 0)
+        return NULL;
+
+    /* Keep what ngram_search_find_exit() would find. */
+    live_frame[frame_idx] = TRUE;
+    if (ngs->bp_table_idx[frame_idx] > 0)
+        live_frame[ngs->bp_table[ngs->bp_table_idx[frame_idx] - 1].frame] = TRUE;
+
+    /* Any entry in a live frame may yet be a predecessor (see
+     * last_phone_transition()), so keep them all, and their
+     * predecessors.  Since predecessors come first, this takes one
+     * pass backwards, during which the number of entries still to be
+     * visited drops to one exactly at the latest common predecessor,
+     * unless two paths go back to different starts. */
+    bp_map = ckd_calloc(ngs->bpidx + 1, sizeof(*bp_map));
+    n_pending = 0;
+    for (i = 0; i < ngs->bpidx; ++i) {
+        if (live_frame[ngs->bp_table[i].frame]) {
+            bp_map[i] = TRUE;
+            ++n_pending;
+        }
+    }
+    stable = NO_BP;
+    diverged = FALSE;
+    for (i = ngs->bpidx - 1; i >= 0; --i) {
+        if (!bp_map[i])
+            continue;
+        if (n_pending == 1 && !diverged && stable == NO_BP)
+            stable = i;
+        --n_pending;
+        bp = ngs->bp_table[i].bp;
+        if (bp == NO_BP)
+            diverged = TRUE;
+        else if (!bp_map[bp]) {
+            bp_map[bp] = TRUE;
+            ++n_pending;
+        }
+    }
+
+    /* Turn the flags into new indices. */
+    for (i = j = 0; i < ngs->bpidx; ++i) {
+        int32 keep = bp_map[i];
+        bp_map[i] = j;
+        j += keep;
+    }
+    bp_map[ngs->bpidx] = j;
+
+    if (stable != NO_BP)
+        ngs->bp_stable = bp_map[stable];
+    else if (ngs->bp_stable != NO_BP)
+        ngs->bp_stable = bp_map[ngs->bp_stable];
+    if (j == ngs->bpidx) {
+        ckd_free(bp_map);
+        return NULL;
+    }
+
+    /* Move the entries and their right context scores down. */
+    for (i = j = ss = 0; i < ngs->bpidx; ++i) {
+        bptbl_t *be = ngs->bp_table + i;
+
+        if (bp_map[i + 1] == bp_map[i])
+            continue;
+        if (be->s_idx != -1) {
+            int32 rcsize = dict2pid_rssid(ps_search_dict2pid(ngs),
+                                          be->last_phone,
+                                          be->last2_phone)->n_ssid;
+            memmove(ngs->bscore_stack + ss, ngs->bscore_stack + be->s_idx,
+                    rcsize * sizeof(*ngs->bscore_stack));
+            be->s_idx = ss;
+            ss += rcsize;
+        }
+        if (be->bp != NO_BP)
+            be->bp = bp_map[be->bp];
+        ngs->bp_table[j++] = *be;
+    }
+    for (i = 0; i <= frame_idx; ++i)
+        ngs->bp_table_idx[i] = bp_map[ngs->bp_table_idx[i]];
+
+    ngs->st.n_bp_collected += ngs->bpidx - j;
+    ngs->bpidx = j;
+    ngs->bss_head = ss;
+    return bp_map;
+}
+
+char const *
+ngram_search_stable_hyp(ngram_search_t *ngs, int32 *out_frame)
+{
+    if (out_frame)
+        *out_frame = -1;
+    if (ngs->bp_stable == NO_BP)
+        return NULL;
+    if (out_frame)
+        *out_frame = ngs->bp_table[ngs->bp_stable].frame;
+    return ngram_search_bp_hyp(ngs, ngs->bp_stable);
+}
+
 void
 ngram_search_alloc_all_rc(ngram_search_t *ngs, int32 w)
 {
@@ -188,6 +188,7 @@ typedef struct ngram_search_stats_s {
     int32 n_fwdflat_words;
     int32 n_fwdflat_word_transition;
     int32 n_senone_active_utt;
+    int32 n_bp_collected;
 } ngram_search_stats_t;
 
 
@@ -203,6 +204,7 @@ struct ngram_search_s {
     uint8 fwdtree;
     uint8 fwdflat;
     uint8 bestpath;
+    uint8 lmla;      /**< Apply LM lookahead in fwdtree search? */
 
     /* State of procesing. */
     uint8 done;
@@ -233,6 +235,21 @@ struct ngram_search_s {
     int32 n_root_chan;       /**< Number of valid root_chan */
     int32 n_nonroot_chan;    /**< Number of valid non-root channels */
     int32 max_nonroot_chan;  /**< Maximum possible number of non-root channels */
+    chan_t *nonroot_chan;    /**< Non-root channels of the search tree, in
+                                breadth-first order, so that the children
+                                of each channel are contiguous */
+    int32 n_nonroot_chan_alloc; /**< Number of nonroot_chan allocated */
+    /**
+     * LM lookahead score of each root and non-root channel (indexed
+     * like root_chan and nonroot_chan): the best unigram score of the
+     * words below it in the tree, or 0 without lookahead.  Scores in
+     * the tree include the lookahead of the channel they are in, which
+     * is traded for that of a child on each phone transition and taken
+     * out again when the word enters its last phone, where the real LM
+     * score is applied.
+     */
+    int32 *root_lmla;
+    int32 *nonroot_lmla;
     root_chan_t *rhmm_1ph;   /**< Root HMMs for single-phone words */
 
     /**
@@ -309,6 +326,11 @@ struct ngram_search_s {
     int32 *bp_table_idx; /* First BPTable entry for each frame */
     int32 *word_lat_idx; /* BPTable index for any word in current frame;
                             cleared before each frame */
+    int32 bptbl_gc;      /**< Compact the backpointer table every this
+                            many frames (0 for never), see
+                            ngram_search_compact_bptable() */
+    int32 bp_stable;     /**< Last entry of the part of the best path that
+                            can no longer change, or NO_BP */
 
     /*
      * Flat lexicon (2nd pass) search stuff.
@@ -354,6 +376,9 @@ struct ngram_search_s {
     int32 pip;
     int32 maxwpf;
     int32 maxhmmpf;
+    int32 *prune_score;      /**< Scores of the channels or word exits of
+                                a frame, for -maxhmmpf and -maxwpf */
+    int32 n_prune_score_alloc; /**< Number of prune_score allocated */
 };
 typedef struct ngram_search_s ngram_search_t;
 
@@ -402,6 +427,34 @@ void ngram_search_free_all_rc(ngram_search_t *ngs, int32 w);
  */
 int ngram_search_find_exit(ngram_search_t *ngs, int frame_idx, int32 *out_best_score, int32 *out_is_final);
 
+/**
+ * Discard the backpointer table entries that the search can no longer
+ * reach, at the end of a frame.
+ *
+ * Every entry in a frame for which live_frame[] is nonzero is kept,
+ * along with all of its predecessors, and so is the last frame that
+ * ngram_search_find_exit() would look at.  The entries kept are moved
+ * down in order, and ngs->bp_stable is advanced to the latest entry that
+ * all of them descend from.
+ *
+ * @param live_frame one flag per frame up to frame_idx.  The frames of
+ * the histories of all active HMMs must be set.
+ * @return a newly allocated map from old to new backpointer indices (the
+ * entries that were dropped map to the next one kept), for the caller
+ * to update its HMMs with and free, or NULL if nothing was dropped.
+ */
+int32 *ngram_search_compact_bptable(ngram_search_t *ngs, int frame_idx,
+                                    uint8 *live_frame);
+
+/**
+ * Get the part of the best path that can no longer change.
+ *
+ * @param out_frame Output: last frame of the returned words, or -1.
+ * @return a <strong>read-only</strong> string with the words, or NULL if
+ * there is none yet.
+ */
+char const *ngram_search_stable_hyp(ngram_search_t *ngs, int32 *out_frame);
+
 /**
  * Backtrace from a given backpointer index to obtain a word hypothesis.
  *
@@ -59,6 +59,8 @@
 #else
 #define chan_v_eval(chan) hmm_vit_eval(&(chan)->hmm)
 #endif
+/* Queue a channel to be evaluated with others (see hmm_vit_eval_add()) */
+#define chan_v_eval_add(ngs, chan) hmm_vit_eval_add((ngs)->hmmctx, &(chan)->hmm)
 
 static void
 ngram_fwdflat_expand_all(ngram_search_t *ngs)
@@ -471,13 +473,13 @@ fwdflat_eval_chan(ngram_search_t *ngs, int frame_idx)
 
         for (hmm = rhmm->next; hmm; hmm = hmm->next) {
             if (hmm_frame(&hmm->hmm) == frame_idx) {
-                int32 score = chan_v_eval(hmm);
-                if (score BETTER_THAN bestscore)
-                    bestscore = score;
+                chan_v_eval_add(ngs, hmm);
                 ngs->st.n_fwdflat_chan++;
             }
         }
     }
+    if ((i = hmm_vit_eval_flush(ngs->hmmctx)) BETTER_THAN bestscore)
+        bestscore = i;
 
     ngs->best_score = bestscore;
 }
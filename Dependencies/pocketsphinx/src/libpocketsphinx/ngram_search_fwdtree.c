@@ -59,6 +59,10 @@
 #else
 #define chan_v_eval(chan) hmm_vit_eval(&(chan)->hmm)
 #endif
+/* Queue a channel to be evaluated with others (see hmm_vit_eval_add()) */
+#define chan_v_eval_add(ngs, chan) hmm_vit_eval_add((ngs)->hmmctx, &(chan)->hmm)
+/* LM lookahead score of a non-root channel */
+#define chan_lmla(ngs, chan) (ngs)->nonroot_lmla[(chan) - (ngs)->nonroot_chan]
 
 /*
  * Allocate that part of the search channel tree structure that is independent of the
@@ -117,6 +121,8 @@ init_search_tree(ngram_search_t *ngs)
     /* Allocate and initialize root channels */
     ngs->root_chan =
         ckd_calloc(ngs->n_root_chan_alloc, sizeof(*ngs->root_chan));
+    ngs->root_lmla =
+        ckd_calloc(ngs->n_root_chan_alloc, sizeof(*ngs->root_lmla));
     for (i = 0; i < ngs->n_root_chan_alloc; i++) {
         hmm_init(ngs->hmmctx, &ngs->root_chan[i].hmm, TRUE, -1, -1);
         ngs->root_chan[i].penult_phn_wid = -1;
@@ -161,12 +167,138 @@ init_nonroot_chan(ngram_search_t *ngs, chan_t * hmm, int32 ph, int32 ci, int32 t
     hmm_init(ngs->hmmctx, &hmm->hmm, FALSE, ph, tmatid);
 }
 
+/*
+ * Move the channels from hmm along its list of siblings to
+ * nonroot_chan[n] onwards, in the same order.
+ * Returns the index of the next free channel.
+ */
+static int32
+pack_search_siblings(ngram_search_t *ngs, chan_t *hmm, int32 n)
+{
+    chan_t *sibling;
+
+    for (; hmm; hmm = sibling) {
+        sibling = hmm->alt;
+        ngs->nonroot_chan[n] = *hmm;
+        ngs->nonroot_chan[n].alt = sibling ? &ngs->nonroot_chan[n + 1] : NULL;
+        listelem_free(ngs->chan_alloc, hmm);
+        ++n;
+    }
+    return n;
+}
+
+/*
+ * Move the interior channels of the search tree, as built by
+ * create_search_tree(), into the single array ngs->nonroot_chan, in
+ * breadth-first order.  The children of a channel (and of a root
+ * channel) are then next to each other in memory, and channels of the
+ * same depth are close together, which is the order in which the
+ * active ones are visited in each frame.
+ *
+ * The tree is still built one channel at a time from chan_alloc and
+ * copied here, rather than laid out breadth-first as it is built:
+ * words are added in dictionary order, so the final position of a
+ * channel is only known once the whole tree exists.  This costs one
+ * copy per channel per create_search_tree(), which is small next to
+ * building the tree, and leaves its construction as it was.
+ */
+static void
+pack_search_tree(ngram_search_t *ngs)
+{
+    chan_t *hmm;
+    int32 i, n;
+
+    if (ngs->n_nonroot_chan > ngs->n_nonroot_chan_alloc) {
+        ckd_free(ngs->nonroot_chan);
+        ngs->n_nonroot_chan_alloc = ngs->max_nonroot_chan;
+        ngs->nonroot_chan = ckd_calloc(ngs->n_nonroot_chan_alloc,
+                                       sizeof(*ngs->nonroot_chan));
+        ckd_free(ngs->nonroot_lmla);
+        ngs->nonroot_lmla = ckd_calloc(ngs->n_nonroot_chan_alloc,
+                                       sizeof(*ngs->nonroot_lmla));
+    }
+
+    /* First the children of the roots, then those of each channel
+     * already moved, which are still linked to the old ones. */
+    n = 0;
+    for (i = 0; i < ngs->n_root_chan; i++) {
+        hmm = ngs->root_chan[i].next;
+        if (hmm)
+            ngs->root_chan[i].next = &ngs->nonroot_chan[n];
+        n = pack_search_siblings(ngs, hmm, n);
+    }
+    for (i = 0; i < n; i++) {
+        hmm = ngs->nonroot_chan[i].next;
+        if (hmm)
+            ngs->nonroot_chan[i].next = &ngs->nonroot_chan[n];
+        n = pack_search_siblings(ngs, hmm, n);
+    }
+    assert(n == ngs->n_nonroot_chan);
+}
+
+/*
+ * Best unigram score of word w and those after it in its homophone_set
+ * list, or best if that is better.
+ */
+static int32
+best_unigram_score(ngram_search_t *ngs, int32 w, int32 best)
+{
+    dict_t *dict = ps_search_dict(ngs);
+    int32 score, n_used;
+
+    for (; w >= 0; w = ngs->homophone_set[w]) {
+        score = ngram_ng_score(ngs->lmset, dict_basewid(dict, w),
+                               NULL, 0, &n_used) >> SENSCR_SHIFT;
+        if (score BETTER_THAN best)
+            best = score;
+    }
+    return best;
+}
+
+/*
+ * Compute the LM lookahead score of every channel in the search tree
+ * (see ngram_search_t::nonroot_lmla).  Children come after their
+ * parent in ngs->nonroot_chan, so going backwards each channel is
+ * reached after all of its descendants.
+ */
+static void
+compute_search_tree_lmla(ngram_search_t *ngs)
+{
+    chan_t *hmm, *child;
+    int32 i, best;
+
+    if (!ngs->lmla) {
+        memset(ngs->root_lmla, 0,
+               ngs->n_root_chan * sizeof(*ngs->root_lmla));
+        memset(ngs->nonroot_lmla, 0,
+               ngs->n_nonroot_chan * sizeof(*ngs->nonroot_lmla));
+        return;
+    }
+
+    for (i = ngs->n_nonroot_chan - 1; i >= 0; --i) {
+        hmm = &ngs->nonroot_chan[i];
+        best = best_unigram_score(ngs, hmm->info.penult_phn_wid, WORST_SCORE);
+        for (child = hmm->next; child; child = child->alt)
+            if (chan_lmla(ngs, child) BETTER_THAN best)
+                best = chan_lmla(ngs, child);
+        ngs->nonroot_lmla[i] = best;
+    }
+    for (i = 0; i < ngs->n_root_chan; ++i) {
+        best = best_unigram_score(ngs, ngs->root_chan[i].penult_phn_wid,
+                                  WORST_SCORE);
+        for (child = ngs->root_chan[i].next; child; child = child->alt)
+            if (chan_lmla(ngs, child) BETTER_THAN best)
+                best = chan_lmla(ngs, child);
+        ngs->root_lmla[i] = best;
+    }
+}
+
 /*
  * Allocate and initialize search channel-tree structure.
  * At this point, all the root-channels have been allocated and partly initialized
  * (as per init_search_tree()), and channels for all the single-phone words have been
  * allocated and initialized.  None of the interior channels of search-trees have
- * been allocated.
+ * been allocated; they are built here, then packed into ngs->nonroot_chan.
  * This routine may be called on every utterance, after reinit_search_tree() clears
  * the search tree created for the previous utterance.  Meant for reconfiguring the
  * search tree to suit the currently active LM.
@@ -332,6 +464,9 @@ create_search_tree(ngram_search_t *ngs)
                                               sizeof(**ngs->active_chan_list));
     }
 
+    pack_search_tree(ngs);
+    compute_search_tree_lmla(ngs);
+
     if (!ngs->n_root_chan)
 	E_ERROR("No word from the language model has pronunciation in the dictionary\n");
 
@@ -339,41 +474,19 @@ create_search_tree(ngram_search_t *ngs)
            ngs->n_root_chan, ngs->n_nonroot_chan, ngs->n_1ph_words);
 }
 
-static void
-reinit_search_subtree(ngram_search_t *ngs, chan_t * hmm)
-{
-    chan_t *child, *sibling;
-
-    /* First free all children under hmm */
-    for (child = hmm->next; child; child = sibling) {
-        sibling = child->alt;
-        reinit_search_subtree(ngs, child);
-    }
-
-    /* Now free hmm */
-    hmm_deinit(&hmm->hmm);
-    listelem_free(ngs->chan_alloc, hmm);
-}
-
 /*
- * Delete search tree by freeing all interior channels within search tree and
+ * Delete search tree by releasing all interior channels within search tree and
  * restoring root channel state to the init state (i.e., just after init_search_tree()).
+ * The array of interior channels is kept for the next call to create_search_tree().
  */
 static void
 reinit_search_tree(ngram_search_t *ngs)
 {
     int32 i;
-    chan_t *hmm, *sibling;
 
+    for (i = 0; i < ngs->n_nonroot_chan; i++)
+        hmm_deinit(&ngs->nonroot_chan[i].hmm);
     for (i = 0; i < ngs->n_root_chan; i++) {
-        hmm = ngs->root_chan[i].next;
-
-        while (hmm) {
-            sibling = hmm->alt;
-            reinit_search_subtree(ngs, hmm);
-            hmm = sibling;
-        }
-
         ngs->root_chan[i].penult_phn_wid = -1;
         ngs->root_chan[i].next = NULL;
     }
@@ -388,6 +501,7 @@ ngram_fwdtree_init(ngram_search_t *ngs)
                                 sizeof(*ngs->bestbp_rc));
     ngs->lastphn_cand = ckd_calloc(ps_search_n_words(ngs),
                                    sizeof(*ngs->lastphn_cand));
+    ngs->lmla = cmd_ln_boolean_r(ps_search_config(ngs), "-lmla");
     init_search_tree(ngs);
     create_search_tree(ngs);
 }
@@ -415,6 +529,8 @@ deinit_search_tree(ngram_search_t *ngs)
     ngs->n_root_chan_alloc = 0;
     ckd_free(ngs->root_chan);
     ngs->root_chan = NULL;
+    ckd_free(ngs->root_lmla);
+    ngs->root_lmla = NULL;
     ckd_free(ngs->single_phone_wid);
     ngs->single_phone_wid = NULL;
     ckd_free(ngs->homophone_set);
@@ -439,6 +555,14 @@ ngram_fwdtree_deinit(ngram_search_t *ngs)
     /* Free the search tree. */
     deinit_search_tree(ngs);
     /* Free other stuff. */
+    ckd_free(ngs->nonroot_chan);
+    ngs->nonroot_chan = NULL;
+    ckd_free(ngs->nonroot_lmla);
+    ngs->nonroot_lmla = NULL;
+    ngs->n_nonroot_chan_alloc = 0;
+    ckd_free(ngs->prune_score);
+    ngs->prune_score = NULL;
+    ngs->n_prune_score_alloc = 0;
     ngs->max_nonroot_chan = 0;
     ckd_free_2d(ngs->active_chan_list);
     ngs->active_chan_list = NULL;
@@ -487,6 +611,7 @@ ngram_fwdtree_start(ngram_search_t *ngs)
     /* Reset backpointer table. */
     ngs->bpidx = 0;
     ngs->bss_head = 0;
+    ngs->bp_stable = NO_BP;
 
     /* Reset word lattice. */
     for (i = 0; i < n_words; ++i)
@@ -628,21 +753,18 @@ static int32
 eval_nonroot_chan(ngram_search_t *ngs, int frame_idx)
 {
     chan_t *hmm, **acl;
-    int32 i, bestscore;
+    int32 i;
 
     i = ngs->n_active_chan[frame_idx & 0x1];
     acl = ngs->active_chan_list[frame_idx & 0x1];
-    bestscore = WORST_SCORE;
     ngs->st.n_nonroot_chan_eval += i;
 
     for (hmm = *(acl++); i > 0; --i, hmm = *(acl++)) {
-        int32 score = chan_v_eval(hmm);
         assert(hmm_frame(&hmm->hmm) == frame_idx);
-        if (score BETTER_THAN bestscore)
-            bestscore = score;
+        chan_v_eval_add(ngs, hmm);
     }
 
-    return bestscore;
+    return hmm_vit_eval_flush(ngs->hmmctx);
 }
 
 static int32
@@ -653,7 +775,6 @@ eval_word_chan(ngram_search_t *ngs, int frame_idx)
     int32 i, w, bestscore, *awl, j, k;
 
     k = 0;
-    bestscore = WORST_SCORE;
     awl = ngs->active_word_list[frame_idx & 0x1];
 
     i = ngs->n_active_word[frame_idx & 0x1];
@@ -663,18 +784,12 @@ eval_word_chan(ngram_search_t *ngs, int frame_idx)
         assert(ngs->word_chan[w] != NULL);
 
         for (hmm = ngs->word_chan[w]; hmm; hmm = hmm->next) {
-            int32 score;
-
             assert(hmm_frame(&hmm->hmm) == frame_idx);
-            score = chan_v_eval(hmm);
-            /*printf("eval word chan %d score %d\n", w, score); */
-
-            if (score BETTER_THAN bestscore)
-                bestscore = score;
-
+            chan_v_eval_add(ngs, hmm);
             k++;
         }
     }
+    bestscore = hmm_vit_eval_flush(ngs->hmmctx);
 
     /* Similarly for statically allocated single-phone words */
     j = 0;
@@ -728,7 +843,7 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
 {
     root_chan_t *rhmm;
     chan_t *hmm;
-    int32 i, nf, w;
+    int32 i, nf, w, lmla;
     int32 thresh, newphone_thresh, lastphn_thresh, newphone_score;
     chan_t **nacl;              /* next active list */
     lastphn_cand_t *candp;
@@ -754,14 +869,18 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
             /* transitions out of this root channel */
             /* transition to all next-level channels in the HMM tree */
             newphone_score = hmm_out_score(&rhmm->hmm) + ngs->pip;
+            lmla = ngs->root_lmla[i];
             if (pls != NULL || newphone_score BETTER_THAN newphone_thresh) {
                 for (hmm = rhmm->next; hmm; hmm = hmm->alt) {
-                    int32 pl_newphone_score = newphone_score
+                    /* Lookahead of a child is never better than its parent's */
+                    int32 la_newphone_score = newphone_score
+                        + chan_lmla(ngs, hmm) - lmla;
+                    int32 pl_newphone_score = la_newphone_score
                         + phone_loop_search_score(pls, hmm->ciphone);
                     if (pl_newphone_score BETTER_THAN newphone_thresh) {
                         if ((hmm_frame(&hmm->hmm) < frame_idx)
-                            || (newphone_score BETTER_THAN hmm_in_score(&hmm->hmm))) {
-                            hmm_enter(&hmm->hmm, newphone_score,
+                            || (la_newphone_score BETTER_THAN hmm_in_score(&hmm->hmm))) {
+                            hmm_enter(&hmm->hmm, la_newphone_score,
                                       hmm_out_history(&rhmm->hmm), nf);
                             *(nacl++) = hmm;
                         }
@@ -772,7 +891,7 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
             /*
              * Transition to last phone of all words for which this is the
              * penultimate phone (the last phones may need multiple right contexts).
-             * Remember to remove the temporary newword_penalty.
+             * Remember to remove the temporary newword_penalty and LM lookahead.
              */
             if (pls != NULL || newphone_score BETTER_THAN lastphn_thresh) {
                 for (w = rhmm->penult_phn_wid; w >= 0;
@@ -786,7 +905,7 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
                         ngs->n_lastphn_cand++;
                         candp->wid = w;
                         candp->score =
-                            newphone_score - ngs->nwpen;
+                            newphone_score - ngs->nwpen - lmla;
                         candp->bp = hmm_out_history(&rhmm->hmm);
                     }
                 }
@@ -804,7 +923,7 @@ static void
 prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
 {
     chan_t *hmm, *nexthmm;
-    int32 nf, w, i;
+    int32 nf, w, i, lmla;
     int32 thresh, newphone_thresh, lastphn_thresh, newphone_score;
     chan_t **acl, **nacl;       /* active list, next active list */
     lastphn_cand_t *candp;
@@ -833,19 +952,22 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
 
             /* transition to all next-level channel in the HMM tree */
             newphone_score = hmm_out_score(&hmm->hmm) + ngs->pip;
+            lmla = chan_lmla(ngs, hmm);
             if (pls != NULL || newphone_score BETTER_THAN newphone_thresh) {
                 for (nexthmm = hmm->next; nexthmm; nexthmm = nexthmm->alt) {
-                    int32 pl_newphone_score = newphone_score
+                    int32 la_newphone_score = newphone_score
+                        + chan_lmla(ngs, nexthmm) - lmla;
+                    int32 pl_newphone_score = la_newphone_score
                         + phone_loop_search_score(pls, nexthmm->ciphone);
                     if ((pl_newphone_score BETTER_THAN newphone_thresh)
                         && ((hmm_frame(&nexthmm->hmm) < frame_idx)
-                            || (newphone_score
+                            || (la_newphone_score
                                 BETTER_THAN hmm_in_score(&nexthmm->hmm)))) {
                         if (hmm_frame(&nexthmm->hmm) != nf) {
                             /* Keep this HMM on the active list */
                             *(nacl++) = nexthmm;
                         }
-                        hmm_enter(&nexthmm->hmm, newphone_score,
+                        hmm_enter(&nexthmm->hmm, la_newphone_score,
                                   hmm_out_history(&hmm->hmm), nf);
                     }
                 }
@@ -854,7 +976,7 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
             /*
              * Transition to last phone of all words for which this is the
              * penultimate phone (the last phones may need multiple right contexts).
-             * Remember to remove the temporary newword_penalty.
+             * Remember to remove the temporary newword_penalty and LM lookahead.
              */
             if (pls != NULL || newphone_score BETTER_THAN lastphn_thresh) {
                 for (w = hmm->info.penult_phn_wid; w >= 0;
@@ -867,7 +989,7 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
                         ngs->n_lastphn_cand++;
                         candp->wid = w;
                         candp->score =
-                            newphone_score - ngs->nwpen;
+                            newphone_score - ngs->nwpen - lmla;
                         candp->bp = hmm_out_history(&hmm->hmm);
                     }
                 }
@@ -1137,45 +1259,29 @@ prune_channels(ngram_search_t *ngs, int frame_idx)
     ngs->n_lastphn_cand = 0;
     /* Set the dynamic beam based on maxhmmpf here. */
     ngs->dynamic_beam = ngs->beam;
-    if (ngs->maxhmmpf != -1
-        && ngs->st.n_root_chan_eval + ngs->st.n_nonroot_chan_eval > ngs->maxhmmpf) {
-        /* Build a histogram to approximately prune them. */
-        int32 bins[256], bw, nhmms, i;
+    if (ngs->maxhmmpf > 0) {
         root_chan_t *rhmm;
-        chan_t **acl, *hmm;
-
-        /* Bins go from zero (best score) to edge of beam. */
-        bw = -ngs->beam / 256;
-        memset(bins, 0, sizeof(bins));
-        /* For each active root channel. */
+        chan_t **acl;
+        int32 *score, i, n, beam;
+
+        /* Collect the scores of the active root and non-root channels. */
+        acl = ngs->active_chan_list[frame_idx & 0x1];
+        n = ngs->n_active_chan[frame_idx & 0x1];
+        score = hmm_score_grow(&ngs->prune_score, &ngs->n_prune_score_alloc,
+                               ngs->n_root_chan + n);
+        for (i = 0; i < n; ++i)
+            score[i] = hmm_bestscore(&acl[i]->hmm);
         for (i = 0, rhmm = ngs->root_chan; i < ngs->n_root_chan; i++, rhmm++) {
-            int32 b;
-
-            /* Put it in a bin according to its bestscore. */
-            b = (ngs->best_score - hmm_bestscore(&rhmm->hmm)) / bw;
-            if (b >= 256)
-                b = 255;
-            ++bins[b];
+            if (hmm_frame(&rhmm->hmm) >= frame_idx)
+                score[n++] = hmm_bestscore(&rhmm->hmm);
         }
-        /* For each active non-root channel. */
-        acl = ngs->active_chan_list[frame_idx & 0x1];       /* currently active HMMs in tree */
-        for (i = ngs->n_active_chan[frame_idx & 0x1], hmm = *(acl++);
-             i > 0; --i, hmm = *(acl++)) {
-            int32 b;
-
-            /* Put it in a bin according to its bestscore. */
-            b = (ngs->best_score - hmm_bestscore(&hmm->hmm)) / bw;
-            if (b >= 256)
-                b = 255;
-            ++bins[b];
+        /* Narrow the beam so that only the maxhmmpf best survive. */
+        if (n > ngs->maxhmmpf) {
+            beam = hmm_score_select(score, n, ngs->maxhmmpf)
+                - 1 - ngs->best_score;
+            if (beam BETTER_THAN ngs->dynamic_beam)
+                ngs->dynamic_beam = beam;
         }
-        /* Walk down the bins to find the new beam. */
-        for (i = nhmms = 0; i < 256; ++i) {
-            nhmms += bins[i];
-            if (nhmms > ngs->maxhmmpf)
-                break;
-        }
-        ngs->dynamic_beam = -(i * bw);
     }
 
     prune_root_chan(ngs, frame_idx);
@@ -1192,8 +1298,9 @@ static void
 bptable_maxwpf(ngram_search_t *ngs, int frame_idx)
 {
     int32 bp, n;
-    int32 bestscr, worstscr;
-    bptbl_t *bpe, *bestbpe, *worstbpe;
+    int32 bestscr, cutoff;
+    int32 *score;
+    bptbl_t *bpe, *bestbpe;
 
     /* Don't prune if no pruing. */
     if (ngs->maxwpf == -1 || ngs->maxwpf == ps_search_n_words(ngs))
@@ -1223,21 +1330,34 @@ bptable_maxwpf(ngram_search_t *ngs, int frame_idx)
     /* Allow up to maxwpf best entries to survive; mark the remaining with valid = 0 */
     n = (ngs->bpidx
          - ngs->bp_table_idx[frame_idx]) - n;  /* No. of entries after limiting fillers */
-    for (; n > ngs->maxwpf; --n) {
-        /* Find worst BPTable entry */
-        worstscr = (int32) 0x7fffffff;
-        worstbpe = NULL;
-        for (bp = ngs->bp_table_idx[frame_idx]; (bp < ngs->bpidx); bp++) {
-            bpe = &(ngs->bp_table[bp]);
-            if (bpe->valid && (bpe->score WORSE_THAN worstscr)) {
-                worstscr = bpe->score;
-                worstbpe = bpe;
-            }
-        }
-        /* FIXME: Don't panic! */
-        if (worstbpe == NULL)
-            E_FATAL("PANIC: No worst BPtable entry remaining\n");
-        worstbpe->valid = FALSE;
+    if (n <= ngs->maxwpf)
+        return;
+    score = hmm_score_grow(&ngs->prune_score, &ngs->n_prune_score_alloc, n);
+    n = 0;
+    for (bp = ngs->bp_table_idx[frame_idx]; bp < ngs->bpidx; bp++) {
+        bpe = &(ngs->bp_table[bp]);
+        if (bpe->valid)
+            score[n++] = bpe->score;
+    }
+    if (ngs->maxwpf > 0)
+        cutoff = hmm_score_select(score, n, ngs->maxwpf);
+    else
+        cutoff = (int32) 0x7fffffff;
+    /* Of the entries tied with the worst one kept, keep the last ones. */
+    n = ngs->maxwpf;
+    for (bp = ngs->bp_table_idx[frame_idx]; bp < ngs->bpidx; bp++) {
+        bpe = &(ngs->bp_table[bp]);
+        if (bpe->valid && (bpe->score BETTER_THAN cutoff))
+            --n;
+    }
+    for (bp = ngs->bpidx - 1; bp >= ngs->bp_table_idx[frame_idx]; bp--) {
+        bpe = &(ngs->bp_table[bp]);
+        if (!bpe->valid || (bpe->score BETTER_THAN cutoff))
+            continue;
+        if (bpe->score == cutoff && n > 0)
+            --n;
+        else
+            bpe->valid = FALSE;
     }
 }
 
@@ -1315,7 +1435,8 @@ word_transition(ngram_search_t *ngs, int frame_idx)
     for (i = ngs->n_root_chan, rhmm = ngs->root_chan; i > 0; --i, rhmm++) {
         bestbp_rc_ptr = &(ngs->bestbp_rc[rhmm->ciphone]);
 
-        newscore = bestbp_rc_ptr->score + ngs->nwpen + ngs->pip;
+        newscore = bestbp_rc_ptr->score + ngs->nwpen + ngs->pip
+            + ngs->root_lmla[rhmm - ngs->root_chan];
         pl_newscore = newscore
             + phone_loop_search_score(pls, rhmm->ciphone);
         if (pl_newscore BETTER_THAN thresh) {
@@ -1454,6 +1575,104 @@ deactivate_channels(ngram_search_t *ngs, int frame_idx)
     }
 }
 
+/*
+ * Mark the frames of the backpointers that the HMMs active in frame nf
+ * come from in live_frame, or, if bp_map is not NULL, renumber them
+ * after ngram_search_compact_bptable().
+ */
+static void
+map_hmm_history(hmm_t *hmm, uint8 *live_frame, bptbl_t const *bp_table,
+                int32 const *bp_map)
+{
+    int32 i, bp;
+
+    for (i = -1; i < hmm_n_emit_state(hmm); ++i) {
+        /* Score and history of the exit state, then the others. */
+        int32 score = i < 0 ? hmm_out_score(hmm) : hmm_score(hmm, i);
+        bp = i < 0 ? hmm_out_history(hmm) : hmm_history(hmm, i);
+        if (bp == NO_BP)
+            continue;
+        if (bp_map == NULL) {
+            if (score BETTER_THAN WORST_SCORE)
+                live_frame[bp_table[bp].frame] = TRUE;
+        }
+        else {
+            /* What was dropped was not on any path. */
+            bp = (bp_map[bp + 1] == bp_map[bp]) ? NO_BP : bp_map[bp];
+            if (i < 0)
+                hmm_out_history(hmm) = bp;
+            else
+                hmm_history(hmm, i) = bp;
+        }
+    }
+}
+
+static void
+map_active_history(ngram_search_t *ngs, int nf, uint8 *live_frame,
+                   int32 const *bp_map)
+{
+    root_chan_t *rhmm;
+    chan_t *hmm, **acl;
+    int32 i, w, *awl;
+
+    for (i = ngs->n_root_chan, rhmm = ngs->root_chan; i > 0; --i, rhmm++) {
+        if (hmm_frame(&rhmm->hmm) == nf)
+            map_hmm_history(&rhmm->hmm, live_frame, ngs->bp_table, bp_map);
+    }
+    i = ngs->n_active_chan[nf & 0x1];
+    acl = ngs->active_chan_list[nf & 0x1];
+    for (; i > 0; --i) {
+        hmm = *(acl++);
+        if (hmm_frame(&hmm->hmm) == nf)
+            map_hmm_history(&hmm->hmm, live_frame, ngs->bp_table, bp_map);
+    }
+    i = ngs->n_active_word[nf & 0x1];
+    awl = ngs->active_word_list[nf & 0x1];
+    for (; i > 0; --i) {
+        for (hmm = ngs->word_chan[*(awl++)]; hmm; hmm = hmm->next) {
+            if (hmm_frame(&hmm->hmm) == nf)
+                map_hmm_history(&hmm->hmm, live_frame, ngs->bp_table, bp_map);
+        }
+    }
+    for (i = 0; i < ngs->n_1ph_words; i++) {
+        w = ngs->single_phone_wid[i];
+        rhmm = (root_chan_t *) ngs->word_chan[w];
+        if (hmm_frame(&rhmm->hmm) == nf)
+            map_hmm_history(&rhmm->hmm, live_frame, ngs->bp_table, bp_map);
+    }
+}
+
+/*
+ * Drop the backpointers that no active HMM can lead back to, so that the
+ * table does not grow with the length of the utterance.
+ */
+static void
+compact_bptable(ngram_search_t *ngs, int frame_idx)
+{
+    uint8 *live_frame;
+    int32 *bp_map;
+    int32 i, n_words;
+
+    live_frame = ckd_calloc(frame_idx + 1, sizeof(*live_frame));
+    map_active_history(ngs, frame_idx + 1, live_frame, NULL);
+    bp_map = ngram_search_compact_bptable(ngs, frame_idx, live_frame);
+    if (bp_map) {
+        map_active_history(ngs, frame_idx + 1, NULL, bp_map);
+        /* Best transitions into last phones are only looked up again
+         * from live frames, whose entries were all kept. */
+        n_words = ps_search_n_words(ngs);
+        for (i = 0; i < n_words; ++i) {
+            int32 sf = ngs->last_ltrans[i].sf;
+            if (sf > 0 && live_frame[sf - 1])
+                ngs->last_ltrans[i].bp = bp_map[ngs->last_ltrans[i].bp];
+            else
+                ngs->last_ltrans[i].sf = -1;
+        }
+        ckd_free(bp_map);
+    }
+    ckd_free(live_frame);
+}
+
 int
 ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx)
 {
@@ -1492,6 +1711,9 @@ ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx)
     word_transition(ngs, frame_idx);
     /* Deactivate pruned HMMs. */
     deactivate_channels(ngs, frame_idx);
+    /* Garbage collect the backpointer table if need be. */
+    if (ngs->bptbl_gc > 0 && (frame_idx + 1) % ngs->bptbl_gc == 0)
+        compact_bptable(ngs, frame_idx);
 
     ++ngs->n_frame;
     /* Return the number of frames processed. */
@@ -1549,8 +1771,12 @@ ngram_fwdtree_finish(ngram_search_t *ngs)
     if (cf > 0) {
         double n_speech = (double)(cf + 1)
             / cmd_ln_int32_r(ps_search_config(ngs), "-frate");
+        int32 n_bp = ngs->bpidx + ngs->st.n_bp_collected;
         E_INFO("%8d words recognized (%d/fr)\n",
-               ngs->bpidx, (ngs->bpidx + (cf >> 1)) / (cf + 1));
+               n_bp, (n_bp + (cf >> 1)) / (cf + 1));
+        if (ngs->bptbl_gc > 0)
+            E_INFO("%8d backpointers collected, %d kept\n",
+                   ngs->st.n_bp_collected, ngs->bpidx);
         E_INFO("%8d senones evaluated (%d/fr)\n", ngs->st.n_senone_active_utt,
                (ngs->st.n_senone_active_utt + (cf >> 1)) / (cf + 1));
         E_INFO("%8d channels searched (%d/fr), %d 1st, %d last\n",
@@ -79,7 +79,8 @@ phone_loop_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2p)
     if (pls->hmmctx)
         hmm_context_free(pls->hmmctx);
     pls->hmmctx = hmm_context_init(bin_mdef_n_emit_state(acmod->mdef),
-                                   acmod->tmat->tp, NULL, acmod->mdef->sseq);
+                                   acmod->tmat->tp, acmod->tmat->n_tmat,
+                                   NULL, acmod->mdef->sseq);
     if (pls->hmmctx == NULL)
         return -1;
 
@@ -201,23 +202,18 @@ renormalize_hmms(phone_loop_search_t *pls, int frame_idx, int32 norm)
 static void
 evaluate_hmms(phone_loop_search_t *pls, int16 const *senscr, int frame_idx)
 {
-    int32 bs = WORST_SCORE;
     int i;
 
     hmm_context_set_senscore(pls->hmmctx, senscr);
 
     for (i = 0; i < pls->n_phones; ++i) {
         hmm_t *hmm = (hmm_t *)&pls->hmms[i];
-        int32 score;
 
         if (hmm_frame(hmm) < frame_idx)
             continue;
-        score = hmm_vit_eval(hmm);
-        if (score BETTER_THAN bs) {
-            bs = score;
-        }
+        hmm_vit_eval_add(pls->hmmctx, hmm);
     }
-    pls->best_score = bs;
+    pls->best_score = hmm_vit_eval_flush(pls->hmmctx);
 }
 
 static void
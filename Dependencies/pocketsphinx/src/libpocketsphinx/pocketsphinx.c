@@ -1028,7 +1028,8 @@ ps_search_forward(ps_decoder_t *ps)
     int nfr;
 
     nfr = 0;
-    while (ps->acmod->n_feat_frame > 0) {
+    while (ps->acmod->n_feat_frame > 0
+           || acmod_fetch_feat(ps->acmod) > 0) {
         int k;
         if (ps->pl_window > 0)
             if ((k = ps_search_step(ps->phone_loop, ps->acmod->output_frame)) < 0)
@@ -1044,17 +1045,17 @@ ps_search_forward(ps_decoder_t *ps)
     return nfr;
 }
 
-int
-ps_decode_senscr(ps_decoder_t *ps, FILE *senfh)
+/* Search the frames of the senone score file set up in acmod. */
+static int
+ps_search_senscr(ps_decoder_t *ps)
 {
     int nfr, n_searchfr;
 
-    ps_start_utt(ps);
     n_searchfr = 0;
-    acmod_set_insenfh(ps->acmod, senfh);
     while ((nfr = acmod_read_scores(ps->acmod)) > 0) {
         if ((nfr = ps_search_forward(ps)) < 0) {
             ps_end_utt(ps);
+            acmod_set_insenfh(ps->acmod, NULL);
             return nfr;
         }
         n_searchfr += nfr;
@@ -1065,6 +1066,28 @@ ps_decode_senscr(ps_decoder_t *ps, FILE *senfh)
     return n_searchfr;
 }
 
+int
+ps_decode_senscr(ps_decoder_t *ps, FILE *senfh)
+{
+    ps_start_utt(ps);
+    if (acmod_set_insenfh(ps->acmod, senfh) < 0) {
+        ps_end_utt(ps);
+        return -1;
+    }
+    return ps_search_senscr(ps);
+}
+
+int
+ps_decode_senscr_file(ps_decoder_t *ps, char const *file)
+{
+    ps_start_utt(ps);
+    if (acmod_set_insen_file(ps->acmod, file) < 0) {
+        ps_end_utt(ps);
+        return -1;
+    }
+    return ps_search_senscr(ps);
+}
+
 int
 ps_process_raw(ps_decoder_t *ps,
                int16 const *data,
@@ -1167,6 +1190,8 @@ ps_end_utt(ps_decoder_t *ps)
         return rv;
     }
     ptmr_stop(&ps->perf);
+    /* Stop logging senone scores, now that they are all computed. */
+    acmod_set_senfh(ps->acmod, NULL);
 
     /* Log a backtrace if requested. */
     if (cmd_ln_boolean_r(ps->config, "-backtrace")) {
@@ -1220,6 +1245,20 @@ ps_get_hyp_final(ps_decoder_t *ps, int32 *out_is_final)
     return hyp;
 }
 
+char const *
+ps_get_hyp_stable(ps_decoder_t *ps, int32 *out_frame)
+{
+    char const *hyp = NULL;
+
+    if (out_frame)
+        *out_frame = -1;
+    ptmr_start(&ps->perf);
+    if (!strcmp(PS_SEARCH_TYPE_NGRAM, ps_search_type(ps->search)))
+        hyp = ngram_search_stable_hyp((ngram_search_t *)ps->search, out_frame);
+    ptmr_stop(&ps->perf);
+    return hyp;
+}
+
 
 int32
 ps_get_prob(ps_decoder_t *ps)
@@ -1375,6 +1414,25 @@ ps_get_utt_time(ps_decoder_t *ps, double *out_nspeech,
     *out_nwall = ps->perf.t_elapsed;
 }
 
+void
+ps_get_utt_skip(ps_decoder_t *ps, int32 *out_nframe, int32 *out_nskip,
+                double *out_ncpu, double *out_nsaved)
+{
+    acmod_t *acmod = ps->acmod;
+    int32 n_full;
+
+    *out_nframe = acmod->n_score_frame;
+    *out_nskip = acmod->n_skip_frame;
+    *out_ncpu = acmod->score_perf.t_cpu + acmod->skip_perf.t_cpu;
+    /* Assume skipped frames would have cost as much as the others. */
+    n_full = acmod->n_score_frame - acmod->n_skip_frame;
+    if (n_full > 0)
+        *out_nsaved = acmod->score_perf.t_cpu / n_full * acmod->n_skip_frame
+            - acmod->skip_perf.t_cpu;
+    else
+        *out_nsaved = 0;
+}
+
 void
 ps_get_all_time(ps_decoder_t *ps, double *out_nspeech,
                 double *out_ncpu, double *out_nwall)
@@ -1390,7 +1448,7 @@ ps_get_all_time(ps_decoder_t *ps, double *out_nspeech,
 uint8 
 ps_get_in_speech(ps_decoder_t *ps)
 {
-    return fe_get_vad_state(ps->acmod->fe);
+    return acmod_get_vad_state(ps->acmod);
 }
 
 void
@@ -64,16 +64,10 @@ static ps_mgaufuncs_t ptm_mgau_funcs = {
     "ptm",
     ptm_mgau_frame_eval,      /* frame_eval */
     ptm_mgau_mllr_transform,  /* transform */
-    ptm_mgau_free             /* free */
+    ptm_mgau_free,            /* free */
+    NULL                      /* frame_eval_batch */
 };
 
-#define COMPUTE_GMM_MAP(_idx)                           \
-    diff[_idx] = obs[_idx] - mean[_idx];                \
-    sqdiff[_idx] = MFCCMUL(diff[_idx], diff[_idx]);     \
-    compl[_idx] = MFCCMUL(sqdiff[_idx], var[_idx]);
-#define COMPUTE_GMM_REDUCE(_idx)                \
-    d = GMMSUB(d, compl[_idx]);
-
 static void
 insertion_sort_topn(ptm_topn_t *topn, int i, int32 d)
 {
@@ -91,49 +85,31 @@ insertion_sort_topn(ptm_topn_t *topn, int i, int32 d)
 }
 
 static int
-eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
+eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z, mfcc_t *dist)
 {
+    tied_mgau_eval_t *e = s->eval;
     ptm_topn_t *topn;
-    int i, ceplen;
+    mfcc_t const *mean[TIED_MGAU_MAX_LANE], *var[TIED_MGAU_MAX_LANE];
+    mfcc_t det[TIED_MGAU_MAX_LANE];
+    int i, l, ceplen;
 
     topn = s->f->topn[cb][feat];
     ceplen = s->g->featlen[feat];
 
-    for (i = 0; i < s->max_topn; i++) {
-        mfcc_t *mean, diff[4], sqdiff[4], compl[4]; /* diff, diff^2, component likelihood */
-        mfcc_t *var, d;
-        mfcc_t *obs;
-        int32 cw, j;
-
-        cw = topn[i].cw;
-        mean = s->g->mean[cb][feat][0] + cw * ceplen;
-        var = s->g->var[cb][feat][0] + cw * ceplen;
-        d = s->g->det[cb][feat][cw];
-        obs = z;
-        for (j = 0; j < ceplen % 4; ++j) {
-            diff[0] = *obs++ - *mean++;
-            sqdiff[0] = MFCCMUL(diff[0], diff[0]);
-            compl[0] = MFCCMUL(sqdiff[0], *var);
-            d = GMMSUB(d, compl[0]);
-            ++var;
-        }
-        /* We could vectorize this but it's unlikely to make much
-         * difference as the outer loop here isn't very big. */
-        for (;j < ceplen; j += 4) {
-            COMPUTE_GMM_MAP(0);
-            COMPUTE_GMM_MAP(1);
-            COMPUTE_GMM_MAP(2);
-            COMPUTE_GMM_MAP(3);
-            COMPUTE_GMM_REDUCE(0);
-            COMPUTE_GMM_REDUCE(1);
-            COMPUTE_GMM_REDUCE(2);
-            COMPUTE_GMM_REDUCE(3);
-            var += 4;
-            obs += 4;
-            mean += 4;
+    /* Score all of them first: insertion_sort_topn() only moves
+     * entries that were already scored. */
+    for (i = 0; i < s->max_topn; i += e->n_topn_lane) {
+        for (l = 0; l < e->n_topn_lane; ++l) {
+            /* Pad the last group by repeating the last codeword. */
+            int32 cw = topn[MIN(i + l, s->max_topn - 1)].cw;
+            mean[l] = s->g->mean[cb][feat][cw];
+            var[l] = s->g->var[cb][feat][cw];
+            det[l] = s->g->det[cb][feat][cw];
         }
-        insertion_sort_topn(topn, i, (int32)d);
+        e->eval_topn(mean, var, det, z, ceplen, dist + i);
     }
+    for (i = 0; i < s->max_topn; i++)
+        insertion_sort_topn(topn, i, (int32)dist[i]);
 
     return topn[0].score;
 }
@@ -154,102 +130,123 @@ insertion_sort_cb(ptm_topn_t **cur, ptm_topn_t *worst, ptm_topn_t *best,
 static int
 eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
 {
+    tied_mgau_eval_t *e = s->eval;
     ptm_topn_t *worst, *best, *topn;
-    mfcc_t *mean;
-    mfcc_t *var, *det, *detP, *detE;
-    int32 i, ceplen;
+    mfcc_t const *mean, *var, *det;
+    mfcc_t d[TIED_MGAU_MAX_LANE], dmin[TIED_MGAU_MAX_LANE];
+    int32 b, l, i, ceplen;
 
     best = topn = s->f->topn[cb][feat];
     worst = topn + (s->max_topn - 1);
-    mean = s->g->mean[cb][feat][0];
-    var = s->g->var[cb][feat][0];
-    det = s->g->det[cb][feat];
-    detE = det + s->g->n_density;
+    mean = e->mean[cb][feat];
+    var = e->var[cb][feat];
+    det = e->det[cb][feat];
     ceplen = s->g->featlen[feat];
 
-    for (detP = det; detP < detE; ++detP) {
-        mfcc_t diff[4], sqdiff[4], compl[4]; /* diff, diff^2, component likelihood */
-        mfcc_t d, thresh;
-        mfcc_t *obs;
-        ptm_topn_t *cur;
-        int32 cw, j;
+    for (b = 0; b < e->n_block; ++b) {
+        mfcc_t thresh;
 
-        d = *detP;
+        /* Check for knockout after the first ceplen % 4 dimensions
+         * one at a time, then every 4 dimensions.  The threshold
+         * only goes up, so blocks knocked out with this one would be
+         * knocked out anyway. */
         thresh = (mfcc_t) worst->score; /* Avoid int-to-float conversions */
-        obs = z;
-        cw = (int)(detP - det);
-
-        /* Unroll the loop starting with the first dimension(s).  In
-         * theory this might be a bit faster if this Gaussian gets
-         * "knocked out" by C0. In practice not. */
-        for (j = 0; (j < ceplen % 4) && (d >= thresh); ++j) {
-            diff[0] = *obs++ - *mean++;
-            sqdiff[0] = MFCCMUL(diff[0], diff[0]);
-            compl[0] = MFCCMUL(sqdiff[0], *var++);
-            d = GMMSUB(d, compl[0]);
-        }
-        /* Now do 4 dimensions at a time.  You'd think that GCC would
-         * vectorize this?  Apparently not.  And it's right, because
-         * that won't make this any faster, at least on x86-64. */
-        for (; j < ceplen && d >= thresh; j += 4) {
-            COMPUTE_GMM_MAP(0);
-            COMPUTE_GMM_MAP(1);
-            COMPUTE_GMM_MAP(2);
-            COMPUTE_GMM_MAP(3);
-            COMPUTE_GMM_REDUCE(0);
-            COMPUTE_GMM_REDUCE(1);
-            COMPUTE_GMM_REDUCE(2);
-            COMPUTE_GMM_REDUCE(3);
-            var += 4;
-            obs += 4;
-            mean += 4;
-        }
-        if (j < ceplen) {
-            /* terminated early, so not in topn */
-            mean += (ceplen - j);
-            var += (ceplen - j);
-            continue;
-        }
-        if (d < thresh)
-            continue;
-        for (i = 0; i < s->max_topn; i++) {
-            /* already there, so don't need to insert */
-            if (topn[i].cw == cw)
+        b = e->eval_cb(mean, var, det, z, ceplen, 4, thresh,
+                       b, e->n_block, d, dmin);
+        if (b == e->n_block)
+            break;
+        for (l = 0; l < e->n_lane; ++l) {
+            ptm_topn_t *cur;
+            int32 cw = b * e->n_lane + l;
+
+            if (cw >= s->g->n_density)
                 break;
+            thresh = (mfcc_t) worst->score;
+            /* Knocked out at one of the checks, or at the end. */
+            if (dmin[l] < thresh || d[l] < thresh)
+                continue;
+            for (i = 0; i < s->max_topn; i++) {
+                /* already there, so don't need to insert */
+                if (topn[i].cw == cw)
+                    break;
+            }
+            if (i < s->max_topn)
+                continue;       /* already there.  Don't insert */
+            insertion_sort_cb(&cur, worst, best, cw, (int32)d[l]);
         }
-        if (i < s->max_topn)
-            continue;       /* already there.  Don't insert */
-        insertion_sort_cb(&cur, worst, best, cw, (int32)d);
     }
 
     return best->score;
 }
 
 /**
- * Compute top-N densities for active codebooks (and prune)
+ * Work shared out to the threads computing a frame's senone scores.
  */
-static int
-ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
+typedef struct ptm_mgau_job_s {
+    ptm_mgau_t *s;
+    mfcc_t **z;
+    int16 *senone_scores;
+    int32 n_sen;     /**< Number of senones to evaluate. */
+    int32 compall;   /**< Evaluate all senones? */
+    int32 topn_only; /**< Only re-evaluate the previous top-N? */
+} ptm_mgau_job_t;
+
+/*
+ * Run func on every part of a job, on all threads if there are any.
+ * Parts only write their own codebooks' top-N and their own senones'
+ * scores, so the results are the same with any number of threads.
+ */
+static void
+ptm_mgau_run(ptm_mgau_t *s, sbpool_func func, ptm_mgau_job_t *job)
 {
-    int i, j;
+    if (s->pool)
+        sbpool_run(s->pool, func, job);
+    else
+        (*func)(job, 0, 1);
+}
 
-    /* First evaluate top-N from previous frame. */
-    for (i = 0; i < s->g->n_mgau; ++i)
+/**
+ * Compute top-N densities for a part of the codebooks (and prune)
+ */
+static void
+ptm_mgau_codebook_eval_part(void *arg, int part, int n_part)
+{
+    ptm_mgau_job_t *job = arg;
+    ptm_mgau_t *s = job->s;
+    mfcc_t *dist = s->topn_dist + part * s->n_topn_dist;
+    int i, j, end;
+
+    end = sbpool_part_start(s->g->n_mgau, part + 1, n_part);
+    for (i = sbpool_part_start(s->g->n_mgau, part, n_part); i < end; ++i) {
+        /* First evaluate top-N from previous frame. */
         for (j = 0; j < s->g->n_feat; ++j)
-            eval_topn(s, i, j, z[j]);
+            eval_topn(s, i, j, job->z[j], dist);
 
-    /* If frame downsampling is in effect, possibly do nothing else. */
-    if (frame % s->ds_ratio)
-        return 0;
+        /* If frame downsampling is in effect, possibly do nothing else. */
+        if (job->topn_only)
+            continue;
 
-    /* Evaluate remaining codebooks. */
-    for (i = 0; i < s->g->n_mgau; ++i) {
+        /* Evaluate remaining codebooks. */
         if (bitvec_is_clear(s->f->mgau_active, i))
             continue;
         for (j = 0; j < s->g->n_feat; ++j) {
-            eval_cb(s, i, j, z[j]);
+            eval_cb(s, i, j, job->z[j]);
         }
     }
+}
+
+/**
+ * Compute top-N densities for active codebooks (and prune)
+ */
+static int
+ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
+{
+    ptm_mgau_job_t job;
+
+    job.s = s;
+    job.z = z;
+    job.topn_only = (frame % s->ds_ratio) != 0;
+    ptm_mgau_run(s, ptm_mgau_codebook_eval_part, &job);
     return 0;
 }
 
@@ -321,47 +318,33 @@ ptm_mgau_calc_cb_active(ptm_mgau_t *s, uint8 *senone_active,
 }
 
 /**
- * Compute senone scores from top-N densities for active codebooks.
+ * Compute senone scores from top-N densities for a part of the
+ * active senones.
  */
-static int
-ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
-                     uint8 *senone_active, int32 n_senone_active,
-                     int compall)
+static void
+ptm_mgau_senone_eval_part(void *arg, int part, int n_part)
 {
-    int i, lastsen, bestscore;
+    ptm_mgau_job_t *job = arg;
+    ptm_mgau_t *s = job->s;
+    int i, end, bestscore;
 
-    memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
     /* FIXME: This is the non-cache-efficient way to do this.  We want
      * to evaluate one codeword at a time but this requires us to have
      * a reverse codebook to senone mapping, which we don't have
      * (yet), since different codebooks have different top-N
      * codewords. */
-    if (compall)
-        n_senone_active = s->n_sen;
     bestscore = 0x7fffffff;
-    for (lastsen = i = 0; i < n_senone_active; ++i) {
+    end = sbpool_part_start(job->n_sen, part + 1, n_part);
+    for (i = sbpool_part_start(job->n_sen, part, n_part); i < end; ++i) {
         int sen, f, cb;
         int ascore;
 
-        if (compall)
+        if (job->compall)
             sen = i;
         else
-            sen = senone_active[i] + lastsen;
-        lastsen = sen;
+            sen = s->sen_active[i];
         cb = s->sen2cb[sen];
 
-        if (bitvec_is_clear(s->f->mgau_active, cb)) {
-            int j;
-            /* Because senone_active is deltas we can't really "knock
-             * out" senones from pruned codebooks, and in any case,
-             * it wouldn't make any difference to the search code,
-             * which doesn't expect senone_active to change. */
-            for (f = 0; f < s->g->n_feat; ++f) {
-                for (j = 0; j < s->max_topn; ++j) {
-                    s->f->topn[cb][f][j].score = MAX_NEG_ASCR;
-                }
-            }
-        }
         /* For each feature, log-sum codeword scores + mixw to get
          * feature density, then sum (multiply) to get ascore */
         ascore = 0;
@@ -391,7 +374,57 @@ ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
             ascore += fden;
         }
         if (ascore < bestscore) bestscore = ascore;
-        senone_scores[sen] = ascore;
+        job->senone_scores[sen] = ascore;
+    }
+    s->part_best[part] = bestscore;
+}
+
+/**
+ * Compute senone scores from top-N densities for active codebooks.
+ */
+static int
+ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
+                     uint8 *senone_active, int32 n_senone_active,
+                     int compall)
+{
+    ptm_mgau_job_t job;
+    int i, lastsen, bestscore, n_part;
+
+    memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
+    job.s = s;
+    job.senone_scores = senone_scores;
+    job.compall = compall;
+    job.n_sen = compall ? s->n_sen : n_senone_active;
+    for (lastsen = i = 0; i < job.n_sen; ++i) {
+        int sen, cb;
+
+        if (compall)
+            sen = i;
+        else
+            sen = s->sen_active[i] = senone_active[i] + lastsen;
+        lastsen = sen;
+        cb = s->sen2cb[sen];
+
+        if (bitvec_is_clear(s->f->mgau_active, cb)) {
+            int f, j;
+            /* Because senone_active is deltas we can't really "knock
+             * out" senones from pruned codebooks, and in any case,
+             * it wouldn't make any difference to the search code,
+             * which doesn't expect senone_active to change. */
+            for (f = 0; f < s->g->n_feat; ++f) {
+                for (j = 0; j < s->max_topn; ++j) {
+                    s->f->topn[cb][f][j].score = MAX_NEG_ASCR;
+                }
+            }
+        }
+    }
+    ptm_mgau_run(s, ptm_mgau_senone_eval_part, &job);
+
+    n_part = s->pool ? sbpool_size(s->pool) : 1;
+    bestscore = s->part_best[0];
+    for (i = 1; i < n_part; ++i) {
+        if (s->part_best[i] < bestscore)
+            bestscore = s->part_best[i];
     }
     /* Normalize the scores again (finishing the job we started above
      * in ptm_mgau_codebook_eval...) */
@@ -834,6 +867,21 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
     s->max_topn = cmd_ln_int32_r(s->config, "-topn");
     E_INFO("Maximum top-N: %d\n", s->max_topn);
 
+    /* Choose the density evaluation kernels. */
+    s->eval = tied_mgau_eval_init(s->g);
+    i = cmd_ln_int32_r(s->config, "-nthreads");
+    if (i > 1) {
+        E_INFO("Computing senone scores on %d threads\n", i);
+        if ((s->pool = sbpool_init(s->config, i)) == NULL)
+            goto error_out;
+    }
+    s->n_topn_dist = s->max_topn + s->eval->n_topn_lane;
+    s->topn_dist = ckd_calloc((s->pool ? sbpool_size(s->pool) : 1)
+                              * s->n_topn_dist, sizeof(*s->topn_dist));
+    s->part_best = ckd_calloc(s->pool ? sbpool_size(s->pool) : 1,
+                              sizeof(*s->part_best));
+    s->sen_active = ckd_calloc(s->n_sen, sizeof(*s->sen_active));
+
     /* Assume mapping of senones to their base phones, though this
      * will become more flexible in the future. */
     s->sen2cb = ckd_calloc(s->n_sen, sizeof(*s->sen2cb));
@@ -881,7 +929,11 @@ ptm_mgau_mllr_transform(ps_mgau_t *ps,
                             ps_mllr_t *mllr)
 {
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
-    return gauden_mllr_transform(s->g, mllr, s->config);
+    int rv;
+
+    if ((rv = gauden_mllr_transform(s->g, mllr, s->config)) == 0)
+        tied_mgau_eval_reload(s->eval, s->g);
+    return rv;
 }
 
 void
@@ -908,5 +960,10 @@ ptm_mgau_free(ps_mgau_t *ps)
     ckd_free(s->hist);
     
     gauden_free(s->g);
+    tied_mgau_eval_free(s->eval);
+    ckd_free(s->topn_dist);
+    ckd_free(s->part_best);
+    ckd_free(s->sen_active);
+    sbpool_free(s->pool);
     ckd_free(s);
 }
@@ -46,6 +46,7 @@
 #include <sphinxbase/fe.h>
 #include <sphinxbase/logmath.h>
 #include <sphinxbase/mmio.h>
+#include <sphinxbase/sbthread.h>
 
 /* Local headers. */
 #include "acmod.h"
@@ -77,6 +78,15 @@ struct ptm_mgau_s {
     int16 max_topn;
     int16 ds_ratio;
 
+    struct tied_mgau_eval_s *eval; /**< Density evaluation kernels. */
+    mfcc_t *topn_dist;       /**< Scores of the previous top-N densities,
+                                for each thread. */
+    int32 n_topn_dist;       /**< Size of each thread's topn_dist. */
+
+    sbpool_t *pool;          /**< Threads to compute scores on, or NULL. */
+    int32 *sen_active;       /**< Active senones. */
+    int32 *part_best;        /**< Best senone score in each part. */
+
     ptm_fast_eval_t *hist;   /**< Fast evaluation info for past frames. */
     ptm_fast_eval_t *f;      /**< Fast eval info for current frame. */
     int n_fast_hist;         /**< Number of past frames tracked. */
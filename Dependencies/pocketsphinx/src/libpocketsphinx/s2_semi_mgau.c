@@ -55,6 +55,14 @@
 #include <sphinxbase/bio.h>
 #include <sphinxbase/err.h>
 #include <sphinxbase/prim_type.h>
+#include <sphinxbase/simd.h>
+
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
 
 /* Local headers */
 #include "s2_semi_mgau.h"
@@ -64,7 +72,8 @@ static ps_mgaufuncs_t s2_semi_mgau_funcs = {
     "s2_semi",
     s2_semi_mgau_frame_eval,      /* frame_eval */
     s2_semi_mgau_mllr_transform,  /* transform */
-    s2_semi_mgau_free             /* free */
+    s2_semi_mgau_free,            /* free */
+    NULL                          /* frame_eval_batch */
 };
 
 struct vqFeature_s {
@@ -829,6 +838,310 @@ get_scores_4b_feat_all(s2_semi_mgau_t * s, int i, int topn, int16 *senone_scores
     return 0;
 }
 
+/*
+ * Vector mixture weight lookup.  The scores of S2_SEMI_BLK senones
+ * are computed together, in 16-bit lanes since log-adding the top-N
+ * can take them slightly below zero.  The 4-bit mixture weights are
+ * unpacked to nibbles and looked up in the scaled codebook (kept in
+ * 8 bits, like w_den above) with a byte shuffle, and so is the
+ * log-add table.  Only its first 32 entries are looked at, so these
+ * kernels are only used when the rest of the table is zero, which it
+ * is for any usable log base.  The scores are the same as those of
+ * the scalar code above.
+ */
+#define S2_DEFINE_MIXW(name, attr, vec_t, lut_t, n_vec,                 \
+                       LUT_INIT, LOAD, LOGADD, ACCUM)                    \
+static attr void                                                         \
+name(s2_semi_mgau_t *s, vqFeature_t const *f, int topn,                 \
+     int32 j, int32 n_blk, int16 *out)                                  \
+{                                                                        \
+    lut_t lut = LUT_INIT((uint8 const *)LOGMATH_TABLE(s->lmath_8b)->table); \
+    int32 b;                                                             \
+                                                                         \
+    for (b = 0; b < n_blk; ++b, j += S2_SEMI_BLK, out += S2_SEMI_BLK) {  \
+        vec_t acc[n_vec], w[n_vec];                                      \
+        int k, v;                                                        \
+                                                                         \
+        LOAD(s, f, 0, j, acc);                                           \
+        for (k = 1; k < topn; ++k) {                                     \
+            LOAD(s, f, k, j, w);                                         \
+            for (v = 0; v < n_vec; ++v)                                  \
+                acc[v] = LOGADD(acc[v], w[v], lut);                      \
+        }                                                                \
+        for (v = 0; v < n_vec; ++v)                                      \
+            ACCUM(out + v * (S2_SEMI_BLK / n_vec), acc[v]);              \
+    }                                                                    \
+}
+
+#ifdef SPHINX_HAVE_AVX2
+/* pshufb needs SSSE3, so on x86 only AVX2 is supported. */
+typedef struct s2_lut_avx2_s {
+    __m256i lo, hi;
+} s2_lut_avx2_t;
+
+static inline SIMD_TARGET_AVX2 s2_lut_avx2_t
+s2_lut_avx2(uint8 const *t)
+{
+    s2_lut_avx2_t lut;
+
+    lut.lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *)t));
+    lut.hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *)
+                                                         (t + 16)));
+    return lut;
+}
+
+static inline SIMD_TARGET_AVX2 __m256i
+s2_logadd_avx2(__m256i x, __m256i y, s2_lut_avx2_t lut)
+{
+    __m256i r, d, bias, t;
+
+    r = _mm256_min_epi16(x, y);
+    d = _mm256_min_epi16(_mm256_sub_epi16(_mm256_max_epi16(x, y), r),
+                         _mm256_set1_epi16(32));
+    /* Shuffle indices with the top bit set give zero.  Biasing the
+     * low byte of each lane by 0x70 (saturating) keeps only the
+     * indices below 16, and the high byte always gives zero. */
+    bias = _mm256_set1_epi16((short)0x8070);
+    t = _mm256_or_si256(_mm256_shuffle_epi8(lut.lo,
+                                            _mm256_adds_epu8(d, bias)),
+                        _mm256_shuffle_epi8(lut.hi, _mm256_adds_epu8
+                                            (_mm256_sub_epi8
+                                             (d, _mm256_set1_epi16(16)),
+                                             bias)));
+    return _mm256_sub_epi16(r, t);
+}
+
+static inline SIMD_TARGET_AVX2 void
+s2_load_4b_avx2(s2_semi_mgau_t *s, vqFeature_t const *f,
+                int k, int32 j, __m256i *w)
+{
+    __m128i b, lo, hi, wden;
+
+    b = _mm_loadu_si128((__m128i const *)(s->topn_mixw[k] + j / 2));
+    lo = _mm_and_si128(b, _mm_set1_epi8(0x0f));
+    hi = _mm_and_si128(_mm_srli_epi16(b, 4), _mm_set1_epi8(0x0f));
+    wden = _mm_loadu_si128((__m128i const *)(s->topn_wden + k * 16));
+    /* Even senones are in the low nibbles. */
+    w[0] = _mm256_cvtepu8_epi16(_mm_shuffle_epi8(wden,
+                                                 _mm_unpacklo_epi8(lo, hi)));
+    w[1] = _mm256_cvtepu8_epi16(_mm_shuffle_epi8(wden,
+                                                 _mm_unpackhi_epi8(lo, hi)));
+}
+
+static inline SIMD_TARGET_AVX2 void
+s2_load_8b_avx2(s2_semi_mgau_t *s, vqFeature_t const *f,
+                int k, int32 j, __m256i *w)
+{
+    __m256i score = _mm256_set1_epi16(f[k].score);
+    uint8 const *p = s->topn_mixw[k] + j;
+
+    w[0] = _mm256_add_epi16(_mm256_cvtepu8_epi16
+                            (_mm_loadu_si128((__m128i const *)p)), score);
+    w[1] = _mm256_add_epi16(_mm256_cvtepu8_epi16
+                            (_mm_loadu_si128((__m128i const *)(p + 16))),
+                            score);
+}
+
+static inline SIMD_TARGET_AVX2 void
+s2_accum_avx2(int16 *out, __m256i v)
+{
+    _mm256_storeu_si256((__m256i *)out,
+                        _mm256_add_epi16(_mm256_loadu_si256((__m256i *)out),
+                                         v));
+}
+
+S2_DEFINE_MIXW(mixw_4b_avx2, SIMD_TARGET_AVX2, __m256i, s2_lut_avx2_t, 2,
+               s2_lut_avx2, s2_load_4b_avx2, s2_logadd_avx2, s2_accum_avx2)
+S2_DEFINE_MIXW(mixw_8b_avx2, SIMD_TARGET_AVX2, __m256i, s2_lut_avx2_t, 2,
+               s2_lut_avx2, s2_load_8b_avx2, s2_logadd_avx2, s2_accum_avx2)
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+static inline uint8x16x2_t
+s2_lut_neon(uint8 const *t)
+{
+    uint8x16x2_t lut;
+
+    lut.val[0] = vld1q_u8(t);
+    lut.val[1] = vld1q_u8(t + 16);
+    return lut;
+}
+
+static inline int16x8_t
+s2_logadd_neon(int16x8_t x, int16x8_t y, uint8x16x2_t lut)
+{
+    uint16x8_t d;
+
+    /* Table indices from 32 on give zero, so setting the high byte
+     * of each lane zeroes it. */
+    d = vminq_u16(vreinterpretq_u16_s16(vabdq_s16(x, y)), vdupq_n_u16(32));
+    d = vorrq_u16(d, vdupq_n_u16(0xff00));
+    return vsubq_s16(vminq_s16(x, y),
+                     vreinterpretq_s16_u8(vqtbl2q_u8
+                                          (lut, vreinterpretq_u8_u16(d))));
+}
+
+static inline void
+s2_load_4b_neon(s2_semi_mgau_t *s, vqFeature_t const *f,
+                int k, int32 j, int16x8_t *w)
+{
+    uint8x16_t b, lo, hi, wden, v0, v1;
+
+    b = vld1q_u8(s->topn_mixw[k] + j / 2);
+    lo = vandq_u8(b, vdupq_n_u8(0x0f));
+    hi = vshrq_n_u8(b, 4);
+    wden = vld1q_u8(s->topn_wden + k * 16);
+    /* Even senones are in the low nibbles. */
+    v0 = vqtbl1q_u8(wden, vzip1q_u8(lo, hi));
+    v1 = vqtbl1q_u8(wden, vzip2q_u8(lo, hi));
+    w[0] = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v0)));
+    w[1] = vreinterpretq_s16_u16(vmovl_high_u8(v0));
+    w[2] = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v1)));
+    w[3] = vreinterpretq_s16_u16(vmovl_high_u8(v1));
+}
+
+static inline void
+s2_load_8b_neon(s2_semi_mgau_t *s, vqFeature_t const *f,
+                int k, int32 j, int16x8_t *w)
+{
+    int16x8_t score = vdupq_n_s16(f[k].score);
+    uint8x16_t v0, v1;
+
+    v0 = vld1q_u8(s->topn_mixw[k] + j);
+    v1 = vld1q_u8(s->topn_mixw[k] + j + 16);
+    w[0] = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v0))), score);
+    w[1] = vaddq_s16(vreinterpretq_s16_u16(vmovl_high_u8(v0)), score);
+    w[2] = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v1))), score);
+    w[3] = vaddq_s16(vreinterpretq_s16_u16(vmovl_high_u8(v1)), score);
+}
+
+#define S2_NEON_ACCUM(out, v) vst1q_s16(out, vaddq_s16(vld1q_s16(out), v))
+S2_DEFINE_MIXW(mixw_4b_neon, , int16x8_t, uint8x16x2_t, 4, s2_lut_neon,
+               s2_load_4b_neon, s2_logadd_neon, S2_NEON_ACCUM)
+S2_DEFINE_MIXW(mixw_8b_neon, , int16x8_t, uint8x16x2_t, 4, s2_lut_neon,
+               s2_load_8b_neon, s2_logadd_neon, S2_NEON_ACCUM)
+#endif /* SPHINX_HAVE_NEON */
+
+/* Fewest active senones in a block for it to be scored as a whole. */
+#define S2_SEMI_MIN_ACTIVE 4
+
+static s2_semi_mixw_f
+mixw_eval_select(s2_semi_mgau_t *s)
+{
+    uint8 const *t = (uint8 const *)LOGMATH_TABLE(s->lmath_8b)->table;
+    uint32 simd, size, i;
+
+    logmath_get_table_shape(s->lmath_8b, &size, NULL, NULL);
+    for (i = 32; i < size; ++i)
+        if (t[i])
+            return NULL;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON)
+        return s->mixw_cb ? mixw_4b_neon : mixw_8b_neon;
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2)
+        return s->mixw_cb ? mixw_4b_avx2 : mixw_8b_avx2;
+#endif
+    (void)simd;
+    return NULL;
+}
+
+/*
+ * Score one senone from the top-N tables, for the senones the vector
+ * kernels leave out.
+ */
+static int32
+get_scores_topn_sen(s2_semi_mgau_t *s, vqFeature_t const *f, int topn,
+                    int n)
+{
+    int32 tmp;
+    int k;
+
+    if (s->mixw_cb) {
+        int shift = (n & 1) ? 4 : 0;
+
+        tmp = s->topn_wden[(s->topn_mixw[0][n/2] >> shift) & 0x0f];
+        for (k = 1; k < topn; ++k) {
+            int cw = (s->topn_mixw[k][n/2] >> shift) & 0x0f;
+            tmp = fast_logmath_add(s->lmath_8b, tmp,
+                                   s->topn_wden[k * 16 + cw]);
+        }
+    }
+    else {
+        tmp = s->topn_mixw[0][n] + f[0].score;
+        for (k = 1; k < topn; ++k)
+            tmp = fast_logmath_add(s->lmath_8b, tmp,
+                                   s->topn_mixw[k][n] + f[k].score);
+    }
+    return tmp;
+}
+
+static int32
+get_scores_vec(s2_semi_mgau_t * s, int i, int topn,
+               int16 *senone_scores, uint8 *senone_active,
+               int32 n_senone_active, int32 compallsen)
+{
+    vqFeature_t const *f = s->f[i];
+    int32 j, k, l, b, e, n_blk, n_sen;
+
+    for (k = 0; k < topn; ++k) {
+        s->topn_mixw[k] = s->mixw[i][f[k].codeword];
+        if (s->mixw_cb) {
+            for (j = 0; j < 16; ++j)
+                s->topn_wden[k * 16 + j] = s->mixw_cb[j] + f[k].score;
+        }
+    }
+
+    /* Rows of the sendump may be memory-mapped back to back, so
+     * the kernels only read whole blocks. */
+    n_blk = s->n_sen / S2_SEMI_BLK;
+    if (compallsen) {
+        s->mixw_eval(s, f, topn, 0, n_blk, senone_scores);
+        /* The 4-bit code has always skipped an odd last senone. */
+        n_sen = s->mixw_cb ? (s->n_sen & ~1) : s->n_sen;
+        for (j = n_blk * S2_SEMI_BLK; j < n_sen; ++j)
+            senone_scores[j] += get_scores_topn_sen(s, f, topn, j);
+        return 0;
+    }
+
+    /* Count the active senones in each block, and score each run of
+     * blocks with enough of them with one call.  It is cheaper to
+     * score a few scattered senones one by one. */
+    n_sen = n_blk * S2_SEMI_BLK;
+    memset(s->blk_n_active, 0, n_blk);
+    for (l = j = 0; j < n_senone_active; j++) {
+        l += senone_active[j];
+        if (l < n_sen)
+            ++s->blk_n_active[l / S2_SEMI_BLK];
+    }
+    for (b = 0; b < n_blk; b = e) {
+        if (s->blk_n_active[b] < S2_SEMI_MIN_ACTIVE) {
+            e = b + 1;
+            continue;
+        }
+        for (e = b + 1; e < n_blk
+                 && s->blk_n_active[e] >= S2_SEMI_MIN_ACTIVE; ++e)
+            ;
+        memset(s->blk_scores + b * S2_SEMI_BLK, 0,
+               (e - b) * S2_SEMI_BLK * sizeof(*s->blk_scores));
+        s->mixw_eval(s, f, topn, b * S2_SEMI_BLK, e - b,
+                     s->blk_scores + b * S2_SEMI_BLK);
+    }
+    for (l = j = 0; j < n_senone_active; j++) {
+        int32 n = senone_active[j] + l;
+
+        if (n < n_sen
+            && s->blk_n_active[n / S2_SEMI_BLK] >= S2_SEMI_MIN_ACTIVE)
+            senone_scores[n] += s->blk_scores[n];
+        else
+            senone_scores[n] += get_scores_topn_sen(s, f, topn, n);
+        l = n;
+    }
+    return 0;
+}
+
 /*
  * Compute senone scores for the active senones.
  */
@@ -862,7 +1175,15 @@ s2_semi_mgau_frame_eval(ps_mgau_t *ps,
             mgau_dist(s, frame, i, featbuf[i]);
             s->topn_hist_n[topn_idx][i] = mgau_norm(s, i);
         }
-        if (s->mixw_cb) {
+        /* The vector kernels score whole blocks of senones, which
+         * does not pay off for short active lists. */
+        if (s->mixw_eval
+            && (compallsen || n_senone_active * S2_SEMI_BLK
+                >= s->n_sen * S2_SEMI_MIN_ACTIVE)) {
+            get_scores_vec(s, i, s->topn_hist_n[topn_idx][i], senone_scores,
+                           senone_active, n_senone_active, compallsen);
+        }
+        else if (s->mixw_cb) {
             if (compallsen)
                 get_scores_4b_feat_all(s, i, s->topn_hist_n[topn_idx][i], senone_scores);
             else
@@ -1298,6 +1619,12 @@ s2_semi_mgau_init(acmod_t *acmod)
     }
     E_INFOCONT("\n");
 
+    s->mixw_eval = mixw_eval_select(s);
+    s->topn_mixw = ckd_calloc(s->max_topn, sizeof(*s->topn_mixw));
+    s->topn_wden = ckd_calloc(s->max_topn, 16);
+    s->blk_n_active = ckd_calloc(s->n_sen / S2_SEMI_BLK + 1, 1);
+    s->blk_scores = ckd_calloc(s->n_sen, sizeof(*s->blk_scores));
+
     /* Top-N scores from recent frames */
     s->n_topn_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
     s->topn_hist = (vqFeature_t ***)
@@ -1350,6 +1677,10 @@ s2_semi_mgau_free(ps_mgau_t *ps)
     }
     gauden_free(s->g);
     ckd_free(s->topn_beam);
+    ckd_free(s->topn_mixw);
+    ckd_free(s->topn_wden);
+    ckd_free(s->blk_n_active);
+    ckd_free(s->blk_scores);
     ckd_free_2d(s->topn_hist_n);
     ckd_free_3d((void **)s->topn_hist);
     ckd_free(s);
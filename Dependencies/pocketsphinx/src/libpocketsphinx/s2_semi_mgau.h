@@ -56,6 +56,21 @@
 typedef struct vqFeature_s vqFeature_t;
 
 typedef struct s2_semi_mgau_s s2_semi_mgau_t;
+
+/** Number of senones scored together by the vector kernels. */
+#define S2_SEMI_BLK 32
+
+/**
+ * Add the mixture weight part of the senone scores for one feature
+ * stream to out, for n_blk blocks of S2_SEMI_BLK senones starting at
+ * senone j.  The mixture weights of the top-N codewords f (and, for
+ * 4-bit sendumps, their scaled codebooks) are in
+ * s2_semi_mgau_t::topn_mixw and s2_semi_mgau_t::topn_wden.
+ */
+typedef void (*s2_semi_mixw_f)(s2_semi_mgau_t *s, vqFeature_t const *f,
+                               int topn, int32 j, int32 n_blk,
+                               int16 *out);
+
 struct s2_semi_mgau_s {
     ps_mgau_t base;     /**< base structure. */
     cmd_ln_t *config;   /* configuration parameters */
@@ -76,6 +91,12 @@ struct s2_semi_mgau_s {
     vqFeature_t **f;          /**< Topn-N for currently scoring frame. */
     int n_topn_hist;          /**< Number of past frames tracked. */
 
+    s2_semi_mixw_f mixw_eval; /**< Vector mixture weight kernel, or NULL. */
+    uint8 **topn_mixw;        /**< Mixture weights of the top-N codewords. */
+    uint8 *topn_wden;         /**< mixw_cb scaled by each top-N score. */
+    uint8 *blk_n_active;      /**< Number of active senones in each block. */
+    int16 *blk_scores;        /**< Scores of the active blocks. */
+
     /* Log-add table for compressed values. */
     logmath_t *lmath_8b;
     /* Log-add object for reloading means/variances. */
@@ -295,7 +295,8 @@ state_align_search_init(const char *name,
 		   PS_SEARCH_TYPE_STATE_ALIGN, name,
                    config, acmod, al->d2p->dict, al->d2p);
     sas->hmmctx = hmm_context_init(bin_mdef_n_emit_state(acmod->mdef),
-                                   acmod->tmat->tp, NULL, acmod->mdef->sseq);
+                                   acmod->tmat->tp, acmod->tmat->n_tmat,
+                                   NULL, acmod->mdef->sseq);
     if (sas->hmmctx == NULL) {
         ckd_free(sas);
         return NULL;
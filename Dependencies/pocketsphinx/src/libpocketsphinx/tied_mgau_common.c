@@ -0,0 +1,344 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * This file was written for the OpenEars copy of PocketSphinx.  It may be
+ * used and redistributed under the same conditions as the Carnegie
+ * Mellon University files alongside it.
+ * ====================================================================
+ */
+
+/**
+ * @file tied_mgau_common.c
+ * @brief Vector density evaluation for SC and PTM (tied-state) models.
+ *
+ * The kernels compute exactly what the scalar loops in
+ * s2_semi_mgau.c and ptm_mgau.c did: every density is still scored
+ * one dimension at a time, in order, and the vector lanes hold
+ * different densities.  This also keeps the scalar pruning checks,
+ * since a lane only needs to remember the lowest score it had at any
+ * of them.
+ */
+
+#include <string.h>
+#include <limits.h>
+
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/simd.h>
+
+#ifdef SPHINX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+#include "tied_mgau_common.h"
+
+/* Add dimension k of a block of densities to their scores d. */
+#define TMG_DEFINE_EVAL_DIM(name, attr, vec_t, width, LOAD, SET1,      \
+                            SUB, MUL, GSUB)                             \
+    static inline attr vec_t                                            \
+    name(vec_t d, mfcc_t const *obs, mfcc_t const *mean,                \
+         mfcc_t const *var, int32 k)                                    \
+    {                                                                   \
+        vec_t diff = SUB(SET1(obs[k]), LOAD(mean + k * (width)));       \
+        return GSUB(d, MUL(MUL(diff, diff), LOAD(var + k * (width))));  \
+    }
+
+#define TMG_DEFINE_EVAL_CB(name, attr, vec_t, width, LOAD, STORE, SET1,  \
+                           SUB, MUL, GSUB, MIN, ALL_LT)                 \
+    TMG_DEFINE_EVAL_DIM(name##_dim, attr, vec_t, width, LOAD, SET1,    \
+                        SUB, MUL, GSUB)                                 \
+    static attr int32                                                   \
+    name(mfcc_t const *mean, mfcc_t const *var, mfcc_t const *det,      \
+         mfcc_t const *obs, int32 ceplen, int32 step, mfcc_t thresh,    \
+         int32 b, int32 n_block, mfcc_t *out_d, mfcc_t *out_dmin)       \
+    {                                                                   \
+        vec_t th = SET1(thresh);                                        \
+        int32 r = ceplen % step;                                        \
+                                                                        \
+        mean += b * ceplen * (width);                                   \
+        var += b * ceplen * (width);                                    \
+        for (; b < n_block; ++b) {                                      \
+            vec_t d = LOAD(det + b * (width)), dmin = d;                \
+            int32 j, k;                                                 \
+                                                                        \
+            for (j = 0; j < ceplen; j += k) {                           \
+                dmin = MIN(dmin, d);                                    \
+                if (ALL_LT(dmin, th))                                   \
+                    break;                                              \
+                if (j >= r && step == 4) {                              \
+                    /* Unrolled for PTM models. */                      \
+                    d = name##_dim(d, obs + j, mean, var, 0);           \
+                    d = name##_dim(d, obs + j, mean, var, 1);           \
+                    d = name##_dim(d, obs + j, mean, var, 2);           \
+                    d = name##_dim(d, obs + j, mean, var, 3);           \
+                    k = 4;                                              \
+                }                                                       \
+                else {                                                  \
+                    for (k = 0; k < ((j < r) ? 1 : step); ++k)          \
+                        d = name##_dim(d, obs + j, mean, var, k);       \
+                }                                                       \
+                mean += k * (width);                                    \
+                var += k * (width);                                     \
+            }                                                           \
+            if (j == ceplen) {                                          \
+                STORE(out_d, d);                                        \
+                STORE(out_dmin, dmin);                                  \
+                return b;                                               \
+            }                                                           \
+            mean += (ceplen - j) * (width);                             \
+            var += (ceplen - j) * (width);                              \
+        }                                                               \
+        return n_block;                                                 \
+    }
+
+#define TMG_DEFINE_EVAL_TOPN(name, attr, vec_t, width, LOAD, STORE,    \
+                             SET1, GATHER, SUB, MUL, GSUB)              \
+    static attr void                                                    \
+    name(mfcc_t const **mean, mfcc_t const **var, mfcc_t const *det,    \
+         mfcc_t const *obs, int32 ceplen, mfcc_t *out_d)                \
+    {                                                                   \
+        vec_t d = LOAD(det), diff;                                      \
+        int32 j;                                                        \
+                                                                        \
+        for (j = 0; j < ceplen; ++j) {                                  \
+            diff = SUB(SET1(obs[j]), GATHER(mean, j));                  \
+            d = GSUB(d, MUL(MUL(diff, diff), GATHER(var, j)));          \
+        }                                                               \
+        STORE(out_d, d);                                                \
+    }
+
+#define TMG_SCALAR_LOAD(p) (*(p))
+#define TMG_SCALAR_STORE(p, v) (*(p) = (v))
+#define TMG_SCALAR_SET1(x) (x)
+#define TMG_SCALAR_GATHER(p, j) ((p)[0][j])
+#define TMG_SCALAR_SUB(a, b) ((a) - (b))
+#define TMG_SCALAR_MUL(a, b) MFCCMUL(a, b)
+/* With one density per block, the first check it fails ends the
+ * block, so the last score checked is also the lowest. */
+#define TMG_SCALAR_MIN(a, b) (b)
+#define TMG_SCALAR_ALL_LT(a, b) ((a) < (b))
+TMG_DEFINE_EVAL_CB(eval_cb, , mfcc_t, 1, TMG_SCALAR_LOAD, TMG_SCALAR_STORE,
+                   TMG_SCALAR_SET1, TMG_SCALAR_SUB, TMG_SCALAR_MUL, GMMSUB,
+                   TMG_SCALAR_MIN, TMG_SCALAR_ALL_LT)
+TMG_DEFINE_EVAL_TOPN(eval_topn, , mfcc_t, 1, TMG_SCALAR_LOAD,
+                     TMG_SCALAR_STORE, TMG_SCALAR_SET1, TMG_SCALAR_GATHER,
+                     TMG_SCALAR_SUB, TMG_SCALAR_MUL, GMMSUB)
+
+#ifdef FIXED_POINT
+/*
+ * MFCCMUL() keeps bits DEFAULT_RADIX..DEFAULT_RADIX+31 of the 64-bit
+ * product, and GMMSUB() saturates to INT_MIN if b is negative or a - b
+ * would underflow (tested as a < INT_MIN + b, which cannot wrap for
+ * b >= 0).  SSE2 has no signed
+ * 32x32->64 multiply, so on x86 only AVX2 (which also provides the
+ * SSE4.1 128-bit operations used by eval_topn) is supported.
+ */
+#ifdef SPHINX_HAVE_AVX2
+static inline SIMD_TARGET_AVX2 __m256i
+tmg_fixmul_avx2(__m256i a, __m256i b)
+{
+    __m256i even, odd;
+
+    even = _mm256_mul_epi32(a, b);
+    odd = _mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                           _mm256_srli_epi64(b, 32));
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, DEFAULT_RADIX),
+                              _mm256_slli_epi64(odd, 32 - DEFAULT_RADIX),
+                              0xaa);
+}
+static inline SIMD_TARGET_AVX2 __m256i
+tmg_gmmsub_avx2(__m256i a, __m256i b)
+{
+    __m256i sat = _mm256_set1_epi32(INT_MIN);
+    __m256i under = _mm256_or_si256
+        (_mm256_cmpgt_epi32(_mm256_setzero_si256(), b),
+         _mm256_cmpgt_epi32(_mm256_add_epi32(sat, b), a));
+    return _mm256_blendv_epi8(_mm256_sub_epi32(a, b), sat, under);
+}
+static inline SIMD_TARGET_AVX2 int
+tmg_all_lt_avx2(__m256i a, __m256i b)
+{
+    return _mm256_movemask_ps(_mm256_castsi256_ps
+                              (_mm256_cmpgt_epi32(b, a))) == 0xff;
+}
+#define TMG_AVX2_LOAD(p) _mm256_loadu_si256((__m256i const *)(p))
+#define TMG_AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+TMG_DEFINE_EVAL_CB(eval_cb_avx2, SIMD_TARGET_AVX2, __m256i, 8,
+                   TMG_AVX2_LOAD, TMG_AVX2_STORE, _mm256_set1_epi32,
+                   _mm256_sub_epi32, tmg_fixmul_avx2, tmg_gmmsub_avx2,
+                   _mm256_min_epi32, tmg_all_lt_avx2)
+
+static inline SIMD_TARGET_AVX2 __m128i
+tmg_fixmul_sse4(__m128i a, __m128i b)
+{
+    __m128i even, odd;
+
+    even = _mm_mul_epi32(a, b);
+    odd = _mm_mul_epi32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_blend_epi32(_mm_srli_epi64(even, DEFAULT_RADIX),
+                           _mm_slli_epi64(odd, 32 - DEFAULT_RADIX), 0xa);
+}
+static inline SIMD_TARGET_AVX2 __m128i
+tmg_gmmsub_sse4(__m128i a, __m128i b)
+{
+    __m128i sat = _mm_set1_epi32(INT_MIN);
+    __m128i under = _mm_or_si128(_mm_cmpgt_epi32(_mm_setzero_si128(), b),
+                                 _mm_cmpgt_epi32(_mm_add_epi32(sat, b), a));
+    return _mm_blendv_epi8(_mm_sub_epi32(a, b), sat, under);
+}
+#define TMG_SSE4_GATHER(p, j) \
+    _mm_setr_epi32((p)[0][j], (p)[1][j], (p)[2][j], (p)[3][j])
+#define TMG_SSE4_LOAD(p) _mm_loadu_si128((__m128i const *)(p))
+#define TMG_SSE4_STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+TMG_DEFINE_EVAL_TOPN(eval_topn_avx2, SIMD_TARGET_AVX2, __m128i, 4,
+                     TMG_SSE4_LOAD, TMG_SSE4_STORE, _mm_set1_epi32,
+                     TMG_SSE4_GATHER, _mm_sub_epi32, tmg_fixmul_sse4,
+                     tmg_gmmsub_sse4)
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+static inline int32x4_t
+tmg_fixmul_neon(int32x4_t a, int32x4_t b)
+{
+    return vcombine_s32(vshrn_n_s64(vmull_s32(vget_low_s32(a),
+                                              vget_low_s32(b)),
+                                    DEFAULT_RADIX),
+                        vshrn_n_s64(vmull_high_s32(a, b), DEFAULT_RADIX));
+}
+static inline int32x4_t
+tmg_gmmsub_neon(int32x4_t a, int32x4_t b)
+{
+    int32x4_t sat = vdupq_n_s32(INT_MIN);
+    uint32x4_t under = vorrq_u32(vcltq_s32(b, vdupq_n_s32(0)),
+                                 vcgtq_s32(vaddq_s32(sat, b), a));
+    return vbslq_s32(under, sat, vsubq_s32(a, b));
+}
+static inline int32x4_t
+tmg_gather_neon(mfcc_t const **p, int32 j)
+{
+    mfcc_t v[4];
+
+    v[0] = p[0][j];
+    v[1] = p[1][j];
+    v[2] = p[2][j];
+    v[3] = p[3][j];
+    return vld1q_s32(v);
+}
+#define TMG_NEON_ALL_LT(a, b) (vminvq_u32(vcltq_s32(a, b)) != 0)
+TMG_DEFINE_EVAL_CB(eval_cb_neon, , int32x4_t, 4, vld1q_s32, vst1q_s32,
+                   vdupq_n_s32, vsubq_s32, tmg_fixmul_neon, tmg_gmmsub_neon,
+                   vminq_s32, TMG_NEON_ALL_LT)
+TMG_DEFINE_EVAL_TOPN(eval_topn_neon, , int32x4_t, 4, vld1q_s32, vst1q_s32,
+                     vdupq_n_s32, tmg_gather_neon, vsubq_s32,
+                     tmg_fixmul_neon, tmg_gmmsub_neon)
+#endif /* SPHINX_HAVE_NEON */
+
+#else /* !FIXED_POINT */
+
+/* Separate multiplies and subtracts (no FMA) round like the scalar
+ * code. */
+#ifdef SPHINX_HAVE_SSE2
+#define TMG_HAVE_SSE2 1
+#define TMG_SSE2_GATHER(p, j) \
+    _mm_setr_ps((p)[0][j], (p)[1][j], (p)[2][j], (p)[3][j])
+#define TMG_SSE2_ALL_LT(a, b) (_mm_movemask_ps(_mm_cmplt_ps(a, b)) == 0xf)
+TMG_DEFINE_EVAL_CB(eval_cb_sse2, , __m128, 4, _mm_loadu_ps, _mm_storeu_ps,
+                   _mm_set1_ps, _mm_sub_ps, _mm_mul_ps, _mm_sub_ps,
+                   _mm_min_ps, TMG_SSE2_ALL_LT)
+TMG_DEFINE_EVAL_TOPN(eval_topn_sse2, , __m128, 4, _mm_loadu_ps,
+                     _mm_storeu_ps, _mm_set1_ps, TMG_SSE2_GATHER,
+                     _mm_sub_ps, _mm_mul_ps, _mm_sub_ps)
+#endif /* SPHINX_HAVE_SSE2 */
+
+#ifdef SPHINX_HAVE_AVX2
+#define TMG_AVX2_ALL_LT(a, b) \
+    (_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)) == 0xff)
+TMG_DEFINE_EVAL_CB(eval_cb_avx2, SIMD_TARGET_AVX2, __m256, 8,
+                   _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps,
+                   _mm256_sub_ps, _mm256_mul_ps, _mm256_sub_ps,
+                   _mm256_min_ps, TMG_AVX2_ALL_LT)
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+static inline float32x4_t
+tmg_gather_neon(mfcc_t const **p, int32 j)
+{
+    mfcc_t v[4];
+
+    v[0] = p[0][j];
+    v[1] = p[1][j];
+    v[2] = p[2][j];
+    v[3] = p[3][j];
+    return vld1q_f32(v);
+}
+#define TMG_NEON_ALL_LT(a, b) (vminvq_u32(vcltq_f32(a, b)) != 0)
+TMG_DEFINE_EVAL_CB(eval_cb_neon, , float32x4_t, 4, vld1q_f32, vst1q_f32,
+                   vdupq_n_f32, vsubq_f32, vmulq_f32, vsubq_f32,
+                   vminq_f32, TMG_NEON_ALL_LT)
+TMG_DEFINE_EVAL_TOPN(eval_topn_neon, , float32x4_t, 4, vld1q_f32,
+                     vst1q_f32, vdupq_n_f32, tmg_gather_neon, vsubq_f32,
+                     vmulq_f32, vsubq_f32)
+#endif /* SPHINX_HAVE_NEON */
+
+#endif /* !FIXED_POINT */
+
+tied_mgau_eval_t *
+tied_mgau_eval_init(gauden_t *g)
+{
+    tied_mgau_eval_t *e;
+    uint32 simd;
+
+    /* gauden_init() chose the block size with the same rules, so
+     * the codebooks are already laid out for these kernels. */
+    e = ckd_calloc(1, sizeof(*e));
+    e->n_topn_lane = 1;
+    e->eval_cb = eval_cb;
+    e->eval_topn = eval_topn;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON) {
+        e->n_topn_lane = 4;
+        e->eval_cb = eval_cb_neon;
+        e->eval_topn = eval_topn_neon;
+    }
+#endif
+#ifdef TMG_HAVE_SSE2
+    if (simd & SIMD_SSE2) {
+        e->n_topn_lane = 4;
+        e->eval_cb = eval_cb_sse2;
+        e->eval_topn = eval_topn_sse2;
+    }
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2) {
+        e->eval_cb = eval_cb_avx2;
+#ifdef FIXED_POINT
+        e->n_topn_lane = 4;
+        e->eval_topn = eval_topn_avx2;
+#endif
+    }
+#endif
+    tied_mgau_eval_reload(e, g);
+
+    return e;
+}
+
+void
+tied_mgau_eval_reload(tied_mgau_eval_t *e, gauden_t *g)
+{
+    e->n_lane = g->n_lane;
+    e->n_block = g->n_block;
+    e->mean = g->blk_mean;
+    e->var = g->blk_var;
+    e->det = g->blk_det;
+}
+
+void
+tied_mgau_eval_free(tied_mgau_eval_t *e)
+{
+    ckd_free(e);
+}
@@ -46,15 +46,22 @@
 #include <sphinxbase/logmath.h>
 #include <sphinxbase/fixpoint.h>
 
+#include "ms_gauden.h"
+
 #define MGAU_MIXW_VERSION	"1.0"   /* Sphinx-3 file format version for mixw */
 #define MGAU_PARAM_VERSION	"1.0"   /* Sphinx-3 file format version for mean/var */
 #define NONE		-1
 #define WORST_DIST	(int32)(0x80000000)
 
-/** Subtract GMM component b (assumed to be positive) and saturate */
+/**
+ * Subtract GMM component b (assumed to be positive) and saturate.
+ * A negative b can only come from a product that overflowed, so it
+ * saturates as well.  Nothing here may overflow: the vector kernels in
+ * tied_mgau_common.c compute exactly the same thing.
+ */
 #ifdef FIXED_POINT
 #define GMMSUB(a,b) \
-	(((a)-(b) > a) ? (INT_MIN) : ((a)-(b)))
+	(((b) < 0 || (a) < INT_MIN + (b)) ? (INT_MIN) : ((a)-(b)))
 /** Add GMM component b (assumed to be positive) and saturate */
 #define GMMADD(a,b) \
 	(((a)+(b) < a) ? (INT_MAX) : ((a)+(b)))
@@ -118,4 +125,71 @@ fast_logmath_add(logmath_t *lmath, int mlx, int mly)
     return r - (((uint8 *)t->table)[d]);
 }
 
+/** Largest number of densities evaluated together by a kernel. */
+#define TIED_MGAU_MAX_LANE 8
+
+/**
+ * Find the next block of densities of one codebook and feature
+ * stream that survives pruning against a feature vector.
+ *
+ * The densities are stored in blocks of n_lane whose parameters are
+ * interleaved (see gauden_t::blk_mean), so
+ * mean[(b * ceplen + j) * n_lane + l] is dimension j of density
+ * b * n_lane + l.  Pruning is checked before dimensions
+ * j < ceplen % step and before every step dimensions after that, as
+ * in the scalar loops of the tied-mixture models.  A block survives
+ * unless every density in it falls below thresh at one of these
+ * checks.  For the surviving block, d holds the final scores, and
+ * dmin the lowest score each density had at a check (or any score
+ * below thresh, if it fell below it).
+ *
+ * @return the index of the first surviving block from b onwards, or
+ * n_block if there is none.
+ */
+typedef int32 (*tied_mgau_eval_cb_f)(mfcc_t const *mean, mfcc_t const *var,
+                                     mfcc_t const *det, mfcc_t const *obs,
+                                     int32 ceplen, int32 step,
+                                     mfcc_t thresh, int32 b, int32 n_block,
+                                     mfcc_t *d, mfcc_t *dmin);
+
+/**
+ * Evaluate n_topn_lane arbitrary densities (given by pointers to
+ * their mean and variance vectors) against a feature vector, without
+ * pruning.
+ */
+typedef void (*tied_mgau_eval_topn_f)(mfcc_t const **mean,
+                                      mfcc_t const **var,
+                                      mfcc_t const *det, mfcc_t const *obs,
+                                      int32 ceplen, mfcc_t *d);
+
+/**
+ * Density evaluation kernels, selected at initialization, and the
+ * blocked codebooks of the gauden_t they work on.
+ */
+typedef struct tied_mgau_eval_s {
+    int32 n_lane;       /**< Densities per block for eval_cb. */
+    int32 n_block;      /**< Blocks per codebook and stream. */
+    int32 n_topn_lane;  /**< Densities evaluated together by eval_topn. */
+    mfcc_t ***mean;     /**< gauden_t::blk_mean */
+    mfcc_t ***var;      /**< gauden_t::blk_var */
+    mfcc_t ***det;      /**< gauden_t::blk_det */
+    tied_mgau_eval_cb_f eval_cb;
+    tied_mgau_eval_topn_f eval_topn;
+} tied_mgau_eval_t;
+
+/**
+ * Select the kernels for this machine, for the densities in g.
+ */
+tied_mgau_eval_t *tied_mgau_eval_init(gauden_t *g);
+
+/**
+ * Point at the densities in g again, after they were changed (by MLLR).
+ */
+void tied_mgau_eval_reload(tied_mgau_eval_t *e, gauden_t *g);
+
+/**
+ * Free the kernels.
+ */
+void tied_mgau_eval_free(tied_mgau_eval_t *e);
+
 #endif /* __TIED_MGAU_COMMON_H__ */
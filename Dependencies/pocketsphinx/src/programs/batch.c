@@ -396,7 +396,7 @@ process_ctl_line(ps_decoder_t *ps, cmd_ln_t *config,
 
     if (cmd_ln_boolean_r(config, "-senin")) {
         /* start and end frames not supported. */
-        ps_decode_senscr(ps, infh);
+        ps_decode_senscr_file(ps, infile);
     }
     else if (cmd_ln_boolean_r(config, "-adcin")) {
         
@@ -760,6 +760,17 @@ process_ctl(ps_decoder_t *ps, cmd_ln_t *config, FILE *ctlfh)
                    uttid, n_speech, n_cpu, n_wall);
             E_INFO("%s: %.2f xRT (CPU), %.2f xRT (elapsed)\n",
                    uttid, n_cpu / n_speech, n_wall / n_speech);
+            if (cmd_ln_float32_r(config, "-ds_thresh") > 0) {
+                int32 n_frame, n_skip;
+                double n_gmm, n_saved;
+
+                ps_get_utt_skip(ps, &n_frame, &n_skip, &n_gmm, &n_saved);
+                E_INFO("%s: reused senone scores for %d of %d frames (%.1f%%), "
+                       "%.2f seconds CPU scoring, about %.2f saved\n",
+                       uttid, n_skip, n_frame,
+                       n_frame ? 100.0 * n_skip / n_frame : 0.0,
+                       n_gmm, n_saved);
+            }
             /* help make the logfile somewhat less opaque (air) */
             E_INFO_NOFN("%s (%s %d)\n", hyp ? hyp : "", uttid, score); 
             E_INFO_NOFN("%s done --------------------------------------\n", uttid);
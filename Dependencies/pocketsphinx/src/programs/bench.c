@@ -0,0 +1,642 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * This file was written for the OpenEars copy of PocketSphinx.  It may be
+ * used and redistributed under the same conditions as the Carnegie
+ * Mellon University files alongside it.
+ * ====================================================================
+ */
+/**
+ * bench.c - time the vector kernels of the decoder against the scalar code
+ *
+ * Each stage is set up twice from the same configuration, once with
+ * simd_set_features(SIMD_NONE) and once with every instruction set the
+ * machine has, and run -benchiter times on the audio in -benchin.  The
+ * best time of each is reported, so that the numbers can be compared
+ * between trees as well as between the two code paths.
+ **/
+
+/* System headers. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/err.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/strfuncs.h>
+#include <sphinxbase/profile.h>
+#include <sphinxbase/simd.h>
+#include <sphinxbase/fe.h>
+#include <sphinxbase/yin.h>
+#include <sphinxbase/genrand.h>
+
+/* PocketSphinx headers. */
+#include <pocketsphinx.h>
+
+/* S3kr3t headerz. */
+#include "pocketsphinx_internal.h"
+#include "acmod.h"
+#include "hmm.h"
+
+static const arg_t bench_args_def[] = {
+    POCKETSPHINX_OPTIONS,
+    /* Argument file. */
+    { "-argfile",
+      ARG_STRING,
+      NULL,
+      "Argument file giving extra arguments." },
+    { "-benchin",
+      ARG_STRING,
+      NULL,
+      "Audio file to run the benchmarks on (16-bit mono, native byte order)" },
+    { "-benchhdr",
+      ARG_INT32,
+      "44",
+      "Size of audio file header in bytes (headers are ignored)" },
+    { "-bench",
+      ARG_STRING,
+      "all",
+      "Comma-separated list of stages to time: fe, pitch, hmm, mgau (needs -hmm), or all" },
+    { "-benchiter",
+      ARG_INT32,
+      "10",
+      "Number of times each stage is run (the best time is reported)" },
+    { "-benchact",
+      ARG_FLOAT32,
+      "1.0",
+      "Fraction of senones on the active list in the mgau stage (without -compallsen)" },
+    { "-benchthreads",
+      ARG_STRING,
+      NULL,
+      "Comma-separated list of -nthreads values to run the mgau stage with" },
+
+    CMDLN_EMPTY_OPTION
+};
+
+/**
+ * Check whether a stage was asked for with -bench.
+ */
+static int
+bench_stage_enabled(cmd_ln_t *config, char const *stage)
+{
+    char *stages, *word[32];
+    int32 nwords, i, found;
+
+    stages = ckd_salloc(cmd_ln_str_r(config, "-bench"));
+    for (i = 0; stages[i]; ++i)
+        if (stages[i] == ',')
+            stages[i] = ' ';
+    nwords = str2words(stages, word, 32);
+    found = FALSE;
+    for (i = 0; i < nwords; ++i)
+        if (0 == strcmp(word[i], stage) || 0 == strcmp(word[i], "all"))
+            found = TRUE;
+    ckd_free(stages);
+
+    return found;
+}
+
+/**
+ * Read the whole of the -benchin file.
+ */
+static int16 *
+bench_read_audio(cmd_ln_t *config, size_t *out_nsamps)
+{
+    FILE *fh;
+    int16 *data;
+    long size;
+    int32 hdr;
+
+    if ((fh = fopen(cmd_ln_str_r(config, "-benchin"), "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s", cmd_ln_str_r(config, "-benchin"));
+        return NULL;
+    }
+    hdr = cmd_ln_int32_r(config, "-benchhdr");
+    fseek(fh, 0, SEEK_END);
+    size = (ftell(fh) - hdr) / sizeof(*data);
+    fseek(fh, hdr, SEEK_SET);
+    if (size <= 0) {
+        E_ERROR("%s has no samples\n", cmd_ln_str_r(config, "-benchin"));
+        fclose(fh);
+        return NULL;
+    }
+    data = ckd_calloc(size, sizeof(*data));
+    *out_nsamps = fread(data, sizeof(*data), size, fh);
+    fclose(fh);
+
+    return data;
+}
+
+/**
+ * Print the best scalar and vector times of a stage, per unit of work.
+ */
+static void
+bench_report(char const *stage, char const *unit, int32 n_unit,
+             double scalar, double vector)
+{
+    printf("%-24s scalar %10.2f us/%s  vector %10.2f us/%s  x%.2f\n",
+           stage, scalar * 1e6 / n_unit, unit, vector * 1e6 / n_unit, unit,
+           vector > 0 ? scalar / vector : 0.0);
+}
+
+/**
+ * Front end: fe_process_frames() over the whole file, cepstra only.
+ */
+static double
+bench_fe_run(cmd_ln_t *config, uint32 simd, int16 const *data,
+             size_t nsamps, int32 *out_nframes)
+{
+    fe_t *fe;
+    mfcc_t **cep;
+    ptmr_t tmr;
+    double best;
+    uint32 saved;
+    int32 frame_shift, frame_size, nframes, i, n_iter;
+
+    saved = simd_set_features(simd);
+    fe = fe_init_auto_r(config);
+    simd_set_features(saved);
+    if (fe == NULL)
+        return -1;
+    fe_get_input_size(fe, &frame_shift, &frame_size);
+    *out_nframes = nsamps < (size_t)frame_size
+        ? 1 : 1 + (nsamps - frame_size) / frame_shift;
+    cep = (mfcc_t **)ckd_calloc_2d(*out_nframes + 1, fe_get_output_size(fe),
+                                   sizeof(**cep));
+
+    best = -1;
+    n_iter = cmd_ln_int32_r(config, "-benchiter");
+    for (i = 0; i < n_iter; ++i) {
+        int16 const *spch = data;
+        size_t nspch = nsamps;
+
+        nframes = *out_nframes + 1;
+        ptmr_init(&tmr);
+        fe_start_utt(fe);
+        ptmr_start(&tmr);
+        fe_process_frames(fe, &spch, &nspch, cep, &nframes, NULL);
+        ptmr_stop(&tmr);
+        fe_end_utt(fe, cep[0], &nframes);
+        if (best < 0 || tmr.t_elapsed < best)
+            best = tmr.t_elapsed;
+    }
+
+    ckd_free_2d(cep);
+    fe_free(fe);
+    return best;
+}
+
+static void
+bench_fe(cmd_ln_t *config, int16 const *data, size_t nsamps)
+{
+    double scalar, vector;
+    int32 nframes;
+
+    scalar = bench_fe_run(config, SIMD_NONE, data, nsamps, &nframes);
+    vector = bench_fe_run(config, ~0U, data, nsamps, &nframes);
+    if (scalar < 0 || vector < 0) {
+        E_ERROR("Failed to initialize the front end\n");
+        return;
+    }
+    bench_report("fe_process_frames", "frame", nframes, scalar, vector);
+}
+
+/**
+ * Pitch: YIN over -wlen frames every 1 / -frate seconds, with the
+ * defaults of sphinx_pitch for everything else, summing either
+ * directly or with the FFT.
+ */
+static double
+bench_pitch_run(cmd_ln_t *config, uint32 simd, int use_fft,
+                int16 const *data, size_t nsamps, int32 *out_nframes)
+{
+    yin_t *yin;
+    ptmr_t tmr;
+    double best;
+    uint32 saved;
+    uint16 period;
+    float32 bestdiff;
+    int32 frame_shift, frame_size, i, n_iter;
+    size_t pos;
+
+    frame_size = (int32)(cmd_ln_float32_r(config, "-wlen")
+                         * cmd_ln_float32_r(config, "-samprate") + 0.5);
+    frame_shift = (int32)(cmd_ln_float32_r(config, "-samprate")
+                          / cmd_ln_int32_r(config, "-frate") + 0.5);
+    if (nsamps < (size_t)frame_size)
+        return -1;
+    saved = simd_set_features(simd);
+    yin = yin_init(frame_size, 0.1, 0.2, 2);
+    simd_set_features(saved);
+    if (yin == NULL)
+        return -1;
+    yin_set_fft(yin, use_fft);
+
+    best = -1;
+    n_iter = cmd_ln_int32_r(config, "-benchiter");
+    for (i = 0; i < n_iter; ++i) {
+        *out_nframes = 0;
+        ptmr_init(&tmr);
+        ptmr_start(&tmr);
+        yin_start(yin);
+        for (pos = 0; pos + frame_size <= nsamps; pos += frame_shift) {
+            yin_write(yin, data + pos);
+            yin_read(yin, &period, &bestdiff);
+            ++*out_nframes;
+        }
+        yin_end(yin);
+        while (yin_read(yin, &period, &bestdiff))
+            ;
+        ptmr_stop(&tmr);
+        if (best < 0 || tmr.t_elapsed < best)
+            best = tmr.t_elapsed;
+    }
+
+    yin_free(yin);
+    return best;
+}
+
+static void
+bench_pitch(cmd_ln_t *config, int16 const *data, size_t nsamps)
+{
+    double scalar, vector;
+    int32 nframes;
+    int use_fft;
+
+    for (use_fft = 0; use_fft < 2; ++use_fft) {
+        scalar = bench_pitch_run(config, SIMD_NONE, use_fft,
+                                 data, nsamps, &nframes);
+        vector = bench_pitch_run(config, ~0U, use_fft,
+                                 data, nsamps, &nframes);
+        if (scalar < 0 || vector < 0) {
+            E_ERROR("Failed to initialize pitch estimation\n");
+            return;
+        }
+        bench_report(use_fft ? "yin/fft" : "yin/direct", "frame",
+                     nframes, scalar, vector);
+    }
+}
+
+/* Random HMMs for the hmm stage. */
+#define BENCH_HMM_N_HMM 4000
+#define BENCH_HMM_N_SEN 2000
+#define BENCH_HMM_N_TMAT 4
+#define BENCH_HMM_N_FRAME 100
+
+/**
+ * A random state score.  Some are WORST_SCORE or just above it, as in
+ * HMMs which were just entered or are about to be pruned.
+ */
+static int32
+bench_hmm_score(void)
+{
+    switch (genrand_int31() % 16) {
+    case 0:
+        return WORST_SCORE;
+    case 1:
+        return WORST_SCORE + genrand_int31() % 300;
+    default:
+        return -(int32)(genrand_int31() % 200000);
+    }
+}
+
+/**
+ * Viterbi evaluation: hmm_vit_eval_add() and hmm_vit_eval_flush() on
+ * BENCH_HMM_N_HMM random HMMs in each of BENCH_HMM_N_FRAME frames.
+ * Without vector kernels these evaluate the HMMs one at a time with
+ * hmm_vit_eval().  An eighth of the HMMs get new random scores in
+ * each frame, outside the timer.  The last transition matrix has no
+ * skips, as in some models.  A checksum of the states of all the
+ * HMMs after each frame is returned in out_sum.
+ */
+static double
+bench_hmm_run(cmd_ln_t *config, uint32 simd, int32 n_emit_state,
+              uint32 *out_sum)
+{
+    hmm_context_t *ctx;
+    hmm_t *hmm;
+    uint8 ***tp;
+    uint16 **sseq;
+    int16 *senscr;
+    ptmr_t tmr;
+    double best;
+    uint32 saved;
+    int32 i, j, k, f, iter, n_iter;
+
+    genrand_seed(1111);
+    tp = (uint8 ***)ckd_calloc_3d(BENCH_HMM_N_TMAT, n_emit_state,
+                                  n_emit_state + 1, sizeof(***tp));
+    for (k = 0; k < BENCH_HMM_N_TMAT; ++k)
+        for (i = 0; i < n_emit_state; ++i)
+            for (j = 0; j <= n_emit_state; ++j)
+                tp[k][i][j] = (j < i
+                               || (k == BENCH_HMM_N_TMAT - 1 && j == i + 2))
+                    ? 255 : genrand_int31() % 256;
+    sseq = (uint16 **)ckd_calloc_2d(BENCH_HMM_N_HMM, n_emit_state,
+                                    sizeof(**sseq));
+    senscr = ckd_calloc(BENCH_HMM_N_SEN, sizeof(*senscr));
+
+    saved = simd_set_features(simd);
+    ctx = hmm_context_init(n_emit_state, tp, BENCH_HMM_N_TMAT, senscr, sseq);
+    simd_set_features(saved);
+    hmm = ckd_calloc(BENCH_HMM_N_HMM, sizeof(*hmm));
+    for (i = 0; i < BENCH_HMM_N_HMM; ++i) {
+        for (j = 0; j < n_emit_state; ++j)
+            sseq[i][j] = genrand_int31() % BENCH_HMM_N_SEN;
+        hmm_init(ctx, &hmm[i], FALSE, i,
+                 genrand_int31() % BENCH_HMM_N_TMAT);
+    }
+
+    best = -1;
+    *out_sum = 0;
+    n_iter = cmd_ln_int32_r(config, "-benchiter");
+    for (iter = 0; iter < n_iter; ++iter) {
+        ptmr_init(&tmr);
+        for (f = 0; f < BENCH_HMM_N_FRAME; ++f) {
+            for (i = 0; i < BENCH_HMM_N_SEN; ++i)
+                senscr[i] = genrand_int31() % 3000;
+            for (i = 0; i < BENCH_HMM_N_HMM; ++i) {
+                if (f == 0 || genrand_int31() % 8 == 0) {
+                    for (j = 0; j < n_emit_state; ++j) {
+                        hmm_score(&hmm[i], j) = bench_hmm_score();
+                        hmm_history(&hmm[i], j) = genrand_int31();
+                    }
+                    hmm_out_score(&hmm[i]) = bench_hmm_score();
+                    hmm_out_history(&hmm[i]) = genrand_int31();
+                }
+                hmm_frame(&hmm[i]) = f;
+            }
+
+            ptmr_start(&tmr);
+            for (i = 0; i < BENCH_HMM_N_HMM; ++i)
+                hmm_vit_eval_add(ctx, &hmm[i]);
+            k = hmm_vit_eval_flush(ctx);
+            ptmr_stop(&tmr);
+
+            if (iter > 0)
+                continue;
+            *out_sum = *out_sum * 31 + k;
+            for (i = 0; i < BENCH_HMM_N_HMM; ++i) {
+                for (j = 0; j < n_emit_state; ++j)
+                    *out_sum = (*out_sum * 31 + hmm_score(&hmm[i], j)) * 31
+                        + hmm_history(&hmm[i], j);
+                *out_sum = ((*out_sum * 31 + hmm_out_score(&hmm[i])) * 31
+                            + hmm_out_history(&hmm[i])) * 31
+                    + hmm_bestscore(&hmm[i]);
+            }
+        }
+        if (best < 0 || tmr.t_elapsed < best)
+            best = tmr.t_elapsed;
+    }
+
+    for (i = 0; i < BENCH_HMM_N_HMM; ++i)
+        hmm_deinit(&hmm[i]);
+    ckd_free(hmm);
+    hmm_context_free(ctx);
+    ckd_free(senscr);
+    ckd_free_2d(sseq);
+    ckd_free_3d(tp);
+    return best;
+}
+
+static void
+bench_hmm(cmd_ln_t *config)
+{
+    double scalar, vector;
+    uint32 scalar_sum, vector_sum;
+    int32 n_emit_state;
+    char stage[64];
+
+    for (n_emit_state = 3; n_emit_state <= 5; n_emit_state += 2) {
+        scalar = bench_hmm_run(config, SIMD_NONE, n_emit_state, &scalar_sum);
+        vector = bench_hmm_run(config, ~0U, n_emit_state, &vector_sum);
+        sprintf(stage, "hmm_vit_eval/%d-state", n_emit_state);
+        bench_report(stage, "frame", BENCH_HMM_N_FRAME, scalar, vector);
+        if (scalar_sum != vector_sum)
+            E_ERROR("Scalar and vector %d-state HMM scores differ\n",
+                    n_emit_state);
+    }
+}
+
+/**
+ * Create a decoder whose kernels are chosen from the given features.
+ */
+static ps_decoder_t *
+bench_decoder(cmd_ln_t *config, uint32 simd)
+{
+    ps_decoder_t *ps;
+    uint32 saved;
+
+    saved = simd_set_features(simd);
+    ps = ps_init(config);
+    simd_set_features(saved);
+
+    return ps;
+}
+
+/**
+ * Acoustic scoring: ps_mgau_frame_eval() on every frame of the file.
+ * With -compallsen no, a fraction -benchact of the senones, scattered
+ * at random with a fixed seed, is on the active list.  A checksum of
+ * all the active scores is returned in out_sum, so that the scalar
+ * and vector code can be checked against each other.
+ */
+static double
+bench_mgau_run(cmd_ln_t *config, uint32 simd, int16 const *data,
+               size_t nsamps, int32 *out_nframes, uint32 *out_sum)
+{
+    ps_decoder_t *ps;
+    acmod_t *acmod;
+    ptmr_t tmr;
+    double best;
+    float32 frac;
+    int32 i, f, sen, n_sen, n_iter;
+
+    if ((ps = bench_decoder(config, simd)) == NULL)
+        return -1;
+    acmod = ps->acmod;
+    n_sen = bin_mdef_n_sen(acmod->mdef);
+
+    /* Compute all the features up front. */
+    acmod_start_utt(acmod);
+    acmod_process_raw(acmod, &data, &nsamps, TRUE);
+    *out_nframes = acmod->n_feat_frame;
+    if (*out_nframes == 0) {
+        ps_free(ps);
+        return -1;
+    }
+    if (!acmod->compallsen) {
+        frac = cmd_ln_float32_r(config, "-benchact");
+        genrand_seed(1111);
+        acmod_clear_active(acmod);
+        for (i = 0; i < n_sen; ++i)
+            if (frac >= 1.0 || genrand_real3() < frac)
+                acmod_activate_sen(acmod, i);
+        acmod_flags2list(acmod);
+        if (acmod->n_senone_active == 0) {
+            acmod_end_utt(acmod);
+            ps_free(ps);
+            return -1;
+        }
+    }
+
+    best = -1;
+    n_iter = cmd_ln_int32_r(config, "-benchiter");
+    for (i = 0; i < n_iter; ++i) {
+        ptmr_init(&tmr);
+        ptmr_start(&tmr);
+        for (f = 0; f < *out_nframes; ++f)
+            ps_mgau_frame_eval(acmod->mgau, acmod->senone_scores,
+                               acmod->senone_active,
+                               acmod->n_senone_active,
+                               acmod->feat_buf[f], f, acmod->compallsen);
+        ptmr_stop(&tmr);
+        if (best < 0 || tmr.t_elapsed < best)
+            best = tmr.t_elapsed;
+    }
+
+    /* Once more, untimed, to check the scores. */
+    *out_sum = 0;
+    for (f = 0; f < *out_nframes; ++f) {
+        ps_mgau_frame_eval(acmod->mgau, acmod->senone_scores,
+                           acmod->senone_active, acmod->n_senone_active,
+                           acmod->feat_buf[f], f, acmod->compallsen);
+        if (acmod->compallsen) {
+            for (sen = 0; sen < n_sen; ++sen)
+                *out_sum = *out_sum * 31 + (uint16)acmod->senone_scores[sen];
+            continue;
+        }
+        for (i = sen = 0; i < acmod->n_senone_active; ++i) {
+            sen += acmod->senone_active[i];
+            *out_sum = *out_sum * 31 + (uint16)acmod->senone_scores[sen];
+        }
+    }
+
+    acmod_end_utt(acmod);
+    ps_free(ps);
+    return best;
+}
+
+/**
+ * Time the scalar and vector paths with the current -nthreads.  The
+ * checksum of the vector scores is returned in out_sum.
+ */
+static int
+bench_mgau_threads(cmd_ln_t *config, int16 const *data, size_t nsamps,
+                   uint32 *out_sum)
+{
+    double scalar, vector;
+    uint32 scalar_sum;
+    int32 nframes;
+    char stage[64];
+
+    scalar = bench_mgau_run(config, SIMD_NONE, data, nsamps,
+                            &nframes, &scalar_sum);
+    vector = bench_mgau_run(config, ~0U, data, nsamps,
+                            &nframes, out_sum);
+    if (scalar < 0 || vector < 0) {
+        E_ERROR("Failed to initialize the decoder\n");
+        return -1;
+    }
+    if (cmd_ln_int32_r(config, "-nthreads") > 1)
+        sprintf(stage, "ps_mgau_frame_eval/%d",
+                cmd_ln_int32_r(config, "-nthreads"));
+    else
+        strcpy(stage, "ps_mgau_frame_eval");
+    bench_report(stage, "frame", nframes, scalar, vector);
+    if (scalar_sum != *out_sum)
+        E_ERROR("Scalar and vector senone scores differ\n");
+    return 0;
+}
+
+/**
+ * Acoustic scoring, once for each thread count in -benchthreads.
+ * Scores must not depend on the thread count, so the checksums of
+ * all the runs are compared as well.
+ */
+static void
+bench_mgau(cmd_ln_t *config, int16 const *data, size_t nsamps)
+{
+    char *threads, *word[32];
+    int32 nwords, i, nthreads;
+    uint32 sum, first_sum;
+
+    if (cmd_ln_str_r(config, "-benchthreads") == NULL) {
+        bench_mgau_threads(config, data, nsamps, &sum);
+        return;
+    }
+
+    threads = ckd_salloc(cmd_ln_str_r(config, "-benchthreads"));
+    for (i = 0; threads[i]; ++i)
+        if (threads[i] == ',')
+            threads[i] = ' ';
+    nwords = str2words(threads, word, 32);
+    nthreads = cmd_ln_int32_r(config, "-nthreads");
+    first_sum = 0;
+    for (i = 0; i < nwords; ++i) {
+        cmd_ln_set_int32_r(config, "-nthreads", atoi(word[i]));
+        if (bench_mgau_threads(config, data, nsamps, &sum) < 0)
+            break;
+        if (i == 0)
+            first_sum = sum;
+        else if (sum != first_sum)
+            E_ERROR("Senone scores differ with %s threads\n", word[i]);
+    }
+    cmd_ln_set_int32_r(config, "-nthreads", nthreads);
+    ckd_free(threads);
+}
+
+int
+main(int32 argc, char *argv[])
+{
+    cmd_ln_t *config;
+    char const *argfile;
+    int16 *data;
+    size_t nsamps;
+
+    config = cmd_ln_parse_r(NULL, bench_args_def, argc, argv, TRUE);
+
+    /* Handle argument file as -argfile. */
+    if (config && (argfile = cmd_ln_str_r(config, "-argfile")) != NULL) {
+        config = cmd_ln_parse_file_r(config, bench_args_def, argfile, FALSE);
+    }
+
+    if (config == NULL) {
+        /* This probably just means that we got no arguments. */
+        return 1;
+    }
+
+    if (cmd_ln_str_r(config, "-benchin") == NULL) {
+        E_FATAL("-benchin argument not present, nothing to time!\n");
+    }
+    if ((data = bench_read_audio(config, &nsamps)) == NULL) {
+        cmd_ln_free_r(config);
+        return 1;
+    }
+
+    printf("vector instruction sets: %s%s%s%s\n",
+           simd_get_features() & SIMD_SSE2 ? "sse2 " : "",
+           simd_get_features() & SIMD_AVX2 ? "avx2 " : "",
+           simd_get_features() & SIMD_NEON ? "neon " : "",
+           simd_get_features() == SIMD_NONE ? "none" : "");
+    if (bench_stage_enabled(config, "fe"))
+        bench_fe(config, data, nsamps);
+    if (bench_stage_enabled(config, "pitch"))
+        bench_pitch(config, data, nsamps);
+    if (bench_stage_enabled(config, "hmm"))
+        bench_hmm(config);
+    if (cmd_ln_str_r(config, "-hmm") == NULL) {
+        if (bench_stage_enabled(config, "mgau")
+            && strcmp(cmd_ln_str_r(config, "-bench"), "all") != 0)
+            E_ERROR("Acoustic model stages need -hmm\n");
+    }
+    else {
+        ps_default_search_args(config);
+        if (bench_stage_enabled(config, "mgau"))
+            bench_mgau(config, data, nsamps);
+    }
+
+    ckd_free(data);
+    cmd_ln_free_r(config);
+    return 0;
+}
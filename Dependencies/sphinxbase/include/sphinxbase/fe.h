@@ -136,6 +136,11 @@ extern "C" {
     ARG_STRINGIFY(DEFAULT_SAMPLING_RATE), \
     "Sampling rate" }, \
    \
+  { "-insamprate", \
+    ARG_FLOAT32, \
+    "0", \
+    "Sampling rate of the input audio, if different from -samprate (it is resampled to -samprate)" }, \
+   \
   { "-frate", \
     ARG_INT32, \
     ARG_STRINGIFY(DEFAULT_FRAME_RATE), \
@@ -211,6 +216,11 @@ extern "C" {
     "2.0", \
     "Threshold for decision between noise and silence frames. Log-ratio between signal level and noise level." }, \
    \
+  { "-vad_cheap", \
+    ARG_BOOLEAN, \
+    "no", \
+    "Skip the FFT, filterbank and DCT on frames whose raw energy marks them as silence" }, \
+   \
   { "-input_endian", \
     ARG_STRING, \
     NATIVE_ENDIAN, \
@@ -487,6 +497,10 @@ int fe_process_frames_ext(fe_t *fe,
  *          do_some_stuff(cepstra, nframes);
  *  }
  *
+ * If -insamprate is set, the samples are at that rate and are
+ * resampled to -samprate on the fly; the sample counts here are
+ * always in input samples.
+ *
  * @param inout_spch Input: Pointer to pointer to speech samples
  *                   (signed 16-bit linear PCM).
  *                   Output: Pointer to remaining samples.
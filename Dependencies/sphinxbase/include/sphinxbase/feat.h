@@ -151,14 +151,36 @@ typedef struct feat_s {
     agc_t *agc_struct;	/**< Structure that stores the temporary variables for acoustic
                            gain control*/
 
-    mfcc_t **cepbuf;    /**< Circular buffer of MFCC frames for live feature computation. */
-    mfcc_t **tmpcepbuf; /**< Array of pointers into cepbuf to handle border cases. */
-    int32   bufpos;     /**< Write index in cepbuf. */
-    int32   curpos;     /**< Read index in cepbuf. */
+    mfcc_t **cepbuf;    /**< Circular buffer of MFCC frames for live
+                           feature computation, stored contiguously
+                           after window_size frames which mirror its
+                           end and followed by window_size frames
+                           which mirror its start. */
+    mfcc_t **tmpcepbuf; /**< No longer used, always NULL. */
+    int32   bufpos;     /**< Write index in the circular buffer. */
+    int32   curpos;     /**< Read index in the circular buffer. */
 
     mfcc_t ***lda; /**< Array of linear transformations (for LDA, MLLT, or whatever) */
     uint32 n_lda;   /**< Number of linear transformations in lda. */
     uint32 out_dim; /**< Output dimensionality */
+    mfcc_t *lda_panels; /**< First transformation in lda, packed in
+                           panels of lda_width output rows for
+                           feat_lda_transform(). */
+    mfcc_t *lda_buf;    /**< Output of feat_lda_transform() for one
+                           block of frames. */
+    uint32 lda_width;   /**< Number of output rows in a panel. */
+    /**
+     * Multiply a block of frames by one panel of lda_panels.
+     **/
+    void (*lda_gemm)(mfcc_t const *panel, uint32 n, mfcc_t const **in,
+                     mfcc_t *out, uint32 out_stride);
+    /**
+     * Same as compute_feat, for input frames stored contiguously
+     * (input points to frame 0 of them) and a single output stream.
+     * NULL if this feature type has no such function.
+     **/
+    void (*compute_feat_flat)(struct feat_s *fcb, mfcc_t const *input,
+                              mfcc_t *feat);
 } feat_t;
 
 /**
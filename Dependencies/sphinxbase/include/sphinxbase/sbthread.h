@@ -212,6 +212,52 @@ int sbevent_signal(sbevent_t *evt);
 SPHINXBASE_EXPORT
 int sbevent_wait(sbevent_t *evt, int sec, int nsec);
 
+/**
+ * Pool of worker threads for splitting a computation into parts.
+ */
+typedef struct sbpool_s sbpool_t;
+
+/**
+ * Function run on each part of a computation, part i of n.
+ */
+typedef void (*sbpool_func)(void *arg, int i, int n);
+
+/**
+ * Start of part i of n of the range [0, count), for splitting a
+ * computation into contiguous parts of (nearly) the same size.
+ */
+#define sbpool_part_start(count, i, n) ((int32)((int64)(count) * (i) / (n)))
+
+/**
+ * Start a pool of threads that runs computations in n_thread parts.
+ *
+ * The calling thread runs one of the parts, so n_thread - 1 worker
+ * threads are started.
+ */
+SPHINXBASE_EXPORT
+sbpool_t *sbpool_init(cmd_ln_t *config, int n_thread);
+
+/**
+ * Get the number of parts computations are split into.
+ */
+SPHINXBASE_EXPORT
+int sbpool_size(sbpool_t *pool);
+
+/**
+ * Run func on every part of a computation.
+ *
+ * Returns once every part is done.  Part 0 runs on the calling
+ * thread.
+ */
+SPHINXBASE_EXPORT
+void sbpool_run(sbpool_t *pool, sbpool_func func, void *arg);
+
+/**
+ * Stop the worker threads and free a pool.
+ */
+SPHINXBASE_EXPORT
+void sbpool_free(sbpool_t *pool);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,87 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * This file was written for the OpenEars copy of SphinxBase.  It may be
+ * used and redistributed under the same conditions as the Carnegie
+ * Mellon University files alongside it.
+ * ====================================================================
+ */
+/**
+ * @file simd.h
+ * @brief Compile-time and run-time detection of vector instruction sets.
+ *
+ * Kernels with vector implementations are compiled for every
+ * instruction set the compiler can target (AVX2 is compiled through
+ * function target attributes, so it does not require building the
+ * whole library with -mavx2) and then selected once, at
+ * initialization time, based on simd_get_features().
+ **/
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include <sphinxbase/sphinxbase_export.h>
+#include <sphinxbase/prim_type.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+/* Fool Emacs. */
+}
+#endif
+
+/* SSE2 is part of the x86-64 baseline, so it needs no run-time check. */
+#if defined(__SSE2__) || defined(_M_X64)
+#define SPHINX_HAVE_SSE2 1
+#endif
+
+/* AVX2 kernels are built with a target attribute and dispatched at
+ * run-time. */
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__GNUC__) || defined(__clang__)) && defined(SPHINX_HAVE_SSE2)
+#define SPHINX_HAVE_AVX2 1
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* NEON (with double-precision lanes) is mandatory on AArch64. */
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define SPHINX_HAVE_NEON 1
+#endif
+
+/**
+ * Instruction set flags returned by simd_get_features().
+ */
+enum simd_feature_e {
+    SIMD_NONE = 0,
+    SIMD_SSE2 = (1 << 0),
+    SIMD_AVX2 = (1 << 1),
+    SIMD_NEON = (1 << 2)
+};
+
+/**
+ * Get the vector instruction sets usable on this machine.
+ *
+ * This is the intersection of what was compiled in, what the CPU
+ * supports, and the mask set with simd_set_features().
+ */
+SPHINXBASE_EXPORT
+uint32 simd_get_features(void);
+
+/**
+ * Restrict the vector instruction sets used by kernels initialized
+ * after this call.
+ *
+ * This exists mostly to compare vector kernels against the scalar
+ * reference code.  Passing SIMD_NONE forces the scalar paths,
+ * passing ~0 restores automatic detection.
+ *
+ * @return the previous mask.
+ */
+SPHINXBASE_EXPORT
+uint32 simd_set_features(uint32 mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIMD_H__ */
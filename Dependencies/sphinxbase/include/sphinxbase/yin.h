@@ -71,6 +71,16 @@ yin_t *yin_init(int frame_size, float search_threshold,
 SPHINXBASE_EXPORT
 void yin_free(yin_t *pe);
 
+/**
+ * Compute the difference function with an FFT instead of summing it
+ * directly, which is several times faster.  The FFT result is exact and
+ * the direct sums round, so some voiced frames get a different period:
+ * under 1% in floating point, and a few percent in fixed point, where
+ * the sums are scaled down.  The default is to sum directly.
+ */
+SPHINXBASE_EXPORT
+void yin_set_fft(yin_t *pe, int use_fft);
+
 /**
  * Start processing an utterance.
  */
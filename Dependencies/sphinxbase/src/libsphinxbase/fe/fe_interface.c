@@ -115,6 +115,7 @@ fe_parse_general_params(cmd_ln_t *config, fe_t * fe)
     fe->post_speech = (int16)cmd_ln_int32_r(config, "-vad_postspeech");
     fe->start_speech = (int16)cmd_ln_int32_r(config, "-vad_startspeech");
     fe->vad_threshold = cmd_ln_float32_r(config, "-vad_threshold");
+    fe->vad_cheap = cmd_ln_boolean_r(config, "-vad_cheap");
 
     fe->remove_dc = cmd_ln_boolean_r(config, "-remove_dc");
     fe->remove_noise = cmd_ln_boolean_r(config, "-remove_noise");
@@ -219,6 +220,7 @@ fe_init_auto_r(cmd_ln_t *config)
 {
     fe_t *fe;
     int prespch_frame_len;
+    float32 insamprate;
 
     fe = (fe_t*)ckd_calloc(1, sizeof(*fe));
     fe->refcount = 1;
@@ -288,8 +290,18 @@ fe_init_auto_r(cmd_ln_t *config)
         fe->noise_stats = fe_init_noisestats(fe->mel_fb->num_filters);
 
     fe->vad_data = (vad_data_t*)ckd_calloc(1, sizeof(*fe->vad_data));
-    prespch_frame_len = fe->log_spec != RAW_LOG_SPEC ? fe->num_cepstra : fe->mel_fb->num_filters;
-    fe->vad_data->prespch_buf = fe_prespch_init(fe->pre_speech + 1, prespch_frame_len, fe->frame_shift);
+    prespch_frame_len = fe->feature_dimension;
+    /* With -vad_cheap, speech can start while skipped frames are
+     * replayed, and the rest of them are added on top of a full
+     * prespeech buffer. */
+    fe->vad_data->prespch_buf =
+        fe_prespch_init(fe->pre_speech + 1,
+                        fe->vad_cheap ? fe->pre_speech : 0,
+                        prespch_frame_len, fe->frame_shift);
+    if (fe->vad_cheap && fe->pre_speech > 0)
+        fe->vad_data->skipped_frames =
+            ckd_calloc(fe->pre_speech * fe->fft_size,
+                       sizeof(*fe->vad_data->skipped_frames));
 
     /* Create temporary FFT, spectrum and mel-spectrum buffers. */
     /* FIXME: Gosh there are a lot of these. */
@@ -297,12 +309,40 @@ fe_init_auto_r(cmd_ln_t *config)
     fe->frame = ckd_calloc(fe->fft_size, sizeof(*fe->frame));
     fe->spec = ckd_calloc(fe->fft_size, sizeof(*fe->spec));
     fe->mfspec = ckd_calloc(fe->mel_fb->num_filters, sizeof(*fe->mfspec));
+    fe->block_spch = ckd_calloc(fe->frame_size
+                                + (FE_BLOCK_FRAMES - 1) * fe->frame_shift,
+                                sizeof(*fe->block_spch));
+    fe->block_frame = ckd_calloc(FE_BLOCK_FRAMES * fe->fft_size,
+                                 sizeof(*fe->block_frame));
+    fe->block_spec = ckd_calloc(FE_BLOCK_FRAMES * fe->fft_size,
+                                sizeof(*fe->block_spec));
+    fe->block_mfspec = ckd_calloc(FE_BLOCK_FRAMES * fe->mel_fb->num_filters,
+                                  sizeof(*fe->block_mfspec));
 
     /* create twiddle factors */
     fe->ccc = ckd_calloc(fe->fft_size / 4, sizeof(*fe->ccc));
     fe->sss = ckd_calloc(fe->fft_size / 4, sizeof(*fe->sss));
+    fe->stage_ccc = ckd_calloc(fe->fft_size / 2, sizeof(*fe->stage_ccc));
+    fe->stage_sss = ckd_calloc(fe->fft_size / 2, sizeof(*fe->stage_sss));
     fe_create_twiddle(fe);
 
+    /* Resample the input if it is not at -samprate. */
+    insamprate = cmd_ln_float32_r(config, "-insamprate");
+    if (insamprate > 0
+        && (int32)(insamprate + 0.5) != (int32)(fe->sampling_rate + 0.5)) {
+        fe->resampler = fe_resampler_init((int32)(insamprate + 0.5),
+                                          (int32)(fe->sampling_rate + 0.5),
+                                          fe->swap);
+        if (fe->resampler == NULL) {
+            fe_free(fe);
+            return NULL;
+        }
+        /* The resampler does the byte swapping. */
+        fe->swap = 0;
+        fe->rs_spch_size = fe->frame_size + FE_BLOCK_FRAMES * fe->frame_shift;
+        fe->rs_spch = ckd_calloc(fe->rs_spch_size, sizeof(*fe->rs_spch));
+    }
+
     if (cmd_ln_boolean_r(config, "-verbose")) {
         fe_print_current(fe);
     }
@@ -346,6 +386,8 @@ fe_reset_vad_data(vad_data_t * vad_data)
     vad_data->in_speech = 0;
     vad_data->pre_speech_frames = 0;
     vad_data->post_speech_frames = 0;
+    vad_data->skipped_start = 0;
+    vad_data->n_skipped = 0;
     fe_prespch_reset_cep(vad_data->prespch_buf);
 }
 
@@ -357,6 +399,8 @@ fe_start_utt(fe_t * fe)
     fe->start_flag = 1;
     fe->prior = 0;
     fe_reset_vad_data(fe->vad_data);
+    if (fe->resampler)
+        fe_resampler_reset(fe->resampler);
     return 0;
 }
 
@@ -364,6 +408,8 @@ void
 fe_start_stream(fe_t *fe)
 {
     fe->sample_counter = 0;
+    if (fe->vad_data)
+        fe->vad_data->energy_frames = 0;
     fe_reset_noisestats(fe->noise_stats);
 }
 
@@ -407,9 +453,17 @@ fe_process_frames(fe_t *fe,
 static int
 fe_copy_from_prespch(fe_t *fe, int32 *inout_nframes, mfcc_t **buf_cep, int outidx)
 {
-    while ((*inout_nframes) > 0 && fe_prespch_read_cep(fe->vad_data->prespch_buf, buf_cep[outidx]) > 0) {
-	    outidx++;
-    	    (*inout_nframes)--;
+    mfcc_t const *frames;
+    int32 i, n;
+
+    while ((*inout_nframes) > 0
+           && (n = fe_prespch_read_cep_span(fe->vad_data->prespch_buf,
+                                            &frames, *inout_nframes)) > 0) {
+        for (i = 0; i < n; ++i)
+            memcpy(buf_cep[outidx + i], frames + i * fe->feature_dimension,
+                   fe->feature_dimension * sizeof(**buf_cep));
+        outidx += n;
+        (*inout_nframes) -= n;
     }
     return outidx;    
 }
@@ -443,8 +497,8 @@ fe_check_prespeech(fe_t *fe, int32 *inout_nframes, mfcc_t **buf_cep, int outidx,
     return outidx;
 }
 
-int 
-fe_process_frames_ext(fe_t *fe,
+static int 
+fe_process_frames_int(fe_t *fe,
                   int16 const **inout_spch,
                   size_t *inout_nsamps,
                   mfcc_t **buf_cep,
@@ -471,7 +525,8 @@ fe_process_frames_ext(fe_t *fe,
                 + ((*inout_nsamps + fe->num_overflow_samps - fe->frame_size)
                    / fe->frame_shift);
         if (!fe->vad_data->in_speech)
-            *inout_nframes += fe_prespch_ncep(fe->vad_data->prespch_buf);
+            *inout_nframes += fe_prespch_ncep(fe->vad_data->prespch_buf)
+                + fe->vad_data->n_skipped;
         return *inout_nframes;
     }
 
@@ -540,6 +595,30 @@ fe_process_frames_ext(fe_t *fe,
 
     /* Process all remaining frames. */
     while (*inout_nframes > 0 && *inout_nsamps >= (size_t)fe->frame_shift) {
+        int nblock, i;
+
+        /* Only run a block of frames which are all certain to be
+         * consumed below.  Each one produces at most one output frame
+         * of its own plus whatever is waiting in the prespeech buffer. */
+        nblock = *inout_nsamps / fe->frame_shift;
+        if (nblock > *inout_nframes
+            - fe_prespch_ncep(fe->vad_data->prespch_buf))
+            nblock = *inout_nframes
+                - fe_prespch_ncep(fe->vad_data->prespch_buf);
+        if (nblock > 1 && !fe->vad_cheap) {
+            nblock = fe_shift_block(fe, *inout_spch, nblock);
+            for (i = 0; i < nblock; ++i) {
+                fe_write_block_frame(fe, i, buf_cep[outidx],
+                                     voiced_spch != NULL);
+                outidx = fe_check_prespeech(fe, inout_nframes, buf_cep,
+                                            outidx, out_frameidx,
+                                            inout_nsamps, orig_nsamps);
+                *inout_spch += fe->frame_shift;
+                *inout_nsamps -= fe->frame_shift;
+            }
+            continue;
+        }
+
         fe_shift_frame(fe, *inout_spch, fe->frame_shift);
         fe_write_frame(fe, buf_cep[outidx], voiced_spch != NULL);
 
@@ -598,6 +677,88 @@ fe_process_frames_ext(fe_t *fe,
     return 0;
 }
 
+/**
+ * Resample the input a piece at a time into rs_spch and process that.
+ * If the output frames run out before a piece is used up, the input
+ * behind the unused samples is given back to the caller.
+ */
+static int
+fe_process_frames_resample(fe_t *fe,
+                           int16 const **inout_spch,
+                           size_t *inout_nsamps,
+                           mfcc_t **buf_cep,
+                           int32 *inout_nframes,
+                           int16 *voiced_spch,
+                           int32 *voiced_spch_nsamps,
+                           int32 *out_frameidx)
+{
+    int16 const *spch;
+    size_t nsamps;
+    int32 outidx, nframes, frameidx, n_in, n_out;
+
+    if (buf_cep == NULL) {
+        nsamps = fe_resampler_count(fe->resampler, *inout_nsamps);
+        return fe_process_frames_int(fe, NULL, &nsamps, NULL,
+                                     inout_nframes, NULL, NULL, NULL);
+    }
+
+    if (out_frameidx)
+        *out_frameidx = 0;
+    outidx = 0;
+    do {
+        n_in = fe_resampler_input_for(fe->resampler, fe->rs_spch_size);
+        if ((size_t)n_in > *inout_nsamps)
+            n_in = *inout_nsamps;
+        fe_resampler_mark(fe->resampler);
+        n_out = fe_resampler_process(fe->resampler, *inout_spch, n_in,
+                                     fe->rs_spch);
+
+        spch = fe->rs_spch;
+        nsamps = n_out;
+        nframes = *inout_nframes - outidx;
+        frameidx = 0;
+        fe_process_frames_int(fe, &spch, &nsamps, buf_cep + outidx, &nframes,
+                              voiced_spch, voiced_spch_nsamps, &frameidx);
+        outidx += nframes;
+        if (out_frameidx && frameidx)
+            *out_frameidx = frameidx;
+
+        if (nsamps > 0) {
+            /* Keep only the input needed for the samples used. */
+            fe_resampler_rewind(fe->resampler);
+            n_in = fe_resampler_input_for(fe->resampler, n_out - nsamps);
+            fe_resampler_process(fe->resampler, *inout_spch, n_in, NULL);
+            *inout_spch += n_in;
+            *inout_nsamps -= n_in;
+            break;
+        }
+        *inout_spch += n_in;
+        *inout_nsamps -= n_in;
+    } while (*inout_nsamps > 0 && outidx < *inout_nframes);
+
+    *inout_nframes = outidx;
+    return 0;
+}
+
+int 
+fe_process_frames_ext(fe_t *fe,
+                  int16 const **inout_spch,
+                  size_t *inout_nsamps,
+                  mfcc_t **buf_cep,
+                  int32 *inout_nframes,
+                  int16 *voiced_spch,
+                  int32 *voiced_spch_nsamps,
+                  int32 *out_frameidx)
+{
+    if (fe->resampler)
+        return fe_process_frames_resample(fe, inout_spch, inout_nsamps,
+                                          buf_cep, inout_nframes, voiced_spch,
+                                          voiced_spch_nsamps, out_frameidx);
+    return fe_process_frames_int(fe, inout_spch, inout_nsamps, buf_cep,
+                                 inout_nframes, voiced_spch,
+                                 voiced_spch_nsamps, out_frameidx);
+}
+
 int
 fe_process_utt(fe_t * fe, int16 const * spch, size_t nsamps,
                mfcc_t *** cep_block, int32 * nframes)
@@ -663,22 +824,36 @@ fe_free(fe_t * fe)
         ckd_free(fe->mel_fb->filt_start);
         ckd_free(fe->mel_fb->filt_width);
         ckd_free(fe->mel_fb->filt_coeffs);
+        ckd_free(fe->mel_fb->packed_coeffs);
+        ckd_free(fe->mel_fb->packed_start);
+        ckd_free(fe->mel_fb->packed_width);
+        ckd_free(fe->mel_fb->cosine_t);
+        ckd_free(fe->mel_fb->dct_out);
         ckd_free(fe->mel_fb);
     }
     ckd_free(fe->spch);
     ckd_free(fe->frame);
     ckd_free(fe->ccc);
     ckd_free(fe->sss);
+    ckd_free(fe->stage_ccc);
+    ckd_free(fe->stage_sss);
     ckd_free(fe->spec);
     ckd_free(fe->mfspec);
+    ckd_free(fe->block_spch);
+    ckd_free(fe->block_frame);
+    ckd_free(fe->block_spec);
+    ckd_free(fe->block_mfspec);
     ckd_free(fe->overflow_samps);
     ckd_free(fe->hamming_window);
+    fe_resampler_free(fe->resampler);
+    ckd_free(fe->rs_spch);
 
     if (fe->noise_stats)
         fe_free_noisestats(fe->noise_stats);
 
     if (fe->vad_data) {
         fe_prespch_free(fe->vad_data->prespch_buf);
+        ckd_free(fe->vad_data->skipped_frames);
 	ckd_free(fe->vad_data);
     }
 
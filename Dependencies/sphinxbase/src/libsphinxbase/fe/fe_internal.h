@@ -47,6 +47,7 @@
 
 #include "fe_noise.h"
 #include "fe_prespch_buf.h"
+#include "fe_resample.h"
 #include "fe_type.h"
 
 #ifdef __cplusplus
@@ -71,6 +72,34 @@ enum {
 };
 
 typedef struct melfb_s melfb_t;
+
+/**
+ * Vectorized FFT butterflies for one block of one stage of
+ * fe_fft_real().  Handles indices 1 <= j < n4 in whole vectors and
+ * returns the first j left for the scalar code.
+ */
+typedef int (*fe_butterfly_func)(frame_t *x, int n2, int n4,
+                                 frame_t const *cc, frame_t const *ss);
+
+/**
+ * Vectorized power spectrum of a real FFT for bins 1 <= j <= n/2.
+ * Returns the first j left for the scalar code.
+ */
+typedef int (*fe_power_func)(frame_t const *fft, powspec_t *spec, int n);
+
+/**
+ * Vectorized mel filterbank over the packed filter coefficients.
+ */
+typedef void (*fe_melspec_func)(melfb_t *mel_fb, powspec_t const *spec,
+                                powspec_t *mfspec);
+
+/**
+ * Vectorized DCT over the transposed cosine table.  Writes all
+ * cosine_stride outputs to mel_fb->dct_out.
+ */
+typedef void (*fe_dct_func)(melfb_t *mel_fb, powspec_t const *mflogspec,
+                            int32 beta);
+
 /** Base Struct to hold all structure for MFCC computation. */
 struct melfb_s {
     float32 sampling_rate;
@@ -101,6 +130,18 @@ struct melfb_s {
     /* Round filter frequencies to DFT points (hurts accuracy, but is
        useful for legacy purposes) */
     int32 round_filters;
+    /* Filter coefficients with each filter padded to a whole number
+       of vectors (float only). */
+    powspec_t *packed_coeffs;
+    int32 *packed_start;
+    int16 *packed_width;
+    /* DCT coefficients transposed to [num_filters][cosine_stride]. */
+    powspec_t *cosine_t;
+    int32 cosine_stride;
+    powspec_t *dct_out;
+    /* Vector kernels, or NULL to use the scalar code. */
+    fe_melspec_func mel_spec;
+    fe_dct_func dct;
 };
 
 /* sqrt(1/2), also used for unitary DCT-II/DCT-III */
@@ -111,6 +152,15 @@ typedef struct vad_data_s {
     int16 pre_speech_frames;
     int16 post_speech_frames;
     prespch_buf_t* prespch_buf;
+    /* Running log energy floor and last log energy for -vad_cheap. */
+    float64 energy_floor;
+    float64 prev_energy;
+    int32 energy_frames;
+    /* Windowed frames skipped by -vad_cheap which may still be needed
+       for the prespeech buffer (at most pre_speech of them). */
+    frame_t *skipped_frames;
+    int16 skipped_start;
+    int16 n_skipped;
 } vad_data_t;
 
 /** Structure for the front-end computation. */
@@ -147,6 +197,11 @@ struct fe_s {
 
     /* Twiddle factors for FFT. */
     frame_t *ccc, *sss;
+    /* The same, stored contiguously for each butterfly stage. */
+    frame_t *stage_ccc, *stage_sss;
+    /* Vector kernels, or NULL to use the scalar code. */
+    fe_butterfly_func fft_butterflies;
+    fe_power_func spec_power;
     /* Mel filter parameters. */
     melfb_t *mel_fb;
     /* Half of a Hamming Window. */
@@ -160,6 +215,7 @@ struct fe_s {
     int16 post_speech;
     int16 start_speech;
     float32 vad_threshold;
+    uint8 vad_cheap;
     vad_data_t *vad_data;
 
     /* Temporary buffers for processing. */
@@ -170,8 +226,21 @@ struct fe_s {
     int16 *overflow_samps;
     int16 num_overflow_samps;    
     int16 prior;
+
+    /* Resampler for -insamprate, and its output buffer. */
+    fe_resampler_t *resampler;
+    int16 *rs_spch;
+    int32 rs_spch_size;
+
+    /* Buffers for processing FE_BLOCK_FRAMES frames at once. */
+    int16 *block_spch;
+    frame_t *block_frame;
+    powspec_t *block_spec, *block_mfspec;
 };
 
+/* Maximum number of frames processed together by fe_shift_block(). */
+#define FE_BLOCK_FRAMES 8
+
 void fe_init_dither(int32 seed);
 
 /* Apply 1/2 bit noise to a buffer of audio. */
@@ -186,6 +255,14 @@ int fe_shift_frame(fe_t *fe, int16 const *in, int32 len);
 /* Process a frame of data into features. */
 void fe_write_frame(fe_t *fe, mfcc_t *feat, int32 store_pcm);
 
+/* Shift in nframes * frame_shift samples and run everything up to the
+ * mel spectrum for each of the frames.  Returns the number of frames,
+ * which is at most FE_BLOCK_FRAMES. */
+int fe_shift_block(fe_t *fe, int16 const *in, int32 nframes);
+
+/* Finish frame idx of the last block, like fe_write_frame(). */
+void fe_write_block_frame(fe_t *fe, int32 idx, mfcc_t *feat, int32 store_pcm);
+
 /* Initialization functions. */
 int32 fe_build_melfilters(melfb_t *MEL_FB);
 int32 fe_compute_melcosine(melfb_t *MEL_FB);
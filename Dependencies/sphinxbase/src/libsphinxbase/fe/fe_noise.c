@@ -73,6 +73,11 @@
 #define SLOW_PEAK_LEARN_FACTOR 0.9
 #define SPEECH_VOLUME_RANGE 8.0
 
+/* Cheap VAD constants, in natural log of the raw frame energy */
+#define ENERGY_WARMUP_FRAMES 20
+#define ENERGY_SILENCE_MARGIN 1.0
+#define ENERGY_MAX_FLUX 0.5
+
 //#define VAD_DEBUG 1
 #ifdef VAD_DEBUG
 static FILE *vad_stats;
@@ -456,6 +461,49 @@ fe_track_snr(fe_t * fe, int32 *in_speech)
     ckd_free(signal);
 }
 
+int32
+fe_vad_quiet(fe_t * fe)
+{
+    vad_data_t *vad_data;
+    float64 energy, flux;
+    int64 sum;
+    int32 i;
+
+    vad_data = fe->vad_data;
+    sum = 0;
+    for (i = 0; i < fe->frame_size; i++)
+        sum += (int32) fe->spch[i] * fe->spch[i];
+    energy = log((float64) sum / fe->frame_size + 1.0);
+
+    if (vad_data->energy_frames == 0) {
+        vad_data->energy_floor = energy;
+        vad_data->prev_energy = energy;
+    }
+    /* The energy flux stands in for spectral flux, which would need
+     * the very FFT we are trying to avoid. */
+    flux = energy - vad_data->prev_energy;
+    vad_data->prev_energy = energy;
+
+    /* Lower envelope, which follows drops quickly and rises slowly. */
+    if (energy >= vad_data->energy_floor)
+        vad_data->energy_floor =
+            LAMBDA_A * vad_data->energy_floor + (1 - LAMBDA_A) * energy;
+    else
+        vad_data->energy_floor =
+            LAMBDA_B * vad_data->energy_floor + (1 - LAMBDA_B) * energy;
+
+    /* Let the full VAD and noise tracking see the start of the stream. */
+    if (vad_data->energy_frames < ENERGY_WARMUP_FRAMES) {
+        vad_data->energy_frames++;
+        return FALSE;
+    }
+
+    /* Only skip once the full VAD has called the last frame silence. */
+    return !vad_data->in_speech && vad_data->pre_speech_frames == 0
+        && energy < vad_data->energy_floor + ENERGY_SILENCE_MARGIN
+        && fabs(flux) < ENERGY_MAX_FLUX;
+}
+
 void
 fe_vad_hangover(fe_t * fe, mfcc_t * feat, int32 is_speech, int32 store_pcm)
 {
@@ -58,6 +58,12 @@ void fe_free_noisestats(noise_stats_t * noise_stats);
  */
 void fe_track_snr(fe_t *fe, int32 *in_speech);
 
+/**
+ * Update the raw energy statistics for the current frame, and return
+ * TRUE if it is confidently silence and can be skipped (-vad_cheap).
+ */
+int32 fe_vad_quiet(fe_t *fe);
+
 /**
  * Updates global state based on local VAD state smoothing the estimate.
  */
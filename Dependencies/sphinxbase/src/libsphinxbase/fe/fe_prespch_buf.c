@@ -49,12 +49,12 @@
 #include "fe_prespch_buf.h"
 
 struct prespch_buf_s {
-    /* saved mfcc frames */
-    mfcc_t **cep_buf;
-    /* saved pcm audio */
+    /* saved mfcc frames, num_frames_cep of num_cepstra each */
+    mfcc_t *cep_buf;
+    /* saved pcm audio, num_frames_pcm of num_samples each */
     int16 *pcm_buf;
 
-    /* flag for pcm buffer initialization */
+    /* write pointer for cep buffer */
     int16 cep_write_ptr;
     /* read pointer for cep buffer */
     int16 cep_read_ptr;
@@ -62,15 +62,17 @@ struct prespch_buf_s {
     int16 ncep;
     
 
-    /* flag for pcm buffer initialization */
+    /* write pointer for pcm buffer */
     int16 pcm_write_ptr;
-    /* read pointer for cep buffer */
+    /* read pointer for pcm buffer */
     int16 pcm_read_ptr;
     /* Count */
     int16 npcm;
     
     /* frames amount in cep buffer */
     int16 num_frames_cep;
+    /* frames kept in cep buffer before speech starts */
+    int16 num_keep_cep;
     /* frames amount in pcm buffer */
     int16 num_frames_pcm;
     /* filters amount */
@@ -80,16 +82,18 @@ struct prespch_buf_s {
 };
 
 prespch_buf_t *
-fe_prespch_init(int num_frames, int num_cepstra, int num_samples)
+fe_prespch_init(int num_frames, int num_extra, int num_cepstra,
+                int num_samples)
 {
     prespch_buf_t *prespch_buf;
 
     prespch_buf = (prespch_buf_t *) ckd_calloc(1, sizeof(prespch_buf_t));
 
     prespch_buf->num_cepstra = num_cepstra;
-    prespch_buf->num_frames_cep = num_frames;
+    prespch_buf->num_frames_cep = num_frames + num_extra;
+    prespch_buf->num_keep_cep = num_frames;
     prespch_buf->num_samples = num_samples;
-    prespch_buf->num_frames_pcm = 0;
+    prespch_buf->num_frames_pcm = num_frames;
 
     prespch_buf->cep_write_ptr = 0;
     prespch_buf->cep_read_ptr = 0;
@@ -99,9 +103,11 @@ fe_prespch_init(int num_frames, int num_cepstra, int num_samples)
     prespch_buf->pcm_read_ptr = 0;
     prespch_buf->npcm = 0;
 
-    prespch_buf->cep_buf = (mfcc_t **)
-        ckd_calloc_2d(num_frames, num_cepstra,
-                      sizeof(**prespch_buf->cep_buf));
+    /* Both are rings of whole frames, so that any run of frames
+     * which does not wrap around is contiguous. */
+    prespch_buf->cep_buf = (mfcc_t *)
+        ckd_calloc(prespch_buf->num_frames_cep * num_cepstra,
+                   sizeof(*prespch_buf->cep_buf));
 
     prespch_buf->pcm_buf = (int16 *)
         ckd_calloc(prespch_buf->num_frames_pcm * prespch_buf->num_samples,
@@ -114,44 +120,98 @@ fe_prespch_init(int num_frames, int num_cepstra, int num_samples)
 int
 fe_prespch_read_cep(prespch_buf_t * prespch_buf, mfcc_t * feat)
 {
-    if (prespch_buf->ncep == 0)
+    mfcc_t const *frame;
+
+    if (fe_prespch_read_cep_span(prespch_buf, &frame, 1) == 0)
         return 0;
-    memcpy(feat, prespch_buf->cep_buf[prespch_buf->cep_read_ptr],
-           sizeof(mfcc_t) * prespch_buf->num_cepstra);
-    prespch_buf->cep_read_ptr = (prespch_buf->cep_read_ptr + 1) % prespch_buf->num_frames_cep;
-    prespch_buf->ncep--;
+    memcpy(feat, frame, sizeof(mfcc_t) * prespch_buf->num_cepstra);
     return 1;
 }
 
+int32
+fe_prespch_read_cep_span(prespch_buf_t * prespch_buf,
+                         mfcc_t const **out_frames, int32 max_frames)
+{
+    int32 n;
+
+    n = prespch_buf->num_frames_cep - prespch_buf->cep_read_ptr;
+    if (n > prespch_buf->ncep)
+        n = prespch_buf->ncep;
+    if (n > max_frames)
+        n = max_frames;
+    if (n <= 0)
+        return 0;
+    *out_frames = prespch_buf->cep_buf
+        + prespch_buf->cep_read_ptr * prespch_buf->num_cepstra;
+    prespch_buf->cep_read_ptr = (prespch_buf->cep_read_ptr + n) % prespch_buf->num_frames_cep;
+    prespch_buf->ncep -= n;
+    return n;
+}
+
+mfcc_t *
+fe_prespch_cep_slot(prespch_buf_t * prespch_buf)
+{
+    return prespch_buf->cep_buf
+        + prespch_buf->cep_write_ptr * prespch_buf->num_cepstra;
+}
+
 void
 fe_prespch_write_cep(prespch_buf_t * prespch_buf, mfcc_t * feat)
 {
-    memcpy(prespch_buf->cep_buf[prespch_buf->cep_write_ptr], feat,
-           sizeof(mfcc_t) * prespch_buf->num_cepstra);
+    mfcc_t *slot = fe_prespch_cep_slot(prespch_buf);
+
+    /* Nothing to copy if it was computed in place. */
+    if (feat != slot)
+        memcpy(slot, feat, sizeof(mfcc_t) * prespch_buf->num_cepstra);
     prespch_buf->cep_write_ptr = (prespch_buf->cep_write_ptr + 1) % prespch_buf->num_frames_cep;
-    if (prespch_buf->ncep < prespch_buf->num_frames_cep) {
+    if (prespch_buf->ncep < prespch_buf->num_keep_cep) {
         prespch_buf->ncep++;	
     } else {
         prespch_buf->cep_read_ptr = (prespch_buf->cep_read_ptr + 1) % prespch_buf->num_frames_cep;
     }
 }
 
+void
+fe_prespch_append_cep(prespch_buf_t * prespch_buf, mfcc_t * feat)
+{
+    assert(prespch_buf->ncep < prespch_buf->num_frames_cep);
+    memcpy(fe_prespch_cep_slot(prespch_buf), feat,
+           sizeof(mfcc_t) * prespch_buf->num_cepstra);
+    prespch_buf->cep_write_ptr = (prespch_buf->cep_write_ptr + 1) % prespch_buf->num_frames_cep;
+    prespch_buf->ncep++;
+}
+
 void
 fe_prespch_read_pcm(prespch_buf_t * prespch_buf, int16 *samples,
                     int32 *samples_num)
 {
-    int i;
-    int16 *cursample = samples;
-    *samples_num = prespch_buf->npcm * prespch_buf->num_samples;
-    for (i = 0; i < prespch_buf->npcm; i++) {
-	memcpy(cursample, &prespch_buf->pcm_buf[prespch_buf->pcm_read_ptr * prespch_buf->num_samples],
-	           prespch_buf->num_samples * sizeof(int16));
-	prespch_buf->pcm_read_ptr = (prespch_buf->pcm_read_ptr + 1) % prespch_buf->num_frames_pcm;
+    int16 const *span;
+    int32 n;
+
+    *samples_num = 0;
+    while ((n = fe_prespch_read_pcm_span(prespch_buf, &span)) > 0) {
+        memcpy(samples + *samples_num, span, n * sizeof(int16));
+        *samples_num += n;
     }
-    prespch_buf->pcm_read_ptr = 0;
-    prespch_buf->pcm_write_ptr = 0;    
-    prespch_buf->npcm = 0;
-    return;
+    fe_prespch_reset_pcm(prespch_buf);
+}
+
+int32
+fe_prespch_read_pcm_span(prespch_buf_t * prespch_buf,
+                         int16 const **out_samples)
+{
+    int32 n;
+
+    n = prespch_buf->num_frames_pcm - prespch_buf->pcm_read_ptr;
+    if (n > prespch_buf->npcm)
+        n = prespch_buf->npcm;
+    if (n <= 0)
+        return 0;
+    *out_samples = prespch_buf->pcm_buf
+        + prespch_buf->pcm_read_ptr * prespch_buf->num_samples;
+    prespch_buf->pcm_read_ptr = (prespch_buf->pcm_read_ptr + n) % prespch_buf->num_frames_pcm;
+    prespch_buf->npcm -= n;
+    return n * prespch_buf->num_samples;
 }
 
 void
@@ -193,7 +253,7 @@ fe_prespch_free(prespch_buf_t * prespch_buf)
     if (!prespch_buf)
 	return;
     if (prespch_buf->cep_buf)
-        ckd_free_2d((void **) prespch_buf->cep_buf);
+        ckd_free(prespch_buf->cep_buf);
     if (prespch_buf->pcm_buf)
         ckd_free(prespch_buf->pcm_buf);
     ckd_free(prespch_buf);
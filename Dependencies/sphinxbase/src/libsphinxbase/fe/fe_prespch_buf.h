@@ -44,20 +44,39 @@
 
 typedef struct prespch_buf_s prespch_buf_t;
 
-/* Creates prespeech buffer */
-prespch_buf_t *fe_prespch_init(int num_frames, int num_cepstra,
-                               int num_samples);
+/* Creates prespeech buffer, which keeps num_frames frames before
+ * speech starts and has room for num_extra more added after that */
+prespch_buf_t *fe_prespch_init(int num_frames, int num_extra,
+                               int num_cepstra, int num_samples);
 
 /* Reads mfcc frame from prespeech buffer */
 int fe_prespch_read_cep(prespch_buf_t * prespch_buf, mfcc_t * fea);
 
+/* Reads up to max_frames contiguous mfcc frames without copying them,
+ * returns the number of frames.  They stay valid until the next write. */
+int32 fe_prespch_read_cep_span(prespch_buf_t * prespch_buf,
+                               mfcc_t const **out_frames, int32 max_frames);
+
+/* Returns where the next mfcc frame will be stored, so that it can be
+ * computed in place and then passed to fe_prespch_write_cep() */
+mfcc_t *fe_prespch_cep_slot(prespch_buf_t * prespch_buf);
+
 /* Writes mfcc frame to prespeech buffer */
 void fe_prespch_write_cep(prespch_buf_t * prespch_buf, mfcc_t * fea);
 
+/* Writes mfcc frame computed after speech started to prespeech buffer,
+ * using the extra room instead of dropping the oldest frame */
+void fe_prespch_append_cep(prespch_buf_t * prespch_buf, mfcc_t * fea);
+
 /* Reads pcm frame from prespeech buffer */
 void fe_prespch_read_pcm(prespch_buf_t * prespch_buf, int16 *samples,
                          int32 * samples_num);
 
+/* Reads contiguous pcm frames without copying them, returns the number
+ * of samples.  They stay valid until the next write. */
+int32 fe_prespch_read_pcm_span(prespch_buf_t * prespch_buf,
+                               int16 const **out_samples);
+
 /* Writes pcm frame to prespeech buffer */
 void fe_prespch_write_pcm(prespch_buf_t * prespch_buf, int16 * samples);
 
@@ -0,0 +1,369 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * This file was written for the OpenEars copy of SphinxBase.  It may be
+ * used and redistributed under the same conditions as the Carnegie
+ * Mellon University files alongside it.
+ * ====================================================================
+ */
+
+/*
+ * Streaming polyphase resampler.
+ *
+ * The rate ratio out_rate/in_rate is reduced to up/down.  A windowed
+ * sinc low-pass filter is designed at up * in_rate and split into up
+ * phases of ntaps coefficients each, so every output sample is a
+ * single dot product of one phase with the last ntaps input samples.
+ * The coefficients are 16-bit fixed point and the dot products are
+ * done in 32-bit integer arithmetic, so the vector kernels give the
+ * same output as the scalar one.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "sphinxbase/prim_type.h"
+#include "sphinxbase/ckd_alloc.h"
+#include "sphinxbase/byteorder.h"
+#include "sphinxbase/err.h"
+#include "sphinxbase/simd.h"
+
+#ifdef SPHINX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+#include "fe_resample.h"
+
+/* Zero crossings of the filter on each side, at the lower rate. */
+#define FE_RESAMPLE_ZEROS 12
+/* Passband edge as a fraction of the lower Nyquist frequency. */
+#define FE_RESAMPLE_ROLLOFF 0.92
+/* Kaiser window shape (about 80dB stopband). */
+#define FE_RESAMPLE_BETA 8.0
+/* Phases are padded with zeros to a multiple of this many taps. */
+#define FE_RESAMPLE_ALIGN 16
+/* Input samples staged behind the filter history at once. */
+#define FE_RESAMPLE_CHUNK 1024
+/* Fractional bits of the filter coefficients. */
+#define FE_RESAMPLE_SHIFT 15
+
+/**
+ * Dot product of n 16-bit values, n a multiple of FE_RESAMPLE_ALIGN.
+ */
+typedef int32 (*fe_resample_dot_func)(int16 const *a, int16 const *b,
+                                      int32 n);
+
+struct fe_resampler_s {
+    int32 up, down;
+    int32 ntaps;
+    int32 swap;
+    /* Filter phases, [up][ntaps], each one time-reversed. */
+    int16 *taps;
+    /* Last ntaps - 1 input samples followed by the staged input. */
+    int16 *buf;
+    /* Input sample (counting from the next one to be read) and
+     * filter phase of the next output sample. */
+    int32 pos, phase;
+    int32 start_pos, start_phase;
+    /* State saved by fe_resampler_mark(). */
+    int16 *mark_hist;
+    int32 mark_pos, mark_phase;
+    fe_resample_dot_func dot;
+};
+
+static int32
+fe_resample_dot(int16 const *a, int16 const *b, int32 n)
+{
+    int32 i, sum;
+
+    sum = 0;
+    for (i = 0; i < n; ++i)
+        sum += (int32)a[i] * b[i];
+    return sum;
+}
+
+#ifdef SPHINX_HAVE_SSE2
+static int32
+fe_resample_dot_sse2(int16 const *a, int16 const *b, int32 n)
+{
+    __m128i acc;
+    int32 i;
+
+    acc = _mm_setzero_si128();
+    for (i = 0; i < n; i += 8)
+        acc = _mm_add_epi32(acc,
+                            _mm_madd_epi16(_mm_loadu_si128((__m128i const *)(a + i)),
+                                           _mm_loadu_si128((__m128i const *)(b + i))));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+#endif /* SPHINX_HAVE_SSE2 */
+
+#ifdef SPHINX_HAVE_AVX2
+static SIMD_TARGET_AVX2 int32
+fe_resample_dot_avx2(int16 const *a, int16 const *b, int32 n)
+{
+    __m256i acc;
+    __m128i sum;
+    int32 i;
+
+    acc = _mm256_setzero_si256();
+    for (i = 0; i < n; i += 16)
+        acc = _mm256_add_epi32(acc,
+                               _mm256_madd_epi16(_mm256_loadu_si256((__m256i const *)(a + i)),
+                                                 _mm256_loadu_si256((__m256i const *)(b + i))));
+    sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                        _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+static int32
+fe_resample_dot_neon(int16 const *a, int16 const *b, int32 n)
+{
+    int32x4_t acc;
+    int32 i;
+
+    acc = vdupq_n_s32(0);
+    for (i = 0; i < n; i += 8) {
+        int16x8_t x = vld1q_s16(a + i);
+        int16x8_t y = vld1q_s16(b + i);
+        acc = vmlal_s16(acc, vget_low_s16(x), vget_low_s16(y));
+        acc = vmlal_high_s16(acc, x, y);
+    }
+    return vaddvq_s32(acc);
+}
+#endif /* SPHINX_HAVE_NEON */
+
+static int32
+fe_resample_gcd(int32 a, int32 b)
+{
+    while (b) {
+        int32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Modified Bessel function of the first kind, order 0. */
+static float64
+fe_resample_bessel_i0(float64 x)
+{
+    float64 sum, term;
+    int i;
+
+    sum = term = 1.0;
+    for (i = 1; i < 50 && term > sum * 1e-12; ++i) {
+        term *= (x / (2 * i)) * (x / (2 * i));
+        sum += term;
+    }
+    return sum;
+}
+
+static void
+fe_resample_design(fe_resampler_t *rs)
+{
+    float64 *h, fc, c, norm;
+    int32 n, k, p, j;
+
+    /* Prototype filter at up * in_rate, cutting off below the lower
+     * of the two Nyquist frequencies. */
+    n = rs->ntaps * rs->up;
+    h = ckd_calloc(n, sizeof(*h));
+    fc = FE_RESAMPLE_ROLLOFF
+        / (2.0 * (rs->up > rs->down ? rs->up : rs->down));
+    c = (n - 1) / 2.0;
+    norm = fe_resample_bessel_i0(FE_RESAMPLE_BETA);
+    for (k = 0; k < n; ++k) {
+        float64 t = k - c;
+        float64 r = t / (c + 1);
+        float64 sinc = (t == 0) ? 1.0 : sin(2 * M_PI * fc * t) / (2 * M_PI * fc * t);
+        h[k] = 2 * fc * sinc
+            * fe_resample_bessel_i0(FE_RESAMPLE_BETA * sqrt(1 - r * r)) / norm;
+    }
+
+    /* Split into phases with unit gain at DC. */
+    for (p = 0; p < rs->up; ++p) {
+        float64 sum = 0;
+        for (j = 0; j < rs->ntaps; ++j)
+            sum += h[p + j * rs->up];
+        for (j = 0; j < rs->ntaps; ++j)
+            rs->taps[p * rs->ntaps + rs->ntaps - 1 - j]
+                = (int16)floor(h[p + j * rs->up] / sum
+                               * (1 << FE_RESAMPLE_SHIFT) + 0.5);
+    }
+    ckd_free(h);
+
+    /* Start half a filter in, so the output is not delayed. */
+    rs->start_pos = (n - 1) / 2 / rs->up;
+    rs->start_phase = (n - 1) / 2 % rs->up;
+}
+
+fe_resampler_t *
+fe_resampler_init(int32 in_rate, int32 out_rate, int32 swap)
+{
+    fe_resampler_t *rs;
+    uint32 simd;
+    int32 g, up, down, half;
+
+    if (in_rate <= 0 || out_rate <= 0) {
+        E_ERROR("Invalid resampling rates %d -> %d\n", in_rate, out_rate);
+        return NULL;
+    }
+    g = fe_resample_gcd(in_rate, out_rate);
+    up = out_rate / g;
+    down = in_rate / g;
+    if (up > FE_RESAMPLE_MAX_PHASES || down > FE_RESAMPLE_MAX_PHASES) {
+        E_ERROR("Can not resample from %d to %d Hz: ratio %d/%d is too complex\n",
+                in_rate, out_rate, up, down);
+        return NULL;
+    }
+
+    rs = ckd_calloc(1, sizeof(*rs));
+    rs->up = up;
+    rs->down = down;
+    rs->swap = swap;
+    /* Filter length in input samples, enough for FE_RESAMPLE_ZEROS
+     * zero crossings on each side. */
+    half = (int32)ceil(FE_RESAMPLE_ZEROS
+                       * (float64)(up > down ? up : down) / up
+                       / FE_RESAMPLE_ROLLOFF);
+    rs->ntaps = (2 * half + FE_RESAMPLE_ALIGN - 1)
+        / FE_RESAMPLE_ALIGN * FE_RESAMPLE_ALIGN;
+    rs->taps = ckd_calloc(up * rs->ntaps, sizeof(*rs->taps));
+    rs->buf = ckd_calloc(rs->ntaps - 1 + FE_RESAMPLE_CHUNK, sizeof(*rs->buf));
+    rs->mark_hist = ckd_calloc(rs->ntaps - 1, sizeof(*rs->mark_hist));
+    fe_resample_design(rs);
+    fe_resampler_reset(rs);
+
+    rs->dot = fe_resample_dot;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON)
+        rs->dot = fe_resample_dot_neon;
+#endif
+#ifdef SPHINX_HAVE_SSE2
+    if (simd & SIMD_SSE2)
+        rs->dot = fe_resample_dot_sse2;
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2)
+        rs->dot = fe_resample_dot_avx2;
+#endif
+
+    E_INFO("Resampling from %d to %d Hz (%d/%d, %d taps per phase)\n",
+           in_rate, out_rate, up, down, rs->ntaps);
+    return rs;
+}
+
+void
+fe_resampler_free(fe_resampler_t *rs)
+{
+    if (rs == NULL)
+        return;
+    ckd_free(rs->taps);
+    ckd_free(rs->buf);
+    ckd_free(rs->mark_hist);
+    ckd_free(rs);
+}
+
+void
+fe_resampler_reset(fe_resampler_t *rs)
+{
+    memset(rs->buf, 0, (rs->ntaps - 1) * sizeof(*rs->buf));
+    rs->pos = rs->start_pos;
+    rs->phase = rs->start_phase;
+}
+
+int32
+fe_resampler_count(fe_resampler_t const *rs, int32 n_in)
+{
+    if (n_in <= rs->pos)
+        return 0;
+    /* Outputs m with pos + (phase + m * down) / up < n_in. */
+    return (int32)(((int64)(n_in - rs->pos) * rs->up - rs->phase
+                    + rs->down - 1) / rs->down);
+}
+
+int32
+fe_resampler_input_for(fe_resampler_t const *rs, int32 n_out)
+{
+    if (n_out <= 0)
+        return 0;
+    return rs->pos + (int32)((rs->phase + (int64)(n_out - 1) * rs->down)
+                             / rs->up) + 1;
+}
+
+int32
+fe_resampler_process(fe_resampler_t *rs, int16 const *in, int32 n_in,
+                     int16 *out)
+{
+    int16 *x;
+    int32 n_out, hist, n, i;
+
+    hist = rs->ntaps - 1;
+    x = rs->buf + hist;
+    n_out = 0;
+    while (n_in > 0) {
+        n = n_in > FE_RESAMPLE_CHUNK ? FE_RESAMPLE_CHUNK : n_in;
+        memcpy(x, in, n * sizeof(*x));
+        if (rs->swap)
+            for (i = 0; i < n; ++i)
+                SWAP_INT16(&x[i]);
+        while (rs->pos < n) {
+            if (out) {
+                int32 y = rs->dot(rs->taps + rs->phase * rs->ntaps,
+                                  rs->buf + rs->pos, rs->ntaps);
+                y = (y + (1 << (FE_RESAMPLE_SHIFT - 1))) >> FE_RESAMPLE_SHIFT;
+                if (y > 32767)
+                    y = 32767;
+                else if (y < -32768)
+                    y = -32768;
+                out[n_out] = (int16)y;
+            }
+            ++n_out;
+            rs->phase += rs->down;
+            rs->pos += rs->phase / rs->up;
+            rs->phase %= rs->up;
+        }
+        memmove(rs->buf, rs->buf + n, hist * sizeof(*rs->buf));
+        rs->pos -= n;
+        in += n;
+        n_in -= n;
+    }
+    return n_out;
+}
+
+void
+fe_resampler_mark(fe_resampler_t *rs)
+{
+    memcpy(rs->mark_hist, rs->buf, (rs->ntaps - 1) * sizeof(*rs->buf));
+    rs->mark_pos = rs->pos;
+    rs->mark_phase = rs->phase;
+}
+
+void
+fe_resampler_rewind(fe_resampler_t *rs)
+{
+    memcpy(rs->buf, rs->mark_hist, (rs->ntaps - 1) * sizeof(*rs->buf));
+    rs->pos = rs->mark_pos;
+    rs->phase = rs->mark_phase;
+}
@@ -0,0 +1,68 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * This file was written for the OpenEars copy of SphinxBase.  It may be
+ * used and redistributed under the same conditions as the Carnegie
+ * Mellon University files alongside it.
+ * ====================================================================
+ */
+#ifndef FE_RESAMPLE_H
+#define FE_RESAMPLE_H
+
+#include "sphinxbase/prim_type.h"
+
+/**
+ * Streaming polyphase resampler used for -insamprate.
+ *
+ * Converts 16-bit PCM between any two integer sampling rates whose
+ * ratio reduces to at most FE_RESAMPLE_MAX_PHASES.  The filter
+ * history is kept between calls, so the input may be cut into pieces
+ * of any size without changing the output.
+ */
+typedef struct fe_resampler_s fe_resampler_t;
+
+/* Largest numerator or denominator of the reduced rate ratio. */
+#define FE_RESAMPLE_MAX_PHASES 1024
+
+/**
+ * Create a resampler from in_rate to out_rate.  If swap is non-zero
+ * the input is byte-swapped as it is read.  Returns NULL if the rates
+ * are not supported.
+ */
+fe_resampler_t *fe_resampler_init(int32 in_rate, int32 out_rate, int32 swap);
+
+/* Free a resampler. */
+void fe_resampler_free(fe_resampler_t *rs);
+
+/* Clear the filter history, as at the start of a new stream. */
+void fe_resampler_reset(fe_resampler_t *rs);
+
+/**
+ * Number of output samples which n_in more input samples would
+ * produce.
+ */
+int32 fe_resampler_count(fe_resampler_t const *rs, int32 n_in);
+
+/**
+ * Number of input samples needed to produce exactly n_out more output
+ * samples.
+ */
+int32 fe_resampler_input_for(fe_resampler_t const *rs, int32 n_out);
+
+/**
+ * Consume n_in input samples and write fe_resampler_count(rs, n_in)
+ * output samples to out.  If out is NULL, only the filter state is
+ * updated.  Returns the number of output samples.
+ */
+int32 fe_resampler_process(fe_resampler_t *rs, int16 const *in, int32 n_in,
+                           int16 *out);
+
+/**
+ * Remember the current state, so that input consumed afterwards can
+ * be given back with fe_resampler_rewind().
+ */
+void fe_resampler_mark(fe_resampler_t *rs);
+
+/* Return to the state saved by fe_resampler_mark(). */
+void fe_resampler_rewind(fe_resampler_t *rs);
+
+#endif                          /* FE_RESAMPLE_H */
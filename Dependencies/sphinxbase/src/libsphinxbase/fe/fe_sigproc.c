@@ -63,6 +63,17 @@
 #include "sphinxbase/fe.h"
 #include "sphinxbase/genrand.h"
 #include "sphinxbase/err.h"
+#include "sphinxbase/simd.h"
+
+#ifdef SPHINX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
 
 #include "fe_internal.h"
 #include "fe_warp.h"
@@ -534,6 +545,280 @@ fe_log(float32 x)
 }
 #endif
 
+/*
+ * Vector kernels for the FFT butterflies, power spectrum, mel
+ * filterbank and DCT.
+ *
+ * Except for the mel filterbank, these perform exactly the same
+ * arithmetic as the scalar code, in the same order, so the output
+ * does not depend on which kernel is used.
+ */
+
+/*
+ * FFT butterflies.  Within one block of a stage, the indices i1 and
+ * i3 run forwards while i2 and i4 run backwards, so the latter are
+ * loaded and stored reversed.
+ */
+#define FE_DEFINE_BUTTERFLIES(name, attr, vec_t, width,                 \
+                              LOAD, STORE, REV, MUL, ADD, SUB, NEG)     \
+static attr int                                                         \
+name(frame_t *x, int n2, int n4, frame_t const *cc, frame_t const *ss)  \
+{                                                                       \
+    int j;                                                              \
+                                                                        \
+    for (j = 1; j + (width) <= n4; j += (width)) {                      \
+        vec_t x1, x2, x3, x4, c, s, t1, t2;                             \
+                                                                        \
+        x1 = LOAD(x + j);                                               \
+        x2 = REV(LOAD(x + n2 - j - (width) + 1));                       \
+        x3 = LOAD(x + n2 + j);                                          \
+        x4 = REV(LOAD(x + n2 + n2 - j - (width) + 1));                  \
+        c = LOAD(cc + j);                                               \
+        s = LOAD(ss + j);                                               \
+        t1 = ADD(MUL(x3, c), MUL(x4, s));                               \
+        t2 = SUB(MUL(x3, s), MUL(x4, c));                               \
+        STORE(x + n2 + n2 - j - (width) + 1, REV(SUB(x2, t2)));         \
+        STORE(x + n2 + j, SUB(NEG(x2), t2));                            \
+        STORE(x + n2 - j - (width) + 1, REV(SUB(x1, t1)));              \
+        STORE(x + j, ADD(x1, t1));                                      \
+    }                                                                   \
+    return j;                                                           \
+}
+
+/* Power spectrum (float only, fixed-point works in the log domain). */
+#define FE_DEFINE_POWER(name, attr, vec_t, width, LOAD, STORE, REV, MUL, ADD) \
+static attr int                                                         \
+name(frame_t const *fft, powspec_t *spec, int n)                        \
+{                                                                       \
+    int j;                                                              \
+                                                                        \
+    for (j = 1; j + (width) <= n / 2 + 1; j += (width)) {               \
+        vec_t re, im;                                                   \
+                                                                        \
+        re = LOAD(fft + j);                                             \
+        im = REV(LOAD(fft + n - j - (width) + 1));                      \
+        STORE(spec + j, ADD(MUL(re, re), MUL(im, im)));                 \
+    }                                                                   \
+    return j;                                                           \
+}
+
+/*
+ * Mel filterbank (float only, fixed-point uses a chain of log-adds).
+ * Each filter is a dot product with its row of packed_coeffs.  The
+ * partial sums are accumulated per lane, so results may differ from
+ * the scalar code in the last bits.
+ */
+#define FE_DEFINE_MELSPEC(name, attr, vec_t, width, LOAD, ZERO, MUL, ADD, HSUM) \
+static attr void                                                        \
+name(melfb_t *mel_fb, powspec_t const *spec, powspec_t *mfspec)         \
+{                                                                       \
+    int32 f, i;                                                         \
+                                                                        \
+    for (f = 0; f < mel_fb->num_filters; ++f) {                         \
+        powspec_t const *s = spec + mel_fb->spec_start[f];              \
+        powspec_t const *c = mel_fb->packed_coeffs                      \
+            + mel_fb->packed_start[f];                                  \
+        vec_t acc = ZERO;                                               \
+                                                                        \
+        for (i = 0; i < mel_fb->packed_width[f]; i += (width))          \
+            acc = ADD(acc, MUL(LOAD(s + i), LOAD(c + i)));              \
+        mfspec[f] = HSUM(acc);                                          \
+    }                                                                   \
+}
+
+/*
+ * DCT against the transposed cosine table, one vector of cepstra at
+ * a time.  With beta == 2, every filter but the first is counted
+ * twice, as in fe_spec2cep().  ROUND reproduces the rounding of the
+ * scalar code, which accumulates directly into mfcc_t.
+ */
+#define FE_DEFINE_DCT(name, attr, vec_t, width,                         \
+                      LOAD, STORE, SET1, ZERO, MUL, ADD, ROUND)         \
+static attr void                                                        \
+name(melfb_t *mel_fb, powspec_t const *mflogspec, int32 beta)           \
+{                                                                       \
+    int32 i, j;                                                         \
+                                                                        \
+    for (i = 0; i < mel_fb->cosine_stride; i += (width)) {              \
+        powspec_t const *c = mel_fb->cosine_t + i;                      \
+        vec_t acc = ZERO;                                               \
+                                                                        \
+        for (j = 0; j < mel_fb->num_filters; ++j) {                     \
+            vec_t p = MUL(SET1(mflogspec[j]),                           \
+                          LOAD(c + j * mel_fb->cosine_stride));         \
+            if (beta == 2 && j > 0)                                     \
+                p = ADD(p, p);                                          \
+            acc = ROUND(ADD(acc, p));                                   \
+        }                                                               \
+        STORE(mel_fb->dct_out + i, acc);                                \
+    }                                                                   \
+}
+
+#define FE_ROUND_NONE(v) (v)
+
+#ifdef FIXED_POINT
+/*
+ * COSMUL() keeps bits 30..61 of the 64-bit product, which we can get
+ * with logical shifts, so only the even/odd lane shuffling differs
+ * between instruction sets.
+ */
+#ifdef SPHINX_HAVE_SSE2
+static inline __m128i
+fe_cosmul_sse2(__m128i a, __m128i b)
+{
+    __m128i lo32 = _mm_set_epi32(0, -1, 0, -1);
+    __m128i even, odd, corr;
+
+    /* SSE2 only has unsigned 32x32->64 multiplies, so correct the
+     * high words to get signed products. */
+    even = _mm_mul_epu32(a, b);
+    odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    corr = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                         _mm_and_si128(_mm_srai_epi32(b, 31), a));
+    even = _mm_sub_epi64(even, _mm_slli_epi64(corr, 32));
+    odd = _mm_sub_epi64(odd, _mm_andnot_si128(lo32, corr));
+    return _mm_or_si128(_mm_and_si128(_mm_srli_epi64(even, 30), lo32),
+                        _mm_andnot_si128(lo32, _mm_slli_epi64(odd, 2)));
+}
+#define FE_SSE2_LOAD(p) _mm_loadu_si128((__m128i const *)(p))
+#define FE_SSE2_STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define FE_SSE2_REV(v) _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3))
+#define FE_SSE2_NEG(v) _mm_sub_epi32(_mm_setzero_si128(), v)
+FE_DEFINE_BUTTERFLIES(fe_fft_butterflies_sse2, , __m128i, 4,
+                      FE_SSE2_LOAD, FE_SSE2_STORE, FE_SSE2_REV,
+                      fe_cosmul_sse2, _mm_add_epi32, _mm_sub_epi32,
+                      FE_SSE2_NEG)
+FE_DEFINE_DCT(fe_dct_sse2, , __m128i, 4,
+              FE_SSE2_LOAD, FE_SSE2_STORE, _mm_set1_epi32,
+              _mm_setzero_si128(), fe_cosmul_sse2, _mm_add_epi32,
+              FE_ROUND_NONE)
+#endif /* SPHINX_HAVE_SSE2 */
+
+#ifdef SPHINX_HAVE_AVX2
+static inline SIMD_TARGET_AVX2 __m256i
+fe_cosmul_avx2(__m256i a, __m256i b)
+{
+    __m256i even, odd;
+
+    even = _mm256_mul_epi32(a, b);
+    odd = _mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                           _mm256_srli_epi64(b, 32));
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, 30),
+                              _mm256_slli_epi64(odd, 2), 0xaa);
+}
+#define FE_AVX2_LOAD(p) _mm256_loadu_si256((__m256i const *)(p))
+#define FE_AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define FE_AVX2_REV(v) \
+    _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0))
+#define FE_AVX2_NEG(v) _mm256_sub_epi32(_mm256_setzero_si256(), v)
+FE_DEFINE_BUTTERFLIES(fe_fft_butterflies_avx2, SIMD_TARGET_AVX2, __m256i, 8,
+                      FE_AVX2_LOAD, FE_AVX2_STORE, FE_AVX2_REV,
+                      fe_cosmul_avx2, _mm256_add_epi32, _mm256_sub_epi32,
+                      FE_AVX2_NEG)
+FE_DEFINE_DCT(fe_dct_avx2, SIMD_TARGET_AVX2, __m256i, 8,
+              FE_AVX2_LOAD, FE_AVX2_STORE, _mm256_set1_epi32,
+              _mm256_setzero_si256(), fe_cosmul_avx2, _mm256_add_epi32,
+              FE_ROUND_NONE)
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+static inline int32x4_t
+fe_cosmul_neon(int32x4_t a, int32x4_t b)
+{
+    return vcombine_s32(vshrn_n_s64(vmull_s32(vget_low_s32(a),
+                                              vget_low_s32(b)), 30),
+                        vshrn_n_s64(vmull_high_s32(a, b), 30));
+}
+static inline int32x4_t
+fe_rev_neon(int32x4_t v)
+{
+    v = vrev64q_s32(v);
+    return vextq_s32(v, v, 2);
+}
+FE_DEFINE_BUTTERFLIES(fe_fft_butterflies_neon, , int32x4_t, 4,
+                      vld1q_s32, vst1q_s32, fe_rev_neon,
+                      fe_cosmul_neon, vaddq_s32, vsubq_s32, vnegq_s32)
+FE_DEFINE_DCT(fe_dct_neon, , int32x4_t, 4,
+              vld1q_s32, vst1q_s32, vdupq_n_s32, vdupq_n_s32(0),
+              fe_cosmul_neon, vaddq_s32, FE_ROUND_NONE)
+#endif /* SPHINX_HAVE_NEON */
+
+#else /* !FIXED_POINT */
+
+#ifdef SPHINX_HAVE_SSE2
+#define FE_SSE2_REV(v) _mm_shuffle_pd(v, v, 1)
+#define FE_SSE2_NEG(v) _mm_xor_pd(v, _mm_set1_pd(-0.0))
+#define FE_SSE2_ROUND(v) _mm_cvtps_pd(_mm_cvtpd_ps(v))
+static inline double
+fe_hsum_sse2(__m128d v)
+{
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+FE_DEFINE_BUTTERFLIES(fe_fft_butterflies_sse2, , __m128d, 2,
+                      _mm_loadu_pd, _mm_storeu_pd, FE_SSE2_REV,
+                      _mm_mul_pd, _mm_add_pd, _mm_sub_pd, FE_SSE2_NEG)
+FE_DEFINE_POWER(fe_spec_power_sse2, , __m128d, 2,
+                _mm_loadu_pd, _mm_storeu_pd, FE_SSE2_REV,
+                _mm_mul_pd, _mm_add_pd)
+FE_DEFINE_MELSPEC(fe_mel_spec_sse2, , __m128d, 2,
+                  _mm_loadu_pd, _mm_setzero_pd(), _mm_mul_pd, _mm_add_pd,
+                  fe_hsum_sse2)
+FE_DEFINE_DCT(fe_dct_sse2, , __m128d, 2,
+              _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_setzero_pd(),
+              _mm_mul_pd, _mm_add_pd, FE_SSE2_ROUND)
+#endif /* SPHINX_HAVE_SSE2 */
+
+#ifdef SPHINX_HAVE_AVX2
+#define FE_AVX2_REV(v) _mm256_permute4x64_pd(v, _MM_SHUFFLE(0, 1, 2, 3))
+#define FE_AVX2_NEG(v) _mm256_xor_pd(v, _mm256_set1_pd(-0.0))
+#define FE_AVX2_ROUND(v) _mm256_cvtps_pd(_mm256_cvtpd_ps(v))
+static inline SIMD_TARGET_AVX2 double
+fe_hsum_avx2(__m256d v)
+{
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(v),
+                           _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+FE_DEFINE_BUTTERFLIES(fe_fft_butterflies_avx2, SIMD_TARGET_AVX2, __m256d, 4,
+                      _mm256_loadu_pd, _mm256_storeu_pd, FE_AVX2_REV,
+                      _mm256_mul_pd, _mm256_add_pd, _mm256_sub_pd,
+                      FE_AVX2_NEG)
+FE_DEFINE_POWER(fe_spec_power_avx2, SIMD_TARGET_AVX2, __m256d, 4,
+                _mm256_loadu_pd, _mm256_storeu_pd, FE_AVX2_REV,
+                _mm256_mul_pd, _mm256_add_pd)
+FE_DEFINE_MELSPEC(fe_mel_spec_avx2, SIMD_TARGET_AVX2, __m256d, 4,
+                  _mm256_loadu_pd, _mm256_setzero_pd(), _mm256_mul_pd,
+                  _mm256_add_pd, fe_hsum_avx2)
+FE_DEFINE_DCT(fe_dct_avx2, SIMD_TARGET_AVX2, __m256d, 4,
+              _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd,
+              _mm256_setzero_pd(), _mm256_mul_pd, _mm256_add_pd,
+              FE_AVX2_ROUND)
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+#define FE_NEON_REV(v) vextq_f64(v, v, 1)
+#define FE_NEON_ROUND(v) vcvt_f64_f32(vcvt_f32_f64(v))
+FE_DEFINE_BUTTERFLIES(fe_fft_butterflies_neon, , float64x2_t, 2,
+                      vld1q_f64, vst1q_f64, FE_NEON_REV,
+                      vmulq_f64, vaddq_f64, vsubq_f64, vnegq_f64)
+FE_DEFINE_POWER(fe_spec_power_neon, , float64x2_t, 2,
+                vld1q_f64, vst1q_f64, FE_NEON_REV,
+                vmulq_f64, vaddq_f64)
+FE_DEFINE_MELSPEC(fe_mel_spec_neon, , float64x2_t, 2,
+                  vld1q_f64, vdupq_n_f64(0.0), vmulq_f64, vaddq_f64,
+                  vaddvq_f64)
+FE_DEFINE_DCT(fe_dct_neon, , float64x2_t, 2,
+              vld1q_f64, vst1q_f64, vdupq_n_f64, vdupq_n_f64(0.0),
+              vmulq_f64, vaddq_f64, FE_NEON_ROUND)
+#endif /* SPHINX_HAVE_NEON */
+
+#endif /* !FIXED_POINT */
+
+/* Packed filter rows and cepstra are padded to the widest vector of
+ * powspec_t that any kernel uses. */
+#define FE_FILT_PACK 4
+#define FE_CEP_PACK 8
+
 static float32
 fe_mel(melfb_t * mel, float32 x)
 {
@@ -549,6 +834,56 @@ fe_melinv(melfb_t * mel, float32 x)
     return fe_warp_warped_to_unwarped(mel, warped);
 }
 
+#ifndef FIXED_POINT
+/**
+ * Copy the filter coefficients into packed_coeffs, padding each
+ * filter with zeros to a whole number of vectors, and pick the
+ * filterbank kernel.
+ */
+static void
+fe_pack_melfilters(melfb_t * mel_fb)
+{
+    uint32 simd;
+    int n_coeffs, i, j;
+
+    mel_fb->packed_start =
+        ckd_calloc(mel_fb->num_filters, sizeof(*mel_fb->packed_start));
+    mel_fb->packed_width =
+        ckd_calloc(mel_fb->num_filters, sizeof(*mel_fb->packed_width));
+    n_coeffs = 0;
+    for (i = 0; i < mel_fb->num_filters; ++i) {
+        mel_fb->packed_start[i] = n_coeffs;
+        mel_fb->packed_width[i] = (mel_fb->filt_width[i] + FE_FILT_PACK - 1)
+            / FE_FILT_PACK * FE_FILT_PACK;
+        n_coeffs += mel_fb->packed_width[i];
+    }
+
+    /* The padding reads past the end of the filter, but never past
+     * the end of the (fft_size long) power spectrum. */
+    mel_fb->packed_coeffs =
+        ckd_calloc(n_coeffs, sizeof(*mel_fb->packed_coeffs));
+    for (i = 0; i < mel_fb->num_filters; ++i)
+        for (j = 0; j < mel_fb->filt_width[i]; ++j)
+            mel_fb->packed_coeffs[mel_fb->packed_start[i] + j]
+                = mel_fb->filt_coeffs[mel_fb->filt_start[i] + j];
+
+    mel_fb->mel_spec = NULL;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON)
+        mel_fb->mel_spec = fe_mel_spec_neon;
+#endif
+#ifdef SPHINX_HAVE_SSE2
+    if (simd & SIMD_SSE2)
+        mel_fb->mel_spec = fe_mel_spec_sse2;
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2)
+        mel_fb->mel_spec = fe_mel_spec_avx2;
+#endif
+}
+#endif /* !FIXED_POINT */
+
 int32
 fe_build_melfilters(melfb_t * mel_fb)
 {
@@ -680,6 +1015,10 @@ fe_build_melfilters(melfb_t * mel_fb)
         }
     }
 
+#ifndef FIXED_POINT
+    fe_pack_melfilters(mel_fb);
+#endif
+
     return FE_SUCCESS;
 }
 
@@ -688,6 +1027,7 @@ fe_compute_melcosine(melfb_t * mel_fb)
 {
 
     float64 freqstep;
+    uint32 simd;
     int32 i, j;
 
     mel_fb->mel_cosine =
@@ -706,6 +1046,34 @@ fe_compute_melcosine(melfb_t * mel_fb)
         }
     }
 
+    /* Transposed copy for the vector kernels, so that each filter's
+     * contribution to all cepstra is contiguous. */
+    mel_fb->cosine_stride = (mel_fb->num_cepstra + FE_CEP_PACK - 1)
+        / FE_CEP_PACK * FE_CEP_PACK;
+    mel_fb->cosine_t = ckd_calloc(mel_fb->num_filters * mel_fb->cosine_stride,
+                                  sizeof(*mel_fb->cosine_t));
+    mel_fb->dct_out = ckd_calloc(mel_fb->cosine_stride,
+                                 sizeof(*mel_fb->dct_out));
+    for (i = 0; i < mel_fb->num_cepstra; i++)
+        for (j = 0; j < mel_fb->num_filters; j++)
+            mel_fb->cosine_t[j * mel_fb->cosine_stride + i]
+                = mel_fb->mel_cosine[i][j];
+
+    mel_fb->dct = NULL;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON)
+        mel_fb->dct = fe_dct_neon;
+#endif
+#ifdef SPHINX_HAVE_SSE2
+    if (simd & SIMD_SSE2)
+        mel_fb->dct = fe_dct_sse2;
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2)
+        mel_fb->dct = fe_dct_avx2;
+#endif
+
     /* Also precompute normalization constants for unitary DCT. */
     mel_fb->sqrt_inv_n = FLOAT2COS(sqrt(1.0 / mel_fb->num_filters));
     mel_fb->sqrt_inv_2n = FLOAT2COS(sqrt(2.0 / mel_fb->num_filters));
@@ -865,12 +1233,13 @@ fe_shift_frame(fe_t * fe, int16 const *in, int32 len)
 }
 
 /**
- * Create arrays of twiddle factors.
+ * Create arrays of twiddle factors, and pick the FFT kernels.
  */
 void
 fe_create_twiddle(fe_t * fe)
 {
-    int i;
+    uint32 simd;
+    int i, j, k;
 
     for (i = 0; i < fe->fft_size / 4; ++i) {
         float64 a = 2 * M_PI * i / fe->fft_size;
@@ -882,16 +1251,55 @@ fe_create_twiddle(fe_t * fe)
         fe->sss[i] = sin(a);
 #endif
     }
+
+    /* Butterfly stage k uses every (1 << (m-k-1))th twiddle factor,
+     * for j < (1 << (k-1)).  Store each stage's factors contiguously
+     * starting at offset (1 << (k-1)) - 1. */
+    for (k = 1; k < fe->fft_order; ++k) {
+        for (j = 0; j < (1 << (k - 1)); ++j) {
+            fe->stage_ccc[(1 << (k - 1)) - 1 + j]
+                = fe->ccc[j << (fe->fft_order - k - 1)];
+            fe->stage_sss[(1 << (k - 1)) - 1 + j]
+                = fe->sss[j << (fe->fft_order - k - 1)];
+        }
+    }
+
+    fe->fft_butterflies = NULL;
+    fe->spec_power = NULL;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON) {
+        fe->fft_butterflies = fe_fft_butterflies_neon;
+#ifndef FIXED_POINT
+        fe->spec_power = fe_spec_power_neon;
+#endif
+    }
+#endif
+#ifdef SPHINX_HAVE_SSE2
+    if (simd & SIMD_SSE2) {
+        fe->fft_butterflies = fe_fft_butterflies_sse2;
+#ifndef FIXED_POINT
+        fe->spec_power = fe_spec_power_sse2;
+#endif
+    }
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2) {
+        fe->fft_butterflies = fe_fft_butterflies_avx2;
+#ifndef FIXED_POINT
+        fe->spec_power = fe_spec_power_avx2;
+#endif
+    }
+#endif
 }
 
 
 static int
-fe_fft_real(fe_t * fe)
+fe_fft_real(fe_t * fe, frame_t * x)
 {
     int i, j, k, m, n;
-    frame_t *x, xt;
+    frame_t xt;
 
-    x = fe->frame;
     m = fe->fft_order;
     n = fe->fft_size;
 
@@ -950,7 +1358,12 @@ fe_fft_real(fe_t * fe)
             /* Butterflies with complex twiddle factors.
              * There are (1<<k-1) of them.
              */
-            for (j = 1; j < (1 << n4); ++j) {
+            j = 1;
+            if (fe->fft_butterflies)
+                j = fe->fft_butterflies(x + i, 1 << n2, 1 << n4,
+                                        fe->stage_ccc + (1 << n4) - 1,
+                                        fe->stage_sss + (1 << n4) - 1);
+            for (; j < (1 << n4); ++j) {
                 frame_t cc, ss, t1, t2;
                 int i1, i2, i3, i4;
 
@@ -984,19 +1397,13 @@ fe_fft_real(fe_t * fe)
 }
 
 static void
-fe_spec_magnitude(fe_t * fe)
+fe_spec_magnitude(fe_t * fe, frame_t * fft, powspec_t * spec)
 {
-    frame_t *fft;
-    powspec_t *spec;
     int32 j, scale, fftsize;
 
     /* Do FFT and get the scaling factor back (only actually used in
      * fixed-point).  Note the scaling factor is expressed in bits. */
-    scale = fe_fft_real(fe);
-
-    /* Convenience pointers to make things less awkward below. */
-    fft = fe->frame;
-    spec = fe->spec;
+    scale = fe_fft_real(fe, fft);
     fftsize = fe->fft_size;
 
     /* We need to scale things up the rest of the way to N. */
@@ -1011,7 +1418,10 @@ fe_spec_magnitude(fe_t * fe)
 #endif
     }
 
-    for (j = 1; j <= fftsize / 2; j++) {
+    j = 1;
+    if (fe->spec_power)
+        j = fe->spec_power(fft, spec, fftsize);
+    for (; j <= fftsize / 2; j++) {
 #if defined(FIXED_POINT)
         int32 rr = FIXLN(abs(fft[j]) << scale) * 2;
         int32 ii = FIXLN(abs(fft[fftsize - j]) << scale) * 2;
@@ -1023,14 +1433,14 @@ fe_spec_magnitude(fe_t * fe)
 }
 
 static void
-fe_mel_spec(fe_t * fe)
+fe_mel_spec(fe_t * fe, powspec_t const * spec, powspec_t * mfspec)
 {
     int whichfilt;
-    powspec_t *spec, *mfspec;
 
-    /* Convenience poitners. */
-    spec = fe->spec;
-    mfspec = fe->mfspec;
+    if (fe->mel_fb->mel_spec) {
+        fe->mel_fb->mel_spec(fe->mel_fb, spec, mfspec);
+        return;
+    }
     for (whichfilt = 0; whichfilt < fe->mel_fb->num_filters; whichfilt++) {
         int spec_start, filt_start, i;
 
@@ -1111,6 +1521,14 @@ fe_spec2cep(fe_t * fe, const powspec_t * mflogspec, mfcc_t * mfcep)
         mfcep[0] += mflogspec[j];       /* beta = 1.0 */
     mfcep[0] /= (frame_t) fe->mel_fb->num_filters;
 
+    if (fe->mel_fb->dct) {
+        fe->mel_fb->dct(fe->mel_fb, mflogspec, 2);
+        for (i = 1; i < fe->num_cepstra; ++i)
+            mfcep[i] = (mfcc_t) fe->mel_fb->dct_out[i]
+                / ((frame_t) fe->mel_fb->num_filters * 2);
+        return;
+    }
+
     for (i = 1; i < fe->num_cepstra; ++i) {
         mfcep[i] = 0;
         for (j = 0; j < fe->mel_fb->num_filters; j++) {
@@ -1143,6 +1561,14 @@ fe_dct2(fe_t * fe, const powspec_t * mflogspec, mfcc_t * mfcep, int htk)
     else                        /* sqrt(1/N) = sqrt(2/N) * 1/sqrt(2) */
         mfcep[0] = COSMUL(mfcep[0], fe->mel_fb->sqrt_inv_n);
 
+    if (fe->mel_fb->dct) {
+        fe->mel_fb->dct(fe->mel_fb, mflogspec, 1);
+        for (i = 1; i < fe->num_cepstra; ++i)
+            mfcep[i] = COSMUL((mfcc_t) fe->mel_fb->dct_out[i],
+                              fe->mel_fb->sqrt_inv_2n);
+        return;
+    }
+
     for (i = 1; i < fe->num_cepstra; ++i) {
         mfcep[i] = 0;
         for (j = 0; j < fe->mel_fb->num_filters; j++) {
@@ -1179,17 +1605,179 @@ fe_dct3(fe_t * fe, const mfcc_t * mfcep, powspec_t * mflogspec)
     }
 }
 
-void
-fe_write_frame(fe_t * fe, mfcc_t * feat, int32 store_pcm)
+static void
+fe_finish_frame(fe_t * fe, mfcc_t * feat, int32 store_pcm)
 {
     int32 is_speech;
+    mfcc_t *out;
 
-    fe_spec_magnitude(fe);
-    fe_mel_spec(fe);
+    /* Outside speech the frame goes to the prespeech buffer, so
+     * compute it in place there. */
+    out = feat;
+    if (!fe->vad_data->in_speech)
+        out = fe_prespch_cep_slot(fe->vad_data->prespch_buf);
     fe_track_snr(fe, &is_speech);
-    fe_mel_cep(fe, feat);
-    fe_lifter(fe, feat);
-    fe_vad_hangover(fe, feat, is_speech, store_pcm);
+    fe_mel_cep(fe, out);
+    fe_lifter(fe, out);
+    fe_vad_hangover(fe, out, is_speech, store_pcm);
+    /* fe_end_utt() returns the frame itself if it started speech. */
+    if (out != feat && fe->vad_data->in_speech)
+        memcpy(feat, out, fe->feature_dimension * sizeof(*feat));
+}
+
+/**
+ * Keep a frame skipped by -vad_cheap, dropping the oldest one once
+ * there are more than could end up in the prespeech buffer.
+ */
+static void
+fe_keep_skipped_frame(fe_t * fe)
+{
+    vad_data_t *vad_data = fe->vad_data;
+    int32 idx;
+
+    if (fe->pre_speech <= 0)
+        return;
+    if (vad_data->n_skipped == fe->pre_speech) {
+        vad_data->skipped_start =
+            (vad_data->skipped_start + 1) % fe->pre_speech;
+        vad_data->n_skipped--;
+    }
+    idx = (vad_data->skipped_start + vad_data->n_skipped) % fe->pre_speech;
+    memcpy(vad_data->skipped_frames + idx * fe->fft_size, fe->frame,
+           fe->fft_size * sizeof(*fe->frame));
+    vad_data->n_skipped++;
+}
+
+/**
+ * Run the skipped frames through the full front end after all, since
+ * they are recent enough to be needed if speech starts.  Returns the
+ * number of frames processed.
+ */
+static int32
+fe_process_skipped_frames(fe_t * fe, mfcc_t * feat)
+{
+    vad_data_t *vad_data = fe->vad_data;
+    int32 n, in_speech;
+
+    for (n = 0; vad_data->n_skipped > 0; ++n) {
+        frame_t *frame = vad_data->skipped_frames
+            + vad_data->skipped_start * fe->fft_size;
+
+        fe_spec_magnitude(fe, frame, fe->spec);
+        fe_mel_spec(fe, fe->spec, fe->mfspec);
+        in_speech = vad_data->in_speech;
+        fe_finish_frame(fe, feat, FALSE);
+        /* Once in speech, the hangover no longer buffers frames, but
+         * the caller only takes one, so buffer the rest here. */
+        if (in_speech)
+            fe_prespch_append_cep(vad_data->prespch_buf, feat);
+        vad_data->skipped_start =
+            (vad_data->skipped_start + 1) % fe->pre_speech;
+        vad_data->n_skipped--;
+    }
+    return n;
+}
+
+void
+fe_write_frame(fe_t * fe, mfcc_t * feat, int32 store_pcm)
+{
+    int32 n_skipped, in_speech;
+
+    n_skipped = 0;
+    if (fe->vad_cheap && fe->remove_silence && !store_pcm) {
+        if (fe_vad_quiet(fe)) {
+            fe_keep_skipped_frame(fe);
+            return;
+        }
+        n_skipped = fe_process_skipped_frames(fe, feat);
+    }
+
+    fe_spec_magnitude(fe, fe->frame, fe->spec);
+    fe_mel_spec(fe, fe->spec, fe->mfspec);
+    in_speech = fe->vad_data->in_speech;
+    fe_finish_frame(fe, feat, store_pcm);
+    if (n_skipped && in_speech)
+        fe_prespch_append_cep(fe->vad_data->prespch_buf, feat);
+}
+
+int
+fe_shift_block(fe_t * fe, int16 const *in, int32 nframes)
+{
+    int16 *spch;
+    int32 offset, len, shift, nfilt, i, k;
+
+    if (nframes > FE_BLOCK_FRAMES)
+        nframes = FE_BLOCK_FRAMES;
+    shift = fe->frame_shift;
+    offset = fe->frame_size - shift;
+    len = nframes * shift;
+    nfilt = fe->mel_fb->num_filters;
+
+    /* Lay out the samples for all the frames contiguously, starting
+     * with the end of the last frame, then swap and dither the new
+     * ones in the same order as fe_shift_frame() would. */
+    spch = fe->block_spch;
+    memcpy(spch, fe->spch + shift, offset * sizeof(*spch));
+    memcpy(spch + offset, in, len * sizeof(*spch));
+    if (fe->swap)
+        for (i = 0; i < len; ++i)
+            SWAP_INT16(&spch[offset + i]);
+    if (fe->dither)
+        for (i = 0; i < len; ++i)
+            spch[offset + i] += (int16) ((!(s3_rand_int31() % 4)) ? 1 : 0);
+
+    /* Each stage now runs over the whole block before the next one
+     * starts.  The first is pre-emphasis, where the prior sample of
+     * each frame is simply the one before it in the block. */
+    for (k = 0; k < nframes; ++k) {
+        int16 const *frame_spch = spch + k * shift;
+        frame_t *frame = fe->block_frame + k * fe->fft_size;
+
+        if (fe->pre_emphasis_alpha != 0.0)
+            fe_pre_emphasis(frame_spch, frame, fe->frame_size,
+                            fe->pre_emphasis_alpha,
+                            k ? frame_spch[-1] : fe->prior);
+        else
+            fe_short_to_frame(frame_spch, frame, fe->frame_size);
+    }
+    if (fe->pre_emphasis_alpha != 0.0)
+        fe->prior = spch[len - 1];
+
+    for (k = 0; k < nframes; ++k) {
+        frame_t *frame = fe->block_frame + k * fe->fft_size;
+
+        memset(frame + fe->frame_size, 0,
+               (fe->fft_size - fe->frame_size) * sizeof(*frame));
+        fe_hamming_window(frame, fe->hamming_window, fe->frame_size,
+                          fe->remove_dc);
+    }
+
+    for (k = 0; k < nframes; ++k)
+        fe_spec_magnitude(fe, fe->block_frame + k * fe->fft_size,
+                          fe->block_spec + k * fe->fft_size);
+
+    for (k = 0; k < nframes; ++k)
+        fe_mel_spec(fe, fe->block_spec + k * fe->fft_size,
+                    fe->block_mfspec + k * nfilt);
+
+    /* Leave the raw speech buffer as fe_shift_frame() would have. */
+    memcpy(fe->spch, spch + len - shift, fe->frame_size * sizeof(*spch));
+
+    return nframes;
+}
+
+void
+fe_write_block_frame(fe_t * fe, int32 idx, mfcc_t * feat, int32 store_pcm)
+{
+    /* Noise tracking and VAD depend on the previous frame, so this
+     * part runs one frame at a time on the buffers fe_write_frame()
+     * uses. */
+    memcpy(fe->mfspec, fe->block_mfspec + idx * fe->mel_fb->num_filters,
+           fe->mel_fb->num_filters * sizeof(*fe->mfspec));
+    if (store_pcm)
+        memcpy(fe->spch, fe->block_spch + idx * fe->frame_shift,
+               fe->frame_size * sizeof(*fe->spch));
+    fe_finish_frame(fe, feat, store_pcm);
 }
 
 
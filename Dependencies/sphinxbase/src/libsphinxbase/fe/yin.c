@@ -42,11 +42,35 @@
 #include "sphinxbase/prim_type.h"
 #include "sphinxbase/ckd_alloc.h"
 #include "sphinxbase/fixpoint.h"
+#include "sphinxbase/simd.h"
 
 #include "sphinxbase/yin.h"
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+
+#ifdef SPHINX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * Vectorized butterflies for one group of one FFT stage.  Handles
+ * 0 <= j < half in whole vectors and returns the first j left.
+ */
+typedef int (*yin_butterfly_func)(float64 *re, float64 *im,
+                                  float64 const *wr, float64 const *wi,
+                                  int half);
 
 struct yin_s {
     uint16 frame_size;       /** Size of analysis frame. */
@@ -71,8 +95,148 @@ struct yin_s {
 #endif
     uint16 *period_window;  /**< Window of best period estimates. */
     int16 *frame;           /**< Storage for frame */
+
+    int use_fft;            /**< Use cmn_diff_fft() instead of cmn_diff(). */
+    int fft_size;           /**< Size of the FFT for the autocorrelation. */
+    float64 *fft_re;        /**< FFT work buffer, real parts. */
+    float64 *fft_im;        /**< FFT work buffer, imaginary parts. */
+    float64 *tw_re;         /**< Twiddle factors for each stage in turn. */
+    float64 *tw_im;
+    int32 *bitrev;          /**< Bit-reversal permutation. */
+    int64 *diff;            /**< Difference function. */
+    yin_butterfly_func butterflies; /**< Vector kernel, or NULL. */
 };
 
+#define YIN_DEFINE_BUTTERFLIES(name, attr, vec_t, width,                \
+                               LOAD, STORE, MUL, ADD, SUB)              \
+    static attr int                                                     \
+    name(float64 *re, float64 *im, float64 const *wr,                   \
+         float64 const *wi, int half)                                   \
+    {                                                                   \
+        int j;                                                          \
+                                                                        \
+        for (j = 0; j + width <= half; j += width) {                    \
+            vec_t cr = LOAD(wr + j), ci = LOAD(wi + j);                 \
+            vec_t xr = LOAD(re + half + j), xi = LOAD(im + half + j);   \
+            vec_t tr = SUB(MUL(cr, xr), MUL(ci, xi));                   \
+            vec_t ti = ADD(MUL(cr, xi), MUL(ci, xr));                   \
+            vec_t ur = LOAD(re + j), ui = LOAD(im + j);                 \
+            STORE(re + half + j, SUB(ur, tr));                          \
+            STORE(im + half + j, SUB(ui, ti));                          \
+            STORE(re + j, ADD(ur, tr));                                 \
+            STORE(im + j, ADD(ui, ti));                                 \
+        }                                                               \
+        return j;                                                       \
+    }
+
+#ifdef SPHINX_HAVE_SSE2
+YIN_DEFINE_BUTTERFLIES(yin_butterflies_sse2, , __m128d, 2,
+                       _mm_loadu_pd, _mm_storeu_pd,
+                       _mm_mul_pd, _mm_add_pd, _mm_sub_pd)
+#endif
+#ifdef SPHINX_HAVE_AVX2
+YIN_DEFINE_BUTTERFLIES(yin_butterflies_avx2, SIMD_TARGET_AVX2, __m256d, 4,
+                       _mm256_loadu_pd, _mm256_storeu_pd,
+                       _mm256_mul_pd, _mm256_add_pd, _mm256_sub_pd)
+#endif
+#ifdef SPHINX_HAVE_NEON
+YIN_DEFINE_BUTTERFLIES(yin_butterflies_neon, , float64x2_t, 2,
+                       vld1q_f64, vst1q_f64, vmulq_f64, vaddq_f64, vsubq_f64)
+#endif
+
+/**
+ * In-place complex FFT of pe->fft_re, pe->fft_im.
+ */
+static void
+yin_fft(yin_t *pe)
+{
+    float64 *re = pe->fft_re, *im = pe->fft_im;
+    float64 const *wr = pe->tw_re, *wi = pe->tw_im;
+    int n = pe->fft_size;
+    int half, k, j;
+
+    for (k = 0; k < n; ++k) {
+        j = pe->bitrev[k];
+        if (j > k) {
+            float64 t;
+            t = re[k]; re[k] = re[j]; re[j] = t;
+            t = im[k]; im[k] = im[j]; im[j] = t;
+        }
+    }
+    for (half = 1; half < n; half *= 2) {
+        for (k = 0; k < n; k += 2 * half) {
+            float64 *xr = re + k, *xi = im + k;
+
+            j = pe->butterflies ? pe->butterflies(xr, xi, wr, wi, half) : 0;
+            for (; j < half; ++j) {
+                float64 tr = wr[j] * xr[half + j] - wi[j] * xi[half + j];
+                float64 ti = wr[j] * xi[half + j] + wi[j] * xr[half + j];
+                xr[half + j] = xr[j] - tr;
+                xi[half + j] = xi[j] - ti;
+                xr[j] += tr;
+                xi[j] += ti;
+            }
+        }
+        wr += half;
+        wi += half;
+    }
+}
+
+/**
+ * Difference function d(t) = sum_j (x[j] - x[t + j])^2 for 0 <= j, t
+ * < ndiff, written to pe->diff.
+ *
+ * This is expanded as e(0) + e(t) - 2 r(t), where e(t) is the energy
+ * of x[t .. t + ndiff - 1], updated as a running sum, and r(t) is the
+ * cross-correlation of x[0 .. ndiff - 1] with x, done with one
+ * forward and one inverse FFT.  The result is rounded back to
+ * integers, which is exact as the rounding error is far below 0.5.
+ */
+static void
+yin_diff(yin_t *pe, int16 const *signal, int ndiff)
+{
+    float64 *re = pe->fft_re, *im = pe->fft_im;
+    int n = pe->fft_size;
+    int64 e0, et;
+    int t, k;
+
+    /* Pack x[0 .. ndiff - 1] and x[0 .. 2 * ndiff - 2] as the real
+     * and imaginary parts of one transform. */
+    for (k = 0; k < n; ++k) {
+        re[k] = (k < ndiff) ? signal[k] : 0;
+        im[k] = (k < 2 * ndiff - 1) ? signal[k] : 0;
+    }
+    yin_fft(pe);
+
+    /* Separate the two spectra A and B, and form conj(A) B, conjugated
+     * so that a forward transform does the inverse. */
+    for (k = 0; k <= n / 2; ++k) {
+        int nk = (n - k) & (n - 1);
+        float64 ar = (re[k] + re[nk]) / 2, ai = (im[k] - im[nk]) / 2;
+        float64 br = (im[k] + im[nk]) / 2, bi = (re[nk] - re[k]) / 2;
+        float64 cr = ar * br + ai * bi, ci = ar * bi - ai * br;
+
+        re[k] = cr;
+        im[k] = -ci;
+        re[nk] = cr;
+        im[nk] = ci;
+    }
+    yin_fft(pe);
+
+    e0 = 0;
+    for (k = 0; k < ndiff; ++k)
+        e0 += signal[k] * signal[k];
+    et = e0;
+    pe->diff[0] = 0;
+    for (t = 1; t < ndiff; ++t) {
+        int64 r = (int64)floor(re[t] / n + 0.5);
+
+        et += signal[t + ndiff - 1] * signal[t + ndiff - 1]
+            - signal[t - 1] * signal[t - 1];
+        pe->diff[t] = e0 + et - 2 * r;
+    }
+}
+
 /**
  * The core of YIN: cumulative mean normalized difference function.
  */
@@ -160,11 +324,65 @@ cmn_diff(int16 const *signal, int32 *out_diff, int ndiff)
 }
 #endif
 
+/**
+ * Same as cmn_diff(), but from the exact difference function computed
+ * by yin_diff().  Its rounding differs from that of the direct sums, so
+ * a few frames get a different period.
+ */
+#ifndef FIXED_POINT
+static void
+cmn_diff_fft(yin_t *pe, int16 const *signal, float *out_diff, int ndiff)
+{
+    double cum;
+    int t;
+
+    yin_diff(pe, signal, ndiff);
+    cum = 0.0f;
+    out_diff[0] = 1.0f;
+
+    for (t = 1; t < ndiff; ++t) {
+        double dd = (double)pe->diff[t];
+        cum += dd;
+        out_diff[t] = (float)(dd * t / cum);
+    }
+}
+#else
+static void
+cmn_diff_fft(yin_t *pe, int16 const *signal, int32 *out_diff, int ndiff)
+{
+    uint64 cum;
+    int32 t;
+
+    yin_diff(pe, signal, ndiff);
+    out_diff[0] = 32768;
+    cum = 0;
+
+    for (t = 1; t < ndiff; ++t) {
+        uint64 num, den;
+
+        cum += pe->diff[t];
+        /* dd * t / cum in Q15, dropping low bits of both sides if
+         * the numerator gets too big to shift up. */
+        num = (uint64)pe->diff[t] * t;
+        den = cum;
+        while (num >= ((uint64)1 << 47)) {
+            num >>= 1;
+            den >>= 1;
+        }
+        /* Avoid divide-by-zero! */
+        if (den == 0) den = 1;
+        out_diff[t] = (int32)((num << 15) / den);
+    }
+}
+#endif
+
 yin_t *
 yin_init(int frame_size, float search_threshold,
          float search_range, int smooth_window)
 {
     yin_t *pe;
+    uint32 simd;
+    int i, j, half;
 
     pe = ckd_calloc(1, sizeof(*pe));
     pe->frame_size = frame_size;
@@ -182,6 +400,43 @@ yin_init(int frame_size, float search_threshold,
     pe->period_window = ckd_calloc(pe->wsize,
                                    sizeof(*pe->period_window));
     pe->frame = ckd_calloc(pe->frame_size, sizeof(*pe->frame));
+
+    /* The cross-correlation needs 2 * (frame_size / 2) - 1 points
+     * without wrapping around. */
+    for (pe->fft_size = 2; pe->fft_size < frame_size; pe->fft_size *= 2)
+        ;
+    pe->fft_re = ckd_calloc(pe->fft_size, sizeof(*pe->fft_re));
+    pe->fft_im = ckd_calloc(pe->fft_size, sizeof(*pe->fft_im));
+    pe->tw_re = ckd_calloc(pe->fft_size, sizeof(*pe->tw_re));
+    pe->tw_im = ckd_calloc(pe->fft_size, sizeof(*pe->tw_im));
+    pe->bitrev = ckd_calloc(pe->fft_size, sizeof(*pe->bitrev));
+    pe->diff = ckd_calloc(pe->frame_size / 2, sizeof(*pe->diff));
+    for (i = 0, half = 1; half < pe->fft_size; half *= 2)
+        for (j = 0; j < half; ++j, ++i) {
+            pe->tw_re[i] = cos(M_PI * j / half);
+            pe->tw_im[i] = -sin(M_PI * j / half);
+        }
+    for (i = 0; i < pe->fft_size; ++i)
+        for (j = 1; j < pe->fft_size; j *= 2) {
+            pe->bitrev[i] <<= 1;
+            if (i & j)
+                pe->bitrev[i] |= 1;
+        }
+
+    pe->butterflies = NULL;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON)
+        pe->butterflies = yin_butterflies_neon;
+#endif
+#ifdef SPHINX_HAVE_SSE2
+    if (simd & SIMD_SSE2)
+        pe->butterflies = yin_butterflies_sse2;
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2)
+        pe->butterflies = yin_butterflies_avx2;
+#endif
     return pe;
 }
 
@@ -190,9 +445,22 @@ yin_free(yin_t *pe)
 {
     ckd_free_2d(pe->diff_window);
     ckd_free(pe->period_window);
+    ckd_free(pe->frame);
+    ckd_free(pe->fft_re);
+    ckd_free(pe->fft_im);
+    ckd_free(pe->tw_re);
+    ckd_free(pe->tw_im);
+    ckd_free(pe->bitrev);
+    ckd_free(pe->diff);
     ckd_free(pe);
 }
 
+void
+yin_set_fft(yin_t *pe, int use_fft)
+{
+    pe->use_fft = use_fft;
+}
+
 void
 yin_start(yin_t *pe)
 {
@@ -264,7 +532,10 @@ yin_write(yin_t *pe, int16 const *frame)
 
     /* Now calculate normalized difference function. */
     difflen = pe->frame_size / 2;
-    cmn_diff(frame, pe->diff_window[outptr], difflen);
+    if (pe->use_fft)
+        cmn_diff_fft(pe, frame, pe->diff_window[outptr], difflen);
+    else
+        cmn_diff(frame, pe->diff_window[outptr], difflen);
 
     /* Find the first point under threshold.  If not found, then
      * use the absolute minimum. */
@@ -136,6 +136,17 @@
 #include "sphinxbase/ckd_alloc.h"
 #include "sphinxbase/prim_type.h"
 #include "sphinxbase/glist.h"
+#include "sphinxbase/simd.h"
+
+#ifdef SPHINX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
 
 #define FEAT_VERSION	"1.0"
 #define FEAT_DCEP_WIN		2
@@ -621,6 +632,72 @@ feat_1s_c_d_dd_cep2feat(feat_t * fcb, mfcc_t ** mfc, mfcc_t ** feat)
     }
 }
 
+/*
+ * Same as feat_1s_c_d_dd_cep2feat(), computing all three parts in one
+ * pass over contiguous input frames, width coefficients at a time.
+ */
+#define FEAT_DEFINE_1S_C_D_DD(name, attr, vec_t, width, LOAD, STORE, SUB) \
+    static attr void                                                    \
+    name(feat_t * fcb, mfcc_t const *mfc, mfcc_t *feat)                 \
+    {                                                                   \
+        int32 n = feat_cepsize(fcb), i;                                 \
+        mfcc_t const *w = mfc + FEAT_DCEP_WIN * n;                      \
+        mfcc_t const *_w = mfc - FEAT_DCEP_WIN * n;                     \
+        mfcc_t const *w1 = w + n, *_w1 = _w + n;                        \
+        mfcc_t const *w_1 = w - n, *_w_1 = _w - n;                      \
+        mfcc_t *d = feat + n, *dd = feat + 2 * n;                       \
+                                                                        \
+        for (i = 0; i + width <= n; i += width) {                       \
+            STORE(feat + i, LOAD(mfc + i));                             \
+            STORE(d + i, SUB(LOAD(w + i), LOAD(_w + i)));               \
+            STORE(dd + i, SUB(SUB(LOAD(w1 + i), LOAD(_w1 + i)),         \
+                              SUB(LOAD(w_1 + i), LOAD(_w_1 + i))));     \
+        }                                                               \
+        for (; i < n; ++i) {                                            \
+            feat[i] = mfc[i];                                           \
+            d[i] = w[i] - _w[i];                                        \
+            dd[i] = (w1[i] - _w1[i]) - (w_1[i] - _w_1[i]);              \
+        }                                                               \
+    }
+
+#define FEAT_SCALAR_LOAD(p) (*(p))
+#define FEAT_SCALAR_STORE(p, v) (*(p) = (v))
+#define FEAT_SCALAR_SUB(a, b) ((a) - (b))
+FEAT_DEFINE_1S_C_D_DD(feat_1s_c_d_dd_flat, , mfcc_t, 1, FEAT_SCALAR_LOAD,
+                      FEAT_SCALAR_STORE, FEAT_SCALAR_SUB)
+
+#ifdef FIXED_POINT
+#ifdef SPHINX_HAVE_SSE2
+#define FEAT_SSE2_LOAD(p) _mm_loadu_si128((__m128i const *)(p))
+#define FEAT_SSE2_STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+FEAT_DEFINE_1S_C_D_DD(feat_1s_c_d_dd_flat_sse2, , __m128i, 4,
+                      FEAT_SSE2_LOAD, FEAT_SSE2_STORE, _mm_sub_epi32)
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#define FEAT_AVX2_LOAD(p) _mm256_loadu_si256((__m256i const *)(p))
+#define FEAT_AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+FEAT_DEFINE_1S_C_D_DD(feat_1s_c_d_dd_flat_avx2, SIMD_TARGET_AVX2, __m256i, 8,
+                      FEAT_AVX2_LOAD, FEAT_AVX2_STORE, _mm256_sub_epi32)
+#endif
+#ifdef SPHINX_HAVE_NEON
+FEAT_DEFINE_1S_C_D_DD(feat_1s_c_d_dd_flat_neon, , int32x4_t, 4,
+                      vld1q_s32, vst1q_s32, vsubq_s32)
+#endif
+#else /* !FIXED_POINT */
+#ifdef SPHINX_HAVE_SSE2
+FEAT_DEFINE_1S_C_D_DD(feat_1s_c_d_dd_flat_sse2, , __m128, 4,
+                      _mm_loadu_ps, _mm_storeu_ps, _mm_sub_ps)
+#endif
+#ifdef SPHINX_HAVE_AVX2
+FEAT_DEFINE_1S_C_D_DD(feat_1s_c_d_dd_flat_avx2, SIMD_TARGET_AVX2, __m256, 8,
+                      _mm256_loadu_ps, _mm256_storeu_ps, _mm256_sub_ps)
+#endif
+#ifdef SPHINX_HAVE_NEON
+FEAT_DEFINE_1S_C_D_DD(feat_1s_c_d_dd_flat_neon, , float32x4_t, 4,
+                      vld1q_f32, vst1q_f32, vsubq_f32)
+#endif
+#endif /* !FIXED_POINT */
+
 static void
 feat_1s_c_d_ld_dd_cep2feat(feat_t * fcb, mfcc_t ** mfc, mfcc_t ** feat)
 {
@@ -706,6 +783,7 @@ feat_init(char const *type, cmn_type_t cmn, int32 varnorm,
           agc_type_t agc, int32 breport, int32 cepsize)
 {
     feat_t *fcb;
+    uint32 simd;
 
     if (cepsize == 0)
         cepsize = 13;
@@ -758,6 +836,20 @@ feat_init(char const *type, cmn_type_t cmn, int32 varnorm,
         fcb->out_dim = cepsize * 3;
         fcb->window_size = FEAT_DCEP_WIN + 1; /* ddcep needs the extra 1 */
         fcb->compute_feat = feat_1s_c_d_dd_cep2feat;
+        fcb->compute_feat_flat = feat_1s_c_d_dd_flat;
+        simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+        if (simd & SIMD_NEON)
+            fcb->compute_feat_flat = feat_1s_c_d_dd_flat_neon;
+#endif
+#ifdef SPHINX_HAVE_SSE2
+        if (simd & SIMD_SSE2)
+            fcb->compute_feat_flat = feat_1s_c_d_dd_flat_sse2;
+#endif
+#ifdef SPHINX_HAVE_AVX2
+        if (simd & SIMD_AVX2)
+            fcb->compute_feat_flat = feat_1s_c_d_dd_flat_avx2;
+#endif
     }
     else if (strncmp(type, "1s_c_d_ld_dd", 12) == 0) {
         fcb->cepsize = cepsize;
@@ -878,15 +970,13 @@ feat_init(char const *type, cmn_type_t cmn, int32 varnorm,
     }
     fcb->agc = agc;
     /*
-     * Make sure this buffer is large enough to be used in feat_s2mfc2feat_block_utt()
+     * Make sure this buffer is large enough to be used in
+     * feat_s2mfc2feat_block_utt(), and add the mirrored frames at
+     * either end so that every window of frames is contiguous.
      */
-    fcb->cepbuf = (mfcc_t **) ckd_calloc_2d((LIVEBUFBLOCKSIZE < feat_window_size(fcb) * 2) ? feat_window_size(fcb) * 2 : LIVEBUFBLOCKSIZE,
+    fcb->cepbuf = (mfcc_t **) ckd_calloc_2d(LIVEBUFBLOCKSIZE + feat_window_size(fcb) * 2,
                                             feat_cepsize(fcb),
                                             sizeof(mfcc_t));
-    /* This one is actually just an array of pointers to "flatten out"
-     * wraparounds. */
-    fcb->tmpcepbuf = (mfcc_t** )ckd_calloc(2 * feat_window_size(fcb) + 1,
-                                sizeof(*fcb->tmpcepbuf));
 
     return fcb;
 }
@@ -1304,12 +1394,30 @@ feat_s2mfc2feat_block_utt(feat_t * fcb, mfcc_t ** uttcep,
     return nfr;
 }
 
+/**
+ * Copy a frame into the circular buffer at bufpos, and into its
+ * mirror if it has one, and advance bufpos.
+ */
+static void
+feat_cepbuf_write(feat_t *fcb, mfcc_t const *cep)
+{
+    int32 win = feat_window_size(fcb);
+    size_t len = feat_cepsize(fcb) * sizeof(mfcc_t);
+
+    memcpy(fcb->cepbuf[win + fcb->bufpos], cep, len);
+    if (fcb->bufpos < win)
+        memcpy(fcb->cepbuf[win + LIVEBUFBLOCKSIZE + fcb->bufpos], cep, len);
+    if (fcb->bufpos >= LIVEBUFBLOCKSIZE - win)
+        memcpy(fcb->cepbuf[fcb->bufpos - (LIVEBUFBLOCKSIZE - win)], cep, len);
+    fcb->bufpos = (fcb->bufpos + 1) % LIVEBUFBLOCKSIZE;
+}
+
 int32
 feat_s2mfc2feat_live(feat_t * fcb, mfcc_t ** uttcep, int32 *inout_ncep,
 		     int32 beginutt, int32 endutt, mfcc_t *** ofeat)
 {
-    int32 win, cepsize, nbufcep;
-    int32 i, j, nfeatvec;
+    int32 win, nbufcep;
+    int32 i, nfeatvec;
     int32 zero = 0;
 
     /* Avoid having to check this everywhere. */
@@ -1320,7 +1428,6 @@ feat_s2mfc2feat_live(feat_t * fcb, mfcc_t ** uttcep, int32 *inout_ncep,
         return feat_s2mfc2feat_block_utt(fcb, uttcep, *inout_ncep, ofeat);
 
     win = feat_window_size(fcb);
-    cepsize = feat_cepsize(fcb);
 
     /* Empty the input buffer on start of utterance. */
     if (beginutt)
@@ -1353,11 +1460,8 @@ feat_s2mfc2feat_live(feat_t * fcb, mfcc_t ** uttcep, int32 *inout_ncep,
      * beginning of the utterance and there was some actual input to
      * deal with.  (FIXME: Not entirely sure why that condition) */
     if (beginutt && *inout_ncep > 0) {
-        for (i = 0; i < win; i++) {
-            memcpy(fcb->cepbuf[fcb->bufpos++], uttcep[0],
-                   cepsize * sizeof(mfcc_t));
-            fcb->bufpos %= LIVEBUFBLOCKSIZE;
-        }
+        for (i = 0; i < win; i++)
+            feat_cepbuf_write(fcb, uttcep[0]);
         /* Move the current pointer past this data. */
         fcb->curpos = fcb->bufpos;
         nbufcep -= win;
@@ -1365,9 +1469,7 @@ feat_s2mfc2feat_live(feat_t * fcb, mfcc_t ** uttcep, int32 *inout_ncep,
 
     /* Copy in frame data to the circular buffer. */
     for (i = 0; i < *inout_ncep; ++i) {
-        memcpy(fcb->cepbuf[fcb->bufpos++], uttcep[i],
-               cepsize * sizeof(mfcc_t));
-        fcb->bufpos %= LIVEBUFBLOCKSIZE;
+        feat_cepbuf_write(fcb, uttcep[i]);
 	++nbufcep;
     }
 
@@ -1380,11 +1482,8 @@ feat_s2mfc2feat_live(feat_t * fcb, mfcc_t ** uttcep, int32 *inout_ncep,
             tpos = LIVEBUFBLOCKSIZE - 1;
         else
             tpos = fcb->bufpos - 1;
-        for (i = 0; i < win; ++i) {
-            memcpy(fcb->cepbuf[fcb->bufpos++], fcb->cepbuf[tpos],
-                   cepsize * sizeof(mfcc_t));
-            fcb->bufpos %= LIVEBUFBLOCKSIZE;
-        }
+        for (i = 0; i < win; ++i)
+            feat_cepbuf_write(fcb, fcb->cepbuf[win + tpos]);
     }
 
     /* We have to leave the trailing window of frames. */
@@ -1393,19 +1492,13 @@ feat_s2mfc2feat_live(feat_t * fcb, mfcc_t ** uttcep, int32 *inout_ncep,
         return 0; /* Do nothing. */
 
     for (i = 0; i < nfeatvec; ++i) {
-        /* Handle wraparound cases. */
-        if (fcb->curpos - win < 0 || fcb->curpos + win >= LIVEBUFBLOCKSIZE) {
-            /* Use tmpcepbuf for this case.  Actually, we just need the pointers. */
-            for (j = -win; j <= win; ++j) {
-                int32 tmppos =
-                    (fcb->curpos + j + LIVEBUFBLOCKSIZE) % LIVEBUFBLOCKSIZE;
-		fcb->tmpcepbuf[win + j] = fcb->cepbuf[tmppos];
-            }
-            fcb->compute_feat(fcb, fcb->tmpcepbuf + win, ofeat[i]);
-        }
-        else {
-            fcb->compute_feat(fcb, fcb->cepbuf + fcb->curpos, ofeat[i]);
-        }
+        /* The mirrored frames make the window contiguous even where
+         * it wraps around. */
+        if (fcb->compute_feat_flat)
+            fcb->compute_feat_flat(fcb, fcb->cepbuf[win + fcb->curpos],
+                                   ofeat[i][0]);
+        else
+            fcb->compute_feat(fcb, fcb->cepbuf + win + fcb->curpos, ofeat[i]);
 	/* Move the read pointer forward. */
         ++fcb->curpos;
         fcb->curpos %= LIVEBUFBLOCKSIZE;
@@ -1448,13 +1541,14 @@ feat_free(feat_t * f)
 
     if (f->cepbuf)
         ckd_free_2d((void **) f->cepbuf);
-    ckd_free(f->tmpcepbuf);
 
     if (f->name) {
         ckd_free((void *) f->name);
     }
     if (f->lda)
         ckd_free_3d((void ***) f->lda);
+    ckd_free(f->lda_panels);
+    ckd_free(f->lda_buf);
 
     ckd_free(f->stream_len);
     ckd_free(f->sv_len);
@@ -54,9 +54,189 @@
 #include "sphinxbase/ckd_alloc.h"
 #include "sphinxbase/bio.h"
 #include "sphinxbase/err.h"
+#include "sphinxbase/simd.h"
+
+#ifdef SPHINX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef SPHINX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#ifdef SPHINX_HAVE_NEON
+#include <arm_neon.h>
+#endif
 
 #define MATRIX_FILE_VERSION "0.1"
 
+/* Number of frames transformed together by feat_lda_transform(). */
+#define LDA_ROWS 4
+
+/*
+ * Multiply LDA_ROWS input frames by one panel of 2 * width rows of
+ * the transform, keeping all LDA_ROWS * 2 * width sums in registers.
+ * Each sum is accumulated over the input dimension in order, as in a
+ * plain matrix-vector product, so the results do not depend on the
+ * kernel.
+ */
+#define LDA_DEFINE_GEMM(name, attr, vec_t, width, LOAD, STORE, SET1,   \
+                        ZERO, MUL, ADD)                                 \
+    static attr void                                                    \
+    name(mfcc_t const *panel, uint32 n, mfcc_t const **in,              \
+         mfcc_t *out, uint32 out_stride)                                \
+    {                                                                   \
+        vec_t c00 = ZERO, c01 = ZERO, c10 = ZERO, c11 = ZERO;           \
+        vec_t c20 = ZERO, c21 = ZERO, c30 = ZERO, c31 = ZERO;           \
+        vec_t b0, b1, x;                                                \
+        uint32 k;                                                       \
+                                                                        \
+        for (k = 0; k < n; ++k, panel += 2 * (width)) {                 \
+            b0 = LOAD(panel);                                           \
+            b1 = LOAD(panel + (width));                                 \
+            x = SET1(in[0][k]);                                         \
+            c00 = ADD(c00, MUL(x, b0));                                 \
+            c01 = ADD(c01, MUL(x, b1));                                 \
+            x = SET1(in[1][k]);                                         \
+            c10 = ADD(c10, MUL(x, b0));                                 \
+            c11 = ADD(c11, MUL(x, b1));                                 \
+            x = SET1(in[2][k]);                                         \
+            c20 = ADD(c20, MUL(x, b0));                                 \
+            c21 = ADD(c21, MUL(x, b1));                                 \
+            x = SET1(in[3][k]);                                         \
+            c30 = ADD(c30, MUL(x, b0));                                 \
+            c31 = ADD(c31, MUL(x, b1));                                 \
+        }                                                               \
+        STORE(out, c00);                                                \
+        STORE(out + (width), c01);                                      \
+        out += out_stride;                                              \
+        STORE(out, c10);                                                \
+        STORE(out + (width), c11);                                      \
+        out += out_stride;                                              \
+        STORE(out, c20);                                                \
+        STORE(out + (width), c21);                                      \
+        out += out_stride;                                              \
+        STORE(out, c30);                                                \
+        STORE(out + (width), c31);                                      \
+    }
+
+#define LDA_SCALAR_LOAD(p) (*(p))
+#define LDA_SCALAR_STORE(p, v) (*(p) = (v))
+#define LDA_SCALAR_SET1(x) (x)
+#define LDA_SCALAR_MUL(a, b) MFCCMUL(a, b)
+#define LDA_SCALAR_ADD(a, b) ((a) + (b))
+LDA_DEFINE_GEMM(lda_gemm, , mfcc_t, 1, LDA_SCALAR_LOAD, LDA_SCALAR_STORE,
+                LDA_SCALAR_SET1, 0, LDA_SCALAR_MUL, LDA_SCALAR_ADD)
+
+#ifdef FIXED_POINT
+/*
+ * MFCCMUL() keeps bits DEFAULT_RADIX..DEFAULT_RADIX+31 of the 64-bit
+ * product, which we can get with logical shifts.  Without a signed
+ * 32x32->64 multiply, SSE2 is slower than the scalar kernel here, so
+ * there is no SSE2 version.
+ */
+#ifdef SPHINX_HAVE_AVX2
+static inline SIMD_TARGET_AVX2 __m256i
+lda_fixmul_avx2(__m256i a, __m256i b)
+{
+    __m256i even, odd;
+
+    even = _mm256_mul_epi32(a, b);
+    odd = _mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                           _mm256_srli_epi64(b, 32));
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, DEFAULT_RADIX),
+                              _mm256_slli_epi64(odd, 32 - DEFAULT_RADIX),
+                              0xaa);
+}
+#define LDA_AVX2_LOAD(p) _mm256_loadu_si256((__m256i const *)(p))
+#define LDA_AVX2_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+LDA_DEFINE_GEMM(lda_gemm_avx2, SIMD_TARGET_AVX2, __m256i, 8,
+                LDA_AVX2_LOAD, LDA_AVX2_STORE, _mm256_set1_epi32,
+                _mm256_setzero_si256(), lda_fixmul_avx2, _mm256_add_epi32)
+#endif /* SPHINX_HAVE_AVX2 */
+
+#ifdef SPHINX_HAVE_NEON
+static inline int32x4_t
+lda_fixmul_neon(int32x4_t a, int32x4_t b)
+{
+    return vcombine_s32(vshrn_n_s64(vmull_s32(vget_low_s32(a),
+                                              vget_low_s32(b)),
+                                    DEFAULT_RADIX),
+                        vshrn_n_s64(vmull_high_s32(a, b), DEFAULT_RADIX));
+}
+LDA_DEFINE_GEMM(lda_gemm_neon, , int32x4_t, 4, vld1q_s32, vst1q_s32,
+                vdupq_n_s32, vdupq_n_s32(0), lda_fixmul_neon, vaddq_s32)
+#endif /* SPHINX_HAVE_NEON */
+
+#else /* !FIXED_POINT */
+
+/* Separate multiplies and adds (no FMA) round like the scalar code. */
+#ifdef SPHINX_HAVE_SSE2
+#define LDA_HAVE_SSE2 1
+LDA_DEFINE_GEMM(lda_gemm_sse2, , __m128, 4, _mm_loadu_ps, _mm_storeu_ps,
+                _mm_set1_ps, _mm_setzero_ps(), _mm_mul_ps, _mm_add_ps)
+#endif
+#ifdef SPHINX_HAVE_AVX2
+LDA_DEFINE_GEMM(lda_gemm_avx2, SIMD_TARGET_AVX2, __m256, 8,
+                _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps,
+                _mm256_setzero_ps(), _mm256_mul_ps, _mm256_add_ps)
+#endif
+#ifdef SPHINX_HAVE_NEON
+LDA_DEFINE_GEMM(lda_gemm_neon, , float32x4_t, 4, vld1q_f32, vst1q_f32,
+                vdupq_n_f32, vdupq_n_f32(0), vmulq_f32, vaddq_f32)
+#endif
+#endif /* !FIXED_POINT */
+
+/*
+ * Choose a kernel and pack the first transformation for it: panel p
+ * holds output rows p * lda_width ... (p + 1) * lda_width - 1
+ * interleaved by input dimension, padded with zero rows.
+ */
+static void
+feat_lda_pack(feat_t *feat, uint32 n)
+{
+    uint32 simd, width, npanel, p, k, c;
+
+    feat->lda_gemm = lda_gemm;
+    width = 1;
+    simd = simd_get_features();
+#ifdef SPHINX_HAVE_NEON
+    if (simd & SIMD_NEON) {
+        feat->lda_gemm = lda_gemm_neon;
+        width = 4;
+    }
+#endif
+#ifdef LDA_HAVE_SSE2
+    if (simd & SIMD_SSE2) {
+        feat->lda_gemm = lda_gemm_sse2;
+        width = 4;
+    }
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    if (simd & SIMD_AVX2) {
+        feat->lda_gemm = lda_gemm_avx2;
+        width = 8;
+    }
+#endif
+    feat->lda_width = width * 2;
+
+    npanel = (feat->out_dim + feat->lda_width - 1) / feat->lda_width;
+    ckd_free(feat->lda_panels);
+    ckd_free(feat->lda_buf);
+    feat->lda_panels = ckd_calloc(npanel * n * feat->lda_width,
+                                  sizeof(mfcc_t));
+    feat->lda_buf = ckd_calloc(LDA_ROWS * npanel * feat->lda_width,
+                               sizeof(mfcc_t));
+    for (p = 0; p < npanel; ++p) {
+        mfcc_t *panel = feat->lda_panels + p * n * feat->lda_width;
+        for (k = 0; k < n; ++k) {
+            for (c = 0; c < feat->lda_width; ++c) {
+                uint32 j = p * feat->lda_width + c;
+                if (j < feat->out_dim)
+                    panel[k * feat->lda_width + c] = feat->lda[0][j][k];
+            }
+        }
+    }
+}
+
 int32
 feat_read_lda(feat_t *feat, const char *ldafile, int32 dim)
 {
@@ -131,6 +311,7 @@ feat_read_lda(feat_t *feat, const char *ldafile, int32 dim)
         dim = m;
     }
     feat->out_dim = dim;
+    feat_lda_pack(feat, n);
 
     return 0;
 }
@@ -138,21 +319,28 @@ feat_read_lda(feat_t *feat, const char *ldafile, int32 dim)
 void
 feat_lda_transform(feat_t *fcb, mfcc_t ***inout_feat, uint32 nfr)
 {
-    mfcc_t *tmp;
-    uint32 i, j, k;
-
-    tmp = ckd_calloc(fcb->stream_len[0], sizeof(mfcc_t));
-    for (i = 0; i < nfr; ++i) {
-        /* Do the matrix multiplication inline here since fcb->lda
-         * is transposed (eigenvectors in rows not columns). */
-        /* FIXME: In the future we ought to use the BLAS. */
-        memset(tmp, 0, sizeof(mfcc_t) * fcb->stream_len[0]);
-        for (j = 0; j < feat_dimension(fcb); ++j) {
-            for (k = 0; k < fcb->stream_len[0]; ++k) {
-                tmp[j] += MFCCMUL(inout_feat[i][0][k], fcb->lda[0][j][k]);
-            }
+    mfcc_t const *in[LDA_ROWS];
+    uint32 i, j, r, nr, n, stride;
+
+    /* Note that fcb->lda is transposed (eigenvectors in rows not
+     * columns), which is what the panels are built from. */
+    n = fcb->stream_len[0];
+    stride = (fcb->out_dim + fcb->lda_width - 1)
+        / fcb->lda_width * fcb->lda_width;
+    for (i = 0; i < nfr; i += LDA_ROWS) {
+        nr = nfr - i < LDA_ROWS ? nfr - i : LDA_ROWS;
+        /* Pad a short block by repeating its last frame. */
+        for (r = 0; r < LDA_ROWS; ++r)
+            in[r] = inout_feat[i + (r < nr ? r : nr - 1)][0];
+        for (j = 0; j < stride; j += fcb->lda_width)
+            fcb->lda_gemm(fcb->lda_panels + j * n, n, in,
+                          fcb->lda_buf + j, stride);
+        /* The whole block is read before any of it is overwritten. */
+        for (r = 0; r < nr; ++r) {
+            memcpy(inout_feat[i + r][0], fcb->lda_buf + r * stride,
+                   fcb->out_dim * sizeof(mfcc_t));
+            memset(inout_feat[i + r][0] + fcb->out_dim, 0,
+                   (n - fcb->out_dim) * sizeof(mfcc_t));
         }
-        memcpy(inout_feat[i][0], tmp, fcb->stream_len[0] * sizeof(mfcc_t));
     }
-    ckd_free(tmp);
 }
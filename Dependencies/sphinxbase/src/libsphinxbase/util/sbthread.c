@@ -482,7 +482,7 @@ sbmsgq_send(sbmsgq_t *q, size_t len, void const *data)
 
     /* Lock the condition variable while we manipulate the buffer. */
     pthread_mutex_lock(&q->mtx);
-    if (q->nbytes + len + sizeof(len) > q->depth) {
+    while (q->nbytes + len + sizeof(len) > q->depth) {
         /* Unlock and wait for space to be available. */
         if (pthread_cond_wait(&q->cond, &q->mtx) != 0) {
             /* Timed out, don't send anything. */
@@ -559,7 +559,7 @@ sbmsgq_wait(sbmsgq_t *q, size_t *out_len, int sec, int nsec)
 
     /* Lock the condition variable while we manipulate nmsg. */
     pthread_mutex_lock(&q->mtx);
-    if (q->nbytes == 0) {
+    while (q->nbytes == 0) {
         /* Unlock the condition variable and wait for a signal. */
         if (cond_timed_wait(&q->cond, &q->mtx, sec, nsec) != 0) {
             /* Timed out or something... */
@@ -655,8 +655,9 @@ sbevent_wait(sbevent_t *evt, int sec, int nsec)
 
     /* Lock the mutex before we check its signalled state. */
     pthread_mutex_lock(&evt->mtx);
-    /* If it's not signalled, then wait until it is. */
-    if (!evt->signalled)
+    /* If it's not signalled, then wait until it is (the wait can
+     * also return spuriously, so check again). */
+    while (!evt->signalled && rv == 0)
         rv = cond_timed_wait(&evt->cond, &evt->mtx, sec, nsec);
     /* Set its state to unsignalled if we were successful. */
     if (rv == 0)
@@ -737,3 +738,101 @@ sbthread_free(sbthread_t *th)
     sbmsgq_free(th->msgq);
     ckd_free(th);
 }
+
+typedef struct sbpool_worker_s {
+    sbpool_t *pool;
+    sbthread_t *th;
+    sbevent_t *go;   /**< Signalled when there is a part to run. */
+    sbevent_t *done; /**< Signalled when the part is done. */
+    int idx;
+} sbpool_worker_t;
+
+struct sbpool_s {
+    int n_thread;
+    sbpool_worker_t *workers; /**< Workers for parts 1 to n_thread - 1. */
+    sbpool_func func;         /**< Current computation, NULL to exit. */
+    void *arg;
+};
+
+static int
+sbpool_worker_main(sbthread_t *th)
+{
+    sbpool_worker_t *w = sbthread_arg(th);
+    sbpool_t *pool = w->pool;
+
+    while (sbevent_wait(w->go, -1, 0) == 0) {
+        if (pool->func == NULL)
+            break;
+        (*pool->func)(pool->arg, w->idx, pool->n_thread);
+        sbevent_signal(w->done);
+    }
+    return 0;
+}
+
+sbpool_t *
+sbpool_init(cmd_ln_t *config, int n_thread)
+{
+    sbpool_t *pool;
+    int i;
+
+    if (n_thread < 1)
+        n_thread = 1;
+    pool = ckd_calloc(1, sizeof(*pool));
+    pool->n_thread = n_thread;
+    pool->workers = ckd_calloc(n_thread, sizeof(*pool->workers));
+    for (i = 1; i < n_thread; ++i) {
+        sbpool_worker_t *w = pool->workers + i;
+        w->pool = pool;
+        w->idx = i;
+        w->go = sbevent_init();
+        w->done = sbevent_init();
+        if ((w->th = sbthread_start(config, sbpool_worker_main, w)) == NULL) {
+            sbpool_free(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+int
+sbpool_size(sbpool_t *pool)
+{
+    return pool->n_thread;
+}
+
+void
+sbpool_run(sbpool_t *pool, sbpool_func func, void *arg)
+{
+    int i;
+
+    pool->func = func;
+    pool->arg = arg;
+    for (i = 1; i < pool->n_thread; ++i)
+        sbevent_signal(pool->workers[i].go);
+    (*func)(arg, 0, pool->n_thread);
+    for (i = 1; i < pool->n_thread; ++i)
+        sbevent_wait(pool->workers[i].done, -1, 0);
+}
+
+void
+sbpool_free(sbpool_t *pool)
+{
+    int i;
+
+    if (pool == NULL)
+        return;
+    pool->func = NULL;
+    for (i = 1; i < pool->n_thread; ++i) {
+        sbpool_worker_t *w = pool->workers + i;
+        if (w->th) {
+            sbevent_signal(w->go);
+            sbthread_free(w->th);
+        }
+        if (w->go)
+            sbevent_free(w->go);
+        if (w->done)
+            sbevent_free(w->done);
+    }
+    ckd_free(pool->workers);
+    ckd_free(pool);
+}
@@ -0,0 +1,59 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * This file was written for the OpenEars copy of SphinxBase.  It may be
+ * used and redistributed under the same conditions as the Carnegie
+ * Mellon University files alongside it.
+ * ====================================================================
+ */
+
+/**
+ * @file simd.c
+ * @brief Run-time detection of vector instruction sets.
+ */
+
+#include "sphinxbase/simd.h"
+
+static uint32 simd_mask = ~(uint32)0;
+
+static uint32
+simd_detect(void)
+{
+    uint32 features = SIMD_NONE;
+
+#ifdef SPHINX_HAVE_SSE2
+    features |= SIMD_SSE2;
+#endif
+#ifdef SPHINX_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        features |= SIMD_AVX2;
+#endif
+#ifdef SPHINX_HAVE_NEON
+    features |= SIMD_NEON;
+#endif
+
+    return features;
+}
+
+uint32
+simd_get_features(void)
+{
+    static int32 detected = FALSE;
+    static uint32 features;
+
+    /* Detection is idempotent, so a race here is harmless. */
+    if (!detected) {
+        features = simd_detect();
+        detected = TRUE;
+    }
+    return features & simd_mask;
+}
+
+uint32
+simd_set_features(uint32 mask)
+{
+    uint32 old = simd_mask;
+
+    simd_mask = mask;
+    return old;
+}
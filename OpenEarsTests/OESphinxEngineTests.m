@@ -0,0 +1,1409 @@
+//
+//  OESphinxEngineTests.m
+//  OpenEars
+//
+//  Tests of the vendored sphinxbase/pocketsphinx engine which don't go
+//  through OEPocketsphinxController. Most of these compare an optimized
+//  code path against the plain one it replaces on the bundled test WAVs.
+//
+//  Copyright (c) 2014 Politepix. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "OETestTools.h"
+
+#include <math.h>
+#include <string.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/cmd_ln.h>
+#include <sphinxbase/simd.h>
+#include <sphinxbase/fe.h>
+#include <sphinxbase/genrand.h>
+#include <sphinxbase/strfuncs.h>
+#include <sphinxbase/feat.h>
+#include <sphinxbase/bio.h>
+#include <sphinxbase/yin.h>
+#include <pocketsphinx.h>
+#include "fe_internal.h"
+#include "tied_mgau_common.h"
+#include "hmm.h"
+
+#pragma mark -
+#pragma mark Engine helpers
+#pragma mark -
+
+// Everything in this section is plain C so that it can also be compiled
+// against the library outside of Xcode when working on the engine.
+
+#define OE_WAV_HEADER_SIZE 44
+
+/* Read the 16 kHz, 16-bit mono samples of one of the test WAVs. */
+static int16 *
+oe_read_test_wav(char const *path, size_t *out_nsamps)
+{
+    FILE *fh;
+    int16 *spch;
+    long size;
+
+    if ((fh = fopen(path, "rb")) == NULL)
+        return NULL;
+    fseek(fh, 0, SEEK_END);
+    size = ftell(fh) - OE_WAV_HEADER_SIZE;
+    fseek(fh, OE_WAV_HEADER_SIZE, SEEK_SET);
+    if (size <= 0) {
+        fclose(fh);
+        return NULL;
+    }
+    spch = ckd_calloc(size / sizeof(*spch), sizeof(*spch));
+    *out_nsamps = fread(spch, sizeof(*spch), size / sizeof(*spch), fh);
+    fclose(fh);
+
+    return spch;
+}
+
+/* Compute the cepstra of a whole utterance.  Kernels are selected from
+ * the simd features in effect when the front end is created; with
+ * fft_only set, the vector mel filter and DCT kernels are switched back
+ * off so that only the FFT and power spectrum kernels differ from the
+ * scalar code. */
+static mfcc_t **
+oe_fe_cepstra(cmd_ln_t *config, uint32 simd, int fft_only,
+              int16 const *spch, size_t nsamps, int32 *out_nframes)
+{
+    fe_t *fe;
+    mfcc_t **cep;
+    uint32 saved;
+    int32 nframes, nlast;
+
+    saved = simd_set_features(simd);
+    fe = fe_init_auto_r(config);
+    simd_set_features(saved);
+    if (fe == NULL)
+        return NULL;
+    if (fft_only) {
+        fe->mel_fb->mel_spec = NULL;
+        fe->mel_fb->dct = NULL;
+    }
+
+    /* Leave room for the frame flushed by fe_end_utt(). */
+    fe_start_utt(fe);
+    fe_process_frames(fe, NULL, &nsamps, NULL, &nframes, NULL);
+    cep = (mfcc_t **)ckd_calloc_2d(nframes + 1, fe_get_output_size(fe),
+                                   sizeof(**cep));
+    fe_process_frames(fe, &spch, &nsamps, cep, &nframes, NULL);
+    fe_end_utt(fe, cep[nframes], &nlast);
+    nframes += nlast;
+    fe_free(fe);
+
+    *out_nframes = nframes;
+    return cep;
+}
+
+/* Compare the cepstra of the scalar front end with those of the one
+ * using every vector kernel available.  Returns the number of frames
+ * which differ, or -1 on error. */
+static int32
+oe_fe_compare_simd(char const *wavpath, int fft_only,
+                   char const *const *extra_args, int32 n_extra_args)
+{
+    cmd_ln_t *config;
+    int16 *spch;
+    size_t nsamps;
+    mfcc_t **ref, **cep;
+    int32 n_ref, n_cep, i, ndiff;
+
+    config = cmd_ln_parse_r(NULL, fe_get_args(), n_extra_args,
+                            (char **)extra_args, FALSE);
+    if (config == NULL)
+        return -1;
+    if ((spch = oe_read_test_wav(wavpath, &nsamps)) == NULL) {
+        cmd_ln_free_r(config);
+        return -1;
+    }
+
+    ref = oe_fe_cepstra(config, SIMD_NONE, fft_only, spch, nsamps, &n_ref);
+    cep = oe_fe_cepstra(config, ~0U, fft_only, spch, nsamps, &n_cep);
+    if (ref == NULL || cep == NULL || n_ref != n_cep)
+        ndiff = -1;
+    else {
+        ndiff = 0;
+        for (i = 0; i < n_ref; ++i) {
+            if (memcmp(ref[i], cep[i],
+                       cmd_ln_int_r(config, "-ncep") * sizeof(**ref)) != 0)
+                ++ndiff;
+        }
+    }
+
+    ckd_free_2d(ref);
+    ckd_free_2d(cep);
+    ckd_free(spch);
+    cmd_ln_free_r(config);
+
+    return ndiff;
+}
+
+/* Compute the cepstra of a whole utterance, giving fe_process_frames()
+ * room for at most max_frames frames at a time.  With room for one,
+ * frames are processed one by one; with more, in blocks. */
+static mfcc_t **
+oe_fe_cepstra_chunked(cmd_ln_t *config, int16 const *spch, size_t nsamps,
+                      int32 max_frames, int32 *out_nframes)
+{
+    fe_t *fe;
+    mfcc_t **cep;
+    int32 frame_shift, frame_size, n_alloc, n, nfr, nlast;
+
+    if ((fe = fe_init_auto_r(config)) == NULL)
+        return NULL;
+    fe_get_input_size(fe, &frame_shift, &frame_size);
+    /* Every frame, plus the one from fe_end_utt(). */
+    n_alloc = nsamps / frame_shift + 2;
+    cep = (mfcc_t **)ckd_calloc_2d(n_alloc, fe_get_output_size(fe),
+                                   sizeof(**cep));
+
+    fe_start_utt(fe);
+    n = 0;
+    do {
+        nfr = n_alloc - 1 - n < max_frames ? n_alloc - 1 - n : max_frames;
+        if (fe_process_frames(fe, &spch, &nsamps, cep + n, &nfr, NULL) < 0)
+            break;
+        n += nfr;
+    } while (nsamps > 0 || nfr > 0);
+    fe_end_utt(fe, cep[n], &nlast);
+    n += nlast;
+    fe_free(fe);
+
+    *out_nframes = n;
+    return cep;
+}
+
+/* Compare the cepstra computed in blocks with those computed frame by
+ * frame.  Returns the number of frames which differ, or -1 on error. */
+static int32
+oe_fe_compare_blocks(char const *wavpath, char const *const *extra_args,
+                     int32 n_extra_args)
+{
+    cmd_ln_t *config;
+    int16 *spch;
+    size_t nsamps;
+    mfcc_t **ref, **cep;
+    int32 n_ref, n_cep, i, ndiff;
+
+    config = cmd_ln_parse_r(NULL, fe_get_args(), n_extra_args,
+                            (char **)extra_args, FALSE);
+    if (config == NULL)
+        return -1;
+    if ((spch = oe_read_test_wav(wavpath, &nsamps)) == NULL) {
+        cmd_ln_free_r(config);
+        return -1;
+    }
+
+    ref = oe_fe_cepstra_chunked(config, spch, nsamps, 1, &n_ref);
+    cep = oe_fe_cepstra_chunked(config, spch, nsamps, nsamps, &n_cep);
+    if (ref == NULL || cep == NULL || n_ref != n_cep || n_ref == 0)
+        ndiff = -1;
+    else {
+        ndiff = 0;
+        for (i = 0; i < n_ref; ++i) {
+            if (memcmp(ref[i], cep[i],
+                       cmd_ln_int_r(config, "-ncep") * sizeof(**ref)) != 0)
+                ++ndiff;
+        }
+    }
+
+    ckd_free_2d(ref);
+    ckd_free_2d(cep);
+    ckd_free(spch);
+    cmd_ln_free_r(config);
+
+    return ndiff;
+}
+
+/* Make a signal where -vad_cheap skips the start of speech, so that the
+ * full voice activity detection only sees it when the skipped frames are
+ * replayed.  After three seconds of steady noise comes a second of noise
+ * whose level changes every four frames, which the cheap detector can't
+ * call quiet but the full one doesn't call speech either.  Then comes a
+ * tone as loud as the quieter noise, which the cheap detector skips but
+ * the full one calls speech, and finally loud noise. */
+static int16 *
+oe_fe_replayed_onset(int32 tone_frames, size_t *out_nsamps)
+{
+    int16 *spch;
+    size_t nsamps, i;
+
+    nsamps = 64000 + tone_frames * 160 + 16000;
+    spch = ckd_calloc(nsamps, sizeof(*spch));
+    genrand_seed(1111);
+    for (i = 0; i < nsamps; ++i) {
+        int32 noise = genrand_int31() % 32768 - 16384;
+        if (i < 48000)
+            spch[i] = noise / 16;
+        else if (i < 64000)
+            spch[i] = (i / 640) % 2 ? noise * 3 / 32 : noise / 16;
+        else if (i < 64000 + tone_frames * 160)
+            spch[i] = (int16)(836 * sin(2 * M_PI * 1237 * i / 16000.0));
+        else
+            spch[i] = noise / 2;
+    }
+
+    *out_nsamps = nsamps;
+    return spch;
+}
+
+/* Give the front end one frame shift of audio at a time and return the
+ * largest number of frames it gives back for one, or -1 on error. */
+static int32
+oe_fe_max_frames_per_shift(cmd_ln_t *config, int16 const *spch,
+                           size_t nsamps)
+{
+    fe_t *fe;
+    mfcc_t **cep;
+    int32 frame_shift, frame_size, n_alloc, nfr, max_nfr;
+
+    if ((fe = fe_init_auto_r(config)) == NULL)
+        return -1;
+    fe_get_input_size(fe, &frame_shift, &frame_size);
+    n_alloc = nsamps / frame_shift + 1;
+    cep = (mfcc_t **)ckd_calloc_2d(n_alloc, fe_get_output_size(fe),
+                                   sizeof(**cep));
+
+    fe_start_utt(fe);
+    max_nfr = 0;
+    while (nsamps > 0) {
+        size_t n = nsamps < (size_t)frame_shift ? nsamps : frame_shift;
+
+        nsamps -= n;
+        nfr = n_alloc;
+        if (fe_process_frames(fe, &spch, &n, cep, &nfr, NULL) < 0) {
+            max_nfr = -1;
+            break;
+        }
+        if (nfr > max_nfr)
+            max_nfr = nfr;
+    }
+    ckd_free_2d(cep);
+    fe_free(fe);
+
+    return max_nfr;
+}
+
+/* Resample 16 kHz audio to rate with a windowed sinc interpolator.  It
+ * is slow, but doesn't share anything with the front end's resampler. */
+static int16 *
+oe_upsample(int16 const *spch, size_t nsamps, int32 rate,
+            size_t *out_nsamps)
+{
+    int16 *out;
+    size_t n, j;
+
+    n = (size_t)((int64)nsamps * rate / 16000);
+    out = ckd_calloc(n, sizeof(*out));
+    for (j = 0; j < n; ++j) {
+        float64 t = (float64)j * 16000 / rate, y = 0;
+        long k;
+
+        for (k = (long)t - 15; k <= (long)t + 16; ++k) {
+            float64 x = t - k;
+            if (k < 0 || k >= (long)nsamps)
+                continue;
+            y += spch[k] * (x == 0 ? 1 : sin(M_PI * x) / (M_PI * x))
+                * (0.5 + 0.5 * cos(M_PI * x / 16));
+        }
+        out[j] = y > 32767 ? 32767 : y < -32768 ? -32768 : (int16)floor(y + 0.5);
+    }
+
+    *out_nsamps = n;
+    return out;
+}
+
+/* Resample audio from in_rate to 16 kHz with the front end's resampler,
+ * giving it pieces of several sizes, and check that each one gives as
+ * many samples as fe_resampler_count() says.  Returns the total number
+ * of samples, or -1 if a piece gives the wrong number. */
+static int32
+oe_resampled_length(int32 in_rate, int16 const *spch, size_t nsamps)
+{
+    static const int32 piece[] = {1, 17, 160, 441, 4096};
+    fe_resampler_t *rs;
+    int16 *out;
+    int32 total, i, n, n_out;
+
+    if ((rs = fe_resampler_init(in_rate, 16000, FALSE)) == NULL)
+        return -1;
+    out = ckd_calloc(4096 * 16000 / in_rate + 2, sizeof(*out));
+    total = 0;
+    for (i = 0; nsamps > 0; ++i) {
+        n = piece[i % 5] < (int32)nsamps ? piece[i % 5] : (int32)nsamps;
+        n_out = fe_resampler_count(rs, n);
+        if (fe_resampler_process(rs, spch, n, out) != n_out) {
+            total = -1;
+            break;
+        }
+        total += n_out;
+        spch += n;
+        nsamps -= n;
+    }
+    ckd_free(out);
+    fe_resampler_free(rs);
+    return total;
+}
+
+/* Estimate the pitch of every 25 ms frame of a WAV, every 10 ms, the
+ * way sphinx_pitch does by default, with the direct sums and with the
+ * FFT.  Returns the number of frames voiced with either one whose
+ * period differs, or -1 on error, and the number of voiced frames. */
+static int32
+oe_yin_compare_fft(char const *wavpath, int32 *out_nvoiced)
+{
+    yin_t *ref, *yin;
+    int16 *spch;
+    size_t nsamps, pos;
+    uint16 ref_period, period;
+    float32 ref_diff, diff;
+    int32 ndiff, nref, n, ended;
+
+    if ((spch = oe_read_test_wav(wavpath, &nsamps)) == NULL)
+        return -1;
+    ref = yin_init(400, 0.1, 0.2, 2);
+    yin = yin_init(400, 0.1, 0.2, 2);
+    yin_set_fft(yin, TRUE);
+
+    ndiff = 0;
+    *out_nvoiced = 0;
+    yin_start(ref);
+    yin_start(yin);
+    for (pos = 0, ended = FALSE;; pos += 160) {
+        if (pos + 400 <= nsamps) {
+            yin_write(ref, spch + pos);
+            yin_write(yin, spch + pos);
+        }
+        else if (!ended) {
+            yin_end(ref);
+            yin_end(yin);
+            ended = TRUE;
+        }
+        nref = yin_read(ref, &ref_period, &ref_diff);
+        n = yin_read(yin, &period, &diff);
+        if (nref != n) {
+            ndiff = -1;
+            break;
+        }
+        if (n == 0 && ended)
+            break;
+        if (n && (ref_diff < 0.1 || diff < 0.1)) {
+            ++*out_nvoiced;
+            ndiff += (ref_period != period);
+        }
+    }
+
+    yin_free(ref);
+    yin_free(yin);
+    ckd_free(spch);
+    return ndiff;
+}
+
+/* Compare the 1s_c_d_dd features computed by the fused kernel for
+ * contiguous frames, selected from the simd features given, with those
+ * of the scalar feature function, on random cepstra of cepsize
+ * coefficients.  Returns the number of frames which differ, or -1 on
+ * error. */
+static int32
+oe_feat_compare_fused(uint32 simd, int32 cepsize, int32 nfr)
+{
+    feat_t *fcb;
+    mfcc_t *cep, **frames, ***ref, *feat;
+    uint32 saved;
+    int32 win, i, ndiff;
+
+    saved = simd_set_features(simd);
+    fcb = feat_init("1s_c_d_dd", CMN_NONE, FALSE, AGC_NONE, FALSE, cepsize);
+    simd_set_features(saved);
+    if (fcb == NULL)
+        return -1;
+    if (fcb->compute_feat_flat == NULL) {
+        feat_free(fcb);
+        return -1;
+    }
+
+    /* Leave room for the window on both sides of every frame. */
+    win = feat_window_size(fcb);
+    cep = ckd_calloc((nfr + win * 2) * cepsize, sizeof(*cep));
+    frames = ckd_calloc(nfr + win * 2, sizeof(*frames));
+    genrand_seed(1111);
+    for (i = 0; i < (nfr + win * 2) * cepsize; ++i)
+        cep[i] = FLOAT2MFCC((genrand_res53() - 0.5) * 2e3);
+    for (i = 0; i < nfr + win * 2; ++i)
+        frames[i] = cep + i * cepsize;
+    ref = feat_array_alloc(fcb, 1);
+    feat = ckd_calloc(feat_dimension(fcb), sizeof(*feat));
+
+    ndiff = 0;
+    for (i = win; i < nfr + win; ++i) {
+        fcb->compute_feat(fcb, frames + i, ref[0]);
+        fcb->compute_feat_flat(fcb, cep + i * cepsize, feat);
+        if (memcmp(ref[0][0], feat, feat_dimension(fcb) * sizeof(*feat)) != 0)
+            ++ndiff;
+    }
+
+    ckd_free(feat);
+    feat_array_free(ref);
+    ckd_free(frames);
+    ckd_free(cep);
+    feat_free(fcb);
+    return ndiff;
+}
+
+/* Transform features by fcb's LDA matrix one frame at a time, the way
+ * feat_lda_transform() did before it worked on blocks of frames. */
+static void
+oe_lda_reference(feat_t *fcb, mfcc_t ***inout_feat, uint32 nfr)
+{
+    mfcc_t *tmp;
+    uint32 i, j, k;
+
+    tmp = ckd_calloc(fcb->stream_len[0], sizeof(mfcc_t));
+    for (i = 0; i < nfr; ++i) {
+        memset(tmp, 0, sizeof(mfcc_t) * fcb->stream_len[0]);
+        for (j = 0; j < feat_dimension(fcb); ++j) {
+            for (k = 0; k < fcb->stream_len[0]; ++k) {
+                tmp[j] += MFCCMUL(inout_feat[i][0][k], fcb->lda[0][j][k]);
+            }
+        }
+        memcpy(inout_feat[i][0], tmp, fcb->stream_len[0] * sizeof(mfcc_t));
+    }
+    ckd_free(tmp);
+}
+
+/* Write a random dim x 39 transform to ldapath, read it back for
+ * 1s_c_d_dd features with the kernels selected from the simd features
+ * given, and compare feat_lda_transform() with the reference loop on
+ * nfr random frames.  Products of the features and the matrix need more
+ * than 32 bits in fixed point.  Returns the number of frames which
+ * differ, or -1 on error. */
+static int32
+oe_lda_compare(char const *ldapath, uint32 simd, int32 dim, int32 nfr)
+{
+    float32 ***lda;
+    feat_t *fcb;
+    mfcc_t ***ref, ***feat;
+    FILE *fh;
+    uint32 chksum, saved;
+    int32 i, j, len, ndiff;
+
+    genrand_seed(1111);
+    lda = (float32 ***)ckd_calloc_3d(1, dim, 39, sizeof(float32));
+    for (i = 0; i < dim; ++i)
+        for (j = 0; j < 39; ++j)
+            lda[0][i][j] = (float32)(genrand_res53() * 2 - 1);
+    if ((fh = fopen(ldapath, "wb")) == NULL) {
+        ckd_free_3d(lda);
+        return -1;
+    }
+    chksum = 0;
+    bio_writehdr(fh, "version", "0.1", NULL);
+    bio_fwrite_3d((void ***)lda, sizeof(float32), 1, dim, 39, fh, &chksum);
+    fclose(fh);
+    ckd_free_3d(lda);
+
+    fcb = feat_init("1s_c_d_dd", CMN_NONE, FALSE, AGC_NONE, FALSE, 13);
+    saved = simd_set_features(simd);
+    i = feat_read_lda(fcb, ldapath, dim);
+    simd_set_features(saved);
+    remove(ldapath);
+    if (i < 0) {
+        feat_free(fcb);
+        return -1;
+    }
+
+    len = fcb->stream_len[0];
+    ref = feat_array_alloc(fcb, nfr);
+    feat = feat_array_alloc(fcb, nfr);
+    for (i = 0; i < nfr; ++i)
+        for (j = 0; j < len; ++j)
+            ref[i][0][j] = feat[i][0][j]
+                = FLOAT2MFCC((genrand_res53() - 0.5) * 2e3);
+    oe_lda_reference(fcb, ref, nfr);
+    feat_lda_transform(fcb, feat, nfr);
+
+    ndiff = 0;
+    for (i = 0; i < nfr; ++i)
+        if (memcmp(ref[i][0], feat[i][0], len * sizeof(mfcc_t)) != 0)
+            ++ndiff;
+
+    feat_array_free(ref);
+    feat_array_free(feat);
+    feat_free(fcb);
+    return ndiff;
+}
+
+/* Create a decoder.  The model and language model come first in the
+ * arguments, followed by extra_args. */
+static ps_decoder_t *
+oe_decoder_init(char const *hmm, char const *lm, char const *dict,
+                char const *const *extra_args, int32 n_extra_args)
+{
+    char const **argv;
+    cmd_ln_t *config;
+    ps_decoder_t *ps;
+    int32 argc;
+
+    argv = ckd_calloc(6 + n_extra_args, sizeof(*argv));
+    argv[0] = "-hmm";
+    argv[1] = hmm;
+    argv[2] = "-lm";
+    argv[3] = lm;
+    argv[4] = "-dict";
+    argv[5] = dict;
+    for (argc = 0; argc < n_extra_args; ++argc)
+        argv[6 + argc] = extra_args[argc];
+    argc = 6 + n_extra_args;
+    config = cmd_ln_parse_r(NULL, ps_args(), argc, (char **)argv, FALSE);
+    ckd_free(argv);
+    if (config == NULL)
+        return NULL;
+    ps = ps_init(config);
+    cmd_ln_free_r(config);
+    return ps;
+}
+
+/* Decode audio the way live recognition does, in small blocks.  The
+ * arguments are as for oe_decoder_init().  If interrupt is set, the
+ * first half of the audio first goes to an utterance which is ended
+ * straight away, as when recognition is stopped mid-sentence.  Returns
+ * the hypothesis, to be freed with ckd_free(), or NULL on error. */
+static char *
+oe_decode_samples(char const *hmm, char const *lm, char const *dict,
+                  int16 const *spch, size_t nsamps,
+                  char const *const *extra_args, int32 n_extra_args,
+                  int interrupt, int32 *out_score)
+{
+    ps_decoder_t *ps;
+    char const *hyp;
+    char *result;
+    size_t i, n;
+
+    if ((ps = oe_decoder_init(hmm, lm, dict, extra_args, n_extra_args)) == NULL)
+        return NULL;
+
+    if (interrupt) {
+        ps_start_utt(ps);
+        for (i = 0; i < nsamps / 2; i += n) {
+            n = nsamps / 2 - i < 2048 ? nsamps / 2 - i : 2048;
+            ps_process_raw(ps, spch + i, n, FALSE, FALSE);
+        }
+        ps_end_utt(ps);
+    }
+    result = NULL;
+    if (ps_start_utt(ps) == 0) {
+        for (i = 0; i < nsamps; i += n) {
+            n = nsamps - i < 2048 ? nsamps - i : 2048;
+            if (ps_process_raw(ps, spch + i, n, FALSE, FALSE) < 0)
+                break;
+        }
+        if (i == nsamps && ps_end_utt(ps) == 0
+            && (hyp = ps_get_hyp(ps, out_score)) != NULL)
+            result = ckd_salloc(hyp);
+    }
+
+    ps_free(ps);
+    return result;
+}
+
+/* Decode a test WAV with oe_decode_samples(). */
+static char *
+oe_decode_wav(char const *hmm, char const *lm, char const *dict,
+              char const *wavpath, char const *const *extra_args,
+              int32 n_extra_args, int interrupt, int32 *out_score)
+{
+    char *result;
+    int16 *spch;
+    size_t nsamps;
+
+    if ((spch = oe_read_test_wav(wavpath, &nsamps)) == NULL)
+        return NULL;
+    result = oe_decode_samples(hmm, lm, dict, spch, nsamps, extra_args,
+                               n_extra_args, interrupt, out_score);
+    ckd_free(spch);
+    return result;
+}
+
+/* Decode a test WAV in one utterance, in small blocks, and get the
+ * number of frames scored and of those which reused the senone scores
+ * of an earlier frame.  Returns the hypothesis, to be freed with
+ * ckd_free(), or NULL on error. */
+static char *
+oe_decode_wav_skip(char const *hmm, char const *lm, char const *dict,
+                   char const *wavpath, char const *const *extra_args,
+                   int32 n_extra_args, int32 *out_score,
+                   int32 *out_nframe, int32 *out_nskip)
+{
+    ps_decoder_t *ps;
+    char const *hyp;
+    char *result;
+    int16 *spch;
+    size_t nsamps, i, n;
+    double ncpu, nsaved;
+
+    if ((spch = oe_read_test_wav(wavpath, &nsamps)) == NULL)
+        return NULL;
+    if ((ps = oe_decoder_init(hmm, lm, dict, extra_args, n_extra_args)) == NULL) {
+        ckd_free(spch);
+        return NULL;
+    }
+
+    result = NULL;
+    if (ps_start_utt(ps) == 0) {
+        for (i = 0; i < nsamps; i += n) {
+            n = nsamps - i < 2048 ? nsamps - i : 2048;
+            if (ps_process_raw(ps, spch + i, n, FALSE, FALSE) < 0)
+                break;
+        }
+        if (i == nsamps && ps_end_utt(ps) == 0
+            && (hyp = ps_get_hyp(ps, out_score)) != NULL)
+            result = ckd_salloc(hyp);
+        ps_get_utt_skip(ps, out_nframe, out_nskip, &ncpu, &nsaved);
+    }
+
+    ps_free(ps);
+    ckd_free(spch);
+    return result;
+}
+
+/* Decode a test WAV in one utterance, in small blocks, and check
+ * after each block that the stable part of the hypothesis (see
+ * ps_get_hyp_stable()) is the start of the final one, in whole words.
+ * out_nstable gets the number of blocks after which some words were
+ * stable and out_nbad the number of those whose stable words weren't
+ * the start of the final hypothesis.  Returns the hypothesis, then the
+ * word, start and end frame of each segment, one per line, to be freed
+ * with ckd_free(), or NULL on error. */
+static char *
+oe_decode_wav_stable(char const *hmm, char const *lm, char const *dict,
+                     char const *wavpath, char const *const *extra_args,
+                     int32 n_extra_args, int32 *out_nstable,
+                     int32 *out_nbad)
+{
+    ps_decoder_t *ps;
+    ps_seg_t *seg;
+    char const *hyp, *stable;
+    char **stables, *result, *tmp;
+    char line[256];
+    int16 *spch;
+    size_t nsamps, i, n, len;
+    int32 score, frame, n_stables, j;
+    int sf, ef;
+
+    *out_nstable = *out_nbad = 0;
+    if ((spch = oe_read_test_wav(wavpath, &nsamps)) == NULL)
+        return NULL;
+    if ((ps = oe_decoder_init(hmm, lm, dict, extra_args, n_extra_args)) == NULL) {
+        ckd_free(spch);
+        return NULL;
+    }
+
+    result = NULL;
+    stables = ckd_calloc(nsamps / 2048 + 1, sizeof(*stables));
+    n_stables = 0;
+    if (ps_start_utt(ps) == 0) {
+        for (i = 0; i < nsamps; i += n) {
+            n = nsamps - i < 2048 ? nsamps - i : 2048;
+            if (ps_process_raw(ps, spch + i, n, FALSE, FALSE) < 0)
+                break;
+            if ((stable = ps_get_hyp_stable(ps, &frame)) != NULL
+                && *stable != '\0')
+                stables[n_stables++] = ckd_salloc(stable);
+        }
+        if (i == nsamps && ps_end_utt(ps) == 0
+            && (hyp = ps_get_hyp(ps, &score)) != NULL) {
+            result = string_join(hyp, "\n", NULL);
+            for (seg = ps_seg_iter(ps, &score); seg; seg = ps_seg_next(seg)) {
+                ps_seg_frames(seg, &sf, &ef);
+                snprintf(line, sizeof(line), "%s %d %d\n",
+                         ps_seg_word(seg), sf, ef);
+                tmp = result;
+                result = string_join(tmp, line, NULL);
+                ckd_free(tmp);
+            }
+            for (j = 0; j < n_stables; ++j) {
+                len = strlen(stables[j]);
+                if (strncmp(hyp, stables[j], len) != 0
+                    || (hyp[len] != '\0' && hyp[len] != ' '))
+                    ++*out_nbad;
+            }
+            *out_nstable = n_stables;
+        }
+    }
+
+    for (j = 0; j < n_stables; ++j)
+        ckd_free(stables[j]);
+    ckd_free(stables);
+    ps_free(ps);
+    ckd_free(spch);
+    return result;
+}
+
+/* Split a hypothesis into words, in place.  Returns the number of
+ * words. */
+static int32
+oe_split_words(char *hyp, char **words, int32 max_words)
+{
+    int32 n;
+    char *word;
+
+    n = 0;
+    for (word = strtok(hyp, " "); word && n < max_words;
+         word = strtok(NULL, " "))
+        words[n++] = word;
+    return n;
+}
+
+/* Count the word substitutions, deletions and insertions which turn ref
+ * into hyp. */
+static int32
+oe_word_errors(char const *ref, char const *hyp)
+{
+    char *ref_copy, *hyp_copy, **ref_words, **hyp_words;
+    int32 n_ref, n_hyp, i, j, *prev, *cur, errors;
+
+    ref_copy = ckd_salloc(ref);
+    hyp_copy = ckd_salloc(hyp);
+    ref_words = ckd_calloc(strlen(ref) + 1, sizeof(*ref_words));
+    hyp_words = ckd_calloc(strlen(hyp) + 1, sizeof(*hyp_words));
+    n_ref = oe_split_words(ref_copy, ref_words, strlen(ref) + 1);
+    n_hyp = oe_split_words(hyp_copy, hyp_words, strlen(hyp) + 1);
+
+    prev = ckd_calloc(n_hyp + 1, sizeof(*prev));
+    cur = ckd_calloc(n_hyp + 1, sizeof(*cur));
+    for (j = 0; j <= n_hyp; ++j)
+        prev[j] = j;
+    for (i = 1; i <= n_ref; ++i) {
+        int32 *tmp;
+
+        cur[0] = i;
+        for (j = 1; j <= n_hyp; ++j) {
+            cur[j] = prev[j - 1]
+                + (strcmp(ref_words[i - 1], hyp_words[j - 1]) != 0);
+            if (prev[j] + 1 < cur[j])
+                cur[j] = prev[j] + 1;
+            if (cur[j - 1] + 1 < cur[j])
+                cur[j] = cur[j - 1] + 1;
+        }
+        tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    errors = prev[n_hyp];
+
+    ckd_free(prev);
+    ckd_free(cur);
+    ckd_free(ref_words);
+    ckd_free(hyp_words);
+    ckd_free(ref_copy);
+    ckd_free(hyp_copy);
+    return errors;
+}
+
+/* Decode a senone score file written with -senlogdir, with the same
+ * arguments as oe_decoder_init().  Returns the hypothesis, to be freed
+ * with ckd_free(), or NULL on error. */
+static char *
+oe_decode_senscr_file(char const *hmm, char const *lm, char const *dict,
+                      char const *senpath, char const *const *extra_args,
+                      int32 n_extra_args, int32 *out_score)
+{
+    ps_decoder_t *ps;
+    char const *hyp;
+    char *result;
+
+    if ((ps = oe_decoder_init(hmm, lm, dict, extra_args, n_extra_args)) == NULL)
+        return NULL;
+    result = NULL;
+    if (ps_decode_senscr_file(ps, senpath) >= 0
+        && (hyp = ps_get_hyp(ps, out_score)) != NULL)
+        result = ckd_salloc(hyp);
+    ps_free(ps);
+    return result;
+}
+
+/* Score every density of one codebook and stream with the eval_topn
+ * kernel, several at a time. */
+static void
+oe_tmg_topn_all(tied_mgau_eval_t *e, gauden_t *g, int32 m, int32 f,
+                mfcc_t const *obs, mfcc_t *out_d)
+{
+    mfcc_t const *mean[TIED_MGAU_MAX_LANE], *var[TIED_MGAU_MAX_LANE];
+    mfcc_t det[TIED_MGAU_MAX_LANE], d[TIED_MGAU_MAX_LANE];
+    int32 c, l;
+
+    for (c = 0; c < g->n_density; c += e->n_topn_lane) {
+        for (l = 0; l < e->n_topn_lane; ++l) {
+            int32 cw = MIN(c + l, g->n_density - 1);
+            mean[l] = g->mean[m][f][cw];
+            var[l] = g->var[m][f][cw];
+            det[l] = g->det[m][f][cw];
+        }
+        e->eval_topn(mean, var, det, obs, g->featlen[f], d);
+        for (l = 0; l < e->n_topn_lane && c + l < g->n_density; ++l)
+            out_d[c + l] = d[l];
+    }
+}
+
+/* Score every density of one codebook and stream with the eval_cb
+ * kernel, with nothing pruned. */
+static void
+oe_tmg_cb_all(tied_mgau_eval_t *e, gauden_t *g, int32 m, int32 f,
+              mfcc_t const *obs, mfcc_t *out_d)
+{
+    mfcc_t d[TIED_MGAU_MAX_LANE], dmin[TIED_MGAU_MAX_LANE];
+    int32 b, l;
+
+    for (b = 0; b < e->n_block; ++b) {
+        b = e->eval_cb(e->mean[m][f], e->var[m][f], e->det[m][f], obs,
+                       g->featlen[f], 4, (mfcc_t)WORST_DIST, b,
+                       e->n_block, d, dmin);
+        for (l = 0; l < e->n_lane && b * e->n_lane + l < g->n_density; ++l)
+            out_d[b * e->n_lane + l] = d[l];
+    }
+}
+
+/* Compare the density scores of the scalar tied-mixture kernels with
+ * the vector ones on random observations.  Half of them are close to
+ * a density of the model, the other half are far enough away that
+ * the fixed-point scores overflow and saturate.  Returns the number
+ * of scores which differ, or -1 on error. */
+static int32
+oe_tmg_compare_simd(char const *meanfn, char const *varfn, int32 n_obs)
+{
+    logmath_t *lmath;
+    gauden_t *ref_g, *g;
+    tied_mgau_eval_t *ref_e, *e;
+    mfcc_t *obs, *ref_d, *d;
+    uint32 saved;
+    int32 i, m, f, j, c, ndiff;
+
+    lmath = logmath_init(1.0001, 0, TRUE);
+    saved = simd_set_features(SIMD_NONE);
+    ref_g = gauden_init(meanfn, varfn, 0.0001, lmath);
+    ref_e = ref_g ? tied_mgau_eval_init(ref_g) : NULL;
+    simd_set_features(saved);
+    g = gauden_init(meanfn, varfn, 0.0001, lmath);
+    e = g ? tied_mgau_eval_init(g) : NULL;
+    if (ref_e == NULL || e == NULL) {
+        ndiff = -1;
+        goto done;
+    }
+
+    for (f = 0, j = 0; f < g->n_feat; ++f)
+        if (g->featlen[f] > j)
+            j = g->featlen[f];
+    obs = ckd_calloc(j, sizeof(*obs));
+    ref_d = ckd_calloc(g->n_density, sizeof(*ref_d));
+    d = ckd_calloc(g->n_density, sizeof(*d));
+    genrand_seed(1111);
+    ndiff = 0;
+    for (i = 0; i < n_obs; ++i) {
+        for (m = 0; m < g->n_mgau; ++m) {
+            for (f = 0; f < g->n_feat; ++f) {
+                c = genrand_int31() % g->n_density;
+                for (j = 0; j < g->featlen[f]; ++j) {
+                    if (i % 2)
+                        obs[j] = FLOAT2MFCC((genrand_res53() - 0.5) * 2e5);
+                    else
+                        obs[j] = g->mean[m][f][c][j]
+                            + FLOAT2MFCC((genrand_res53() - 0.5) * 2);
+                }
+                oe_tmg_topn_all(ref_e, ref_g, m, f, obs, ref_d);
+                oe_tmg_topn_all(e, g, m, f, obs, d);
+                for (c = 0; c < g->n_density; ++c)
+                    ndiff += (ref_d[c] != d[c]);
+                oe_tmg_cb_all(ref_e, ref_g, m, f, obs, ref_d);
+                oe_tmg_cb_all(e, g, m, f, obs, d);
+                for (c = 0; c < g->n_density; ++c)
+                    ndiff += (ref_d[c] != d[c]);
+            }
+        }
+    }
+    ckd_free(obs);
+    ckd_free(ref_d);
+    ckd_free(d);
+
+done:
+    if (ref_e)
+        tied_mgau_eval_free(ref_e);
+    if (e)
+        tied_mgau_eval_free(e);
+    if (ref_g)
+        gauden_free(ref_g);
+    if (g)
+        gauden_free(g);
+    logmath_free(lmath);
+    return ndiff;
+}
+
+#define OE_HMM_N_HMM 4000
+#define OE_HMM_N_SEN 2000
+#define OE_HMM_N_TMAT 4
+#define OE_HMM_N_FRAME 100
+
+/* A random state score, sometimes WORST_SCORE or just above it, as in
+ * HMMs which were just entered or are about to be pruned. */
+static int32
+oe_hmm_random_score(void)
+{
+    switch (genrand_int31() % 16) {
+    case 0:
+        return WORST_SCORE;
+    case 1:
+        return WORST_SCORE + genrand_int31() % 300;
+    default:
+        return -(int32)(genrand_int31() % 200000);
+    }
+}
+
+/* Evaluate random HMMs with hmm_vit_eval_add() and
+ * hmm_vit_eval_flush(), with the kernels chosen from the given
+ * features, and return a checksum of all their states after each
+ * frame.  The HMMs get random scores in the first frame and an eighth
+ * of them get new ones in each later frame.  The last transition
+ * matrix has no skips. */
+static uint32
+oe_hmm_checksum(uint32 simd, int32 n_emit_state)
+{
+    hmm_context_t *ctx;
+    hmm_t *hmm;
+    uint8 ***tp;
+    uint16 **sseq;
+    int16 *senscr;
+    uint32 saved, sum;
+    int32 i, j, k, f;
+
+    genrand_seed(1111);
+    tp = (uint8 ***)ckd_calloc_3d(OE_HMM_N_TMAT, n_emit_state,
+                                  n_emit_state + 1, sizeof(***tp));
+    for (k = 0; k < OE_HMM_N_TMAT; ++k)
+        for (i = 0; i < n_emit_state; ++i)
+            for (j = 0; j <= n_emit_state; ++j)
+                tp[k][i][j] = (j < i
+                               || (k == OE_HMM_N_TMAT - 1 && j == i + 2))
+                    ? 255 : genrand_int31() % 256;
+    sseq = (uint16 **)ckd_calloc_2d(OE_HMM_N_HMM, n_emit_state,
+                                    sizeof(**sseq));
+    senscr = ckd_calloc(OE_HMM_N_SEN, sizeof(*senscr));
+
+    saved = simd_set_features(simd);
+    ctx = hmm_context_init(n_emit_state, tp, OE_HMM_N_TMAT, senscr, sseq);
+    simd_set_features(saved);
+    hmm = ckd_calloc(OE_HMM_N_HMM, sizeof(*hmm));
+    for (i = 0; i < OE_HMM_N_HMM; ++i) {
+        for (j = 0; j < n_emit_state; ++j)
+            sseq[i][j] = genrand_int31() % OE_HMM_N_SEN;
+        hmm_init(ctx, &hmm[i], FALSE, i, genrand_int31() % OE_HMM_N_TMAT);
+    }
+
+    sum = 0;
+    for (f = 0; f < OE_HMM_N_FRAME; ++f) {
+        for (i = 0; i < OE_HMM_N_SEN; ++i)
+            senscr[i] = genrand_int31() % 3000;
+        for (i = 0; i < OE_HMM_N_HMM; ++i) {
+            if (f == 0 || genrand_int31() % 8 == 0) {
+                for (j = 0; j < n_emit_state; ++j) {
+                    hmm_score(&hmm[i], j) = oe_hmm_random_score();
+                    hmm_history(&hmm[i], j) = genrand_int31();
+                }
+                hmm_out_score(&hmm[i]) = oe_hmm_random_score();
+                hmm_out_history(&hmm[i]) = genrand_int31();
+            }
+            hmm_frame(&hmm[i]) = f;
+        }
+
+        for (i = 0; i < OE_HMM_N_HMM; ++i)
+            hmm_vit_eval_add(ctx, &hmm[i]);
+        sum = sum * 31 + hmm_vit_eval_flush(ctx);
+        for (i = 0; i < OE_HMM_N_HMM; ++i) {
+            for (j = 0; j < n_emit_state; ++j)
+                sum = (sum * 31 + hmm_score(&hmm[i], j)) * 31
+                    + hmm_history(&hmm[i], j);
+            sum = ((sum * 31 + hmm_out_score(&hmm[i])) * 31
+                   + hmm_out_history(&hmm[i])) * 31 + hmm_bestscore(&hmm[i]);
+        }
+    }
+
+    for (i = 0; i < OE_HMM_N_HMM; ++i)
+        hmm_deinit(&hmm[i]);
+    ckd_free(hmm);
+    hmm_context_free(ctx);
+    ckd_free(senscr);
+    ckd_free_2d(sseq);
+    ckd_free_3d(tp);
+    return sum;
+}
+
+/* Sort scores best first, for qsort(). */
+static int
+oe_score_cmp(void const *a, void const *b)
+{
+    int32 sa = *(int32 const *)a, sb = *(int32 const *)b;
+
+    return (sa BETTER_THAN sb) ? -1 : (sb BETTER_THAN sa) ? 1 : 0;
+}
+
+/* Compare hmm_score_select() with sorting on n random scores drawn
+ * from n_distinct values (so that most are tied when it is small),
+ * some of them WORST_SCORE, for n_keep = 1, n and a few in between.
+ * Also checks that the scores are only reordered and that keeping
+ * those no worse than the result keeps at least n_keep of them.
+ * Returns the number of selections that went wrong. */
+static int32
+oe_score_select_compare(int32 n, int32 n_distinct)
+{
+    int32 *score, *sorted, *copy;
+    int32 i, t, n_keep, cutoff, n_kept, nerr;
+
+    genrand_seed(1111);
+    score = ckd_calloc(n, sizeof(*score));
+    sorted = ckd_calloc(n, sizeof(*sorted));
+    copy = ckd_calloc(n, sizeof(*copy));
+    for (i = 0; i < n; ++i) {
+        if (genrand_int31() % 16 == 0)
+            score[i] = WORST_SCORE;
+        else
+            score[i] = -(int32)(genrand_int31() % n_distinct) * 100;
+    }
+    memcpy(sorted, score, n * sizeof(*sorted));
+    qsort(sorted, n, sizeof(*sorted), oe_score_cmp);
+
+    nerr = 0;
+    for (t = 0; t < 6; ++t) {
+        if (t == 0)
+            n_keep = 1;
+        else if (t == 1)
+            n_keep = n;
+        else if (t == 2)
+            n_keep = (n + 1) / 2;
+        else
+            n_keep = 1 + genrand_int31() % n;
+        memcpy(copy, score, n * sizeof(*copy));
+        cutoff = hmm_score_select(copy, n, n_keep);
+        for (i = n_kept = 0; i < n; ++i)
+            if (!(cutoff BETTER_THAN copy[i]))
+                ++n_kept;
+        qsort(copy, n, sizeof(*copy), oe_score_cmp);
+        if (cutoff != sorted[n_keep - 1] || n_kept < n_keep
+            || memcmp(copy, sorted, n * sizeof(*copy)) != 0)
+            ++nerr;
+    }
+
+    ckd_free(score);
+    ckd_free(sorted);
+    ckd_free(copy);
+    return nerr;
+}
+
+#pragma mark -
+#pragma mark Test cases
+#pragma mark -
+
+@interface OESphinxEngineTests : XCTestCase
+@end
+
+@implementation OESphinxEngineTests
+
+- (NSString *)pathForTestWav:(NSString *)name {
+    return [self pathForResource:name ofType:@"wav"];
+}
+
+- (NSString *)pathForResource:(NSString *)name ofType:(NSString *)type {
+    return [[OETestTools environmentAppropriateBundle] pathForResource:name ofType:type];
+}
+
+- (NSArray *)testWavNames {
+    return @[@"Reference1Headphones", @"Reference2VeryBriefA", @"change_model_short", @"word_statement_etc_short", @"spanish_short"];
+}
+
+- (void)testFrontEndFFTAndPowerSpectrumMatchScalarCode {
+
+    // The vector FFT butterflies and power spectrum have to give exactly the same cepstra as the scalar code, in the default configuration and with a larger FFT. Silence is kept so that every frame of the WAV is compared.
+    char const *const defaultArgs[] = {"-samprate", "16000", "-remove_silence", "no"};
+    char const *const largeFFTArgs[] = {"-samprate", "16000", "-remove_silence", "no", "-nfft", "1024", "-remove_dc", "yes", "-transform", "dct"};
+
+    for(NSString *name in [self testWavNames]) {
+        char const *path = [[self pathForTestWav:name] UTF8String];
+        XCTAssertEqual(oe_fe_compare_simd(path, TRUE, defaultArgs, 4), 0, @"Vector FFT cepstra differ from the scalar ones for %@", name);
+        XCTAssertEqual(oe_fe_compare_simd(path, TRUE, largeFFTArgs, 10), 0, @"Vector FFT cepstra differ from the scalar ones for %@ with -nfft 1024", name);
+    }
+}
+
+- (void)testFrontEndBlocksMatchFrameByFrame {
+
+    // fe_process_frames() runs several frames per block when there is room for their output, and has to give exactly the same cepstra as when it has room for one frame at a time, with and without voice activity detection and a long prespeech buffer. (Dither is left out: its random numbers already depend on how the audio is split into calls.)
+    char const *const noVADArgs[] = {"-samprate", "16000", "-remove_silence", "no"};
+    char const *const vadArgs[] = {"-samprate", "16000"};
+    char const *const longPrespeechArgs[] = {"-samprate", "16000", "-vad_prespeech", "40", "-vad_postspeech", "30"};
+
+    for(NSString *name in [self testWavNames]) {
+        char const *path = [[self pathForTestWav:name] UTF8String];
+        XCTAssertEqual(oe_fe_compare_blocks(path, noVADArgs, 4), 0, @"Cepstra computed in blocks differ from frame by frame ones for %@", name);
+        XCTAssertEqual(oe_fe_compare_blocks(path, vadArgs, 2), 0, @"Cepstra computed in blocks differ from frame by frame ones for %@ with VAD", name);
+        XCTAssertEqual(oe_fe_compare_blocks(path, longPrespeechArgs, 6), 0, @"Cepstra computed in blocks differ from frame by frame ones for %@ with a long prespeech buffer", name);
+    }
+}
+
+- (void)testCheapVADKeepsPrespeechWhenReplayedFramesStartSpeech {
+
+    // When the first frame -vad_cheap replays starts speech, the front end has to give back the 10 prespeech frames before it, that frame, the 9 replayed after it and the new one, without dropping prespeech frames to make room for the replayed ones.
+    char const *const args[] = {"-samprate", "16000", "-remove_noise", "no", "-vad_cheap", "yes", "-vad_prespeech", "10", "-vad_startspeech", "1"};
+    cmd_ln_t *config = cmd_ln_parse_r(NULL, fe_get_args(), 10, (char **)args, FALSE);
+    size_t nsamps = 0;
+    int16 *spch = oe_fe_replayed_onset(30, &nsamps);
+
+    XCTAssertEqual(oe_fe_max_frames_per_shift(config, spch, nsamps), 21, @"The front end didn't give back the whole prespeech buffer when replayed frames started speech");
+    ckd_free(spch);
+    cmd_ln_free_r(config);
+}
+
+- (void)testResampledInputGivesTheSameFramesAndHypotheses {
+
+    // Test WAVs are upsampled to 44.1 and 48 kHz and fed back in with -insamprate. The resampler only holds back the last few samples, which need input past the end, so the front end has to give as many frames as for the 16 kHz audio, and the hypotheses have to stay within one word in five of the 16 kHz ones.
+    char const *hmm = [[self pathForResource:@"AcousticModelEnglish" ofType:@"bundle"] UTF8String];
+    char const *lm = [[self pathForResource:@"Sherlock" ofType:@"arpa"] UTF8String];
+    char const *dict = [[self pathForResource:@"Sherlock" ofType:@"dic"] UTF8String];
+    char const *const nativeArgs[] = {"-samprate", "16000", "-remove_silence", "no"};
+
+    for(NSString *name in @[@"Reference1Headphones", @"word_statement_etc_short", @"change_model_short"]) {
+        size_t nsamps = 0;
+        int16 *spch = oe_read_test_wav([[self pathForTestWav:name] UTF8String], &nsamps);
+        cmd_ln_t *nativeConfig = cmd_ln_parse_r(NULL, fe_get_args(), 4, (char **)nativeArgs, FALSE);
+        int32 nativeFrames = 0, nativeScore = 0;
+        mfcc_t **nativeCep = oe_fe_cepstra_chunked(nativeConfig, spch, nsamps, 1000, &nativeFrames);
+        char *native = oe_decode_samples(hmm, lm, dict, spch, nsamps, NULL, 0, FALSE, &nativeScore);
+
+        for(NSString *rate in @[@"44100", @"48000"]) {
+            size_t upsampledLength = 0;
+            int16 *upsampled = oe_upsample(spch, nsamps, [rate intValue], &upsampledLength);
+            int32 resampledLength = oe_resampled_length([rate intValue], upsampled, upsampledLength);
+            char const *const resampledArgs[] = {"-samprate", "16000", "-remove_silence", "no", "-insamprate", [rate UTF8String]};
+            cmd_ln_t *resampledConfig = cmd_ln_parse_r(NULL, fe_get_args(), 6, (char **)resampledArgs, FALSE);
+            int32 resampledFrames = 0, resampledScore = 0;
+            mfcc_t **resampledCep = oe_fe_cepstra_chunked(resampledConfig, upsampled, upsampledLength, 1000, &resampledFrames);
+            char *resampled = oe_decode_samples(hmm, lm, dict, upsampled, upsampledLength, resampledArgs + 4, 2, FALSE, &resampledScore);
+
+            XCTAssertTrue(resampledLength >= 0 && resampledLength <= (int32)nsamps && resampledLength >= (int32)nsamps - 16, @"Resampling %@ from %@ Hz gave %d samples instead of about %zu", name, rate, resampledLength, nsamps);
+            XCTAssertEqual(resampledFrames, nativeFrames, @"Resampling %@ from %@ Hz changed the number of frames", name, rate);
+            XCTAssertTrue(native != NULL && resampled != NULL, @"Decoding %@ failed", name);
+            if(native && resampled) {
+                int32 nativeWords = oe_word_errors(native, "");
+                XCTAssertTrue(oe_word_errors(native, resampled) * 5 <= nativeWords, @"Resampling %@ from %@ Hz changed the hypothesis \"%s\" to \"%s\"", name, rate, native, resampled);
+            }
+            ckd_free(resampled);
+            ckd_free_2d(resampledCep);
+            cmd_ln_free_r(resampledConfig);
+            ckd_free(upsampled);
+        }
+        ckd_free(native);
+        ckd_free_2d(nativeCep);
+        cmd_ln_free_r(nativeConfig);
+        ckd_free(spch);
+    }
+}
+
+- (void)testPitchFFTPeriodsStayCloseToDirectSums {
+
+    // Pitch estimation sums the YIN difference function directly unless yin_set_fft() is used. The FFT is exact and the direct sums round (coarsely in fixed point, where they are scaled down), so they can't agree on every frame, but they have to agree on the period of at least nine voiced frames in ten over all of the test WAVs.
+    int32 nDiffering = 0, nVoiced = 0;
+
+    for(NSString *name in [self testWavNames]) {
+        int32 nWavVoiced = 0;
+        int32 nWavDiffering = oe_yin_compare_fft([[self pathForTestWav:name] UTF8String], &nWavVoiced);
+        XCTAssertTrue(nWavDiffering >= 0, @"Pitch estimation with the FFT gave a different number of frames for %@", name);
+        nDiffering += nWavDiffering;
+        nVoiced += nWavVoiced;
+    }
+    XCTAssertTrue(nVoiced > 0, @"No voiced frames in the test WAVs");
+    XCTAssertTrue(nDiffering * 10 <= nVoiced, @"Pitch periods with the FFT differ from the direct sums on %d of %d voiced frames", nDiffering, nVoiced);
+}
+
+- (void)testFusedDeltaFeaturesMatchScalarCode {
+
+    // The live feature computation gets 1s_c_d_dd features from contiguous cepstra in one pass, with a vector kernel where there is one. It has to give exactly the same features as the feature function for arrays of frames, with the usual 13 coefficients and with other lengths, which leave different remainders after the vector loop.
+    int32 const cepsizes[] = {13, 16, 20, 1};
+    size_t i;
+
+    for(i = 0; i < sizeof(cepsizes) / sizeof(cepsizes[0]); ++i) {
+        XCTAssertEqual(oe_feat_compare_fused(SIMD_NONE, cepsizes[i], 200), 0, @"Scalar fused features differ from the feature function with %d coefficients", cepsizes[i]);
+        XCTAssertEqual(oe_feat_compare_fused(~0U, cepsizes[i], 200), 0, @"Vector fused features differ from the feature function with %d coefficients", cepsizes[i]);
+    }
+}
+
+- (void)testBlockedLDATransformMatchesFrameByFrame {
+
+    // feat_lda_transform() multiplies blocks of frames by the LDA matrix in place, padding the last block by repeating its last frame. It has to give exactly the same features as multiplying one frame at a time, with the scalar and the vector kernels, for frame counts which aren't multiples of the block size and for a transform which drops some dimensions.
+    NSString *ldaPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"OESphinxEngineTests.lda"];
+    int32 const frameCounts[] = {1, 3, 4, 5, 7, 101};
+    int32 const dims[] = {39, 29};
+    size_t i, j;
+
+    for(i = 0; i < sizeof(dims) / sizeof(dims[0]); ++i) {
+        for(j = 0; j < sizeof(frameCounts) / sizeof(frameCounts[0]); ++j) {
+            XCTAssertEqual(oe_lda_compare([ldaPath UTF8String], SIMD_NONE, dims[i], frameCounts[j]), 0, @"Scalar blocked LDA differs from frame by frame for %d frames to %d dimensions", frameCounts[j], dims[i]);
+            XCTAssertEqual(oe_lda_compare([ldaPath UTF8String], ~0U, dims[i], frameCounts[j]), 0, @"Vector blocked LDA differs from frame by frame for %d frames to %d dimensions", frameCounts[j], dims[i]);
+        }
+    }
+}
+
+- (void)testTiedMixtureKernelsMatchScalarCode {
+
+    // The vector density kernels used by PTM and semi-continuous models have to give exactly the same scores as the scalar code, including where fixed-point scores saturate.
+    NSString *hmm = [self pathForResource:@"AcousticModelEnglish" ofType:@"bundle"];
+    char const *meanfn = [[hmm stringByAppendingPathComponent:@"means"] UTF8String];
+    char const *varfn = [[hmm stringByAppendingPathComponent:@"variances"] UTF8String];
+
+    XCTAssertEqual(oe_tmg_compare_simd(meanfn, varfn, 20), 0, @"Vector density scores differ from the scalar ones");
+}
+
+- (void)testVectorHMMEvaluationMatchesScalarCode {
+
+    // Evaluating HMMs several at a time with the vector kernels has to leave every state score and history, the exit state and the best score exactly as the scalar code does, for 3- and 5-state HMMs with and without skips.
+    for(int32 nEmitState = 3; nEmitState <= 5; nEmitState += 2) {
+        XCTAssertEqual(oe_hmm_checksum(~0U, nEmitState), oe_hmm_checksum(SIMD_NONE, nEmitState), @"Vector %d-state HMM evaluation differs from the scalar code", nEmitState);
+    }
+}
+
+- (void)testHistogramPruningSelectsTheSameCutoffAsSorting {
+
+    // -maxhmmpf and -maxwpf prune to the score that hmm_score_select() finds, which has to be the n_keep-th best score just as sorting would find it, also when most of the scores are tied and when keeping one score or all of them.
+    int32 const counts[] = {1, 2, 3, 7, 100, 4001};
+    int32 const distinctValues[] = {1, 2, 5, 1000000};
+    size_t i, j;
+
+    for(i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        for(j = 0; j < sizeof(distinctValues) / sizeof(distinctValues[0]); ++j) {
+            XCTAssertEqual(oe_score_select_compare(counts[i], distinctValues[j]), 0, @"hmm_score_select() differs from sorting for %d scores of %d distinct values", counts[i], distinctValues[j]);
+        }
+    }
+}
+
+- (void)testReusedSenoneScoresStayCloseToFullScoring {
+
+    // With -ds_thresh, frames close to a recently scored one reuse its senone scores, for at most -ds_max frames in a row. With -ds_max 0 nothing may be reused and decoding has to be exactly the same as without -ds_thresh. With the default -ds_max 2 some frames have to be reused, never more than two in three, and the hypotheses have to stay within one word in five of the ones scored in full.
+    char const *hmm = [[self pathForResource:@"AcousticModelEnglish" ofType:@"bundle"] UTF8String];
+    char const *lm = [[self pathForResource:@"Sherlock" ofType:@"arpa"] UTF8String];
+    char const *dict = [[self pathForResource:@"Sherlock" ofType:@"dic"] UTF8String];
+    char const *const noReuseArgs[] = {"-ds_thresh", "10", "-ds_max", "0"};
+    char const *const reuseArgs[] = {"-ds_thresh", "10"};
+
+    for(NSString *name in @[@"Reference1Headphones", @"word_statement_etc_short", @"change_model_short"]) {
+        char const *path = [[self pathForTestWav:name] UTF8String];
+        int32 fullScore = 0, noReuseScore = 0, reuseScore = 0;
+        int32 fullFrames = 0, fullSkipped = 0, noReuseFrames = 0, noReuseSkipped = 0, reuseFrames = 0, reuseSkipped = 0;
+        char *full = oe_decode_wav_skip(hmm, lm, dict, path, NULL, 0, &fullScore, &fullFrames, &fullSkipped);
+        char *noReuse = oe_decode_wav_skip(hmm, lm, dict, path, noReuseArgs, 4, &noReuseScore, &noReuseFrames, &noReuseSkipped);
+        char *reuse = oe_decode_wav_skip(hmm, lm, dict, path, reuseArgs, 2, &reuseScore, &reuseFrames, &reuseSkipped);
+
+        XCTAssertTrue(full != NULL && noReuse != NULL && reuse != NULL, @"Decoding %@ failed", name);
+        XCTAssertEqual(fullSkipped, 0, @"Senone scores were reused for %@ without -ds_thresh", name);
+        XCTAssertEqual(noReuseSkipped, 0, @"Senone scores were reused for %@ with -ds_max 0", name);
+        XCTAssertEqual(reuseFrames, fullFrames, @"-ds_thresh changed the number of frames scored for %@", name);
+        XCTAssertTrue(reuseSkipped > 0 && reuseSkipped * 3 <= reuseFrames * 2 + 2, @"Senone scores were reused for %d of %d frames of %@", reuseSkipped, reuseFrames, name);
+        if(full && noReuse && reuse) {
+            int32 fullWords = oe_word_errors(full, "");
+            XCTAssertEqualObjects(@(noReuse), @(full), @"-ds_thresh with -ds_max 0 changed the hypothesis for %@", name);
+            XCTAssertEqual(noReuseScore, fullScore, @"-ds_thresh with -ds_max 0 changed the score for %@", name);
+            XCTAssertTrue(oe_word_errors(full, reuse) * 5 <= fullWords, @"Reusing senone scores changed the hypothesis for %@ from \"%s\" to \"%s\"", name, full, reuse);
+        }
+        ckd_free(full);
+        ckd_free(noReuse);
+        ckd_free(reuse);
+    }
+}
+
+- (void)testPipelineGivesTheSameHypotheses {
+
+    // Computing features on a separate thread with -pipeline yes must not change what is recognized, including after an utterance which was stopped halfway (live CMN carries over from it, so that case is compared with -pipeline no after the same interruption).
+    char const *hmm = [[self pathForResource:@"AcousticModelEnglish" ofType:@"bundle"] UTF8String];
+    char const *lm = [[self pathForResource:@"Sherlock" ofType:@"arpa"] UTF8String];
+    char const *dict = [[self pathForResource:@"Sherlock" ofType:@"dic"] UTF8String];
+    char const *const noPipelineArgs[] = {"-pipeline", "no"};
+    char const *const pipelineArgs[] = {"-pipeline", "yes"};
+
+    for(NSString *name in @[@"Reference1Headphones", @"word_statement_etc_short", @"change_model_short"]) {
+        char const *path = [[self pathForTestWav:name] UTF8String];
+        for(int interrupt = FALSE; interrupt <= TRUE; interrupt++) {
+            int32 referenceScore = 0, pipelineScore = 0;
+            char *reference = oe_decode_wav(hmm, lm, dict, path, noPipelineArgs, 2, interrupt, &referenceScore);
+            char *pipeline = oe_decode_wav(hmm, lm, dict, path, pipelineArgs, 2, interrupt, &pipelineScore);
+
+            XCTAssertTrue(reference != NULL && pipeline != NULL, @"Decoding %@ failed", name);
+            if(reference && pipeline) {
+                XCTAssertEqualObjects(@(pipeline), @(reference), @"-pipeline yes changed the hypothesis for %@ (interrupted: %d)", name, interrupt);
+                XCTAssertEqual(pipelineScore, referenceScore, @"-pipeline yes changed the score for %@ (interrupted: %d)", name, interrupt);
+            }
+            ckd_free(reference);
+            ckd_free(pipeline);
+        }
+    }
+}
+
+- (void)testReplayedSenoneScoreLogsGiveTheSameHypotheses {
+
+    // Compressed senone score logs written with -senlogdir have to replay to the same hypotheses as the live decode, both when only active senones are logged and with -compallsen. With only active senones, the phone loop lookahead scores each frame before the main search does with other senones, so both scorings have to be replayed.
+    char const *hmm = [[self pathForResource:@"AcousticModelEnglish" ofType:@"bundle"] UTF8String];
+    char const *lm = [[self pathForResource:@"Sherlock" ofType:@"arpa"] UTF8String];
+    char const *dict = [[self pathForResource:@"Sherlock" ofType:@"dic"] UTF8String];
+    NSString *logDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"OESphinxEngineTestsSenlog"];
+    char const *senlogdir = [logDirectory UTF8String];
+    char const *senfile = [[logDirectory stringByAppendingPathComponent:@"000000000.sen"] UTF8String];
+    char const *const activeArgs[] = {"-fwdflat", "no", "-bestpath", "no", "-pl_window", "5", "-senlogdir", senlogdir, "-sencomp", "yes"};
+    char const *const allArgs[] = {"-fwdflat", "no", "-bestpath", "no", "-compallsen", "yes", "-senlogdir", senlogdir, "-sencomp", "yes"};
+
+    [[NSFileManager defaultManager] createDirectoryAtPath:logDirectory withIntermediateDirectories:YES attributes:nil error:nil];
+    for(NSString *name in @[@"Reference1Headphones", @"word_statement_etc_short", @"change_model_short"]) {
+        char const *path = [[self pathForTestWav:name] UTF8String];
+        for(int compallsen = FALSE; compallsen <= TRUE; compallsen++) {
+            char const *const *args = compallsen ? allArgs : activeArgs;
+            int32 liveScore = 0, replayScore = 0;
+            // The replay gets the same arguments without -senlogdir, so that it doesn't overwrite the log it reads.
+            char *live = oe_decode_wav(hmm, lm, dict, path, args, 10, FALSE, &liveScore);
+            char *replay = oe_decode_senscr_file(hmm, lm, dict, senfile, args, 6, &replayScore);
+
+            XCTAssertTrue(live != NULL && replay != NULL, @"Decoding %@ failed (compallsen: %d)", name, compallsen);
+            if(live && replay) {
+                XCTAssertEqualObjects(@(replay), @(live), @"Replaying the senone scores changed the hypothesis for %@ (compallsen: %d)", name, compallsen);
+                XCTAssertEqual(replayScore, liveScore, @"Replaying the senone scores changed the score for %@ (compallsen: %d)", name, compallsen);
+            }
+            ckd_free(live);
+            ckd_free(replay);
+        }
+    }
+    [[NSFileManager defaultManager] removeItemAtPath:logDirectory error:nil];
+}
+
+- (void)testCompactedBackpointerTableGivesTheSameSegments {
+
+    // With -bptblgc the backpointer table is compacted during the search, which must not change the hypothesis or the word segments. The words that ps_get_hyp_stable() reports as settled while decoding have to be where the final hypothesis starts.
+    char const *hmm = [[self pathForResource:@"AcousticModelEnglish" ofType:@"bundle"] UTF8String];
+    char const *lm = [[self pathForResource:@"Sherlock" ofType:@"arpa"] UTF8String];
+    char const *dict = [[self pathForResource:@"Sherlock" ofType:@"dic"] UTF8String];
+    char const *const referenceArgs[] = {"-fwdflat", "no", "-bestpath", "no", "-bptblgc", "0"};
+    char const *const compactedArgs[] = {"-fwdflat", "no", "-bestpath", "no", "-bptblgc", "1"};
+    int32 totalStable = 0;
+
+    for(NSString *name in @[@"Reference1Headphones", @"word_statement_etc_short", @"change_model_short"]) {
+        char const *path = [[self pathForTestWav:name] UTF8String];
+        int32 referenceStable = 0, referenceBad = 0, compactedStable = 0, compactedBad = 0;
+        char *reference = oe_decode_wav_stable(hmm, lm, dict, path, referenceArgs, 6, &referenceStable, &referenceBad);
+        char *compacted = oe_decode_wav_stable(hmm, lm, dict, path, compactedArgs, 6, &compactedStable, &compactedBad);
+
+        XCTAssertTrue(reference != NULL && compacted != NULL, @"Decoding %@ failed", name);
+        if(reference && compacted) {
+            XCTAssertEqualObjects(@(compacted), @(reference), @"-bptblgc 1 changed the hypothesis or segments for %@", name);
+        }
+        XCTAssertEqual(compactedBad, 0, @"%d of %d stable hypotheses for %@ don't start the final one", compactedBad, compactedStable, name);
+        totalStable += compactedStable;
+        ckd_free(reference);
+        ckd_free(compacted);
+    }
+    XCTAssertGreaterThan(totalStable, 0, @"No words became stable before the end of an utterance with -bptblgc 1");
+}
+
+@end